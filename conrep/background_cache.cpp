@@ -0,0 +1,139 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// background_cache.cpp
+// implementation of the background cache key and file layout
+
+#include "background_cache.h"
+
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+namespace console {
+  namespace {
+    const std::uint32_t CACHE_MAGIC   = 0x47425243; // "CRBG"
+    const std::uint32_t CACHE_VERSION = 1;
+    // the pixels start on a 16 byte boundary
+    const size_t PIXEL_ALIGNMENT = 16;
+
+    struct CacheHeader {
+      std::uint32_t magic;
+      std::uint32_t version;
+      std::uint32_t key_size;
+      std::int32_t width;
+      std::int32_t height;
+      std::uint32_t pixel_offset;
+    };
+
+    template <typename T>
+    void append(std::vector<unsigned char> & buffer, T value) {
+      size_t size = buffer.size();
+      buffer.resize(size + sizeof(T));
+      std::memcpy(&buffer[size], &value, sizeof(T));
+    }
+
+    // Field by field, so padding never ends up in the comparison. Names are
+    //   stored as UTF-16 code units whatever the size of wchar_t.
+    void serialize(const BackgroundKey & key, std::vector<unsigned char> & buffer) {
+      buffer.clear();
+      append(buffer, static_cast<std::uint32_t>(key.wallpaper_name.size()));
+      for (size_t i = 0; i < key.wallpaper_name.size(); ++i) {
+        append(buffer, static_cast<std::uint16_t>(key.wallpaper_name[i]));
+      }
+      append(buffer, key.modify_time);
+      append(buffer, static_cast<std::int32_t>(key.style));
+      append(buffer, key.background_color);
+      append(buffer, static_cast<std::int32_t>(key.monitor.left));
+      append(buffer, static_cast<std::int32_t>(key.monitor.top));
+      append(buffer, static_cast<std::int32_t>(key.monitor.right));
+      append(buffer, static_cast<std::int32_t>(key.monitor.bottom));
+      append(buffer, static_cast<std::int32_t>(key.origin_x));
+      append(buffer, static_cast<std::int32_t>(key.origin_y));
+      append(buffer, static_cast<std::int32_t>(key.os_version));
+    }
+
+    size_t pixel_offset(size_t key_size) {
+      size_t offset = sizeof(CacheHeader) + key_size;
+      return (offset + PIXEL_ALIGNMENT - 1) / PIXEL_ALIGNMENT * PIXEL_ALIGNMENT;
+    }
+  }
+
+  std::string background_cache_name(const BackgroundKey & key) {
+    std::stringstream sstr;
+    sstr << "monitor_" << key.monitor.left << "_" << key.monitor.top << "_"
+         << (key.monitor.right - key.monitor.left) << "x"
+         << (key.monitor.bottom - key.monitor.top) << ".bgc";
+    return sstr.str();
+  }
+
+  size_t background_cache_size(const BackgroundKey & key, Dimension dim) {
+    std::vector<unsigned char> key_bytes;
+    serialize(key, key_bytes);
+    return pixel_offset(key_bytes.size()) + static_cast<size_t>(dim.width) * dim.height * sizeof(Pixel);
+  }
+
+  void write_background_cache(void * dest, const BackgroundKey & key, Dimension dim,
+                              const Pixel * pixels, int stride) {
+    std::vector<unsigned char> key_bytes;
+    serialize(key, key_bytes);
+
+    CacheHeader header;
+    header.magic        = CACHE_MAGIC;
+    header.version      = CACHE_VERSION;
+    header.key_size     = static_cast<std::uint32_t>(key_bytes.size());
+    header.width        = dim.width;
+    header.height       = dim.height;
+    header.pixel_offset = static_cast<std::uint32_t>(pixel_offset(key_bytes.size()));
+
+    unsigned char * out = static_cast<unsigned char *>(dest);
+    std::memcpy(out, &header, sizeof(header));
+    std::memcpy(out + sizeof(header), &key_bytes[0], key_bytes.size());
+    std::memset(out + sizeof(header) + key_bytes.size(), 0,
+                header.pixel_offset - sizeof(header) - key_bytes.size());
+
+    Pixel * dest_pixels = reinterpret_cast<Pixel *>(out + header.pixel_offset);
+    for (int y = 0; y < dim.height; ++y) {
+      std::memcpy(dest_pixels + y * dim.width, pixels + y * stride, dim.width * sizeof(Pixel));
+    }
+  }
+
+  const Pixel * read_background_cache(const void * data, size_t size,
+                                      const BackgroundKey & key, Dimension & dim) {
+    CacheHeader header;
+    if (size < sizeof(header)) return 0;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION) return 0;
+
+    std::vector<unsigned char> key_bytes;
+    serialize(key, key_bytes);
+    if (header.key_size != key_bytes.size() ||
+        header.pixel_offset != pixel_offset(key_bytes.size())) return 0;
+    const unsigned char * in = static_cast<const unsigned char *>(data);
+    if (std::memcmp(in + sizeof(header), &key_bytes[0], key_bytes.size())) return 0;
+
+    // the key holds the monitor, which fixes the size of the background
+    if (header.width  != key.monitor.right - key.monitor.left ||
+        header.height != key.monitor.bottom - key.monitor.top ||
+        header.width <= 0 || header.height <= 0) return 0;
+    if (size < header.pixel_offset + static_cast<size_t>(header.width) * header.height * sizeof(Pixel)) return 0;
+
+    dim = Dimension(header.width, header.height);
+    return reinterpret_cast<const Pixel *>(in + header.pixel_offset);
+  }
+}
\ No newline at end of file
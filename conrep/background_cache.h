@@ -0,0 +1,67 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Key and file layout for composed monitor backgrounds kept on disk, so that
+//   a restart or device reset can map a file and upload it instead of
+//   decoding and scaling the wallpaper again. A cache file is a header, the
+//   key it was built from and then the pixels, tightly packed. The whole key
+//   is stored and compared, so a stale or foreign file is just a miss.
+
+#ifndef CONREP_BACKGROUND_CACHE_H
+#define CONREP_BACKGROUND_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "dimension.h"
+#include "framebuffer.h"
+
+namespace console {
+  struct BackgroundKey {
+    std::wstring wallpaper_name;
+    std::uint64_t modify_time;     // of the wallpaper file
+    int style;                     // WallpaperStyle
+    std::uint32_t background_color;
+    PixelRect monitor;             // in virtual screen coordinates
+    int origin_x;                  // virtual screen origin, which tiles are
+    int origin_y;                  //   aligned to
+    int os_version;                // major * 256 + minor, for OS specific
+                                   //   layouts
+  };
+
+  // File name for key's monitor. Names depend only on the monitor geometry,
+  //   so there is one file per monitor layout seen and a stale background is
+  //   overwritten rather than left behind.
+  std::string background_cache_name(const BackgroundKey & key);
+
+  // bytes in the cache file for a dim sized background
+  size_t background_cache_size(const BackgroundKey & key, Dimension dim);
+
+  // Writes the file contents into dest, which must hold
+  //   background_cache_size(key, dim) bytes. stride is in pixels.
+  void write_background_cache(void * dest, const BackgroundKey & key, Dimension dim,
+                              const Pixel * pixels, int stride);
+
+  // Returns the pixels in the size bytes at data if they hold a background
+  //   built from key, with its dimensions in dim; otherwise 0.
+  const Pixel * read_background_cache(const void * data, size_t size,
+                                      const BackgroundKey & key, Dimension & dim);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// background_layout.cpp
+// implementation of the BackgroundLayout class
+
+#include "background_layout.h"
+
+#include <algorithm>
+
+namespace console {
+  namespace {
+    bool same_rect(const PixelRect & lhs, const PixelRect & rhs) {
+      return (lhs.left == rhs.left) && (lhs.top == rhs.top) &&
+             (lhs.right == rhs.right) && (lhs.bottom == rhs.bottom);
+    }
+
+    bool same_pieces(const std::vector<BackgroundPiece> & lhs, const std::vector<BackgroundPiece> & rhs) {
+      if (lhs.size() != rhs.size()) return false;
+      for (size_t i = 0; i < lhs.size(); ++i) {
+        if ((lhs[i].monitor != rhs[i].monitor) ||
+            !same_rect(lhs[i].source, rhs[i].source) ||
+            !same_rect(lhs[i].dest, rhs[i].dest)) return false;
+      }
+      return true;
+    }
+  }
+
+  BackgroundLayout::BackgroundLayout() : valid_(false) {}
+
+  bool BackgroundLayout::update(PixelRect window, const std::vector<PixelRect> & monitors) {
+    previous_.swap(pieces_);
+    pieces_.clear();
+    for (size_t i = 0; i < monitors.size(); ++i) {
+      const PixelRect & m = monitors[i];
+      PixelRect overlap = {
+        std::max(window.left, m.left),
+        std::max(window.top, m.top),
+        std::min(window.right, m.right),
+        std::min(window.bottom, m.bottom)
+      };
+      if ((overlap.left >= overlap.right) || (overlap.top >= overlap.bottom)) continue;
+
+      BackgroundPiece piece;
+      piece.monitor = static_cast<int>(i);
+      PixelRect source = { overlap.left - m.left, overlap.top - m.top, overlap.right - m.left, overlap.bottom - m.top };
+      PixelRect dest = { overlap.left - window.left, overlap.top - window.top, overlap.right - window.left, overlap.bottom - window.top };
+      piece.source = source;
+      piece.dest = dest;
+      pieces_.push_back(piece);
+    }
+
+    bool changed = !valid_ || !same_pieces(pieces_, previous_);
+    valid_ = true;
+    return changed;
+  }
+
+  void BackgroundLayout::invalidate(void) {
+    valid_ = false;
+  }
+
+  const std::vector<BackgroundPiece> & BackgroundLayout::pieces(void) const {
+    return pieces_;
+  }
+}
\ No newline at end of file
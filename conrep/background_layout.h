@@ -0,0 +1,57 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Works out which part of each monitor's wallpaper lies under a window, so
+//   that a window sized copy of it can be kept and only rebuilt when the
+//   window moves or resizes, the monitors change or the wallpaper does.
+
+#ifndef CONREP_BACKGROUND_LAYOUT_H
+#define CONREP_BACKGROUND_LAYOUT_H
+
+#include <vector>
+
+#include "framebuffer.h"
+
+namespace console {
+  struct BackgroundPiece {
+    int monitor;       // index into the monitors passed to update()
+    PixelRect source;  // in the monitor's wallpaper
+    PixelRect dest;    // in the window
+  };
+
+  class BackgroundLayout {
+    public:
+      BackgroundLayout();
+
+      // window and monitors are in screen coordinates. Returns whether the
+      //   pieces changed since the last update() or invalidate(), meaning a
+      //   copy built from the old pieces is stale.
+      bool update(PixelRect window, const std::vector<PixelRect> & monitors);
+      // the wallpaper or the copy of it was lost, so the next update()
+      //   returns true
+      void invalidate(void);
+
+      const std::vector<BackgroundPiece> & pieces(void) const;
+    private:
+      std::vector<BackgroundPiece> pieces_;
+      std::vector<BackgroundPiece> previous_; // work buffer
+      bool valid_;
+  };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,74 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// background_rects.cpp
+// implementation of the BackgroundMerger class
+
+#include "background_rects.h"
+
+namespace console {
+  BackgroundMerger::BackgroundMerger() {}
+
+  bool has_backgrounds(const Cell * cells, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      if (cell_attribute(cells[i]) >> 4) return true;
+    }
+    return false;
+  }
+
+  const std::vector<BackgroundRect> & BackgroundMerger::merge(const CellAttribute * attributes,
+                                                              int width,
+                                                              int first_row,
+                                                              int last_row,
+                                                              bool merge_rows) {
+    rects_.clear();
+    open_.clear();
+    for (int row = first_row; row < last_row; ++row) {
+      const CellAttribute * line = attributes + (row - first_row) * width;
+      next_open_.clear();
+      size_t candidate = 0; // position in open_ of the next rectangle to try
+      int j = 0;
+      while (j < width) {
+        int color = line[j] >> 4;
+        int start = j;
+        do {
+          ++j;
+        } while ((j < width) && ((line[j] >> 4) == color));
+        if (!color) continue;
+
+        // open_ is sorted by column, so only rectangles starting at or after
+        //   the last one examined can match this run
+        while ((candidate < open_.size()) && (rects_[open_[candidate]].left < start)) ++candidate;
+        if (merge_rows && (candidate < open_.size())) {
+          BackgroundRect & above = rects_[open_[candidate]];
+          if ((above.left == start) && (above.right == j) && (above.color == color)) {
+            above.bottom = row + 1;
+            next_open_.push_back(open_[candidate]);
+            ++candidate;
+            continue;
+          }
+        }
+        BackgroundRect r = { start, row, j, row + 1, color };
+        next_open_.push_back(rects_.size());
+        rects_.push_back(r);
+      }
+      open_.swap(next_open_);
+    }
+    return rects_;
+  }
+}
\ No newline at end of file
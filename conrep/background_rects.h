@@ -0,0 +1,71 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Merging of console cell backgrounds into rectangles so that each run of
+//   same colored cells can be drawn with a single quad.
+
+#ifndef CONREP_BACKGROUND_RECTS_H
+#define CONREP_BACKGROUND_RECTS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "cell_planes.h"
+
+namespace console {
+  // in cells; right and bottom are exclusive
+  struct BackgroundRect {
+    int left;
+    int top;
+    int right;
+    int bottom;
+    int color; // background color index, never 0
+  };
+
+  class BackgroundMerger {
+    public:
+      BackgroundMerger();
+
+      // Builds the rectangles covering every cell with a non-zero background
+      //   in rows first_row to last_row (exclusive). attributes points to the
+      //   attributes of first_row, with the following rows stored
+      //   contiguously after it. Horizontally adjacent cells of the same color
+      //   always form one rectangle; if merge_rows is set, rectangles with the
+      //   same columns and color in consecutive rows are also combined.
+      const std::vector<BackgroundRect> & merge(const CellAttribute * attributes,
+                                                int width,
+                                                int first_row,
+                                                int last_row,
+                                                bool merge_rows);
+    private:
+      std::vector<BackgroundRect> rects_;
+      // indices into rects_ of the rectangles that end on the previous row
+      //   and on the current row, in column order
+      std::vector<size_t> open_;
+      std::vector<size_t> next_open_;
+
+      BackgroundMerger(const BackgroundMerger &);
+      BackgroundMerger & operator=(const BackgroundMerger &);
+  };
+
+  // Whether any of count cells has a non-zero background, that is whether
+  //   merge() would build any rectangles for them.
+  bool has_backgrounds(const Cell * cells, size_t count);
+}
+
+#endif
\ No newline at end of file
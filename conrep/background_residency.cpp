@@ -0,0 +1,100 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// background_residency.cpp
+// implementation of the BackgroundResidency class
+
+#include "background_residency.h"
+
+#include <algorithm>
+
+namespace console {
+  BackgroundResidency::BackgroundResidency(unsigned idle_time)
+    : idle_time_(idle_time),
+      resident_bytes_(0)
+  {}
+
+  void BackgroundResidency::touch(const std::vector<MonitorKey> & monitors, std::uint32_t now) {
+    for (std::vector<MonitorKey>::const_iterator itr = monitors.begin(); itr != monitors.end(); ++itr) {
+      ResidentMap::iterator entry = resident_.find(*itr);
+      if (entry != resident_.end()) entry->second.last_covered = now;
+    }
+  }
+
+  void BackgroundResidency::cover(OwnerKey owner, const std::vector<MonitorKey> & monitors, std::uint32_t now) {
+    // the monitors being left start their idle time now
+    CoverageMap::iterator itr = coverage_.find(owner);
+    if (itr != coverage_.end()) {
+      touch(itr->second, now);
+      if (monitors.empty()) {
+        coverage_.erase(itr);
+      } else {
+        itr->second = monitors;
+      }
+    } else if (!monitors.empty()) {
+      coverage_[owner] = monitors;
+    }
+    touch(monitors, now);
+  }
+
+  void BackgroundResidency::loaded(MonitorKey monitor, std::size_t bytes, std::uint32_t now) {
+    // a new entry is value initialized, so counts zero bytes; a replaced
+    //   texture stops counting its old size
+    Entry & entry = resident_[monitor];
+    resident_bytes_ = resident_bytes_ - entry.bytes + bytes;
+    entry.bytes = bytes;
+    entry.last_covered = now;
+  }
+
+  void BackgroundResidency::clear(void) {
+    resident_.clear();
+    resident_bytes_ = 0;
+  }
+
+  bool BackgroundResidency::covered(MonitorKey monitor) const {
+    for (CoverageMap::const_iterator itr = coverage_.begin(); itr != coverage_.end(); ++itr) {
+      if (std::find(itr->second.begin(), itr->second.end(), monitor) != itr->second.end()) return true;
+    }
+    return false;
+  }
+
+  bool BackgroundResidency::evict(std::uint32_t now, std::vector<MonitorKey> & evicted) {
+    evicted.clear();
+    for (ResidentMap::iterator itr = resident_.begin(); itr != resident_.end();) {
+      if (covered(itr->first)) {
+        itr->second.last_covered = now;
+        ++itr;
+      } else if (static_cast<std::uint32_t>(now - itr->second.last_covered) >= idle_time_) {
+        evicted.push_back(itr->first);
+        resident_bytes_ -= itr->second.bytes;
+        resident_.erase(itr++);
+      } else {
+        ++itr;
+      }
+    }
+    return !evicted.empty();
+  }
+
+  bool BackgroundResidency::resident(MonitorKey monitor) const {
+    return resident_.find(monitor) != resident_.end();
+  }
+
+  std::size_t BackgroundResidency::resident_bytes(void) const {
+    return resident_bytes_;
+  }
+}
\ No newline at end of file
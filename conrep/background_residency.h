@@ -0,0 +1,77 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Decides which per monitor background textures stay in video memory. A
+//   texture is created the first time a window needs part of its monitor and
+//   released once no window has been over that monitor for a while. Time is
+//   passed in by the caller, in milliseconds from any clock that wraps at
+//   2^32, so the policy can be driven by simulated window movements.
+
+#ifndef CONREP_BACKGROUND_RESIDENCY_H
+#define CONREP_BACKGROUND_RESIDENCY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace console {
+  typedef std::uintptr_t MonitorKey; // HMONITOR
+  typedef std::uintptr_t OwnerKey;   // HWND of the window
+
+  class BackgroundResidency {
+    public:
+      // idle_time is how long a monitor must go without any window over it
+      //   before its texture is evicted
+      BackgroundResidency(unsigned idle_time);
+
+      // Records that owner now lies over monitors, replacing whatever it
+      //   covered before. An owner that goes away covers no monitors.
+      void cover(OwnerKey owner, const std::vector<MonitorKey> & monitors, std::uint32_t now);
+
+      // A texture of bytes was created for monitor.
+      void loaded(MonitorKey monitor, std::size_t bytes, std::uint32_t now);
+      // All textures were released, as on a wallpaper change or device reset.
+      //   What the owners cover is kept.
+      void clear(void);
+
+      // Stores the monitors whose textures should be released, and forgets
+      //   them, returning whether there were any.
+      bool evict(std::uint32_t now, std::vector<MonitorKey> & evicted);
+
+      bool resident(MonitorKey monitor) const;
+      std::size_t resident_bytes(void) const;
+    private:
+      struct Entry {
+        std::size_t bytes;
+        std::uint32_t last_covered;
+      };
+      typedef std::map<MonitorKey, Entry> ResidentMap;
+      typedef std::map<OwnerKey, std::vector<MonitorKey> > CoverageMap;
+
+      unsigned idle_time_;
+      ResidentMap resident_;
+      CoverageMap coverage_;
+      std::size_t resident_bytes_;
+
+      bool covered(MonitorKey monitor) const;
+      void touch(const std::vector<MonitorKey> & monitors, std::uint32_t now);
+  };
+}
+
+#endif
\ No newline at end of file
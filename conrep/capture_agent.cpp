@@ -0,0 +1,299 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// capture_agent.cpp
+// implementation of the capture agent process and the main process's end
+//   of its channel
+
+#include "capture_agent.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <new>
+#include <sstream>
+
+#include "capture_frame.h"
+#include "capture_policy.h"
+#include "capture_ring.h"
+#include "console_capture.h"
+#include "exception.h"
+#include "file_util.h"
+#include "poll_scheduler.h"
+#include "shell_process.h"
+#include "timer.h"
+
+using namespace ATL;
+
+namespace console {
+  // At the start of the file mapping, with the ring after it. Set up by the
+  //   main process before the agent starts.
+  struct CaptureChannelHeader {
+    DWORD host_process_id;
+    DWORD shell_process_id;
+    unsigned sweep_time;
+    std::atomic<std::uint32_t> resize_generation;
+    std::atomic<std::uint32_t> stop;
+  };
+
+  namespace {
+    const size_t CHANNEL_HEADER_SIZE = 64;
+    // A key frame of the largest console a monitor can show is a few
+    //   hundred kilobytes, and records must fit in half the ring.
+    const size_t CHANNEL_RING_CAPACITY = 2 * 1024 * 1024;
+    const size_t CHANNEL_SIZE = CHANNEL_HEADER_SIZE + ring_memory_size(CHANNEL_RING_CAPACITY);
+
+    // rows either side of the cursor read between sweeps
+    const int CURSOR_RADIUS = 2;
+
+    const TCHAR FRAME_EVENT_SUFFIX[] = _T("-frame");
+    const TCHAR POKE_EVENT_SUFFIX[]  = _T("-poke");
+
+    unsigned char * ring_memory(CaptureChannelHeader * header) {
+      return reinterpret_cast<unsigned char *>(header) + CHANNEL_HEADER_SIZE;
+    }
+
+    tstring channel_name(DWORD shell_process_id) {
+      tstringstream sstr;
+      sstr << _T("conrep-capture-") << GetCurrentProcessId() << _T("-") << shell_process_id;
+      return sstr.str();
+    }
+
+    // Unmaps the view when the agent returns.
+    class ViewReleaser {
+      public:
+        explicit ViewReleaser(void * view) : view_(view) {}
+        ~ViewReleaser() { UnmapViewOfFile(view_); }
+      private:
+        void * view_;
+
+        ViewReleaser(const ViewReleaser &);
+        ViewReleaser & operator=(const ViewReleaser &);
+    };
+
+    HANDLE open_event(const tstring & name) {
+      HANDLE event = OpenEvent(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, name.c_str());
+      if (!event) WIN_EXCEPT("Failed call to OpenEvent(). ");
+      return event;
+    }
+
+    HANDLE open_process(DWORD process_id) {
+      HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, process_id);
+      if (!process) WIN_EXCEPT("Failed call to OpenProcess(). ");
+      return process;
+    }
+
+    // Returns false if the shell closes before its console can be attached.
+    bool attach_shell_console(DWORD shell_process_id, HANDLE shell_process) {
+      while (!AttachConsole(shell_process_id)) {
+        // same transient errors as ShellProcess::attach()
+        DWORD err = GetLastError();
+        if (err != 31 && err != 5) WIN_EXCEPT2("Failed call to AttachConsole(). ", err);
+        DWORD ret = WaitForSingleObject(shell_process, CAPTURE_MIN_TIME);
+        if (ret == WAIT_OBJECT_0) return false;
+        if (ret == WAIT_FAILED) WIN_EXCEPT("Failed call to WaitForSingleObject(). ");
+      }
+      return true;
+    }
+
+    void agent_loop(const tstring & name) {
+      HANDLE mapping_handle = OpenFileMapping(FILE_MAP_WRITE, FALSE, name.c_str());
+      if (!mapping_handle) WIN_EXCEPT("Failed call to OpenFileMapping(). ");
+      CHandle mapping(mapping_handle);
+      void * view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, CHANNEL_SIZE);
+      if (!view) WIN_EXCEPT("Failed call to MapViewOfFile(). ");
+      ViewReleaser releaser(view);
+      CaptureChannelHeader * header = static_cast<CaptureChannelHeader *>(view);
+      if (!valid_ring(ring_memory(header), CHANNEL_SIZE - CHANNEL_HEADER_SIZE)) MISC_EXCEPT("Invalid capture channel. ");
+
+      CHandle frame_event(open_event(name + FRAME_EVENT_SUFFIX));
+      CHandle poke_event(open_event(name + POKE_EVENT_SUFFIX));
+      CHandle host_process(open_process(header->host_process_id));
+      CHandle shell_process(open_process(header->shell_process_id));
+
+      // started with DETACHED_PROCESS, so there's no console to free first
+      if (!attach_shell_console(header->shell_process_id, shell_process)) return;
+      // Ctrl+C typed into the console goes to every process attached to it
+      SetConsoleCtrlHandler(NULL, TRUE);
+      HANDLE output_handle = CreateFile(_T("CONOUT$"), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
+      if (output_handle == INVALID_HANDLE_VALUE) WIN_EXCEPT("Failed call to CreateFile(). ");
+      CHandle output(output_handle);
+      HWND console_window = GetConsoleWindow();
+      if (!console_window) WIN_EXCEPT("Failed call to GetConsoleWindow(). ");
+
+      RingWriter writer(ring_memory(header));
+      FrameEncoder encoder;
+      CapturePolicy policy(CURSOR_RADIUS, CAPTURE_RECENT_TIME, header->sweep_time);
+      PollScheduler scheduler(CAPTURE_MIN_TIME, CAPTURE_MAX_TIME, CAPTURE_IDLE_TIME);
+      ConsoleSnapshot snapshot;
+      CaptureFrame frame;
+      std::vector<unsigned char> record;
+      for (;;) {
+        DWORD ret = WaitForSingleObject(shell_process, 0);
+        if (ret == WAIT_FAILED) WIN_EXCEPT("Failed call to WaitForSingleObject(). ");
+        bool exited = (ret == WAIT_OBJECT_0);
+        #pragma warning(suppress: 28159)
+        std::uint32_t now = GetTickCount();
+        if (!exited) {
+          snapshot.resize_generation = header->resize_generation.load();
+          capture_console(output, console_window, policy, now, snapshot);
+          snapshot_to_frame(snapshot, frame);
+        } else {
+          frame.exited = true;
+        }
+
+        bool changed = encoder.encode(frame, record);
+        bool sent = false;
+        if (changed) {
+          if (record.size() > ring_max_record(CHANNEL_RING_CAPACITY)) MISC_EXCEPT("Console too large for the capture channel. ");
+          // If the main process has fallen behind the ring is full; the
+          //   rows go out with the next record instead.
+          sent = writer.write(&record[0], record.size());
+          if (sent) {
+            encoder.commit(frame);
+            if (!SetEvent(frame_event)) WIN_EXCEPT("Failed call to SetEvent(). ");
+          }
+        }
+        if (exited && sent) break;
+
+        // Reading a large console takes a while, so the scheduler is given
+        //   the time after it, as ConsoleCapture::run_attached() does.
+        #pragma warning(suppress: 28159)
+        now = GetTickCount();
+        HANDLE handles[] = { host_process, poke_event };
+        ret = WaitForMultipleObjects(2, handles, FALSE, scheduler.polled(now, changed));
+        if (ret == WAIT_FAILED) WIN_EXCEPT("Failed call to WaitForMultipleObjects(). ");
+        if (ret == WAIT_OBJECT_0) break;
+        if (header->stop.load()) break;
+        if (ret == WAIT_OBJECT_0 + 1) {
+          #pragma warning(suppress: 28159)
+          scheduler.input(GetTickCount());
+        }
+      }
+
+      const CapturePolicyCounts & counts = policy.counts();
+      tstringstream sstr;
+      sstr << _T("conrep: capture agent ") << counts.fast_reads << _T(" fast reads, ")
+           << counts.sweeps << _T(" sweeps, ") << counts.forced_sweeps << _T(" forced sweeps, ")
+           << counts.rows_read << _T(" rows read, ") << counts.missed_sweeps << _T(" sweeps found ")
+           << counts.missed_rows << _T(" missed rows\n");
+      OutputDebugString(sstr.str().c_str());
+    }
+  }
+
+  CaptureAgentHost::CaptureAgentHost(DWORD shell_process_id, unsigned sweep_time)
+    : header_(0)
+  {
+    tstring name = channel_name(shell_process_id);
+    HANDLE mapping = CreateFileMapping(INVALID_HANDLE_VALUE, // no backing file
+                                       0,
+                                       PAGE_READWRITE,
+                                       0,
+                                       static_cast<DWORD>(CHANNEL_SIZE),
+                                       name.c_str());
+    if (!mapping) WIN_EXCEPT("Failed call to CreateFileMapping(). ");
+    DWORD err = GetLastError();
+    mapping_.Attach(mapping);
+    // Someone else made a mapping by this name first, and what they put in
+    //   it would reach the agent. Better to read the console by attaching.
+    if (err == ERROR_ALREADY_EXISTS) MISC_EXCEPT("Capture channel name already in use. ");
+    void * view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, CHANNEL_SIZE);
+    if (!view) WIN_EXCEPT("Failed call to MapViewOfFile(). ");
+    try {
+      start_agent(view, name, shell_process_id, sweep_time);
+    } catch (...) {
+      UnmapViewOfFile(view);
+      throw;
+    }
+  }
+
+  void CaptureAgentHost::start_agent(void * view, const tstring & name, DWORD shell_process_id, unsigned sweep_time) {
+    header_ = new (view) CaptureChannelHeader;
+    header_->host_process_id = GetCurrentProcessId();
+    header_->shell_process_id = shell_process_id;
+    header_->sweep_time = sweep_time;
+    header_->resize_generation.store(0);
+    header_->stop.store(0);
+    init_ring(ring_memory(header_), CHANNEL_RING_CAPACITY);
+    reader_.reset(new RingReader(ring_memory(header_)));
+
+    HANDLE frame_event = CreateEvent(NULL, FALSE, FALSE, (name + FRAME_EVENT_SUFFIX).c_str());
+    if (!frame_event) WIN_EXCEPT("Failed call to CreateEvent(). ");
+    frame_event_.Attach(frame_event);
+    HANDLE poke_event = CreateEvent(NULL, FALSE, FALSE, (name + POKE_EVENT_SUFFIX).c_str());
+    if (!poke_event) WIN_EXCEPT("Failed call to CreateEvent(). ");
+    poke_event_.Attach(poke_event);
+
+    tstring command_line = _T("\"") + get_module_path() + _T("\" --capture_agent ") + name;
+    // CreateProcess() may modify the command line buffer
+    std::vector<TCHAR> buffer(command_line.begin(), command_line.end());
+    buffer.push_back(0);
+    PROCESS_INFORMATION pi = {};
+    STARTUPINFO si = { sizeof(STARTUPINFO) };
+    if (!CreateProcess(0, &buffer[0], 0, 0, FALSE, DETACHED_PROCESS, 0, 0, &si, &pi))
+      WIN_EXCEPT("Unable to spawn capture agent. ");
+    agent_process_.Attach(pi.hProcess);
+    if (!CloseHandle(pi.hThread)) WIN_EXCEPT("CloseHandle() failed on thread handle. ");
+  }
+
+  CaptureAgentHost::~CaptureAgentHost() {
+    if (header_) {
+      header_->stop.store(1);
+      SetEvent(poke_event_);
+      reader_.reset();
+      UnmapViewOfFile(header_);
+    }
+  }
+
+  HANDLE CaptureAgentHost::frame_event(void) const {
+    return frame_event_;
+  }
+
+  HANDLE CaptureAgentHost::agent_process(void) const {
+    return agent_process_;
+  }
+
+  void CaptureAgentHost::poke(void) {
+    if (!SetEvent(poke_event_)) WIN_EXCEPT("Failed call to SetEvent(). ");
+  }
+
+  void CaptureAgentHost::stop(void) {
+    header_->stop.store(1);
+    if (!SetEvent(poke_event_)) WIN_EXCEPT("Failed call to SetEvent(). ");
+  }
+
+  void CaptureAgentHost::set_resize_generation(unsigned generation) {
+    header_->resize_generation.store(generation);
+  }
+
+  RingRead CaptureAgentHost::read(std::vector<unsigned char> & record) {
+    return reader_->read(record);
+  }
+
+  int run_capture_agent(const tstring & channel_name) {
+    try {
+      agent_loop(channel_name);
+      return 0;
+    } catch (std::exception &) {
+      // Nobody would see a message box from here. The main process notices
+      //   the agent exiting and reads the console itself.
+      return EXIT_FAILURE;
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Capture agents are copies of conrep.exe started with --capture_agent. Each
+//   stays attached to one shell's console and streams its contents to the
+//   main process through shared memory. A process can only be attached to
+//   one console at a time, so with an agent per console the consoles are
+//   read in parallel, and the main process no longer attaches and detaches
+//   around every poll.
+
+#ifndef CONREP_CAPTURE_AGENT_H
+#define CONREP_CAPTURE_AGENT_H
+
+#include "windows.h"
+
+#include <memory>
+#include <vector>
+
+#include "atl.h"
+#include "capture_ring.h"
+#include "tchar.h"
+
+namespace console {
+  struct CaptureChannelHeader;
+
+  // The main process's end of the channel to an agent.
+  class CaptureAgentHost {
+    public:
+      // Sets up the channel and starts an agent for the console of the
+      //   process with id shell_process_id, which reads the whole console
+      //   every sweep_time milliseconds and the rows around the cursor in
+      //   between. Throws if either fails.
+      CaptureAgentHost(DWORD shell_process_id, unsigned sweep_time);
+      // asks the agent to exit
+      ~CaptureAgentHost();
+
+      HANDLE frame_event(void) const;   // set after the agent writes records
+      HANDLE agent_process(void) const; // signaled once the agent has exited
+
+      // Has the agent poll right away and return to the fastest rate.
+      void poke(void);
+      // Asks the agent to exit, such as once it has sent something that
+      //   makes no sense.
+      void stop(void);
+      // stamped on the frames the agent captures from now on
+      void set_resize_generation(unsigned generation);
+      // Moves the oldest record into record. Only one thread may read.
+      RingRead read(std::vector<unsigned char> & record);
+    private:
+      ATL::CHandle mapping_;
+      ATL::CHandle frame_event_;
+      ATL::CHandle poke_event_;
+      ATL::CHandle agent_process_;
+      CaptureChannelHeader * header_;
+      std::unique_ptr<RingReader> reader_;
+
+      // everything after mapping the channel, which is unmapped on failure
+      void start_agent(void * view, const tstring & name, DWORD shell_process_id, unsigned sweep_time);
+
+      CaptureAgentHost(const CaptureAgentHost &);
+      CaptureAgentHost & operator=(const CaptureAgentHost &);
+  };
+
+  // What conrep.exe --capture_agent channel_name runs instead of creating
+  //   windows. Returns the process exit code.
+  int run_capture_agent(const tstring & channel_name);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,219 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// capture_frame.cpp
+// implementation of the capture frame record encoding
+
+#include "capture_frame.h"
+
+#include <cstring>
+#include <utility>
+
+namespace console {
+  namespace {
+    enum {
+      FRAME_KEY    = 0x1,
+      FRAME_EXITED = 0x2
+    };
+
+    // Records are only read by the process that wrote them or another copy
+    //   of the same executable, so fields are copied as they are in memory.
+    struct RecordHeader {
+      std::uint32_t flags;
+      std::uint32_t resize_generation;
+      std::int32_t width;
+      std::int32_t height;
+      std::int32_t cursor_x;
+      std::int32_t cursor_y;
+      std::int32_t scroll_min;
+      std::int32_t scroll_max;
+      std::int32_t scroll_page;
+      std::int32_t scroll_pos;
+      std::int32_t scroll_track_pos;
+      std::uint32_t title_length; // in UTF-16 units
+      std::uint32_t row_count;    // each an index followed by width cells
+    };
+
+    // the title is padded to keep the rows after it aligned
+    size_t title_bytes(size_t length) {
+      return (length * sizeof(std::uint16_t) + 3) & ~size_t(3);
+    }
+
+    bool same_state(const RecordHeader & header, const CaptureFrame & frame) {
+      return (header.resize_generation == frame.resize_generation) &&
+             (header.cursor_x == frame.cursor_x) &&
+             (header.cursor_y == frame.cursor_y) &&
+             (header.scroll_min == frame.scroll_min) &&
+             (header.scroll_max == frame.scroll_max) &&
+             (header.scroll_page == frame.scroll_page) &&
+             (header.scroll_pos == frame.scroll_pos) &&
+             (header.scroll_track_pos == frame.scroll_track_pos);
+    }
+  }
+
+  CaptureFrame::CaptureFrame()
+    : exited(false),
+      resize_generation(0),
+      dim(0, 0),
+      cursor_x(0),
+      cursor_y(0),
+      scroll_min(0),
+      scroll_max(0),
+      scroll_page(0),
+      scroll_pos(0),
+      scroll_track_pos(0)
+  {}
+
+  FrameEncoder::FrameEncoder()
+    : have_previous_(false),
+      key_(false),
+      rows_(0),
+      bytes_(0)
+  {
+    FrameEncoderCounts counts = {};
+    counts_ = counts;
+  }
+
+  bool FrameEncoder::encode(const CaptureFrame & frame, std::vector<unsigned char> & record) {
+    RecordHeader header = {};
+    if (frame.exited) {
+      if (have_previous_ && previous_.exited) return false;
+      header.flags = FRAME_EXITED;
+      record.assign(reinterpret_cast<const unsigned char *>(&header),
+                    reinterpret_cast<const unsigned char *>(&header + 1));
+      key_ = true;
+      rows_ = 0;
+      bytes_ = record.size();
+      return true;
+    }
+
+    int width = frame.dim.width;
+    int height = frame.dim.height;
+    bool key = !have_previous_ ||
+               previous_.exited ||
+               (previous_.dim.width != width) ||
+               (previous_.dim.height != height);
+    header.flags = key ? FRAME_KEY : 0;
+    header.resize_generation = frame.resize_generation;
+    header.width = width;
+    header.height = height;
+    header.cursor_x = frame.cursor_x;
+    header.cursor_y = frame.cursor_y;
+    header.scroll_min = frame.scroll_min;
+    header.scroll_max = frame.scroll_max;
+    header.scroll_page = frame.scroll_page;
+    header.scroll_pos = frame.scroll_pos;
+    header.scroll_track_pos = frame.scroll_track_pos;
+    header.title_length = static_cast<std::uint32_t>(frame.title.size());
+
+    // Changed rows are gathered before anything is written so that an
+    //   unchanged frame leaves record alone.
+    std::uint32_t row_count = 0;
+    size_t row_bytes = sizeof(std::uint32_t) + width * sizeof(Cell);
+    size_t header_bytes = sizeof(RecordHeader) + title_bytes(frame.title.size());
+    record.resize(header_bytes);
+    for (int i = 0; (width > 0) && (i < height); ++i) {
+      const Cell * row = &frame.cells[i * width];
+      if (!key && !std::memcmp(row, &previous_.cells[i * width], width * sizeof(Cell))) continue;
+      size_t offset = record.size();
+      record.resize(offset + row_bytes);
+      std::uint32_t index = static_cast<std::uint32_t>(i);
+      std::memcpy(&record[offset], &index, sizeof(index));
+      std::memcpy(&record[offset + sizeof(index)], row, width * sizeof(Cell));
+      ++row_count;
+    }
+    if (!key && !row_count && same_state(header, previous_) && (frame.title == previous_.title)) return false;
+
+    header.row_count = row_count;
+    std::memcpy(&record[0], &header, sizeof(header));
+    if (header_bytes > sizeof(header)) std::memset(&record[sizeof(header)], 0, header_bytes - sizeof(header));
+    if (!frame.title.empty()) {
+      std::memcpy(&record[sizeof(header)], &frame.title[0], frame.title.size() * sizeof(std::uint16_t));
+    }
+    key_ = key;
+    rows_ = row_count;
+    bytes_ = record.size();
+    return true;
+  }
+
+  void FrameEncoder::commit(CaptureFrame & frame) {
+    if (key_) ++counts_.key_frames;
+    else      ++counts_.delta_frames;
+    counts_.rows_sent  += rows_;
+    counts_.bytes_sent += bytes_;
+
+    std::swap(previous_, frame);
+    have_previous_ = true;
+  }
+
+  const FrameEncoderCounts & FrameEncoder::counts(void) const {
+    return counts_;
+  }
+
+  bool apply_frame_record(const unsigned char * record, size_t size, CaptureFrame & frame) {
+    RecordHeader header;
+    if (size < sizeof(header)) return false;
+    std::memcpy(&header, record, sizeof(header));
+    if (header.flags & FRAME_EXITED) {
+      frame.exited = true;
+      return true;
+    }
+    if ((header.width < 0) || (header.height < 0)) return false;
+
+    size_t width = header.width;
+    size_t height = header.height;
+    size_t header_bytes = sizeof(header) + title_bytes(header.title_length);
+    size_t row_bytes = sizeof(std::uint32_t) + width * sizeof(Cell);
+    if ((header.title_length > size) || (header_bytes > size)) return false;
+    if (header.row_count > height) return false;
+    if (header.row_count * row_bytes != size - header_bytes) return false;
+
+    if (header.flags & FRAME_KEY) {
+      frame.exited = false;
+      frame.dim = Dimension(header.width, header.height);
+      frame.cells.resize(width * height);
+    } else if (frame.exited ||
+               (frame.dim.width != header.width) ||
+               (frame.dim.height != header.height) ||
+               (frame.cells.size() != width * height)) {
+      return false;
+    }
+
+    frame.resize_generation = header.resize_generation;
+    frame.cursor_x = header.cursor_x;
+    frame.cursor_y = header.cursor_y;
+    frame.scroll_min = header.scroll_min;
+    frame.scroll_max = header.scroll_max;
+    frame.scroll_page = header.scroll_page;
+    frame.scroll_pos = header.scroll_pos;
+    frame.scroll_track_pos = header.scroll_track_pos;
+    frame.title.resize(header.title_length);
+    if (header.title_length) {
+      std::memcpy(&frame.title[0], record + sizeof(header), header.title_length * sizeof(std::uint16_t));
+    }
+
+    const unsigned char * row = record + header_bytes;
+    for (std::uint32_t i = 0; i < header.row_count; ++i, row += row_bytes) {
+      std::uint32_t index;
+      std::memcpy(&index, row, sizeof(index));
+      if (index >= height) return false;
+      if (width) std::memcpy(&frame.cells[index * width], row + sizeof(index), width * sizeof(Cell));
+    }
+    return true;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// The console state a capture agent sends to the main process, and its
+//   encoding as ring records: a key frame holds every row, later records
+//   only the rows that changed since the last record the reader got. Kept
+//   free of Windows types, so the encoding can be checked anywhere;
+//   console_capture.cpp converts frames to and from ConsoleSnapshots.
+
+#ifndef CONREP_CAPTURE_FRAME_H
+#define CONREP_CAPTURE_FRAME_H
+
+#include <cstdint>
+#include <vector>
+
+#include "damage_set.h"
+#include "dimension.h"
+
+namespace console {
+  struct CaptureFrame {
+    CaptureFrame();
+
+    bool exited; // the shell process has closed; nothing else is filled in
+    std::uint32_t resize_generation;
+    Dimension dim;
+    std::vector<Cell> cells;
+    std::int32_t cursor_x;
+    std::int32_t cursor_y;
+    // the console window's vertical scroll bar
+    std::int32_t scroll_min;
+    std::int32_t scroll_max;
+    std::int32_t scroll_page;
+    std::int32_t scroll_pos;
+    std::int32_t scroll_track_pos;
+    std::vector<std::uint16_t> title; // UTF-16, without a terminator
+  };
+
+  struct FrameEncoderCounts { // for debugging
+    std::uint64_t key_frames;
+    std::uint64_t delta_frames;
+    std::uint64_t rows_sent;
+    std::uint64_t bytes_sent;
+  };
+
+  // Used by the capture agent. Deltas are always against the last frame
+  //   handed to commit(), so a record that couldn't be written because the
+  //   ring was full can just be dropped: the next encode() covers its rows.
+  class FrameEncoder {
+    public:
+      FrameEncoder();
+
+      // Fills record with what turns the last committed frame into frame.
+      //   Returns false, leaving record alone, if nothing changed.
+      bool encode(const CaptureFrame & frame, std::vector<unsigned char> & record);
+      // The record for frame was written. Takes the contents of frame
+      //   rather than copying them.
+      void commit(CaptureFrame & frame);
+
+      const FrameEncoderCounts & counts(void) const;
+    private:
+      CaptureFrame previous_;
+      bool have_previous_;
+      bool key_;          // what the last encode() produced, for commit()
+      std::uint32_t rows_;
+      size_t bytes_;
+      FrameEncoderCounts counts_;
+
+      FrameEncoder(const FrameEncoder &);
+      FrameEncoder & operator=(const FrameEncoder &);
+  };
+
+  // Used by the main process. Applies a record to frame, which must hold the
+  //   result of the records before it. Returns false if the record is
+  //   malformed or is a delta with no key frame before it; frame is then
+  //   left unspecified until the next key frame.
+  bool apply_frame_record(const unsigned char * record, size_t size, CaptureFrame & frame);
+}
+
+#endif
\ No newline at end of file
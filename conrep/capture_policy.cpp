@@ -0,0 +1,152 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// capture_policy.cpp
+// implementation of the CapturePolicy class
+
+#include "capture_policy.h"
+
+#include <algorithm>
+
+namespace console {
+  CapturePolicy::CapturePolicy(int cursor_radius, unsigned recent_time, unsigned sweep_time)
+    : cursor_radius_(cursor_radius),
+      recent_time_(recent_time),
+      sweep_time_(sweep_time),
+      dim_(0, 0),
+      viewport_top_(0),
+      cursor_row_(0),
+      burst_(false),
+      kind_(READ_RESET),
+      last_sweep_(0)
+  {
+    CapturePolicyCounts counts = {};
+    counts_ = counts;
+  }
+
+  bool CapturePolicy::plan(std::uint32_t now, Dimension dim, int viewport_top, int cursor_row, std::vector<RowRange> & hint) {
+    hint.clear();
+    int previous_cursor = cursor_row_;
+    cursor_row_ = cursor_row;
+
+    if ((dim.width != dim_.width) || (dim.height != dim_.height) || rows_.empty() || (viewport_top != viewport_top_)) {
+      dim_ = dim;
+      viewport_top_ = viewport_top;
+      RowState blank = { 0, 0, false };
+      rows_.assign(dim.height, blank);
+      kind_ = READ_RESET;
+    } else if (burst_) {
+      kind_ = READ_FORCED;
+    } else if (!sweep_time_ || (now - last_sweep_ >= sweep_time_)) {
+      kind_ = READ_SWEEP;
+    } else {
+      kind_ = READ_FAST;
+    }
+    burst_ = false;
+    if (kind_ == READ_RESET) {
+      last_sweep_ = now;
+      return true;
+    }
+
+    // Output goes through every row the cursor crossed since the last poll,
+    //   such as the lines printed by a command that didn't fill the screen.
+    add_range(std::min(previous_cursor, cursor_row) - cursor_radius_,
+              std::max(previous_cursor, cursor_row) + cursor_radius_ + 1,
+              hint);
+    int run_start = -1;
+    for (int i = 0; i <= dim_.height; ++i) {
+      bool recent = (i < dim_.height) &&
+                    rows_[i].changed &&
+                    (now - rows_[i].changed_at < recent_time_);
+      if (recent && (run_start < 0)) run_start = i;
+      if (!recent && (run_start >= 0)) {
+        add_range(run_start, i, hint);
+        run_start = -1;
+      }
+    }
+    if (kind_ == READ_FAST) return false;
+
+    // A sweep also stands in for this poll's fast read, so changes in these
+    //   rows weren't missed.
+    fast_rows_.swap(hint);
+    hint.clear();
+    last_sweep_ = now;
+    return true;
+  }
+
+  void CapturePolicy::observe(std::uint32_t now, const Cell * cells, const std::vector<ReadBand> & bands) {
+    int rows_read = 0;
+    int rows_changed = 0;
+    int rows_missed = 0;
+    for (size_t b = 0; b < bands.size(); ++b) {
+      int top = std::max(bands[b].top, 0);
+      int bottom = std::min(bands[b].bottom, static_cast<int>(rows_.size()));
+      for (int i = top; i < bottom; ++i) {
+        RowHash hash = hash_row(cells + i * dim_.width, dim_.width, 0xffffffff);
+        ++rows_read;
+        if ((hash == rows_[i].hash) && (kind_ != READ_RESET)) continue;
+        rows_[i].hash = hash;
+        // Every row differs from a blank baseline, so a reset says nothing
+        //   about which rows are active.
+        if (kind_ == READ_RESET) continue;
+        rows_[i].changed = true;
+        rows_[i].changed_at = now;
+        ++rows_changed;
+        if ((kind_ == READ_SWEEP) && !in_fast_rows(i)) ++rows_missed;
+      }
+    }
+    counts_.rows_read += rows_read;
+
+    switch (kind_) {
+      case READ_FAST:
+        ++counts_.fast_reads;
+        // Most of what was read changing, such as the screen scrolling with
+        //   the cursor on the last line, suggests the rest changed too.
+        burst_ = (rows_changed > 1) && (rows_changed * 2 > rows_read);
+        break;
+      case READ_SWEEP:
+        ++counts_.sweeps;
+        // with sweep_time 0 there are no fast reads to miss anything
+        if (rows_missed && sweep_time_) {
+          ++counts_.missed_sweeps;
+          counts_.missed_rows += rows_missed;
+        }
+        break;
+      case READ_FORCED:
+      case READ_RESET:
+        ++counts_.forced_sweeps;
+        break;
+    }
+  }
+
+  const CapturePolicyCounts & CapturePolicy::counts(void) const {
+    return counts_;
+  }
+
+  bool CapturePolicy::in_fast_rows(int row) const {
+    for (size_t i = 0; i < fast_rows_.size(); ++i) {
+      if ((row >= fast_rows_[i].first) && (row < fast_rows_[i].last)) return true;
+    }
+    return false;
+  }
+
+  void CapturePolicy::add_range(int first, int last, std::vector<RowRange> & hint) const {
+    RowRange r = { std::max(first, 0), std::min(last, dim_.height) };
+    if (r.first < r.last) hint.push_back(r);
+  }
+}
\ No newline at end of file
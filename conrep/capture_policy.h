@@ -0,0 +1,100 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Decides which rows of the console each poll reads. Most output lands on
+//   or near the cursor line, so between full reads only the rows around the
+//   cursor, the rows it moved across and the rows that changed recently are
+//   read. A full sweep at a lower rate catches changes anywhere else, such
+//   as a full screen program redrawing. Sweeps that find changes the fast
+//   reads missed are counted so the rates can be tuned. Time is passed in,
+//   as with PollScheduler, so the policy can be replayed against recorded
+//   frames.
+
+#ifndef CONREP_CAPTURE_POLICY_H
+#define CONREP_CAPTURE_POLICY_H
+
+#include <cstdint>
+#include <vector>
+
+#include "damage_set.h"
+#include "dimension.h"
+#include "read_planner.h"
+#include "scroll_detect.h"
+
+namespace console {
+  struct CapturePolicyCounts { // for debugging
+    std::uint64_t fast_reads;
+    std::uint64_t sweeps;        // run because sweep_time had passed
+    std::uint64_t forced_sweeps; // run early for a resize, a scroll or a burst of changes
+    std::uint64_t rows_read;
+    std::uint64_t missed_sweeps; // scheduled sweeps that found changes the fast reads missed
+    std::uint64_t missed_rows;
+  };
+
+  class CapturePolicy {
+    public:
+      // Fast reads cover cursor_radius rows either side of the cursor and the
+      //   rows that changed in the last recent_time milliseconds. A
+      //   sweep_time of 0 reads the whole viewport at every poll.
+      CapturePolicy(int cursor_radius, unsigned recent_time, unsigned sweep_time);
+
+      // Returns true if the whole viewport should be read at now, or else
+      //   fills hint with the rows to read. viewport_top is where the viewport
+      //   starts in the screen buffer; when it moves, so does every row.
+      bool plan(std::uint32_t now, Dimension dim, int viewport_top, int cursor_row, std::vector<RowRange> & hint);
+      // Reports the read planned at now: cells holds the whole viewport, and
+      //   the rows in bands were the ones just read.
+      void observe(std::uint32_t now, const Cell * cells, const std::vector<ReadBand> & bands);
+
+      const CapturePolicyCounts & counts(void) const;
+    private:
+      enum ReadKind {
+        READ_FAST,
+        READ_SWEEP,
+        READ_FORCED, // a sweep run early because the fast reads saw a burst
+        READ_RESET   // a sweep with nothing to compare against
+      };
+      struct RowState {
+        RowHash hash;
+        std::uint32_t changed_at;
+        bool changed; // changed_at is meaningful
+      };
+
+      int cursor_radius_;
+      unsigned recent_time_;
+      unsigned sweep_time_;
+
+      Dimension dim_;
+      int viewport_top_;
+      int cursor_row_;
+      bool burst_;          // the last fast read saw most of its rows change
+      ReadKind kind_;       // what the last plan() decided
+      std::uint32_t last_sweep_;
+      std::vector<RowState> rows_;
+      std::vector<RowRange> fast_rows_; // what a fast read would have covered, for sweeps
+      CapturePolicyCounts counts_;
+
+      void add_range(int first, int last, std::vector<RowRange> & hint) const;
+      bool in_fast_rows(int row) const;
+
+      CapturePolicy(const CapturePolicy &);
+      CapturePolicy & operator=(const CapturePolicy &);
+  };
+}
+
+#endif
\ No newline at end of file
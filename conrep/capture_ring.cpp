@@ -0,0 +1,144 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// capture_ring.cpp
+// implementation of the shared memory ring of capture records
+
+#include "capture_ring.h"
+
+#include <cstring>
+#include <new>
+
+namespace console {
+  namespace {
+    const std::uint32_t RING_MAGIC = 0x474e5243; // "CRNG"
+    // Records start on 8 byte boundaries, with a 4 byte length in front.
+    //   A length of WRAP_MARKER tells the reader that the rest of the area
+    //   was skipped and the next record is at the start.
+    const size_t RECORD_ALIGN = 8;
+    const std::uint32_t WRAP_MARKER = 0xffffffff;
+
+    size_t header_size(void) {
+      return (sizeof(RingHeader) + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+    }
+
+    std::uint32_t padded_size(size_t size) {
+      return static_cast<std::uint32_t>((sizeof(std::uint32_t) + size + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1));
+    }
+  }
+
+  size_t ring_memory_size(size_t capacity) {
+    return header_size() + capacity;
+  }
+
+  void init_ring(void * memory, size_t capacity) {
+    RingHeader * header = new (memory) RingHeader;
+    header->magic = RING_MAGIC;
+    header->capacity = static_cast<std::uint32_t>(capacity);
+    header->write_pos.store(0);
+    header->read_pos.store(0);
+  }
+
+  bool valid_ring(const void * memory, size_t size) {
+    if (size < ring_memory_size(0)) return false;
+    const RingHeader * header = static_cast<const RingHeader *>(memory);
+    std::uint32_t capacity = header->capacity;
+    return (header->magic == RING_MAGIC) &&
+           (capacity >= 64) &&
+           ((capacity & (capacity - 1)) == 0) &&
+           (ring_memory_size(capacity) <= size);
+  }
+
+  size_t ring_max_record(size_t capacity) {
+    // A record of up to half the area fits either before the end or, after
+    //   skipping to the start, before the reader's position, so once the
+    //   reader catches up it can always be written.
+    return capacity / 2 - sizeof(std::uint32_t);
+  }
+
+  RingWriter::RingWriter(void * memory)
+    : header_(static_cast<RingHeader *>(memory)),
+      records_(static_cast<unsigned char *>(memory) + header_size())
+  {}
+
+  bool RingWriter::write(const void * data, size_t size) {
+    std::uint32_t capacity = header_->capacity;
+    std::uint32_t write_pos = header_->write_pos.load(std::memory_order_relaxed);
+    std::uint32_t read_pos  = header_->read_pos.load(std::memory_order_acquire);
+    std::uint32_t free_space = capacity - (write_pos - read_pos);
+    std::uint32_t offset = write_pos & (capacity - 1);
+
+    std::uint32_t record_size = padded_size(size);
+    std::uint32_t skip = (record_size > capacity - offset) ? capacity - offset : 0;
+    if (skip + record_size > free_space) return false;
+
+    if (skip) {
+      std::memcpy(records_ + offset, &WRAP_MARKER, sizeof(WRAP_MARKER));
+      offset = 0;
+    }
+    std::uint32_t length = static_cast<std::uint32_t>(size);
+    std::memcpy(records_ + offset, &length, sizeof(length));
+    if (size) std::memcpy(records_ + offset + sizeof(length), data, size);
+    header_->write_pos.store(write_pos + skip + record_size, std::memory_order_release);
+    return true;
+  }
+
+  RingReader::RingReader(void * memory)
+    : header_(static_cast<RingHeader *>(memory)),
+      records_(static_cast<unsigned char *>(memory) + header_size())
+  {}
+
+  RingRead RingReader::read(std::vector<unsigned char> & record) {
+    std::uint32_t capacity = header_->capacity;
+    std::uint32_t read_pos  = header_->read_pos.load(std::memory_order_relaxed);
+    std::uint32_t write_pos = header_->write_pos.load(std::memory_order_acquire);
+    if (read_pos == write_pos) return RING_EMPTY;
+
+    std::uint32_t available = write_pos - read_pos;
+    std::uint32_t offset = read_pos & (capacity - 1);
+    std::uint32_t length = 0;
+    bool valid = (available <= capacity) && (available >= sizeof(length));
+    if (valid) {
+      std::memcpy(&length, records_ + offset, sizeof(length));
+      if (length == WRAP_MARKER) {
+        // the writer only skips the end of the area if a record follows
+        std::uint32_t skip = capacity - offset;
+        valid = (skip < available) && (available - skip >= sizeof(length));
+        if (valid) {
+          read_pos += skip;
+          available -= skip;
+          offset = 0;
+          std::memcpy(&length, records_, sizeof(length));
+        }
+      }
+    }
+    // checked one at a time so that none of the sums can overflow
+    valid = valid &&
+            (length <= available - sizeof(length)) &&
+            (offset + sizeof(length) + length <= capacity) &&
+            (padded_size(length) <= available);
+    if (!valid) {
+      header_->read_pos.store(write_pos, std::memory_order_release);
+      return RING_CORRUPT;
+    }
+
+    record.assign(records_ + offset + sizeof(length), records_ + offset + sizeof(length) + length);
+    header_->read_pos.store(read_pos + padded_size(length), std::memory_order_release);
+    return RING_RECORD;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// A single producer, single consumer queue of variable sized records laid
+//   out in a block of memory that both ends can see, such as a file mapping
+//   shared between a capture agent and the main process. Records are
+//   written and read whole and in order; when there isn't room for a record
+//   the writer is told so instead of overwriting anything. Only atomics are
+//   used, so how the other end is woken up is left to the caller, and the
+//   queue can be checked with two threads in place of two processes.
+
+#ifndef CONREP_CAPTURE_RING_H
+#define CONREP_CAPTURE_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace console {
+  // At the start of the memory; the record area follows it.
+  struct RingHeader {
+    std::uint32_t magic;
+    std::uint32_t capacity; // size of the record area, a power of two
+    // Running byte counts, so their difference is how much is waiting to be
+    //   read; each is only stored by one end.
+    std::atomic<std::uint32_t> write_pos;
+    std::atomic<std::uint32_t> read_pos;
+  };
+
+  // bytes of memory needed for a ring with capacity bytes of records
+  size_t ring_memory_size(size_t capacity);
+  // Sets up memory as an empty ring. capacity must be a power of two of at
+  //   least 64 bytes.
+  void init_ring(void * memory, size_t capacity);
+  // Whether memory of size bytes holds a ring set up by init_ring().
+  bool valid_ring(const void * memory, size_t size);
+  // The largest record that always fits in an empty ring.
+  size_t ring_max_record(size_t capacity);
+
+  enum RingRead {
+    RING_EMPTY,
+    RING_RECORD,
+    // The ring held something the writer can't have written, such as a
+    //   length running past what was written. Everything in it was dropped.
+    RING_CORRUPT
+  };
+
+  class RingWriter {
+    public:
+      // memory must hold a valid ring
+      explicit RingWriter(void * memory);
+
+      // Returns false, writing nothing, if the reader hasn't yet made room
+      //   for size bytes. size must be at most ring_max_record().
+      bool write(const void * data, size_t size);
+    private:
+      RingHeader * header_;
+      unsigned char * records_;
+
+      RingWriter(const RingWriter &);
+      RingWriter & operator=(const RingWriter &);
+  };
+
+  class RingReader {
+    public:
+      // memory must hold a valid ring
+      explicit RingReader(void * memory);
+
+      // Moves the oldest record into record. The memory is shared with
+      //   another process, so lengths are checked against what was written
+      //   rather than trusted.
+      RingRead read(std::vector<unsigned char> & record);
+    private:
+      RingHeader * header_;
+      unsigned char * records_;
+
+      RingReader(const RingReader &);
+      RingReader & operator=(const RingReader &);
+  };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,170 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// cell_compare.cpp
+// implementation of the scalar, SSE2 and AVX2 cell comparison kernels and the
+//   runtime selection between them
+
+#include "cell_compare.h"
+
+#include "cpu_features.h"
+
+namespace console {
+  namespace {
+    DiffRange no_difference(size_t count) {
+      DiffRange r = { count, count };
+      return r;
+    }
+
+    size_t scalar_first(const Cell * a, const Cell * b, size_t begin, size_t end, Cell mask) {
+      for (size_t i = begin; i < end; ++i) {
+        if ((a[i] ^ b[i]) & mask) return i;
+      }
+      return end;
+    }
+
+    // searches backwards from end; there must be a difference at or after begin
+    size_t scalar_last(const Cell * a, const Cell * b, size_t begin, size_t end, Cell mask) {
+      for (size_t i = end; i > begin; --i) {
+        if ((a[i - 1] ^ b[i - 1]) & mask) return i - 1;
+      }
+      return begin;
+    }
+
+    DiffRange compare_scalar(const Cell * a, const Cell * b, size_t count, Cell mask) {
+      size_t first = scalar_first(a, b, 0, count, mask);
+      if (first == count) return no_difference(count);
+      DiffRange r = { first, scalar_last(a, b, first, count, mask) };
+      return r;
+    }
+
+    #ifdef CONREP_X86
+      // movemask of the cells in the block that are unchanged under the mask;
+      //   four bits per cell
+      CONREP_TARGET_SSE2 inline unsigned sse2_equal_mask(const Cell * a, const Cell * b, __m128i mask) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i *>(b)));
+        x = _mm_and_si128(x, mask);
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi32(x, _mm_setzero_si128())));
+      }
+
+      CONREP_TARGET_SSE2 DiffRange compare_sse2(const Cell * a, const Cell * b, size_t count, Cell mask) {
+        const size_t BLOCK = 4;
+        const unsigned ALL_EQUAL = 0xffff;
+        __m128i m = _mm_set1_epi32(static_cast<int>(mask));
+
+        size_t first = count;
+        size_t i = 0;
+        for (; i + BLOCK <= count; i += BLOCK) {
+          unsigned eq = sse2_equal_mask(a + i, b + i, m);
+          if (eq != ALL_EQUAL) {
+            first = i + lowest_bit(~eq & ALL_EQUAL) / sizeof(Cell);
+            break;
+          }
+        }
+        if (first == count) first = scalar_first(a, b, i, count, mask);
+        if (first == count) return no_difference(count);
+
+        // cells past the last whole block (counting from first) are checked one
+        //   at a time, then whole blocks going backwards
+        size_t end = count;
+        size_t last = first;
+        for (; (end - first) % BLOCK; --end) {
+          if ((a[end - 1] ^ b[end - 1]) & mask) break;
+        }
+        if ((end - first) % BLOCK) {
+          last = end - 1;
+        } else {
+          for (; end > first; end -= BLOCK) {
+            unsigned eq = sse2_equal_mask(a + end - BLOCK, b + end - BLOCK, m);
+            if (eq != ALL_EQUAL) {
+              last = end - BLOCK + highest_bit(~eq & ALL_EQUAL) / sizeof(Cell);
+              break;
+            }
+          }
+        }
+        DiffRange r = { first, last };
+        return r;
+      }
+
+      CONREP_TARGET_AVX2 inline unsigned avx2_equal_mask(const Cell * a, const Cell * b, __m256i mask) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a)),
+                                     _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b)));
+        x = _mm256_and_si256(x, mask);
+        return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi32(x, _mm256_setzero_si256())));
+      }
+
+      CONREP_TARGET_AVX2 DiffRange compare_avx2(const Cell * a, const Cell * b, size_t count, Cell mask) {
+        const size_t BLOCK = 8;
+        const unsigned ALL_EQUAL = 0xffffffff;
+        __m256i m = _mm256_set1_epi32(static_cast<int>(mask));
+
+        size_t first = count;
+        size_t i = 0;
+        for (; i + BLOCK <= count; i += BLOCK) {
+          unsigned eq = avx2_equal_mask(a + i, b + i, m);
+          if (eq != ALL_EQUAL) {
+            first = i + lowest_bit(~eq) / sizeof(Cell);
+            break;
+          }
+        }
+        if (first == count) first = scalar_first(a, b, i, count, mask);
+        if (first == count) {
+          _mm256_zeroupper();
+          return no_difference(count);
+        }
+
+        // cells past the last whole block (counting from first) are checked one
+        //   at a time, then whole blocks going backwards
+        size_t end = count;
+        size_t last = first;
+        for (; (end - first) % BLOCK; --end) {
+          if ((a[end - 1] ^ b[end - 1]) & mask) break;
+        }
+        if ((end - first) % BLOCK) {
+          last = end - 1;
+        } else {
+          for (; end > first; end -= BLOCK) {
+            unsigned eq = avx2_equal_mask(a + end - BLOCK, b + end - BLOCK, m);
+            if (eq != ALL_EQUAL) {
+              last = end - BLOCK + highest_bit(~eq) / sizeof(Cell);
+              break;
+            }
+          }
+        }
+        _mm256_zeroupper();
+        DiffRange r = { first, last };
+        return r;
+      }
+    #endif
+  }
+
+  DiffRange find_cell_differences(const Cell * a, const Cell * b, size_t count, Cell mask) {
+    return find_cell_differences(a, b, count, mask, get_simd_level());
+  }
+
+  DiffRange find_cell_differences(const Cell * a, const Cell * b, size_t count, Cell mask, SimdLevel level) {
+    // never use a kernel the processor can't execute
+    if (level > get_simd_level()) level = get_simd_level();
+    #ifdef CONREP_X86
+      if (level == SIMD_AVX2) return compare_avx2(a, b, count, mask);
+      if (level == SIMD_SSE2) return compare_sse2(a, b, count, mask);
+    #endif
+    return compare_scalar(a, b, count, mask);
+  }
+}
\ No newline at end of file
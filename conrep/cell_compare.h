@@ -0,0 +1,45 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Cell comparison kernels. SSE2 and AVX2 versions are selected at runtime
+//   based on processor support with a scalar fallback for everything else.
+
+#ifndef CONREP_CELL_COMPARE_H
+#define CONREP_CELL_COMPARE_H
+
+#include <cstddef>
+
+#include "cpu_features.h"
+#include "damage_set.h"
+
+namespace console {
+  // Indices of the first and last cells that differ. If no cells differ then
+  //   first == last == count.
+  struct DiffRange {
+    size_t first;
+    size_t last;
+  };
+
+  // Compares count cells of a and b, only considering bits set in mask. The
+  //   second version forces a specific kernel, which is clamped to what the
+  //   processor supports.
+  DiffRange find_cell_differences(const Cell * a, const Cell * b, size_t count, Cell mask);
+  DiffRange find_cell_differences(const Cell * a, const Cell * b, size_t count, Cell mask, SimdLevel level);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,124 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// cell_planes.cpp
+// implementation of the CellPlanes class and the scalar and SSE2 kernels
+//   that split packed cells into planes
+
+#include "cell_planes.h"
+
+namespace console {
+  namespace {
+    void split_scalar(const Cell * cells, size_t count, CellChar * chars, CellAttribute * attributes) {
+      for (size_t i = 0; i < count; ++i) {
+        chars[i] = cell_char(cells[i]);
+        attributes[i] = cell_attribute(cells[i]);
+      }
+    }
+
+    #ifdef CONREP_X86
+      // SSE2 has no unsigned 32 to 16 bit pack, so characters are biased into
+      //   the signed range, packed with signed saturation and then unbiased.
+      CONREP_TARGET_SSE2 inline __m128i sse2_chars(__m128i lo, __m128i hi) {
+        const __m128i low_word = _mm_set1_epi32(0xffff);
+        const __m128i bias32   = _mm_set1_epi32(0x8000);
+        __m128i c0 = _mm_sub_epi32(_mm_and_si128(lo, low_word), bias32);
+        __m128i c1 = _mm_sub_epi32(_mm_and_si128(hi, low_word), bias32);
+        return _mm_add_epi16(_mm_packs_epi32(c0, c1), _mm_set1_epi16(static_cast<short>(0x8000)));
+      }
+
+      CONREP_TARGET_SSE2 inline __m128i sse2_attributes(__m128i lo, __m128i hi) {
+        const __m128i low_byte = _mm_set1_epi32(0xff);
+        __m128i a0 = _mm_and_si128(_mm_srli_epi32(lo, 16), low_byte);
+        __m128i a1 = _mm_and_si128(_mm_srli_epi32(hi, 16), low_byte);
+        return _mm_packs_epi32(a0, a1);
+      }
+
+      CONREP_TARGET_SSE2 void split_sse2(const Cell * cells, size_t count, CellChar * chars, CellAttribute * attributes) {
+        const size_t BLOCK = 16;
+        size_t i = 0;
+        for (; i + BLOCK <= count; i += BLOCK) {
+          const __m128i * src = reinterpret_cast<const __m128i *>(cells + i);
+          __m128i v0 = _mm_loadu_si128(src);
+          __m128i v1 = _mm_loadu_si128(src + 1);
+          __m128i v2 = _mm_loadu_si128(src + 2);
+          __m128i v3 = _mm_loadu_si128(src + 3);
+
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(chars + i),     sse2_chars(v0, v1));
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(chars + i + 8), sse2_chars(v2, v3));
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(attributes + i),
+                           _mm_packus_epi16(sse2_attributes(v0, v1), sse2_attributes(v2, v3)));
+        }
+        split_scalar(cells + i, count - i, chars + i, attributes + i);
+      }
+    #endif
+  }
+
+  void split_cells(const Cell * cells, size_t count, CellChar * chars, CellAttribute * attributes) {
+    split_cells(cells, count, chars, attributes, get_simd_level());
+  }
+
+  void split_cells(const Cell * cells, size_t count, CellChar * chars, CellAttribute * attributes, SimdLevel level) {
+    if (level > get_simd_level()) level = get_simd_level();
+    #ifdef CONREP_X86
+      // the SSE2 kernel is memory bound already, so AVX2 gets no kernel of
+      //   its own
+      if (level >= SIMD_SSE2) {
+        split_sse2(cells, count, chars, attributes);
+        return;
+      }
+    #endif
+    split_scalar(cells, count, chars, attributes);
+  }
+
+  CellPlanes::CellPlanes() : dim_(0, 0) {}
+
+  void CellPlanes::resize(Dimension dim) {
+    dim_ = dim;
+    size_t size = dim.width * dim.height;
+    if (size > chars_.size()) {
+      chars_.resize(size);
+      attributes_.resize(size);
+    }
+  }
+
+  Dimension CellPlanes::dim(void) const {
+    return dim_;
+  }
+
+  void CellPlanes::assign(const Cell * cells) {
+    assign_rows(cells, 0, dim_.height);
+  }
+
+  void CellPlanes::assign_rows(const Cell * cells, int first_row, int last_row) {
+    if (first_row >= last_row) return;
+    size_t offset = first_row * dim_.width;
+    split_cells(cells + offset,
+                (last_row - first_row) * dim_.width,
+                &chars_[offset],
+                &attributes_[offset]);
+  }
+
+  const CellChar * CellPlanes::chars(int row) const {
+    return &chars_[row * dim_.width];
+  }
+
+  const CellAttribute * CellPlanes::attributes(int row) const {
+    return &attributes_[row * dim_.width];
+  }
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Structure of arrays storage for console cells: the characters and the
+//   attributes are kept in separate contiguous planes so that passes that
+//   only need one of them don't have to stride over the other.
+
+#ifndef CONREP_CELL_PLANES_H
+#define CONREP_CELL_PLANES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpu_features.h"
+#include "damage_set.h"
+#include "dimension.h"
+
+namespace console {
+  typedef std::uint16_t CellChar;
+  // Only the low byte of the console attributes is kept: the foreground
+  //   color in the low nibble and the background color in the high nibble.
+  //   The COMMON_LVB_* flags are dropped, as nothing renders them.
+  typedef std::uint8_t  CellAttribute;
+
+  inline CellChar      cell_char(Cell c)      { return static_cast<CellChar>(c & 0xffff); }
+  inline CellAttribute cell_attribute(Cell c) { return static_cast<CellAttribute>((c >> 16) & 0xff); }
+
+  // De-interleaves count packed cells into the two planes. The second version
+  //   forces a specific kernel, which is clamped to what the processor supports.
+  void split_cells(const Cell * cells, size_t count, CellChar * chars, CellAttribute * attributes);
+  void split_cells(const Cell * cells, size_t count, CellChar * chars, CellAttribute * attributes, SimdLevel level);
+
+  class CellPlanes {
+    public:
+      CellPlanes();
+
+      void resize(Dimension dim);
+      Dimension dim(void) const;
+
+      // cells must have the same dimensions as the planes
+      void assign(const Cell * cells);
+      void assign_rows(const Cell * cells, int first_row, int last_row);
+
+      const CellChar      * chars(int row) const;
+      const CellAttribute * attributes(int row) const;
+    private:
+      Dimension dim_;
+      std::vector<CellChar> chars_;
+      std::vector<CellAttribute> attributes_;
+
+      CellPlanes(const CellPlanes &);
+      CellPlanes & operator=(const CellPlanes &);
+  };
+}
+
+#endif
\ No newline at end of file
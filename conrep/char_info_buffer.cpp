@@ -18,16 +18,36 @@
 
 #include "char_info_buffer.h"
 
+#include <algorithm>
+
 #include "dimension.h"
 
 namespace console {
-  CharInfoBuffer::CharInfoBuffer() : size_(0), cache_valid_(false) {}
+  static_assert(sizeof(CHAR_INFO) == sizeof(Cell), "CHAR_INFO expected to pack into a Cell");
+
+  // For ANSI builds only the low byte of the character union is written by
+  //   ReadConsoleOutput(), so mask off the other byte when comparing.
+  #ifdef UNICODE
+    const Cell CELL_COMPARE_MASK = 0xffffffff;
+  #else
+    const Cell CELL_COMPARE_MASK = 0xffff00ff;
+  #endif
+
+  CharInfoBuffer::CharInfoBuffer()
+    : dim_(0, 0),
+      size_(0),
+      cache_valid_(false),
+      hashes_valid_(false),
+      cache_hashes_valid_(false)
+  {}
 
   void CharInfoBuffer::invalidate(void) {
     cache_valid_ = false;
+    cache_hashes_valid_ = false;
   }
 
   void CharInfoBuffer::resize(Dimension new_size) {
+    dim_ = new_size;
     size_ = new_size.height * new_size.width;
     invalidate();
     ASSERT(buffer_.size() == cache_.size());
@@ -38,27 +58,60 @@ namespace console {
     }
   }
 
-  bool CharInfoBuffer::match(void) const {
+  const DamageSet & CharInfoBuffer::compare(void) {
     ASSERT(buffer_.size() == cache_.size());
-    if (!cache_valid_) return false;
-    for (size_t i = 0; i < size_; ++i) {
-      const CHAR_INFO & b = buffer_[i];
-      const CHAR_INFO & c = cache_[i];
-      if (b.Attributes != c.Attributes) return false;
-      #ifdef UNICODE
-        if (b.Char.UnicodeChar != c.Char.UnicodeChar) return false;
-      #else
-        if (b.Char.AsciiChar != c.Char.AsciiChar) return false;
-      #endif
+    hashes_valid_ = false;
+    if (!cache_valid_) {
+      damage_.reset(dim_);
+      damage_.mark_all();
+    } else if (size_) {
+      compute_damage(reinterpret_cast<const Cell *>(&buffer_[0]),
+                     reinterpret_cast<const Cell *>(&cache_[0]),
+                     dim_,
+                     CELL_COMPARE_MASK,
+                     damage_);
+      // a single new line at the bottom of a scrolling console changes every
+      //   row, so only bother looking for a scroll when most rows changed
+      if (damage_.size() * 2 > static_cast<size_t>(dim_.height)) detect_scroll();
+    } else {
+      damage_.reset(dim_);
+    }
+    return damage_;
+  }
+
+  void CharInfoBuffer::detect_scroll(void) {
+    const Cell * current  = reinterpret_cast<const Cell *>(&buffer_[0]);
+    const Cell * previous = reinterpret_cast<const Cell *>(&cache_[0]);
+    if (!cache_hashes_valid_) {
+      hash_rows(previous, dim_, CELL_COMPARE_MASK, cache_hashes_);
+      cache_hashes_valid_ = true;
+    }
+    hash_rows(current, dim_, CELL_COMPARE_MASK, hashes_);
+    hashes_valid_ = true;
+
+    int shift = scroll_detector_.detect(cache_hashes_, hashes_);
+    if (!shift) return;
+
+    // verify against the actual cells and only keep the result if it means
+    //   drawing fewer rows
+    compute_damage(current, previous, dim_, CELL_COMPARE_MASK, shift, scroll_damage_);
+    if (scroll_damage_.size() < damage_.size()) {
+      std::swap(damage_, scroll_damage_);
     }
-    return true;
   }
 
   const CHAR_INFO & CharInfoBuffer::operator[](size_t index) const { return buffer_[index]; }
         CHAR_INFO & CharInfoBuffer::operator[](size_t index)       { return buffer_[index]; }
 
-  void CharInfoBuffer::swap(void) { 
+  const Cell * CharInfoBuffer::cells(void) const {
+    return reinterpret_cast<const Cell *>(buffer_.data());
+  }
+
+  void CharInfoBuffer::swap(void) {
     buffer_.swap(cache_);
+    hashes_.swap(cache_hashes_);
+    cache_hashes_valid_ = hashes_valid_;
+    hashes_valid_ = false;
     cache_valid_ = true;
   }
-}
+}
\ No newline at end of file
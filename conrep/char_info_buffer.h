@@ -16,7 +16,7 @@
  * <http://www.gnu.org/licenses/>.
  */
 
-// wrapper around two std::vector<CHAR_INFO> objects 
+// wrapper around two std::vector<CHAR_INFO> objects
 
 #ifndef CONREP_CHAR_INFO_BUFFER_H
 #define CONREP_CHAR_INFO_BUFFER_H
@@ -24,31 +24,50 @@
 #include <vector>
 
 #include "assert.h"
+#include "damage_set.h"
+#include "dimension.h"
+#include "scroll_detect.h"
 #include "windows.h"
 
 namespace console {
-  struct Dimension;
-
   class CharInfoBuffer {
     public:
       CharInfoBuffer();
 
       void resize(Dimension new_size);
       void invalidate(void);
-      bool match(void) const;
+      // compares the current buffer to the cached buffer; if the cache is
+      //   invalid every row is reported as damaged. If most rows changed,
+      //   checks whether the contents scrolled instead.
+      const DamageSet & compare(void);
 
       const CHAR_INFO & operator[](size_t index) const;
             CHAR_INFO & operator[](size_t index);
+      // the current buffer viewed as packed cells
+      const Cell * cells(void) const;
 
       void swap(void);
     private:
       CharInfoBuffer(const CharInfoBuffer &);
       CharInfoBuffer & operator=(const CharInfoBuffer &);
 
+      Dimension dim_;
       size_t size_;
       bool cache_valid_;
       std::vector<CHAR_INFO> buffer_;
       std::vector<CHAR_INFO> cache_;
+      DamageSet damage_;
+
+      // row hashes of buffer_ and cache_, only computed when scroll detection
+      //   is attempted
+      std::vector<RowHash> hashes_;
+      std::vector<RowHash> cache_hashes_;
+      bool hashes_valid_;
+      bool cache_hashes_valid_;
+      ScrollDetector scroll_detector_;
+      DamageSet scroll_damage_;
+
+      void detect_scroll(void);
   };
 }
 
@@ -0,0 +1,104 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// console_attachment.cpp
+// implementation of the ConsoleAttachment state machine
+
+#include "console_attachment.h"
+
+namespace console {
+  ConsoleAttachment::ConsoleAttachment(IConsoleApi & api)
+    : api_(api),
+      attached_(0),
+      depth_(0)
+  {
+    AttachmentCounts counts = {};
+    counts_ = counts;
+  }
+
+  AcquireResult ConsoleAttachment::acquire(std::uint32_t process_id, std::uintptr_t process, std::uint32_t & error) {
+    ++counts_.acquires;
+    if (attached_ == process_id) {
+      // An attachment keeps the console alive after its shell closes, so
+      //   reusing one has to check for that itself.
+      if (api_.process_exited(process)) {
+        if (!depth_) detach();
+        return ACQUIRE_EXITED;
+      }
+      ++depth_;
+      ++counts_.reuses;
+      return ACQUIRE_OK;
+    }
+    if (depth_) return ACQUIRE_CONFLICT;
+    detach();
+
+    std::uint64_t start = api_.now_us();
+    AcquireResult result = ACQUIRE_OK;
+    for (;;) {
+      AttachStatus status = api_.attach_console(process_id, error);
+      if (status == ATTACH_OK) break;
+      if (status == ATTACH_ERROR) {
+        result = ACQUIRE_ERROR;
+        break;
+      }
+      ++counts_.retries;
+      if (api_.process_exited(process)) {
+        result = ACQUIRE_EXITED;
+        break;
+      }
+    }
+    counts_.attach_us += api_.now_us() - start;
+    if (result != ACQUIRE_OK) return result;
+
+    ++counts_.attaches;
+    attached_ = process_id;
+    depth_ = 1;
+    return ACQUIRE_OK;
+  }
+
+  void ConsoleAttachment::release(void) {
+    if (depth_) --depth_;
+  }
+
+  void ConsoleAttachment::detach(void) {
+    if (!attached_) return;
+    std::uint64_t start = api_.now_us();
+    api_.free_console();
+    counts_.detach_us += api_.now_us() - start;
+    ++counts_.detaches;
+    attached_ = 0;
+    depth_ = 0;
+  }
+
+  void ConsoleAttachment::adopt(std::uint32_t process_id) {
+    attached_ = process_id;
+    depth_ = 0;
+  }
+
+  std::uint32_t ConsoleAttachment::attached_process(void) const {
+    return attached_;
+  }
+
+  int ConsoleAttachment::depth(void) const {
+    return depth_;
+  }
+
+  const AttachmentCounts & ConsoleAttachment::counts(void) const {
+    return counts_;
+  }
+}
\ No newline at end of file
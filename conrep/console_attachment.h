@@ -0,0 +1,106 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Keeps the process attached to the last console it needed instead of
+//   attaching and freeing around every use. AttachConsole() is slow enough
+//   to show up in every poll, and with a single conrep window the same
+//   console is wanted every time; with several the attachment only moves
+//   when a different console is asked for. The console calls go through
+//   IConsoleApi, so the state machine can be checked against a fake.
+
+#ifndef CONREP_CONSOLE_ATTACHMENT_H
+#define CONREP_CONSOLE_ATTACHMENT_H
+
+#include <cstdint>
+
+namespace console {
+  enum AttachStatus {
+    ATTACH_OK,
+    // Access denied or device not functioning. Seen with consoles that are
+    //   just being created or closed, so worth trying again.
+    ATTACH_BUSY,
+    ATTACH_ERROR
+  };
+
+  enum AcquireResult {
+    ACQUIRE_OK,
+    ACQUIRE_EXITED,  // the process whose console was asked for has closed
+    ACQUIRE_ERROR,   // attaching failed with the returned error code
+    ACQUIRE_CONFLICT // still attached to another console for an earlier acquire
+  };
+
+  class IConsoleApi {
+    public:
+      virtual ~IConsoleApi() {}
+
+      // On ATTACH_ERROR error is set to the error code.
+      virtual AttachStatus attach_console(std::uint32_t process_id, std::uint32_t & error) = 0;
+      virtual void free_console(void) = 0;
+      // process is whatever the caller passed to acquire()
+      virtual bool process_exited(std::uintptr_t process) = 0;
+      // microseconds from any clock, for the timings
+      virtual std::uint64_t now_us(void) = 0;
+  };
+
+  struct AttachmentCounts { // for debugging
+    std::uint64_t acquires;
+    std::uint64_t reuses;    // acquires served by the attachment in place
+    std::uint64_t attaches;
+    std::uint64_t detaches;
+    std::uint64_t retries;   // attach calls that came back busy
+    std::uint64_t attach_us; // spent attaching, retries included
+    std::uint64_t detach_us;
+  };
+
+  // Not thread safe; callers serialize access to it the way they would
+  //   serialize AttachConsole() calls.
+  class ConsoleAttachment {
+    public:
+      explicit ConsoleAttachment(IConsoleApi & api);
+
+      // Attaches to the console of process_id, whose handle or other
+      //   identity for process_exited() is process. Acquires nest, but only
+      //   for the console already attached. error is only set for
+      //   ACQUIRE_ERROR.
+      AcquireResult acquire(std::uint32_t process_id, std::uintptr_t process, std::uint32_t & error);
+      // Ends an acquire that returned ACQUIRE_OK. The attachment is kept
+      //   for the next acquire.
+      void release(void);
+
+      // Frees the console, such as before AllocConsole() or when the
+      //   console is about to be closed. No acquires may be outstanding.
+      void detach(void);
+      // The process was attached to the console of process_id some other
+      //   way, such as by AllocConsole() before starting it.
+      void adopt(std::uint32_t process_id);
+
+      std::uint32_t attached_process(void) const; // 0 when not attached
+      int depth(void) const; // acquires outstanding
+      const AttachmentCounts & counts(void) const;
+    private:
+      IConsoleApi & api_;
+      std::uint32_t attached_;
+      int depth_;
+      AttachmentCounts counts_;
+
+      ConsoleAttachment(const ConsoleAttachment &);
+      ConsoleAttachment & operator=(const ConsoleAttachment &);
+  };
+}
+
+#endif
\ No newline at end of file
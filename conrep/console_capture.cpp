@@ -0,0 +1,244 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// console_capture.cpp
+// implementation of the ConsoleCapture worker thread
+
+#include "console_capture.h"
+
+#include <cstring>
+
+#include "assert.h"
+#include "capture_agent.h"
+#include "exception.h"
+#include "message.h"
+#include "scroll_detect.h"
+#include "shell_process.h"
+#include "timer.h"
+
+namespace console {
+  ConsoleSnapshot::ConsoleSnapshot()
+    : exited(false),
+      resize_generation(0),
+      dim(0, 0)
+  {
+    cursor_pos.X = 0;
+    cursor_pos.Y = 0;
+    SCROLLINFO si = { sizeof(SCROLLINFO), SIF_ALL };
+    scroll_info = si;
+  }
+
+  // A CHAR_INFO is a UTF-16 unit followed by its attributes, the same
+  //   layout as a Cell.
+  void snapshot_to_frame(const ConsoleSnapshot & snapshot, CaptureFrame & frame) {
+    frame.exited = snapshot.exited;
+    frame.resize_generation = snapshot.resize_generation;
+    frame.dim = snapshot.dim;
+    frame.cells.resize(snapshot.cells.size());
+    if (!frame.cells.empty()) std::memcpy(&frame.cells[0], &snapshot.cells[0], frame.cells.size() * sizeof(Cell));
+    frame.cursor_x = snapshot.cursor_pos.X;
+    frame.cursor_y = snapshot.cursor_pos.Y;
+    frame.scroll_min = snapshot.scroll_info.nMin;
+    frame.scroll_max = snapshot.scroll_info.nMax;
+    frame.scroll_page = static_cast<std::int32_t>(snapshot.scroll_info.nPage);
+    frame.scroll_pos = snapshot.scroll_info.nPos;
+    frame.scroll_track_pos = snapshot.scroll_info.nTrackPos;
+    frame.title.assign(snapshot.title.begin(), snapshot.title.end());
+  }
+
+  void frame_to_snapshot(const CaptureFrame & frame, ConsoleSnapshot & snapshot) {
+    snapshot.exited = frame.exited;
+    snapshot.resize_generation = frame.resize_generation;
+    snapshot.dim = frame.dim;
+    snapshot.cells.resize(frame.cells.size());
+    if (!snapshot.cells.empty()) std::memcpy(&snapshot.cells[0], &frame.cells[0], snapshot.cells.size() * sizeof(Cell));
+    snapshot.cursor_pos.X = static_cast<SHORT>(frame.cursor_x);
+    snapshot.cursor_pos.Y = static_cast<SHORT>(frame.cursor_y);
+    snapshot.scroll_info.nMin = frame.scroll_min;
+    snapshot.scroll_info.nMax = frame.scroll_max;
+    snapshot.scroll_info.nPage = static_cast<UINT>(frame.scroll_page);
+    snapshot.scroll_info.nPos = frame.scroll_pos;
+    snapshot.scroll_info.nTrackPos = frame.scroll_track_pos;
+    snapshot.title.assign(frame.title.begin(), frame.title.end());
+  }
+
+  namespace {
+    // Cheap summary of everything in a snapshot that the window shows, to
+    //   tell whether anything changed since the last poll.
+    std::uint32_t fingerprint(const ConsoleSnapshot & snapshot) {
+      // a console can be zero sized in the middle of a resize
+      std::uint32_t h = 2166136261u;
+      if (!snapshot.cells.empty()) {
+        h = hash_row(reinterpret_cast<const Cell *>(&snapshot.cells[0]),
+                     static_cast<int>(snapshot.cells.size()),
+                     0xffffffff);
+      }
+      const std::uint32_t values[] = {
+        static_cast<std::uint32_t>(snapshot.dim.width),
+        static_cast<std::uint32_t>(snapshot.dim.height),
+        static_cast<std::uint32_t>(snapshot.cursor_pos.X),
+        static_cast<std::uint32_t>(snapshot.cursor_pos.Y),
+        static_cast<std::uint32_t>(snapshot.scroll_info.nPos),
+        static_cast<std::uint32_t>(snapshot.scroll_info.nMax),
+        static_cast<std::uint32_t>(snapshot.scroll_info.nPage),
+        snapshot.resize_generation
+      };
+      for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        h = (h ^ values[i]) * 16777619u;
+      }
+      for (tstring::const_iterator itr = snapshot.title.begin(); itr != snapshot.title.end(); ++itr) {
+        h = (h ^ static_cast<std::uint32_t>(*itr)) * 16777619u;
+      }
+      return h;
+    }
+  }
+
+  ConsoleCapture::ConsoleCapture(ShellProcess & shell_process, HWND notify_window)
+    : shell_process_(shell_process),
+      notify_window_(notify_window),
+      poked_(false),
+      failed_(false),
+      scheduler_(CAPTURE_MIN_TIME, CAPTURE_MAX_TIME, CAPTURE_IDLE_TIME),
+      fingerprint_(0)
+  {
+    HANDLE stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!stop_event) WIN_EXCEPT("Failed call to CreateEvent(). ");
+    stop_event_.Attach(stop_event);
+    HANDLE poke_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!poke_event) WIN_EXCEPT("Failed call to CreateEvent(). ");
+    poke_event_.Attach(poke_event);
+  }
+
+  ConsoleCapture::~ConsoleCapture() {
+    if (thread_.joinable()) {
+      SetEvent(stop_event_);
+      thread_.join();
+    }
+  }
+
+  void ConsoleCapture::start(void) {
+    ASSERT(!thread_.joinable());
+    thread_ = std::thread([this]() { run(); });
+  }
+
+  void ConsoleCapture::poke(void) {
+    poked_.store(true);
+    if (!SetEvent(poke_event_)) WIN_EXCEPT("Failed call to SetEvent(). ");
+  }
+
+  const ConsoleSnapshot * ConsoleCapture::latest(void) {
+    if (failed_.load(std::memory_order_acquire)) std::rethrow_exception(error_);
+    if (!snapshots_.acquire()) return 0;
+    return &snapshots_.front();
+  }
+
+  void ConsoleCapture::run(void) {
+    try {
+      // if the agent goes away with the shell still running, carry on by
+      //   attaching from this thread
+      CaptureAgentHost * agent = shell_process_.capture_agent();
+      if (agent && run_agent(*agent)) return;
+      run_attached();
+    } catch (...) {
+      error_ = std::current_exception();
+      failed_.store(true, std::memory_order_release);
+      PostMessage(notify_window_, CRM_CONSOLE_CAPTURE, 0, 0);
+    }
+  }
+
+  // Returns false if the agent stopped sending records, or sent one that
+  //   couldn't be applied, before the shell process closed.
+  bool ConsoleCapture::run_agent(CaptureAgentHost & agent) {
+    bool have_frame = false;
+    for (;;) {
+      // checked before draining so records written just before the agent
+      //   exited still get applied
+      DWORD ret = WaitForSingleObject(agent.agent_process(), 0);
+      if (ret == WAIT_FAILED) WIN_EXCEPT("Failed call to WaitForSingleObject(). ");
+      bool agent_exited = (ret == WAIT_OBJECT_0);
+
+      bool received = false;
+      for (;;) {
+        RingRead result = agent.read(record_);
+        if (result == RING_EMPTY) break;
+        // An agent that sends garbage can't be trusted with the console any
+        //   more, so it is stopped and the console read from here instead.
+        if ((result == RING_CORRUPT) ||
+            !apply_frame_record(record_.empty() ? 0 : &record_[0], record_.size(), frame_)) {
+          agent.stop();
+          return false;
+        }
+        received = true;
+      }
+      have_frame = have_frame || received;
+
+      bool poked = poked_.exchange(false);
+      if (poked) agent.poke();
+      // The agent only writes when something changed, so every batch of
+      //   records is handed over.
+      if (received || (poked && have_frame)) {
+        frame_to_snapshot(frame_, snapshots_.back());
+        snapshots_.publish();
+        PostMessage(notify_window_, CRM_CONSOLE_CAPTURE, 0, 0);
+        if (frame_.exited) return true;
+      }
+      if (agent_exited) return false;
+
+      HANDLE handles[] = { stop_event_, poke_event_, agent.frame_event(), agent.agent_process() };
+      ret = WaitForMultipleObjects(4, handles, FALSE, INFINITE);
+      if (ret == WAIT_OBJECT_0) return true;
+      if (ret == WAIT_FAILED) WIN_EXCEPT("Failed call to WaitForMultipleObjects(). ");
+    }
+  }
+
+  void ConsoleCapture::run_attached(void) {
+    bool first = true;
+    for (;;) {
+      ConsoleSnapshot & snapshot = snapshots_.back();
+      {
+        ProcessLock pl(shell_process_);
+        snapshot.exited = !pl;
+        if (pl) pl.capture(snapshot);
+      }
+      bool exited = snapshot.exited;
+      // if GetTickCount() rolls over the scheduler copes
+      #pragma warning(suppress: 28159)
+      std::uint32_t now = GetTickCount();
+      bool poked = poked_.exchange(false);
+      if (poked) scheduler_.input(now);
+
+      // Unchanged snapshots aren't handed over, so an idle console costs
+      //   the window thread nothing.
+      std::uint32_t print = exited ? 0 : fingerprint(snapshot);
+      bool changed = first || exited || (print != fingerprint_);
+      fingerprint_ = print;
+      first = false;
+      if (changed || poked) {
+        snapshots_.publish();
+        // the window may already be closing, so failure doesn't matter
+        PostMessage(notify_window_, CRM_CONSOLE_CAPTURE, 0, 0);
+      }
+      if (exited) return;
+
+      HANDLE handles[] = { stop_event_, poke_event_ };
+      DWORD ret = WaitForMultipleObjects(2, handles, FALSE, scheduler_.polled(now, changed));
+      if (ret == WAIT_OBJECT_0) return;
+      if (ret == WAIT_FAILED) WIN_EXCEPT("Failed call to WaitForMultipleObjects(). ");
+    }
+  }
+}
\ No newline at end of file
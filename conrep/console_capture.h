@@ -0,0 +1,105 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Reads the contents of the shell process's console on a worker thread so
+//   that a busy console doesn't stall the window's message loop. Snapshots
+//   are handed to the window thread through a TripleBuffer. When the shell
+//   process has a capture agent the worker only applies the agent's records;
+//   otherwise it attaches to the console and reads it itself.
+
+#ifndef CONREP_CONSOLE_CAPTURE_H
+#define CONREP_CONSOLE_CAPTURE_H
+
+#include "windows.h"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "atl.h"
+#include "capture_frame.h"
+#include "dimension.h"
+#include "poll_scheduler.h"
+#include "tchar.h"
+#include "triple_buffer.h"
+
+namespace console {
+  class CaptureAgentHost;
+  class ShellProcess;
+
+  struct ConsoleSnapshot {
+    ConsoleSnapshot();
+
+    bool exited; // the shell process has closed; nothing else is filled in
+    unsigned resize_generation;
+    Dimension dim;
+    std::vector<CHAR_INFO> cells;
+    COORD cursor_pos;
+    SCROLLINFO scroll_info;
+    tstring title;
+  };
+
+  // conversions for frames sent by capture agents
+  void snapshot_to_frame(const ConsoleSnapshot & snapshot, CaptureFrame & frame);
+  void frame_to_snapshot(const CaptureFrame & frame, ConsoleSnapshot & snapshot);
+
+  class ConsoleCapture {
+    public:
+      // After each snapshot that differs from the previous one a
+      //   CRM_CONSOLE_CAPTURE message is posted to notify_window.
+      ConsoleCapture(ShellProcess & shell_process, HWND notify_window);
+      ~ConsoleCapture();
+
+      void start(void);
+      // Polls right away and returns to the fastest polling rate. Called when
+      //   input is forwarded to the console or a fresh snapshot is needed.
+      void poke(void);
+
+      // Returns the newest snapshot if one arrived since the last call, or
+      //   null otherwise. The snapshot stays valid until the next call.
+      //   Exceptions thrown on the worker thread are rethrown here.
+      const ConsoleSnapshot * latest(void);
+    private:
+      ShellProcess & shell_process_;
+      HWND notify_window_;
+      ATL::CHandle stop_event_;
+      ATL::CHandle poke_event_;
+      std::atomic<bool> poked_; // unlike the event, also forces a notification
+      TripleBuffer<ConsoleSnapshot> snapshots_;
+      std::exception_ptr error_;
+      std::atomic<bool> failed_;
+      std::thread thread_;
+
+      // only used on the worker thread
+      PollScheduler scheduler_;
+      std::uint32_t fingerprint_;
+      CaptureFrame frame_;
+      std::vector<unsigned char> record_;
+
+      void run(void);
+      bool run_agent(CaptureAgentHost & agent);
+      void run_attached(void);
+
+      ConsoleCapture(const ConsoleCapture &);
+      ConsoleCapture & operator=(const ConsoleCapture &);
+  };
+}
+
+#endif
\ No newline at end of file
@@ -26,7 +26,12 @@
 #include "windows.h"
 #include "tchar.h"
 
+#include "device_recovery.h"
+#include "frame_scheduler.h"
+#include "frame_tracker.h"
+
 namespace console {
+  class ColorTable;
   class IDirect3DRoot;
   typedef boost::shared_ptr<IDirect3DRoot> RootPtr;
 
@@ -38,13 +43,18 @@ namespace console {
     DEAD
   };
 
-  struct __declspec(novtable) IConsoleWindow {
+  // The root window drives the drawing of its console windows through
+  //   their IScheduledWindow steps, and their recovery from a lost device
+  //   through IDeviceResources.
+  struct __declspec(novtable) IConsoleWindow : public IScheduledWindow, public IDeviceResources {
     virtual HWND get_hwnd(void) const = 0;
     virtual HWND get_console_hwnd(void) const = 0;
 
-    virtual void dispose_resources(void) = 0;
-    virtual void restore_resources(void) = 0;
+    // called on the root window's poll timer while the device, if there is
+    //   one, isn't lost
+    virtual void update_shadows(void) = 0;
     virtual WindowState get_state(void) const = 0; // for debugging
+    virtual FrameCounts get_frame_counts(void) const = 0; // for debugging
 
     virtual ~IConsoleWindow() = 0;
   };
@@ -59,6 +69,15 @@ namespace console {
                                   RootPtr root, 
                                   const tstring & exe_dir,
                                   tstring & message);
+  // For when there is no Direct3D device: the window is drawn with
+  //   SoftwareRenderer and presented with GDI. color_table is the root
+  //   window's, which it keeps polling for changes.
+  WindowPtr create_software_console_window(HWND hub,
+                                           HINSTANCE hInstance,
+                                           const Settings & settings,
+                                           const ColorTable & color_table,
+                                           const tstring & exe_dir,
+                                           tstring & message);
 }
 
 #endif
\ No newline at end of file
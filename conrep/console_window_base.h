@@ -0,0 +1,702 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Behavior shared by the Direct3D console window and the one drawn in
+//   software: sizing, moving, the context menu, --adjust, work area changes,
+//   input forwarding and taking in console snapshots. The derived window
+//   keeps the text and draws it, through the private hooks below and the
+//   IScheduledWindow steps.
+
+#ifndef CONREP_CONSOLE_WINDOW_BASE_H
+#define CONREP_CONSOLE_WINDOW_BASE_H
+
+#include <limits>
+
+#include "assert.h"
+#include "console_capture.h"
+#include "console_util.h"
+#include "console_window.h"
+#include "context_menu.h"
+#include "dimension_ops.h"
+#include "exception.h"
+#include "frame_tracker.h"
+#include "message.h"
+#include "program_options.h"
+#include "resource.h"
+#include "root_window.h"
+#include "settings.h"
+#include "shell_process.h"
+#include "tchar.h"
+#include "window.h"
+#include "win_util.h"
+
+#define CLOSE_SELF() do { close_self(); return; } while (0)
+
+namespace console {
+  const DWORD CONSOLE_WINDOW_STYLE = WS_POPUPWINDOW | WS_VSCROLL;
+
+  template <typename T>
+  class ConsoleWindowBase : public IConsoleWindow, public Window<T> {
+    public:
+      HWND get_hwnd(void) const {
+        return Window<T>::get_hwnd();
+      }
+
+      HWND get_console_hwnd(void) const {
+        return shell_process_.window_handle();
+      }
+
+      WindowState get_state(void) const {
+        return state_;
+      }
+
+      FrameCounts get_frame_counts(void) const {
+        return frame_.counts();
+      }
+    protected:
+      ConsoleWindowBase(HWND hub,
+                        HINSTANCE hInstance,
+                        const Settings & settings,
+                        const tstring & exe_dir,
+                        tstring & message)
+        : Window<T>(hInstance, CONSOLE_WINDOW_STYLE, exe_dir, message, _T("")),
+          active_(true),
+          state_(INITIALIZING),
+          hub_(hub),
+          shell_process_(settings),
+          maximize_(settings.maximize),
+          scrollbar_width_(GetSystemMetrics(SM_CXVSCROLL)),
+          snap_distance_(settings.snap_distance),
+          menu_(get_context_menu(hInstance)),
+          work_area_(get_work_area()),
+          active_post_alpha_(static_cast<unsigned char>(settings.active_post_alpha)),
+          inactive_post_alpha_(static_cast<unsigned char>(settings.inactive_post_alpha)),
+          capture_(shell_process_, get_hwnd())
+      {
+        ASSERT(settings.active_post_alpha <= std::numeric_limits<unsigned char>::max());
+        ASSERT(settings.inactive_post_alpha <= std::numeric_limits<unsigned char>::max());
+      }
+
+      ~ConsoleWindowBase() {}
+
+      // Sizes and shows the window and starts the capture. The hooks can't
+      //   be called from this class's constructor, so the derived
+      //   constructor calls this once everything they use is set up.
+      void start(const Settings & settings) {
+        // window size stuff
+        Dimension max_window_dim = get_max_window_dim(work_area_);
+        Dimension max_console_dim = console_dim_from_window_size(max_window_dim, scrollbar_width_);
+
+        Dimension console_dim = min(Dimension(settings.columns, settings.rows), max_console_dim);
+        resize_buffers(console_dim);
+
+        Dimension client_dim = get_client_size();
+        Dimension window_dim = calc_window_size(client_dim, scrollbar_width_, CONSOLE_WINDOW_STYLE);
+
+        ASSERT(window_dim.height <= max_window_dim.height);
+        ASSERT(window_dim.width <= max_window_dim.width);
+
+        if ((console_dim.height != settings.rows) || (console_dim.width  != settings.columns)) {
+          if (ProcessLock pl = shell_process_) {
+            resize_console(Dimension(console_dim), pl);
+          } else {
+            MISC_EXCEPT("Shell process terminated before window was created.");
+          }
+        }
+
+        if (maximize_) window_dim = max_window_dim;
+
+        ShowWindow(get_hwnd(), SW_SHOW); // no error checks as either return is legitimate
+
+        set_z_order(settings.z_order);
+
+        if (maximize_) {
+          client_dim = get_client_dim(max_window_dim, scrollbar_width_, CONSOLE_WINDOW_STYLE);
+        }
+
+        state_ = RESETTING;
+        resize_window(client_dim, window_dim);
+
+        // start the machinery running
+        state_ = RUNNING;
+        if (!SetForegroundWindow(get_hwnd())) {
+          DWORD err = GetLastError();
+          if (err != 0) WIN_EXCEPT2("Failed call to SetForegroundWindow(). ", err);
+        }
+        if (!UpdateWindow(get_hwnd())) WIN_EXCEPT("Failed UpdateWindow() call. ");
+        capture_.start();
+
+        set_icon();
+      }
+
+      // The first step of preparing a frame: takes in a change of focus and
+      //   the newest snapshot. Returns whether the window is still running.
+      bool take_changes(void) {
+        if (check_active_changed()) {
+          // unless the pre alpha is applied while composing, the text is
+          //   redrawn with the other pre alpha from a new snapshot
+          if (activation_changed()) capture_.poke();
+          frame_.mark(FRAME_ACTIVATION);
+        }
+        apply_snapshot();
+        return state_ == RUNNING;
+      }
+
+      // the client size the window has now, for recreating its targets
+      Dimension current_client_dim(void) {
+        if (!maximize_) return get_client_size();
+        return get_client_dim(get_max_window_dim(work_area_), scrollbar_width_, CONSOLE_WINDOW_STYLE);
+      }
+
+      CursorCell current_cursor(void) const {
+        COORD pos = get_cursor_pos();
+        // if GetTickCount() rolls over it doesn't matter
+        #pragma warning(suppress: 28159)
+        CursorCell cursor = { pos.X, pos.Y, active_ && ((GetTickCount() / 500) % 2) };
+        return cursor;
+      }
+
+      unsigned char post_alpha(void) const {
+        return active_ ? active_post_alpha_ : inactive_post_alpha_;
+      }
+
+      // Asks the root window for a tick sooner than its timer would give
+      //   one. The root window coalesces the requests of all its windows, and
+      //   a frame is only drawn if something visible changed since the last
+      //   present, which for an idle inactive window is never.
+      void request_frame(void) {
+        if (!PostMessage(hub_, CRM_FRAME_REQUEST, 0, 0)) WIN_EXCEPT("Failed call to PostMessage(). ");
+      }
+
+      // for when the text has to be redrawn whole but the last snapshot was
+      //   already drawn
+      void request_snapshot(void) {
+        capture_.poke();
+      }
+
+      void close_self(void) {
+        state_ = CLOSING;
+        dispose_resources();
+        if (!PostMessage(get_hwnd(), WM_CLOSE, 0, 0)) WIN_EXCEPT("Failed call to PostMessage(). ");
+      }
+
+      // The derived window handles its own messages first and passes the
+      //   rest on to this.
+      LRESULT actual_wnd_proc(UINT Msg, WPARAM wParam, LPARAM lParam) {
+        switch (Msg) {
+          case CRM_CONSOLE_CAPTURE:
+            // typing moves the cursor, which shouldn't wait for the timer;
+            //   the snapshot is taken in when the tick prepares this window
+            if (state_ == RUNNING) request_frame();
+            break;
+          case CRM_WORKAREA_CHANGE:
+            on_workarea_change();
+            break;
+          case CRM_ADJUST_WINDOW:
+            { MessageData * msg_data = reinterpret_cast<MessageData *>(lParam);
+              ASSERT(msg_data);
+              on_adjust(msg_data);
+            }
+            break;
+          case WM_ACTIVATE:
+            on_activate();
+            return 0;
+          case WM_COMMAND:
+            on_command(LOWORD(wParam));
+            return 0;
+          case WM_DESTROY:
+            { state_ = DEAD;
+              HWND hWnd = get_hwnd();
+              LRESULT ret_val = Window<T>::actual_wnd_proc(Msg, wParam, lParam);
+              // this SendMesssage() call will cause the C++ object for the class to be destroyed
+              SendMessage(hub_, CRM_CONSOLE_CLOSE, 0, reinterpret_cast<LPARAM>(hWnd));
+              return ret_val;
+            }
+          case WM_MOVING:
+            return on_moving(lParam);
+          case WM_NCHITTEST:
+            { POINTS p = MAKEPOINTS(lParam);
+              WINDOWINFO wi = {};
+              if (!GetWindowInfo(get_hwnd(), &wi)) WIN_EXCEPT("Failed call to GetWindowInfo(). ");
+              int window_x = p.x - wi.rcWindow.left;
+              int scroll_start = wi.rcWindow.right - wi.rcWindow.left + 1
+                                - 2 * wi.cxWindowBorders
+                                - scrollbar_width_;
+              if (window_x >= scroll_start) return HTVSCROLL;
+            }
+            return HTCAPTION;
+          case WM_PAINT:
+            on_paint();
+            break;
+          case WM_QUERYDRAGICON:
+            // DefWindowProc will actually cause an access violation
+            //   for WM_QUERYDRAGICON if the message is passed right after
+            //   the window is created.
+            return NULL;
+          case WM_NCRBUTTONUP:
+            { POINTS p = MAKEPOINTS(lParam);
+              menu_->set_console_visible(shell_process_.is_console_visible());
+              menu_->set_z_order(z_order_);
+              set_menu_options(menu_);
+              menu_->display(get_hwnd(), p);
+            }
+            break;
+          case WM_WINDOWPOSCHANGING:
+            { WINDOWPOS * wp = reinterpret_cast<WINDOWPOS *>(lParam);
+              if (z_order_ == Z_BOTTOM) {
+                wp->hwndInsertAfter = HWND_BOTTOM;
+              }
+            }
+            break;
+          case WM_KEYDOWN:
+          case WM_INPUTLANGCHANGEREQUEST:
+          case WM_KEYUP:
+          case WM_MOUSEWHEEL:
+          case WM_VSCROLL:
+          case WM_SYSKEYDOWN:
+          case WM_SYSKEYUP:
+            PostMessage(shell_process_.window_handle(), Msg, wParam, lParam);
+            capture_.poke();
+            update_scrollbar();
+            request_frame();
+            break;
+          default:
+            break;
+        }
+        return Window<T>::actual_wnd_proc(Msg, wParam, lParam);
+      }
+
+      bool active_; // if window has focus
+      WindowState state_;
+
+      FrameTracker frame_;
+      CursorCell cursor_;  // in the frame being drawn
+    private:
+      // The text and its drawing, as kept by the derived window.
+      virtual Dimension console_dim_from_window_size(Dimension window_dim, INT scrollbar_width) = 0;
+      virtual Dimension get_client_size(void) = 0;
+      virtual void resize_buffers(Dimension console_dim) = 0;
+      // Returns whether the snapshot has a different console size, resizing
+      //   the buffers for it if so.
+      virtual bool poll_console_size(const ConsoleSnapshot & snapshot) = 0;
+      virtual void take_snapshot(const ConsoleSnapshot & snapshot) = 0;
+      virtual void take_console_info(ProcessLock & pl) = 0;
+      virtual COORD get_cursor_pos(void) const = 0;
+      // Returns whether a different font was chosen.
+      virtual bool choose_font(void) = 0;
+      // the font, gutter, pre alpha and character settings of an --adjust
+      virtual void adjust_text(const Settings & settings) = 0;
+      virtual void toggle_extended_chars(void) = 0;
+      virtual void set_menu_options(MenuPtr & menu) = 0;
+      // Returns whether the text has to be redrawn from a new snapshot.
+      virtual bool activation_changed(void) = 0;
+      // Called after the window was resized, to resize what it's drawn into.
+      virtual void resize_targets(Dimension client_dim) = 0;
+
+      HWND hub_;  // handle to controller window
+      ShellProcess shell_process_; // interface to spawned process
+
+      bool maximize_;        // if the window was created to cover work area
+
+      INT scrollbar_width_;
+      int snap_distance_; // distance to edges of work area before window adjustment
+
+      MenuPtr menu_;
+      RECT work_area_;
+      ZOrder z_order_;
+
+      unsigned char active_post_alpha_;
+      unsigned char inactive_post_alpha_;
+
+      // declared last so the capture thread stops before anything it uses is
+      //   destroyed
+      ConsoleCapture capture_;
+
+      void resize_console(Dimension console_dim, ProcessLock & pl) {
+        resize_buffers(pl.resize(console_dim));
+        capture_.poke();
+      }
+
+      // The system wants part of the window repainted, such as when it is
+      //   uncovered. The frame is presented again at the next tick.
+      void on_paint(void) {
+        if (state_ == RUNNING) {
+          frame_.mark(FRAME_EXPOSE);
+          request_frame();
+        }
+      }
+
+      void update_text_buffer(ProcessLock & pl) {
+        ASSERT(pl == true);
+        ASSERT(shell_process_.attached());
+        if (state_ == RUNNING) {
+          take_console_info(pl);
+          request_frame();
+        }
+      }
+
+      void update_scrollbar(void) {
+        if (state_ == RUNNING) {
+          SCROLLINFO si = { sizeof(SCROLLINFO), SIF_ALL };
+          if (!GetScrollInfo(shell_process_.window_handle(), SB_VERT, &si)) {
+            DWORD err = GetLastError();
+            if (err == ERROR_INVALID_WINDOW_HANDLE) {
+              // this can happen if update_scrollbar is called after the shell process
+              //   terminates but before the timer detects it.
+              CLOSE_SELF();
+            }
+            WIN_EXCEPT2("Failed call to GetScrollInfo(). ", err);
+          }
+          update_scrollbar(si);
+        }
+      }
+
+      void update_scrollbar(SCROLLINFO si) {
+        ASSERT(si.cbSize == sizeof(SCROLLINFO));
+        ASSERT(si.fMask == SIF_ALL);
+        // SetScrollInfo()'s return doesn't contain an error value so can be ignored
+        SetScrollInfo(get_hwnd(), SB_VERT, &si, TRUE);
+      }
+
+      void update_console_size(const ConsoleSnapshot & snapshot) {
+        ASSERT(state_ == RUNNING);
+        if (poll_console_size(snapshot)) {
+          //resize window
+          if (!maximize_) {
+            // if the window is maximized, then the only thing we can do is make
+            //   sure the console buffers are big enough
+            // otherwise change the actual window size
+            state_ = RESETTING;
+            Dimension new_client_dim = get_client_size();
+            Dimension new_window_dim = calc_window_size(new_client_dim, scrollbar_width_, CONSOLE_WINDOW_STYLE);
+            resize_window(new_client_dim, new_window_dim);
+            state_ = RUNNING;
+          }
+        }
+      }
+
+      // Takes the newest snapshot from the capture thread, if there is one.
+      //   The console is only read on the capture thread, so a busy console
+      //   can't hold up the message loop. The text is drawn later in the
+      //   tick.
+      void apply_snapshot(void) {
+        ASSERT(state_ == RUNNING);
+        const ConsoleSnapshot * snapshot = capture_.latest();
+        if (!snapshot) return;
+        if (snapshot->exited) CLOSE_SELF();
+        // taken before this window resized the console; the next one will
+        //   be along shortly
+        if (snapshot->resize_generation != shell_process_.resize_generation()) return;
+
+        update_console_size(*snapshot);
+        update_scrollbar(snapshot->scroll_info);
+        set_window_title(snapshot->title);
+        if (state_ == RUNNING) take_snapshot(*snapshot);
+      }
+
+      void set_window_title(const tstring & console_title) {
+        const int BUFFER_SIZE = 0x800;
+
+        // Profiler indicates that SetWindowText() is sufficiently slower than GetWindowtext() that checking if
+        //   the text is the same first makes sense
+        TCHAR window_text[BUFFER_SIZE] = {};
+        if (GetWindowText(get_hwnd(), window_text, BUFFER_SIZE) &&
+            !_tcsncmp(console_title.c_str(), window_text, BUFFER_SIZE)) return;
+
+        if (!SetWindowText(get_hwnd(), console_title.c_str())) WIN_EXCEPT("Failed call to SetWindowText(). ");
+      }
+
+      BOOL on_moving(LPARAM lParam) {
+        RECT * r = reinterpret_cast<RECT *>(lParam);
+        if (maximize_) {
+          r->bottom -= r->top;
+          r->right  -= r->left;
+          r->top    = 0;
+          r->left   = 0;
+        } else {
+          HMONITOR mon = MonitorFromWindow(get_hwnd(), MONITOR_DEFAULTTOPRIMARY);
+          MONITORINFO info = { sizeof(MONITORINFO) };
+          if (!GetMonitorInfo(mon, &info)) WIN_EXCEPT("Failed call to GetMonitorInfo(). ");
+          work_area_ = info.rcWork;
+          snap_window(*r, info.rcWork, snap_distance_);
+        }
+        return TRUE;
+      }
+
+      bool check_active_changed(void) {
+        bool is_active = (GetForegroundWindow() == get_hwnd());
+        if (is_active != active_) {
+          active_ = is_active;
+          return true;
+        }
+        return false;
+      }
+
+      void on_activate(void) {
+        if (check_active_changed()) {
+          if (activation_changed()) capture_.poke();
+          frame_.mark(FRAME_ACTIVATION);
+          request_frame();
+        }
+      }
+
+      void move_window(int x, int y) {
+        if (!SetWindowPos(get_hwnd(),
+                          0, // ignored
+                          x,
+                          y,
+                          0, // ignored
+                          0, // ignored
+                          SWP_NOACTIVATE | SWP_NOSIZE | SWP_NOZORDER))
+          WIN_EXCEPT("Failed call to SetWindowPos().");
+      }
+
+      void on_workarea_change(void) {
+        ASSERT(state_ == RUNNING);
+        int new_scrollbar_width = GetSystemMetrics(SM_CXVSCROLL);
+
+        if (maximize_) {
+          SendMessage(shell_process_.window_handle(), WM_SETTINGCHANGE, 0, 0);
+          state_ = RESETTING;
+
+          Dimension old_window_dim = get_max_window_dim(work_area_);
+
+          HMONITOR mon = MonitorFromWindow(get_hwnd(), MONITOR_DEFAULTTOPRIMARY);
+          MONITORINFO info = { sizeof(MONITORINFO) };
+          if (!GetMonitorInfo(mon, &info)) WIN_EXCEPT("Error in GetMonitorInfo() call. ");
+
+          Dimension new_window_dim = get_max_window_dim(info.rcWork);
+          work_area_ = info.rcWork;
+          POINT p = { work_area_.left, work_area_.top };
+
+          if ((old_window_dim != new_window_dim) || (new_scrollbar_width != scrollbar_width_)) {
+            scrollbar_width_ = new_scrollbar_width;
+            resize_window(get_client_dim(new_window_dim, scrollbar_width_, CONSOLE_WINDOW_STYLE), new_window_dim);
+          }
+          Dimension console_dim = console_dim_from_window_size(new_window_dim, scrollbar_width_);
+          move_window(p.x, p.y);
+          if (ProcessLock pl = shell_process_) {
+            resize_console(console_dim, pl);
+            state_ = RUNNING;
+            update_text_buffer(pl);
+          } else {
+            CLOSE_SELF();
+          }
+        } else {
+          int delta_scrollbar_width = new_scrollbar_width - scrollbar_width_;
+          if (new_scrollbar_width != scrollbar_width_) {
+            scrollbar_width_ = new_scrollbar_width;
+            Dimension new_client_dim = get_client_size();
+            Dimension new_window_dim = calc_window_size(new_client_dim, scrollbar_width_, CONSOLE_WINDOW_STYLE);
+            state_ = RESETTING;
+            resize_window(new_client_dim, new_window_dim);
+            state_ = RUNNING;
+          }
+
+          RECT r;
+          if (!GetWindowRect(get_hwnd(), &r)) WIN_EXCEPT("Failed call to GetWindowRect().");
+
+          int delta_left   = r.left   - work_area_.left;
+          int delta_right  = r.right  - work_area_.right;
+          int delta_top    = r.top    - work_area_.top;
+          int delta_bottom = r.bottom - work_area_.bottom;
+
+          int new_x = r.left;
+          int new_y = r.top;
+
+          HMONITOR mon = MonitorFromWindow(get_hwnd(), MONITOR_DEFAULTTOPRIMARY);
+          MONITORINFO info = { sizeof(MONITORINFO) };
+          if (!GetMonitorInfo(mon, &info)) WIN_EXCEPT("Failed call to GetMonitorInfo(). ");
+
+          if (delta_left == 0)   new_x  = info.rcWork.left;
+          if (delta_top  == 0)   new_y  = info.rcWork.top;
+          if (delta_right == 0)  {
+            new_x += info.rcWork.right - work_area_.right;
+            new_x -= delta_scrollbar_width;
+          }
+          if (delta_bottom == 0) new_y += info.rcWork.bottom - work_area_.bottom;
+
+          work_area_ = info.rcWork;
+          move_window(new_x, new_y);
+        }
+      }
+
+      void change_font(void) {
+        ASSERT(state_ == RUNNING);
+        if (choose_font()) {
+          state_ = RESETTING;
+          if (maximize_) {
+            Dimension window_dim = get_max_window_dim(work_area_);
+            Dimension console_dim = console_dim_from_window_size(window_dim, scrollbar_width_);
+
+            if (ProcessLock pl = shell_process_) {
+              resize_console(console_dim, pl);
+            } else {
+              CLOSE_SELF();
+            }
+          } else {
+            Dimension new_client_dim = get_client_size();
+            Dimension new_window_dim = calc_window_size(new_client_dim, scrollbar_width_, CONSOLE_WINDOW_STYLE);
+            resize_window(new_client_dim, new_window_dim);
+          }
+          state_ = RUNNING;
+          if (ProcessLock pl = shell_process_) {
+            update_text_buffer(pl);
+          } else {
+            CLOSE_SELF();
+          }
+        }
+      }
+
+      void resize_window(Dimension new_client_dim, Dimension new_window_dim) {
+        ASSERT(state_ == RESETTING);
+        if (!SetWindowPos(get_hwnd(), 0, 0, 0, new_window_dim.width, new_window_dim.height, SWP_NOMOVE | SWP_NOZORDER))
+          WIN_EXCEPT("Failed call to SetWindowPos().");
+        resize_targets(new_client_dim);
+        frame_.mark(FRAME_RESET);
+        request_frame();
+      }
+
+      void on_command(int id) {
+        switch (id) {
+          case ID_CHANGEFONT:
+            change_font();
+            break;
+          case ID_EXIT:
+            close_self();
+            if (!PostMessage(shell_process_.window_handle(), WM_CLOSE, 0, 0))
+              WIN_EXCEPT("Failed call to PostMessage().");
+            break;
+          case ID_SHOWCONSOLE:
+            shell_process_.toggle_console_visible();
+            break;
+          case ID_SHOWEXTENDEDCHARACTERS:
+            toggle_extended_chars();
+            break;
+          case ID_ALWAYSONTOP:
+            if (z_order_ == Z_TOP) {
+              set_z_order(Z_NORMAL);
+            } else {
+              set_z_order(Z_TOP);
+            }
+            break;
+          case ID_ALWAYSONBOTTOM:
+            if (z_order_ == Z_BOTTOM) {
+              set_z_order(Z_NORMAL);
+            } else {
+              set_z_order(Z_BOTTOM);
+            }
+            break;
+        }
+      }
+
+      void set_z_order(ZOrder z_order) {
+        z_order_ = z_order;
+        switch (z_order) {
+          case Z_BOTTOM:
+            set_z_bottom(get_hwnd());
+            return;
+          case Z_NORMAL:
+            set_z_normal(get_hwnd());
+            return;
+          case Z_TOP:
+            set_z_top(get_hwnd());
+            return;
+          default:
+            ASSERT(false);
+        }
+      }
+
+      void on_adjust(const Settings & settings) {
+        if (settings.scl_z_order) set_z_order(settings.z_order);
+        if (settings.scl_snap_distance) snap_distance_ = settings.snap_distance;
+        if (settings.scl_active_post_alpha) {
+          ASSERT(settings.active_post_alpha <= std::numeric_limits<unsigned char>::max());
+          active_post_alpha_ = static_cast<unsigned char>(settings.active_post_alpha);
+        }
+        if (settings.scl_inactive_post_alpha) {
+          ASSERT(settings.inactive_post_alpha <= std::numeric_limits<unsigned char>::max());
+          inactive_post_alpha_ = static_cast<unsigned char>(settings.inactive_post_alpha);
+        }
+
+        state_ = RESETTING;
+        if (settings.scl_maximize) {
+          maximize_ = settings.maximize;
+          if (maximize_) {
+            HMONITOR mon = MonitorFromWindow(get_hwnd(), MONITOR_DEFAULTTOPRIMARY);
+            MONITORINFO info = { sizeof(MONITORINFO) };
+            if (!GetMonitorInfo(mon, &info)) WIN_EXCEPT("Error in GetMonitorInfo() call. ");
+
+            Dimension new_window_dim = get_max_window_dim(info.rcWork);
+            work_area_ = info.rcWork;
+            POINT p = { work_area_.left, work_area_.top };
+
+            resize_window(get_client_dim(new_window_dim, scrollbar_width_, CONSOLE_WINDOW_STYLE), new_window_dim);
+            move_window(p.x, p.y);
+          }
+        }
+
+        adjust_text(settings);
+        if (maximize_) {
+          Dimension window_dim = get_max_window_dim(work_area_);
+          Dimension console_dim = console_dim_from_window_size(window_dim, scrollbar_width_);
+
+          if (ProcessLock pl = shell_process_) {
+            resize_console(console_dim, pl);
+          } else {
+            CLOSE_SELF();
+          }
+        } else {
+          if (settings.scl_maximize || settings.scl_columns || settings.scl_rows) {
+            if (ProcessLock pl = shell_process_) {
+              resize_console(Dimension(settings.columns, settings.rows), pl);
+            } else {
+              CLOSE_SELF();
+            }
+          }
+
+          Dimension new_client_dim = get_client_size();
+          Dimension new_window_dim = calc_window_size(new_client_dim, scrollbar_width_, CONSOLE_WINDOW_STYLE);
+          resize_window(new_client_dim, new_window_dim);
+        }
+        state_ = RUNNING;
+      }
+
+      void on_adjust(MessageData * msg_data) {
+        try {
+          Settings settings(msg_data->char_data);
+          on_adjust(settings);
+        } catch (boost::program_options::error & e) {
+          MessageBox(get_hwnd(), TBuffer(e.what()), _T("--adjust error"), MB_OK);
+        }
+      }
+
+      void set_icon(void) {
+        HICON hIcon = LoadIcon( GetModuleHandle(NULL), MAKEINTRESOURCE(IDI_ICON1) );
+        if (!hIcon) WIN_EXCEPT("Error in LoadIcon() call. ");
+        actual_wnd_proc(WM_SETICON, ICON_BIG, (LPARAM)hIcon);
+        actual_wnd_proc(WM_SETICON, ICON_SMALL, (LPARAM)hIcon);
+        if (!DestroyIcon(hIcon)) WIN_EXCEPT("Error in DestroyIcon() call. ");
+      }
+
+      ConsoleWindowBase(const ConsoleWindowBase &);
+      ConsoleWindowBase & operator=(const ConsoleWindowBase &);
+  };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,102 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// cpu_features.cpp
+// implementation of SIMD support detection through cpuid
+
+#include "cpu_features.h"
+
+#ifdef _MSC_VER
+  #include <intrin.h>
+#elif defined(CONREP_X86)
+  #include <cpuid.h>
+#endif
+
+namespace console {
+  namespace {
+    #ifdef CONREP_X86
+      SimdLevel detect_simd_level(void) {
+        unsigned regs[4] = {};
+        unsigned max_leaf = 0;
+        #ifdef _MSC_VER
+          int info[4];
+          __cpuid(info, 0);
+          max_leaf = info[0];
+          __cpuid(info, 1);
+          for (int i = 0; i < 4; ++i) regs[i] = info[i];
+        #else
+          if (!__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3])) return SIMD_SCALAR;
+          max_leaf = __get_cpuid_max(0, 0);
+        #endif
+        bool sse2    = (regs[3] & (1 << 26)) != 0;
+        bool osxsave = (regs[2] & (1 << 27)) != 0;
+        bool avx     = (regs[2] & (1 << 28)) != 0;
+        if (!sse2) return SIMD_SCALAR;
+        if (!osxsave || !avx || (max_leaf < 7)) return SIMD_SSE2;
+
+        // the OS must also save the upper halves of the ymm registers
+        unsigned long long xcr0;
+        #ifdef _MSC_VER
+          __cpuidex(info, 7, 0);
+          for (int i = 0; i < 4; ++i) regs[i] = info[i];
+          xcr0 = _xgetbv(0);
+        #else
+          __cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+          unsigned lo, hi;
+          __asm__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+          xcr0 = (static_cast<unsigned long long>(hi) << 32) | lo;
+        #endif
+        bool avx2 = (regs[1] & (1 << 5)) != 0;
+        if (avx2 && ((xcr0 & 0x6) == 0x6)) return SIMD_AVX2;
+        return SIMD_SSE2;
+      }
+    #else
+      SimdLevel detect_simd_level(void) {
+        return SIMD_SCALAR;
+      }
+    #endif
+
+    // Initialized during static initialization, before any other threads
+    //   exist.
+    const SimdLevel simd_level = detect_simd_level();
+  }
+
+  SimdLevel get_simd_level(void) {
+    return simd_level;
+  }
+
+  unsigned lowest_bit(unsigned v) {
+    #ifdef _MSC_VER
+      unsigned long index;
+      _BitScanForward(&index, v);
+      return index;
+    #else
+      return __builtin_ctz(v);
+    #endif
+  }
+
+  unsigned highest_bit(unsigned v) {
+    #ifdef _MSC_VER
+      unsigned long index;
+      _BitScanReverse(&index, v);
+      return index;
+    #else
+      return 31 - __builtin_clz(v);
+    #endif
+  }
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Runtime detection of the SIMD instruction sets used by the cell kernels,
+//   and the macros needed to compile those kernels with different compilers.
+
+#ifndef CONREP_CPU_FEATURES_H
+#define CONREP_CPU_FEATURES_H
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+  #define CONREP_X86 1
+  #include <immintrin.h>
+#endif
+
+// MSVC allows intrinsics for any instruction set to be used in any function;
+//   gcc and clang need the function to be marked with the target.
+#if defined(CONREP_X86) && !defined(_MSC_VER)
+  #define CONREP_TARGET_SSE2 __attribute__((target("sse2")))
+  #define CONREP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+  #define CONREP_TARGET_SSE2
+  #define CONREP_TARGET_AVX2
+#endif
+
+namespace console {
+  // ordered so that a higher level implies support for the lower ones
+  enum SimdLevel {
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2
+  };
+
+  // best level supported by the current processor and OS
+  SimdLevel get_simd_level(void);
+
+  unsigned lowest_bit(unsigned v);  // v must be non-zero
+  unsigned highest_bit(unsigned v); // v must be non-zero
+}
+
+#endif
\ No newline at end of file
@@ -22,41 +22,30 @@
 
 #include "d3root.h"
 
+#include <ShlObj.h>
+
 #include "assert.h"
+#include "background_cache.h"
+#include "background_residency.h"
 #include "dimension.h"
 #include "exception.h"
 #include "gdiplus.h"
+#include "message.h"
 #include "reg.h"
-#include "mem_stream.h"
+#include "timer.h"
+#include "wallpaper_decoder.h"
 
+#include <chrono>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <sstream>
+#include <vector>
 
 using namespace ATL;
 using namespace Gdiplus;
 
 namespace console {
-  CLSID GetEncoderClsid(const std::wstring & format) {
-    UINT  num = 0;          // number of image encoders
-    UINT  size = 0;         // size of the image encoder array in bytes
-
-    Status st = GetImageEncodersSize(&num, &size);
-    if (st != Ok) GDIPLUS_EXCEPT("Failed call to GetImageEncodersSize(). ", st);
-
-    std::vector<char> buffer(size);
-    ImageCodecInfo * pImageCodecInfo = reinterpret_cast<ImageCodecInfo *>(&buffer[0]);
-
-    st = GetImageEncoders(num, size, pImageCodecInfo);
-    if (st != Ok) GDIPLUS_EXCEPT("Failed call to GetImageEncoders(). ", st);
-
-    for (UINT j = 0; j < num; ++j) {
-      if (pImageCodecInfo[j].MimeType == format) {
-        return pImageCodecInfo[j].Clsid;
-      }
-    }
-    MISC_EXCEPT("PNG codec not found.");
-  }
-
   D3DPRESENT_PARAMETERS get_present_parameters(void) {  
     D3DPRESENT_PARAMETERS present_parameters = {};
     present_parameters.BackBufferCount = 1;
@@ -67,6 +56,83 @@ namespace console {
     return present_parameters;
   }
 
+  struct RenderState {
+    D3DRENDERSTATETYPE type;
+    DWORD value;
+  };
+
+  struct StageState {
+    DWORD stage;
+    D3DTEXTURESTAGESTATETYPE type;
+    DWORD value;
+  };
+
+  // separate alpha blending as the sprite leaves it and for drawing text
+  //   that holds transmittance
+  const RenderState OPACITY_BLEND_STATES[] = {
+    { D3DRS_SEPARATEALPHABLENDENABLE, FALSE },
+    { D3DRS_SRCBLENDALPHA,            D3DBLEND_ONE },
+    { D3DRS_DESTBLENDALPHA,           D3DBLEND_ZERO }
+  };
+  const RenderState TRANSMITTANCE_BLEND_STATES[] = {
+    { D3DRS_SEPARATEALPHABLENDENABLE, TRUE },
+    { D3DRS_SRCBLENDALPHA,            D3DBLEND_ZERO },
+    { D3DRS_DESTBLENDALPHA,           D3DBLEND_INVSRCALPHA }
+  };
+
+  // the stages as D3DXSPRITE_ALPHABLEND sets them up
+  const StageState SPRITE_STAGES[] = {
+    { 0, D3DTSS_COLOROP,   D3DTOP_MODULATE },
+    { 0, D3DTSS_COLORARG1, D3DTA_TEXTURE },
+    { 0, D3DTSS_COLORARG2, D3DTA_DIFFUSE },
+    { 0, D3DTSS_ALPHAOP,   D3DTOP_MODULATE },
+    { 0, D3DTSS_ALPHAARG1, D3DTA_TEXTURE },
+    { 0, D3DTSS_ALPHAARG2, D3DTA_DIFFUSE },
+    { 1, D3DTSS_COLOROP,   D3DTOP_DISABLE },
+    { 1, D3DTSS_ALPHAOP,   D3DTOP_DISABLE },
+    { 2, D3DTSS_COLOROP,   D3DTOP_DISABLE },
+    { 2, D3DTSS_ALPHAOP,   D3DTOP_DISABLE }
+  };
+  // see Direct3DRoot::begin_fused_alpha()
+  const StageState FUSED_ALPHA_STAGES[] = {
+    { 0, D3DTSS_COLOROP,   D3DTOP_SELECTARG1 },
+    { 0, D3DTSS_COLORARG1, D3DTA_TEXTURE },
+    { 0, D3DTSS_ALPHAOP,   D3DTOP_MODULATE },
+    { 0, D3DTSS_ALPHAARG1, D3DTA_TEXTURE | D3DTA_COMPLEMENT },
+    { 0, D3DTSS_ALPHAARG2, D3DTA_TEXTURE | D3DTA_COMPLEMENT },
+    { 1, D3DTSS_TEXCOORDINDEX, 0 },
+    { 1, D3DTSS_COLOROP,   D3DTOP_SELECTARG1 },
+    { 1, D3DTSS_COLORARG1, D3DTA_CURRENT },
+    { 1, D3DTSS_ALPHAOP,   D3DTOP_MULTIPLYADD },
+    { 1, D3DTSS_ALPHAARG0, D3DTA_CURRENT },
+    { 1, D3DTSS_ALPHAARG1, D3DTA_TEXTURE },
+    { 1, D3DTSS_ALPHAARG2, D3DTA_TFACTOR },
+    { 2, D3DTSS_COLOROP,   D3DTOP_MODULATE },
+    { 2, D3DTSS_COLORARG1, D3DTA_CURRENT },
+    { 2, D3DTSS_COLORARG2, D3DTA_DIFFUSE },
+    { 2, D3DTSS_ALPHAOP,   D3DTOP_MODULATE },
+    { 2, D3DTSS_ALPHAARG1, D3DTA_CURRENT },
+    { 2, D3DTSS_ALPHAARG2, D3DTA_DIFFUSE },
+    { 3, D3DTSS_COLOROP,   D3DTOP_DISABLE },
+    { 3, D3DTSS_ALPHAOP,   D3DTOP_DISABLE }
+  };
+
+  template <size_t N>
+  void set_render_states(const DevicePtr & device, const RenderState (&states)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+      HRESULT hr = device->SetRenderState(states[i].type, states[i].value);
+      if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::SetRenderState(). ", hr);
+    }
+  }
+
+  template <size_t N>
+  void set_stage_states(const DevicePtr & device, const StageState (&states)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+      HRESULT hr = device->SetTextureStageState(states[i].stage, states[i].type, states[i].value);
+      if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::SetTextureStageState(). ", hr);
+    }
+  }
+
   template <typename T, typename CharT>
   T extract(std::basic_istream<CharT> & input_stream) {
     T temp;
@@ -74,11 +140,20 @@ namespace console {
     return temp;
   }
 
-  class Direct3DRoot;
-  
+  // what the per monitor background textures are built from
+  struct BackgroundData {
+    WallpaperStyle style;
+    D3DCOLOR background_color;
+    
+    tstring wallpaper_name;
+    TexturePtr wallpaper_texture; // loaded with the first monitor texture
+    int wallpaper_width;
+    int wallpaper_height;
+  };
+
   class Direct3DRoot : public IDirect3DRoot {
     public:
-      Direct3DRoot(HWND hwnd);
+      Direct3DRoot(HWND hwnd, Direct3DPtr iface, DevicePtr device);
       ~Direct3DRoot();
       
       DevicePtr device(void) const {
@@ -90,11 +165,10 @@ namespace console {
         return sprite_;
       }
       
-      TexturePtr background_texture(HMONITOR monitor) const {
-        std::map<HMONITOR, TexturePtr>::const_iterator itr = background_textures_.find(monitor);
-        if (itr == background_textures_.end()) MISC_EXCEPT("Invalid HMONITOR index");
-        return itr->second;
-      }
+      TexturePtr background_texture(HMONITOR monitor);
+      void cover_monitors(HWND window, const std::vector<HMONITOR> & monitors);
+      void trim_backgrounds(void);
+      size_t background_bytes(void) const;
       
       TexturePtr white_texture(void) const {
         return white_texture_;
@@ -102,9 +176,17 @@ namespace console {
 
       TexturePtr create_texture(Dimension dim);
       TexturePtr create_texture(Dimension dim, D3DCOLOR color);
+      TexturePtr acquire_target(Dimension dim);
+      TexturePtr acquire_target(Dimension dim, D3DCOLOR color);
       SwapChainPtr get_swap_chain(HWND hwnd, Dimension client_dim);
+      void trim_targets(void);
+      TargetPoolCounts target_counts(void) const;
+      bool read_target(TexturePtr texture, Dimension dim, ShadowImage & image);
+      void upload_target(TexturePtr texture, const ShadowImage & image);
       
-      void reset_background(void);
+      bool reset_background(void);
+      bool install_wallpaper(void);
+      WallpaperTimings wallpaper_timings(void) const;
 
       void begin_scene(void);
       void end_scene(void);
@@ -113,11 +195,22 @@ namespace console {
       void set_render_target(SurfacePtr surface);
       
       void clear(D3DCOLOR color);
+      void clear(D3DCOLOR color, const RECT & rect);
+      void set_scissor(const RECT & rect);
+      void clear_scissor(void);
+      void copy_rect(TexturePtr source, const RECT & source_rect, TexturePtr dest, const RECT & dest_rect);
+      void copy_rect(TexturePtr source, const RECT & source_rect, SurfacePtr dest, const RECT & dest_rect);
+
+      bool supports_fused_alpha(void) const;
+      void set_transmittance_blend(bool enable);
+      void begin_fused_alpha(TexturePtr text, unsigned char pre_alpha);
+      void end_fused_alpha(void);
 
       bool is_device_lost(void);
       void set_device_lost(void);
       
-      HRESULT try_recover(void);
+      DeviceStatus test_device(void);
+      bool reset_device(void);
 
       ColorTable & get_color_table(void);
     private:
@@ -125,23 +218,154 @@ namespace console {
       DevicePtr   device_;
       SpritePtr   sprite_;
       TexturePtr  white_texture_;
-      std::map<HMONITOR, TexturePtr> background_textures_;
+      std::map<HMONITOR, TexturePtr> background_textures_; // built on demand
+      ShadowStore background_shadows_; // by monitor; kept through resets
+      BackgroundResidency residency_;
+      std::vector<MonitorKey> monitor_keys_; // work buffer
+      BackgroundData background_;
+      BackgroundData next_background_; // settings being decoded for
+      bool decoding_;
+      WallpaperTimings timings_;
+      tstring cache_dir_; // composed backgrounds on disk; empty if unavailable
       bool device_lost_;
+      bool fused_alpha_supported_;
+
+      TargetPool texture_pool_;
+      std::map<int, TexturePtr> pooled_textures_;     // by pool id
+      TargetPool swap_chain_pool_;                    // keyed by window
+      std::map<int, SwapChainPtr> pooled_swap_chains_;
+      std::vector<int> evicted_; // work buffer
+
+      std::unique_ptr<IWallpaperSource> wallpaper_source_;
+      WallpaperDecoder decoder_; // uses wallpaper_source_
 
       ColorTable color_table_;
     
       Direct3DRoot(const Direct3DRoot &);
       Direct3DRoot & operator=(const Direct3DRoot &);
       
-      void set_background_textures(void);
+      void read_background_settings(BackgroundData & settings);
+      void install_background(const BackgroundData & settings);
+      void request_wallpaper(const BackgroundData & settings);
+      void load_wallpaper(void);
+      void upload_wallpaper(const DecodedWallpaper & decoded);
+      TexturePtr build_background_texture(const RECT & monitor);
+      bool background_key(const RECT & monitor, BackgroundKey & key);
+      bool load_cached_background(const BackgroundKey & key, ShadowImage & image);
+      void store_cached_background(const BackgroundKey & key, const ShadowImage & image);
       void check_capability(void);
-
-      static BOOL CALLBACK set_background_enum_proc(HMONITOR hMonitor,
-                                                    HDC hdcMonitor,
-                                                    LPRECT lprcMonitor,
-                                                    LPARAM dwData); 
+      void reclaim_targets(std::uint32_t now);
+      void clear_targets(void);
   };
   
+  namespace {
+    // how much memory free pooled targets may hold on to
+    const std::uint64_t TEXTURE_POOL_BYTES    = 64 << 20;
+    const std::uint64_t SWAP_CHAIN_POOL_BYTES = 32 << 20;
+    // how much system memory the shadow copies of backgrounds may take
+    const std::uint64_t BACKGROUND_SHADOW_BYTES = 128 << 20;
+
+    // Whether the pool holds the only reference to object. Windows don't
+    //   hand pooled targets back; they just release their pointers.
+    bool pool_only_reference(IUnknown * object) {
+      object->AddRef();
+      return object->Release() == 1;
+    }
+
+    // unmaps a view of a file mapping when it goes out of scope
+    class MappedView {
+      public:
+        MappedView(HANDLE mapping, DWORD access, size_t size)
+          : addr_(MapViewOfFile(mapping, access, 0, 0, size))
+        {}
+        ~MappedView() {
+          if (addr_) UnmapViewOfFile(addr_);
+        }
+        void * addr(void) const {
+          return addr_;
+        }
+      private:
+        void * addr_;
+
+        MappedView(const MappedView &);
+        MappedView & operator=(const MappedView &);
+    };
+
+    // Composed backgrounds depend on the monitors of this machine, so they
+    //   go under the local rather than the roaming application data.
+    tstring get_background_cache_dir(void) {
+      TCHAR appdata[MAX_PATH];
+      HRESULT hr = SHGetFolderPath(NULL, CSIDL_LOCAL_APPDATA | CSIDL_FLAG_CREATE, NULL, 0, appdata);
+      if (FAILED(hr)) return tstring();
+      tstring dir = tstring(appdata) + _T("\\Conrep");
+      CreateDirectory(dir.c_str(), 0);
+      dir += _T("\\Backgrounds");
+      if (!CreateDirectory(dir.c_str(), 0) && (GetLastError() != ERROR_ALREADY_EXISTS)) return tstring();
+      return dir + _T("\\");
+    }
+
+    // Written through a temporary file so that a partly written background
+    //   is never picked up by a later run.
+    void write_cache_file(const tstring & file_name, const BackgroundKey & key, Dimension dim,
+                          const Pixel * pixels, int stride) {
+      tstring temp_name = file_name + _T(".tmp");
+      unsigned long long size = background_cache_size(key, dim);
+      bool written = false;
+      {
+        HANDLE file_handle = CreateFile(temp_name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+        if (file_handle == INVALID_HANDLE_VALUE) return;
+        CHandle file(file_handle);
+        CHandle mapping(CreateFileMapping(file, 0, PAGE_READWRITE,
+                                          static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), 0));
+        if (mapping) {
+          MappedView view(mapping, FILE_MAP_WRITE, static_cast<size_t>(size));
+          if (view.addr()) {
+            write_background_cache(view.addr(), key, dim, pixels, stride);
+            written = true;
+          }
+        }
+      }
+      if (!written || !MoveFileEx(temp_name.c_str(), file_name.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFile(temp_name.c_str());
+      }
+    }
+
+    // Reads the wallpaper through GDI+ on the decoder's worker thread.
+    class GdiplusWallpaperSource : public IWallpaperSource {
+      public:
+        GdiplusWallpaperSource() {}
+
+        bool open(const std::wstring & name, Dimension & dim) {
+          bitmap_.reset(new Bitmap(name.c_str()));
+          if (bitmap_->GetLastStatus() != Ok) {
+            bitmap_.reset();
+            return false;
+          }
+          dim = Dimension(bitmap_->GetWidth(), bitmap_->GetHeight());
+          return true;
+        }
+        bool read_rows(int first, int count, Pixel * rows) {
+          Rect rect(0, first, bitmap_->GetWidth(), count);
+          BitmapData data = {};
+          data.Width       = rect.Width;
+          data.Height      = rect.Height;
+          data.Stride      = static_cast<INT>(rect.Width * sizeof(Pixel));
+          data.PixelFormat = PixelFormat32bppARGB;
+          data.Scan0       = rows;
+          if (bitmap_->LockBits(&rect, ImageLockModeRead | ImageLockModeUserInputBuf, PixelFormat32bppARGB, &data) != Ok) return false;
+          return bitmap_->UnlockBits(&data) == Ok;
+        }
+        void close(void) {
+          bitmap_.reset();
+        }
+      private:
+        std::unique_ptr<Bitmap> bitmap_;
+
+        GdiplusWallpaperSource(const GdiplusWallpaperSource &);
+        GdiplusWallpaperSource & operator=(const GdiplusWallpaperSource &);
+    };
+  }
+
   void Direct3DRoot::check_capability(void) {
     D3DCAPS9 caps;
     HRESULT hr = device_->GetDeviceCaps(&caps);
@@ -173,28 +397,38 @@ namespace console {
         DX_EXCEPT("Failed call to IDirect3D9::CheckDeviceFormatConversion(). ", hr);
       }
     }
-  }
 
-  Direct3DRoot::Direct3DRoot(HWND hwnd) : device_lost_(false) {
-    // Swap these two lines to force a memory leak.
-    //iface_ = Direct3DCreate9(D3D_SDK_VERSION);
-    iface_.Attach(Direct3DCreate9(D3D_SDK_VERSION));
-    if (!iface_) MISC_EXCEPT("Unable to initialize Direct3D 9.");
-  
-    D3DPRESENT_PARAMETERS present_parameters = get_present_parameters();
-    
-    HRESULT hr = iface_->CreateDevice(D3DADAPTER_DEFAULT,
-                                      D3DDEVTYPE_HAL,
-                                      hwnd,
-                                      D3DCREATE_SOFTWARE_VERTEXPROCESSING,
-                                      &present_parameters,
-                                      &device_);
-    if (FAILED(hr)) DX_EXCEPT("Unable to create device. ", hr);
+    // begin_fused_alpha() needs three stages with the text texture bound to
+    //   two of them
+    fused_alpha_supported_ = (caps.PrimitiveMiscCaps & D3DPMISCCAPS_SEPARATEALPHABLEND) &&
+                             (caps.TextureOpCaps & D3DTEXOPCAPS_MULTIPLYADD) &&
+                             (caps.MaxTextureBlendStages >= 3) &&
+                             (caps.MaxSimultaneousTextures >= 2);
+  }
 
+  Direct3DRoot::Direct3DRoot(HWND hwnd, Direct3DPtr iface, DevicePtr device)
+    : iface_(iface),
+      device_(device),
+      background_shadows_(BACKGROUND_SHADOW_BYTES),
+      residency_(BACKGROUND_IDLE_TIME),
+      decoding_(false),
+      cache_dir_(get_background_cache_dir()),
+      device_lost_(false),
+      fused_alpha_supported_(false),
+      texture_pool_(TARGET_IDLE_TIME, TEXTURE_POOL_BYTES, sizeof(D3DCOLOR)),
+      swap_chain_pool_(TARGET_IDLE_TIME, SWAP_CHAIN_POOL_BYTES, sizeof(D3DCOLOR)),
+      wallpaper_source_(new GdiplusWallpaperSource()),
+      decoder_(*wallpaper_source_, [hwnd]() {
+        // the root window may already be closing, so failure doesn't matter
+        PostMessage(hwnd, CRM_WALLPAPER_DECODED, 0, 0);
+      })
+  {
+    timings_.decode_ms = 0;
+    timings_.upload_ms = 0;
     check_capability();
     init_sprite();
     white_texture_ = create_texture(Dimension(64, 64), D3DCOLOR_XRGB(255, 255, 255));
-    set_background_textures();
+    read_background_settings(background_);
   }
 
   void Direct3DRoot::init_sprite(void) {  
@@ -231,41 +465,175 @@ namespace console {
     if (FAILED(hr)) DX_EXCEPT("Failure in ID3DXSprite::SetTransform(). ", hr);
   }
 
-  struct SetBackgroundData {
-    Direct3DRoot * root;
-    WallpaperStyle style;
-    D3DCOLOR background_color;
-    
-    TexturePtr wallpaper_texture;
-    int wallpaper_width;
-    int wallpaper_height;
-    
-    int origin_x;
-    int origin_y;
-  };
-  
-  BOOL CALLBACK Direct3DRoot::set_background_enum_proc(HMONITOR hMonitor,
-                                                       HDC,
-                                                       LPRECT lprcMonitor,
-                                                       LPARAM dwData) {
-    SetBackgroundData * sbd = reinterpret_cast<SetBackgroundData *>(dwData);
-    Direct3DRoot * root = sbd->root;
-    
-    int mon_width  = lprcMonitor->right - lprcMonitor->left;
-    int mon_height = lprcMonitor->bottom - lprcMonitor->top;
+  // A monitor's background comes from, in order of preference, its shadow
+  //   copy, kept through device resets, the cache on disk or drawing it
+  //   from the wallpaper. The first two are just an upload.
+  TexturePtr Direct3DRoot::background_texture(HMONITOR monitor) {
+    std::map<HMONITOR, TexturePtr>::const_iterator itr = background_textures_.find(monitor);
+    if (itr != background_textures_.end()) return itr->second;
+
+    MONITORINFO info = { sizeof(MONITORINFO) };
+    if (!GetMonitorInfo(monitor, &info)) WIN_EXCEPT("Failed call to GetMonitorInfo(). ");
+    Dimension dim(info.rcMonitor.right - info.rcMonitor.left, info.rcMonitor.bottom - info.rcMonitor.top);
+    MonitorKey monitor_key = reinterpret_cast<MonitorKey>(monitor);
+    TexturePtr texture;
+    const ShadowImage * shadow = background_shadows_.find(monitor_key);
+    if (shadow && (shadow->dim.width == dim.width) && (shadow->dim.height == dim.height)) {
+      texture = create_texture(dim);
+      upload_target(texture, *shadow);
+    } else {
+      ShadowImage image;
+      BackgroundKey key;
+      bool cacheable = background_key(info.rcMonitor, key);
+      bool shadowed = cacheable && load_cached_background(key, image);
+      if (shadowed) {
+        texture = create_texture(dim);
+        upload_target(texture, image);
+      } else {
+        texture = build_background_texture(info.rcMonitor);
+        shadowed = read_target(texture, dim, image);
+        // a wallpaper that failed to load leaves only the background color,
+        //   which isn't what the key describes
+        if (shadowed && cacheable && background_.wallpaper_texture) store_cached_background(key, image);
+      }
+      if (shadowed) background_shadows_.store(monitor_key, image);
+    }
+    background_textures_[monitor] = texture;
+
+    size_t bytes = dim.width * dim.height * sizeof(D3DCOLOR);
+    // if GetTickCount() rolls over it doesn't matter
+    #pragma warning(suppress: 28159)
+    residency_.loaded(monitor_key, bytes, GetTickCount());
+    return texture;
+  }
+
+  void Direct3DRoot::cover_monitors(HWND window, const std::vector<HMONITOR> & monitors) {
+    monitor_keys_.clear();
+    for (std::vector<HMONITOR>::const_iterator itr = monitors.begin(); itr != monitors.end(); ++itr) {
+      monitor_keys_.push_back(reinterpret_cast<MonitorKey>(*itr));
+    }
+    #pragma warning(suppress: 28159)
+    residency_.cover(reinterpret_cast<OwnerKey>(window), monitor_keys_, GetTickCount());
+  }
+
+  void Direct3DRoot::trim_backgrounds(void) {
+    #pragma warning(suppress: 28159)
+    if (residency_.evict(GetTickCount(), monitor_keys_)) {
+      for (std::vector<MonitorKey>::const_iterator itr = monitor_keys_.begin(); itr != monitor_keys_.end(); ++itr) {
+        background_textures_.erase(reinterpret_cast<HMONITOR>(*itr));
+        background_shadows_.erase(*itr);
+      }
+    }
+    // the wallpaper is only needed to build monitor textures, so goes with
+    //   the last of them
+    if (background_textures_.empty()) background_.wallpaper_texture = 0;
+  }
+
+  // Fills in the key for monitor's background. Only backgrounds with a
+  //   wallpaper are worth caching; a plain color is just a clear.
+  bool Direct3DRoot::background_key(const RECT & monitor, BackgroundKey & key) {
+    if (cache_dir_.empty() || background_.wallpaper_name.empty()) return false;
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesEx(background_.wallpaper_name.c_str(), GetFileExInfoStandard, &attributes)) return false;
+
+    OSVERSIONINFO osvi = {};
+    osvi.dwOSVersionInfoSize = sizeof(osvi);
+    if (!GetVersionEx(&osvi)) WIN_EXCEPT("Failed call to GetVersionEx(). ");
+
+    key.wallpaper_name   = WideBuffer(background_.wallpaper_name.c_str());
+    key.modify_time      = (static_cast<unsigned long long>(attributes.ftLastWriteTime.dwHighDateTime) << 32) |
+                           attributes.ftLastWriteTime.dwLowDateTime;
+    key.style            = background_.style;
+    key.background_color = background_.background_color;
+    key.monitor.left     = monitor.left;
+    key.monitor.top      = monitor.top;
+    key.monitor.right    = monitor.right;
+    key.monitor.bottom   = monitor.bottom;
+    key.origin_x         = GetSystemMetrics(SM_XVIRTUALSCREEN);
+    key.origin_y         = GetSystemMetrics(SM_YVIRTUALSCREEN);
+    key.os_version       = static_cast<int>(osvi.dwMajorVersion * 256 + osvi.dwMinorVersion);
+    return true;
+  }
+
+  // Maps the cached background for key and copies it into image. Returns
+  //   false if there isn't one; the cache is only an optimization, so
+  //   nothing here throws over a missing or unreadable file.
+  bool Direct3DRoot::load_cached_background(const BackgroundKey & key, ShadowImage & image) {
+    tstring file_name = cache_dir_ + tstring(TBuffer(background_cache_name(key).c_str()));
+    HANDLE file_handle = CreateFile(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (file_handle == INVALID_HANDLE_VALUE) return false;
+    CHandle file(file_handle);
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (size.QuadPart <= 0) || (size.QuadPart > 0x7fffffff)) return false;
+    CHandle mapping(CreateFileMapping(file, 0, PAGE_READONLY, 0, 0, 0));
+    if (!mapping) return false;
+    MappedView view(mapping, FILE_MAP_READ, static_cast<size_t>(size.QuadPart));
+    if (!view.addr()) return false;
+
+    Dimension dim;
+    const Pixel * pixels = read_background_cache(view.addr(), static_cast<size_t>(size.QuadPart), key, dim);
+    if (!pixels) return false;
+    copy_shadow(pixels, dim.width, dim, image);
+    return true;
+  }
+
+  // Writes a freshly built background, as read back from the device, to
+  //   the cache. Failures just leave the background uncached.
+  void Direct3DRoot::store_cached_background(const BackgroundKey & key, const ShadowImage & image) {
+    tstring file_name = cache_dir_ + tstring(TBuffer(background_cache_name(key).c_str()));
+    write_cache_file(file_name, key, image.dim, &image.pixels[0], image.dim.width);
+  }
+
+  bool Direct3DRoot::read_target(TexturePtr texture, Dimension dim, ShadowImage & image) {
+    SurfacePtr surface;
+    if (FAILED(texture->GetSurfaceLevel(0, &surface))) return false;
+    D3DSURFACE_DESC desc;
+    if (FAILED(surface->GetDesc(&desc))) return false;
+    SurfacePtr copy;
+    if (FAILED(device_->CreateOffscreenPlainSurface(desc.Width, desc.Height, D3DFMT_A8R8G8B8,
+                                                    D3DPOOL_SYSTEMMEM, &copy, 0))) return false;
+    if (FAILED(device_->GetRenderTargetData(surface, copy))) return false;
+
+    D3DLOCKED_RECT locked;
+    if (FAILED(copy->LockRect(&locked, 0, D3DLOCK_READONLY))) return false;
+    copy_shadow(static_cast<const Pixel *>(locked.pBits), locked.Pitch / static_cast<int>(sizeof(Pixel)), dim, image);
+    copy->UnlockRect();
+    return true;
+  }
+
+  void Direct3DRoot::upload_target(TexturePtr texture, const ShadowImage & image) {
+    SurfacePtr surface;
+    HRESULT hr = texture->GetSurfaceLevel(0, &surface);
+    if (FAILED(hr)) DX_EXCEPT("Failure in IDirect3DTexture9::GetSurfaceLevel(). ", hr);
+    RECT rect = { 0, 0, image.dim.width, image.dim.height };
+    hr = D3DXLoadSurfaceFromMemory(surface, 0, &rect, &image.pixels[0], D3DFMT_A8R8G8B8,
+                                   static_cast<UINT>(image.dim.width * sizeof(Pixel)), 0, &rect, D3DX_FILTER_NONE, 0);
+    if (FAILED(hr)) DX_EXCEPT("Failure in D3DXLoadSurfaceFromMemory(). ", hr);
+  }
+
+  size_t Direct3DRoot::background_bytes(void) const {
+    size_t bytes = residency_.resident_bytes();
+    if (background_.wallpaper_texture) {
+      bytes += background_.wallpaper_width * background_.wallpaper_height * sizeof(D3DCOLOR);
+    }
+    return bytes;
+  }
+
+  TexturePtr Direct3DRoot::build_background_texture(const RECT & monitor) {
+    int mon_width  = monitor.right - monitor.left;
+    int mon_height = monitor.bottom - monitor.top;
     
-    TexturePtr & texture = root->background_textures_[hMonitor];
-    texture = root->create_texture(Dimension(mon_width, mon_height), 
-                                   sbd->background_color);
+    TexturePtr texture = create_texture(Dimension(mon_width, mon_height), background_.background_color);
 
-    if (!sbd->wallpaper_texture) return TRUE;
+    load_wallpaper();
+    if (!background_.wallpaper_texture) return texture;
 
-    root->set_render_target(texture);
-    SceneLock scene(*root);
+    set_render_target(texture);
+    SceneLock scene(*this);
 
-    RECT rect = { 0, 0, sbd->wallpaper_width, sbd->wallpaper_height };
-    float x_scale = static_cast<float>(mon_width) / sbd->wallpaper_width;
-    float y_scale = static_cast<float>(mon_height) / sbd->wallpaper_height;
+    RECT rect = { 0, 0, background_.wallpaper_width, background_.wallpaper_height };
+    float x_scale = static_cast<float>(mon_width) / background_.wallpaper_width;
+    float y_scale = static_cast<float>(mon_height) / background_.wallpaper_height;
 
     D3DXVECTOR3 center(static_cast<float>(mon_width / 2),
                        static_cast<float>(mon_height / 2),
@@ -276,60 +644,68 @@ namespace console {
 
     bool windows_8 = (osvi.dwMajorVersion == 6 && osvi.dwMinorVersion == 2);
 
-    if (sbd->style == TILE) {
-      int tx_start = (lprcMonitor->left - sbd->origin_x) / sbd->wallpaper_width;
-      int ty_start = (lprcMonitor->top - sbd->origin_y) / sbd->wallpaper_height;
+    WallpaperStyle style = background_.style;
+    if (style == TILE) {
+      // tiles are aligned to the virtual desktop origin
+      int origin_x = GetSystemMetrics(SM_XVIRTUALSCREEN);
+      int origin_y = GetSystemMetrics(SM_YVIRTUALSCREEN);
 
-      int tx_stop = (lprcMonitor->right - sbd->origin_x) / sbd->wallpaper_width;
-      int ty_stop = (lprcMonitor->bottom - sbd->origin_y) / sbd->wallpaper_height;
+      int tx_start = (monitor.left - origin_x) / background_.wallpaper_width;
+      int ty_start = (monitor.top - origin_y) / background_.wallpaper_height;
+
+      int tx_stop = (monitor.right - origin_x) / background_.wallpaper_width;
+      int ty_stop = (monitor.bottom - origin_y) / background_.wallpaper_height;
       
       for (int i = tx_start; i <= tx_stop; ++i) {
         for (int j = ty_start; j <= ty_stop; ++j) {
-          D3DXVECTOR3 pos(static_cast<float>(i * sbd->wallpaper_width + sbd->origin_x - lprcMonitor->left), 
-                          static_cast<float>(j * sbd->wallpaper_height + sbd->origin_y - lprcMonitor->top),
+          D3DXVECTOR3 pos(static_cast<float>(i * background_.wallpaper_width + origin_x - monitor.left), 
+                          static_cast<float>(j * background_.wallpaper_height + origin_y - monitor.top),
                           0);
-          HRESULT hr = root->sprite_->Draw(sbd->wallpaper_texture, &rect, 0, &pos, 0xffffffff);
+          HRESULT hr = sprite_->Draw(background_.wallpaper_texture, &rect, 0, &pos, 0xffffffff);
           if (FAILED(hr)) DX_EXCEPT("Failure in ID3DXSprite::Draw(). ", hr);
         }
       }
-    } else if (sbd->style == STRETCH) {
-      draw_scaled(rect, sbd->wallpaper_texture, root->sprite_, center, x_scale, y_scale);
-    } else if (sbd->style == CENTER) {
+    } else if (style == STRETCH) {
+      draw_scaled(rect, background_.wallpaper_texture, sprite_, center, x_scale, y_scale);
+    } else if (style == CENTER) {
       float scale = 1.0f;
       if (windows_8) {
         if (max(x_scale, y_scale) < 1.0f) scale = max(x_scale, y_scale);
       }
 
-      draw_scaled(rect, sbd->wallpaper_texture, root->sprite_, center, scale, scale);
-    } else if (sbd->style == ASPECT_PAD) {
+      draw_scaled(rect, background_.wallpaper_texture, sprite_, center, scale, scale);
+    } else if (style == ASPECT_PAD) {
       float scale = min(x_scale, y_scale);
-      draw_scaled(rect, sbd->wallpaper_texture, root->sprite_, center, scale, scale);
-    } else if (sbd->style == ASPECT_CROP) {
+      draw_scaled(rect, background_.wallpaper_texture, sprite_, center, scale, scale);
+    } else if (style == ASPECT_CROP) {
       float scale = max(x_scale, y_scale);
 
       if (windows_8) {
         // Windows 8 displays Wallpaper off center in Fill mode
-        center.y += sbd->wallpaper_height / 6.0f * scale;
+        center.y += background_.wallpaper_height / 6.0f * scale;
         center.y -= mon_height / 6.0f;
-        draw_scaled(rect, sbd->wallpaper_texture, root->sprite_, center, scale, scale);
+        draw_scaled(rect, background_.wallpaper_texture, sprite_, center, scale, scale);
       } else {
-        draw_scaled(rect, sbd->wallpaper_texture, root->sprite_, center, scale, scale);
+        draw_scaled(rect, background_.wallpaper_texture, sprite_, center, scale, scale);
       }
     } else {
       std::stringstream sstr;
-      sstr << "Invalid wallpaper style: " << sbd->style << ". ";
+      sstr << "Invalid wallpaper style: " << style << ". ";
       MISC_EXCEPT(sstr.str().c_str());
     }
 
-    return TRUE;
+    return texture;
   }
   
-  void Direct3DRoot::set_background_textures(void) {
-    SetBackgroundData sbd = { this };
-  
+  void Direct3DRoot::read_background_settings(BackgroundData & settings) {
+    settings.wallpaper_texture = 0;
+    settings.wallpaper_width   = 0;
+    settings.wallpaper_height  = 0;
+
     // ----- wallpaper name, tiling and style -----
     WallpaperInfo wi = get_wallpaper_info();
-    sbd.style = wi.style;
+    settings.style = wi.style;
+    settings.wallpaper_name = wi.wallpaper_name;
 
     // ----- background color -----
     CRegKey colors;
@@ -339,66 +715,105 @@ namespace console {
     int r = extract<int>(ss);
     int g = extract<int>(ss);
     int b = extract<int>(ss);
-    sbd.background_color = D3DCOLOR_XRGB(r, g, b);
-
-    // ----- set wallpaper texture -----
-    if (!wi.wallpaper_name.empty()) {
-      Image wallpaper(WideBuffer(wi.wallpaper_name.c_str()));
-      if (wallpaper.GetLastStatus() != Ok) {
-        // Unable to open wallpaper
-        std::stringstream sstr;
-        sstr << "Unable to open Wallpaper with name: "
-             << NarrowBuffer(wi.wallpaper_name.c_str());
-        GDIPLUS_EXCEPT(sstr.str().c_str(), wallpaper.GetLastStatus());
-      }
-      sbd.wallpaper_width  = wallpaper.GetWidth();
-      sbd.wallpaper_height = wallpaper.GetHeight();
-
-      sbd.wallpaper_texture = create_texture(Dimension(sbd.wallpaper_width, sbd.wallpaper_height));
-      RECT rect = { 0, 0, sbd.wallpaper_width, sbd.wallpaper_height };
-
-      SurfacePtr wallpaper_surface;
-      HRESULT hr = sbd.wallpaper_texture->GetSurfaceLevel(0, &wallpaper_surface);
-      if (FAILED(hr)) DX_EXCEPT("Failure in IDirect3DTexture9::GetSurfaceLevel(). ", hr);
-
-      // TODO: figure out how to handle extremely large wallpaper sizes.
-      hr = D3DXLoadSurfaceFromFile(wallpaper_surface, 0, &rect, wi.wallpaper_name.c_str(),
-                                   0, D3DX_FILTER_NONE, 0, 0);
-      if (hr == D3DXERR_INVALIDDATA) {
-        // probably the file format not supported by DirectX, write a copy of the
-        //   image to a memory stream as a PNG and load from that.
-        CLSID pngClsid = GetEncoderClsid(L"image/png");
-        MemStream ms;
-
-        wallpaper.Save(ms.stream(), &pngClsid, 0);
-        if (wallpaper.GetLastStatus() != Ok)
-          GDIPLUS_EXCEPT("Image::Save() unable to write to memory stream. ", wallpaper.GetLastStatus());
-
-        MemStreamLock msl(ms);
-        ASSERT(msl.size() < 0x100000000ull);
-        hr = D3DXLoadSurfaceFromFileInMemory(wallpaper_surface, 0, &rect, msl.addr(), 
-                                             static_cast<UINT>(msl.size()), 0, D3DX_FILTER_NONE, 0, 0);
-      }
-      
-      if (FAILED(hr)) {
-        tostringstream sstr;
-        sstr << _T("Unable to load wallpaper: ")
-             << wi.wallpaper_name
-             << _T(".");
-        if (hr == D3DERR_INVALIDCALL) {
-          sstr << _T("\nPossible cause: wallpaper is too large.");
-        }
-        MessageBox(0, sstr.str().c_str(), _T("Unable to load wallpaper."), MB_OK);
-        //wallpaper_surface = 0;
-        sbd.wallpaper_texture = 0;
-      }
+    settings.background_color = D3DCOLOR_XRGB(r, g, b);
+  }
+
+  // Switches to settings, dropping every background texture built from the
+  //   old ones. Nothing is rebuilt until a window needs it.
+  void Direct3DRoot::install_background(const BackgroundData & settings) {
+    background_textures_.clear();
+    background_shadows_.clear();
+    residency_.clear();
+    background_ = settings;
+  }
+
+  BOOL CALLBACK collect_monitor_proc(HMONITOR, HDC, LPRECT lprcMonitor, LPARAM dwData) {
+    reinterpret_cast<std::vector<RECT> *>(dwData)->push_back(*lprcMonitor);
+    return TRUE;
+  }
+
+  // Starts decoding the wallpaper for settings on the worker thread. The
+  //   scaled styles never show it larger than the biggest monitor needs, so
+  //   anything past that is averaged away while decoding rather than kept in
+  //   video memory. Every style is limited to the largest texture the device
+  //   can hold.
+  void Direct3DRoot::request_wallpaper(const BackgroundData & settings) {
+    WallpaperRequest request;
+    request.name = WideBuffer(settings.wallpaper_name.c_str());
+    request.scale = SCALE_NONE;
+    if (settings.style == STRETCH || settings.style == ASPECT_CROP) request.scale = SCALE_FILL;
+    if (settings.style == ASPECT_PAD) request.scale = SCALE_FIT;
+
+    std::vector<RECT> monitors;
+    EnumDisplayMonitors(NULL, NULL, &collect_monitor_proc, reinterpret_cast<LPARAM>(&monitors));
+    for (std::vector<RECT>::const_iterator itr = monitors.begin(); itr != monitors.end(); ++itr) {
+      request.monitors.push_back(Dimension(itr->right - itr->left, itr->bottom - itr->top));
     }
-    
-    // ----- virtual desktop origin -----
-    sbd.origin_x = GetSystemMetrics(SM_XVIRTUALSCREEN);
-    sbd.origin_y = GetSystemMetrics(SM_YVIRTUALSCREEN);
-    
-    EnumDisplayMonitors(NULL, NULL, &set_background_enum_proc, reinterpret_cast<LPARAM>(&sbd));
+
+    D3DCAPS9 caps;
+    HRESULT hr = device_->GetDeviceCaps(&caps);
+    if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::GetDeviceCaps(). ", hr);
+    request.max_size = Dimension(caps.MaxTextureWidth, caps.MaxTextureHeight);
+
+    next_background_ = settings;
+    decoder_.request(request);
+    decoding_ = true;
+  }
+
+  // Until the wallpaper has been decoded the background is just the color;
+  //   install_wallpaper() replaces it once the wallpaper is ready.
+  void Direct3DRoot::load_wallpaper(void) {
+    if (background_.wallpaper_texture || background_.wallpaper_name.empty() || decoding_) return;
+    request_wallpaper(background_);
+  }
+
+  void Direct3DRoot::upload_wallpaper(const DecodedWallpaper & decoded) {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+
+    Dimension dim = decoded.dim;
+    TexturePtr wallpaper_texture = create_texture(dim);
+    SurfacePtr wallpaper_surface;
+    HRESULT hr = wallpaper_texture->GetSurfaceLevel(0, &wallpaper_surface);
+    if (FAILED(hr)) DX_EXCEPT("Failure in IDirect3DTexture9::GetSurfaceLevel(). ", hr);
+
+    RECT rect = { 0, 0, dim.width, dim.height };
+    hr = D3DXLoadSurfaceFromMemory(wallpaper_surface, 0, 0, &decoded.pixels[0], D3DFMT_A8R8G8B8,
+                                   static_cast<UINT>(dim.width * sizeof(Pixel)), 0, &rect, D3DX_FILTER_NONE, 0);
+    if (FAILED(hr)) DX_EXCEPT("Failure in D3DXLoadSurfaceFromMemory(). ", hr);
+
+    background_.wallpaper_texture = wallpaper_texture;
+    background_.wallpaper_width   = dim.width;
+    background_.wallpaper_height  = dim.height;
+
+    timings_.decode_ms = decoded.decode_ms;
+    timings_.upload_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  bool Direct3DRoot::install_wallpaper(void) {
+    DecodedWallpaper decoded;
+    if (!decoder_.take(decoded)) return false;
+    decoding_ = false;
+
+    install_background(next_background_);
+    if (!decoded.loaded) {
+      tostringstream sstr;
+      sstr << _T("Unable to load wallpaper: ")
+           << background_.wallpaper_name
+           << _T(".");
+      MessageBox(0, sstr.str().c_str(), _T("Unable to load wallpaper."), MB_OK);
+      // don't try again until the settings change
+      background_.wallpaper_name.clear();
+    } else if (!device_lost_) {
+      // with the device lost the wallpaper is decoded again once the
+      //   background is next needed
+      upload_wallpaper(decoded);
+    }
+    return true;
+  }
+
+  WallpaperTimings Direct3DRoot::wallpaper_timings(void) const {
+    return timings_;
   }
 
   TexturePtr Direct3DRoot::create_texture(Dimension dim) {
@@ -422,22 +837,101 @@ namespace console {
     return ret_val;
   } 
 
+  // Returns to the pools the targets only they still hold.
+  void Direct3DRoot::reclaim_targets(std::uint32_t now) {
+    for (std::map<int, TexturePtr>::const_iterator itr = pooled_textures_.begin(); itr != pooled_textures_.end(); ++itr) {
+      if (texture_pool_.in_use(itr->first) && pool_only_reference(itr->second)) texture_pool_.release(itr->first, now);
+    }
+    for (std::map<int, SwapChainPtr>::const_iterator itr = pooled_swap_chains_.begin(); itr != pooled_swap_chains_.end(); ++itr) {
+      if (swap_chain_pool_.in_use(itr->first) && pool_only_reference(itr->second)) swap_chain_pool_.release(itr->first, now);
+    }
+  }
+
+  void Direct3DRoot::clear_targets(void) {
+    pooled_textures_.clear();
+    texture_pool_.clear();
+    pooled_swap_chains_.clear();
+    swap_chain_pool_.clear();
+  }
+
+  TexturePtr Direct3DRoot::acquire_target(Dimension dim) {
+    // if GetTickCount() rolls over the pool copes
+    #pragma warning(suppress: 28159)
+    std::uint32_t now = GetTickCount();
+    reclaim_targets(now);
+    int id = texture_pool_.acquire(dim, 0, now);
+    if (id >= 0) return pooled_textures_[id];
+
+    Dimension size = target_bucket(dim);
+    TexturePtr texture = create_texture(size);
+    pooled_textures_[texture_pool_.add(size, 0, now)] = texture;
+    return texture;
+  }
+
+  TexturePtr Direct3DRoot::acquire_target(Dimension dim, D3DCOLOR color) {
+    TexturePtr ret_val = acquire_target(dim);
+    set_render_target(ret_val);
+    clear(color);
+    return ret_val;
+  }
+
+  // Swap chains are only reused for the window they were created for, as
+  //   that is the window a back buffer's contents can be patched for.
   SwapChainPtr Direct3DRoot::get_swap_chain(HWND hwnd, Dimension client_dim) {
+    #pragma warning(suppress: 28159)
+    std::uint32_t now = GetTickCount();
+    reclaim_targets(now);
+    std::uintptr_t key = reinterpret_cast<std::uintptr_t>(hwnd);
+    int id = swap_chain_pool_.acquire(client_dim, key, now);
+    if (id >= 0) return pooled_swap_chains_[id];
+
+    Dimension size = target_bucket(client_dim);
     SwapChainPtr swap_chain;
     D3DPRESENT_PARAMETERS pp = get_present_parameters();
-    pp.BackBufferHeight = client_dim.height;
-    pp.BackBufferWidth = client_dim.width;
+    pp.BackBufferHeight = size.height;
+    pp.BackBufferWidth = size.width;
     pp.hDeviceWindow = hwnd;
+    // Console windows patch the cursor into the previous frame and present
+    //   only the cells that changed, which needs the back buffer to survive
+    //   Present().
+    pp.SwapEffect = D3DSWAPEFFECT_COPY;
     
     HRESULT hr = device_->CreateAdditionalSwapChain(&pp, &swap_chain);
     if (FAILED(hr))
       DX_EXCEPT("Failure in IDirect3DDevice9::CreateAdditionalSwapChain(). ", hr);
+    pooled_swap_chains_[swap_chain_pool_.add(size, key, now)] = swap_chain;
     return swap_chain;
   }
+
+  void Direct3DRoot::trim_targets(void) {
+    #pragma warning(suppress: 28159)
+    std::uint32_t now = GetTickCount();
+    reclaim_targets(now);
+    texture_pool_.trim(now, evicted_);
+    for (std::vector<int>::const_iterator itr = evicted_.begin(); itr != evicted_.end(); ++itr) {
+      pooled_textures_.erase(*itr);
+    }
+    swap_chain_pool_.trim(now, evicted_);
+    for (std::vector<int>::const_iterator itr = evicted_.begin(); itr != evicted_.end(); ++itr) {
+      pooled_swap_chains_.erase(*itr);
+    }
+  }
+
+  TargetPoolCounts Direct3DRoot::target_counts(void) const {
+    return texture_pool_.counts();
+  }
   
-  void Direct3DRoot::reset_background(void) {
-    background_textures_.clear();
-    set_background_textures();
+  bool Direct3DRoot::reset_background(void) {
+    BackgroundData settings;
+    read_background_settings(settings);
+    if (settings.wallpaper_name.empty()) {
+      decoder_.cancel();
+      decoding_ = false;
+      install_background(settings);
+      return true;
+    }
+    request_wallpaper(settings);
+    return false;
   }
 
   void Direct3DRoot::begin_scene(void) {
@@ -472,6 +966,79 @@ namespace console {
     if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::Clear(). ", hr);
   }
 
+  void Direct3DRoot::clear(D3DCOLOR color, const RECT & rect) {
+    D3DRECT r = { rect.left, rect.top, rect.right, rect.bottom };
+    HRESULT hr = device_->Clear(1, &r, D3DCLEAR_TARGET, color, 1.0f, 0);
+    if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::Clear(). ", hr);
+  }
+
+  void Direct3DRoot::set_scissor(const RECT & rect) {
+    HRESULT hr = device_->SetScissorRect(&rect);
+    if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::SetScissorRect(). ", hr);
+    hr = device_->SetRenderState(D3DRS_SCISSORTESTENABLE, TRUE);
+    if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::SetRenderState(). ", hr);
+  }
+
+  void Direct3DRoot::clear_scissor(void) {
+    HRESULT hr = device_->SetRenderState(D3DRS_SCISSORTESTENABLE, FALSE);
+    if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::SetRenderState(). ", hr);
+  }
+
+  void Direct3DRoot::copy_rect(TexturePtr source, const RECT & source_rect, TexturePtr dest, const RECT & dest_rect) {
+    SurfacePtr dest_surface;
+    HRESULT hr = dest->GetSurfaceLevel(0, &dest_surface);
+    if (FAILED(hr)) DX_EXCEPT("Failure in IDirect3DTexture9::GetSurfaceLevel(). ", hr);
+    copy_rect(source, source_rect, dest_surface, dest_rect);
+  }
+
+  void Direct3DRoot::copy_rect(TexturePtr source, const RECT & source_rect, SurfacePtr dest, const RECT & dest_rect) {
+    SurfacePtr source_surface;
+    HRESULT hr = source->GetSurfaceLevel(0, &source_surface);
+    if (FAILED(hr)) DX_EXCEPT("Failure in IDirect3DTexture9::GetSurfaceLevel(). ", hr);
+
+    hr = device_->StretchRect(source_surface, &source_rect, dest, &dest_rect, D3DTEXF_NONE);
+    if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::StretchRect(). ", hr);
+  }
+
+  bool Direct3DRoot::supports_fused_alpha(void) const {
+    return fused_alpha_supported_;
+  }
+
+  void Direct3DRoot::set_transmittance_blend(bool enable) {
+    set_render_states(device_, enable ? TRANSMITTANCE_BLEND_STATES : OPACITY_BLEND_STATES);
+  }
+
+  // The text texture holds transmittance t = 1 - coverage, so
+  //   stage 0: (1 - t) * (1 - t), the coverage blended with itself
+  //   stage 1: + t * pre_alpha, what showed through of the cleared texture
+  //   stage 2: * the post alpha in the sprite's diffuse color
+  //   The sprite only sets the texture of stage 0, so the text texture is
+  //   bound to stage 1 as well, sampled with the same texture coordinates.
+  void Direct3DRoot::begin_fused_alpha(TexturePtr text, unsigned char pre_alpha) {
+    ASSERT(fused_alpha_supported_);
+    HRESULT hr = device_->SetTexture(1, text);
+    if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::SetTexture(). ", hr);
+    const D3DSAMPLERSTATETYPE samplers[] = {
+      D3DSAMP_ADDRESSU, D3DSAMP_ADDRESSV, D3DSAMP_MAGFILTER, D3DSAMP_MINFILTER, D3DSAMP_MIPFILTER
+    };
+    for (size_t i = 0; i < sizeof(samplers) / sizeof(samplers[0]); ++i) {
+      DWORD value;
+      hr = device_->GetSamplerState(0, samplers[i], &value);
+      if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::GetSamplerState(). ", hr);
+      hr = device_->SetSamplerState(1, samplers[i], value);
+      if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::SetSamplerState(). ", hr);
+    }
+    hr = device_->SetRenderState(D3DRS_TEXTUREFACTOR, D3DCOLOR_ARGB(pre_alpha, 0, 0, 0));
+    if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::SetRenderState(). ", hr);
+    set_stage_states(device_, FUSED_ALPHA_STAGES);
+  }
+
+  void Direct3DRoot::end_fused_alpha(void) {
+    set_stage_states(device_, SPRITE_STAGES);
+    HRESULT hr = device_->SetTexture(1, 0);
+    if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::SetTexture(). ", hr);
+  }
+
   bool Direct3DRoot::is_device_lost(void) {
     return device_lost_;
   }
@@ -480,31 +1047,35 @@ namespace console {
     device_lost_ = true;
   }
   
-  // before try_recover() is called, all the console windows must free their DirectX
-  //   resources
-  HRESULT Direct3DRoot::try_recover(void) {
-    ASSERT(device_lost_);
+  DeviceStatus Direct3DRoot::test_device(void) {
     HRESULT hr = device_->TestCooperativeLevel();
-    ASSERT(hr != D3D_OK);
-    if (hr == D3DERR_DEVICENOTRESET) {
-      sprite_ = 0;
-      white_texture_ = 0;
-      background_textures_.clear();
+    if (hr == D3DERR_DEVICELOST) return DEVICE_LOST;
+    if (hr == D3DERR_DEVICENOTRESET) return DEVICE_NOT_RESET;
+    if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DDevice9::TestCooperativeLevel(). ", hr);
+    return DEVICE_READY;
+  }
 
-      D3DPRESENT_PARAMETERS present_parameters = get_present_parameters();
-      
-      hr = device_->Reset(&present_parameters);
-      if (FAILED(hr)) return hr;
+  // Before reset_device() is called, all the console windows must free their
+  //   DirectX resources. The background shadows survive the reset, so the
+  //   monitor textures come back without the wallpaper.
+  bool Direct3DRoot::reset_device(void) {
+    ASSERT(device_lost_);
+    sprite_ = 0;
+    white_texture_ = 0;
+    background_textures_.clear();
+    residency_.clear();
+    background_.wallpaper_texture = 0;
+    clear_targets();
 
-      init_sprite();
-      white_texture_ = create_texture(Dimension(64, 64), D3DCOLOR_XRGB(255, 255, 255));
-      set_background_textures();
+    D3DPRESENT_PARAMETERS present_parameters = get_present_parameters();
+    HRESULT hr = device_->Reset(&present_parameters);
+    if (hr == D3DERR_DEVICELOST) return false;
+    if (FAILED(hr)) DX_EXCEPT("Failure to recover device. ", hr);
 
-      device_lost_ = false;
-      return D3DERR_DEVICENOTRESET;
-    } else {
-      return hr;
-    }
+    init_sprite();
+    white_texture_ = create_texture(Dimension(64, 64), D3DCOLOR_XRGB(255, 255, 255));
+    device_lost_ = false;
+    return true;
   }
 
   ColorTable & Direct3DRoot::get_color_table(void) {
@@ -512,7 +1083,9 @@ namespace console {
   }
 
   Direct3DRoot::~Direct3DRoot() {
+    clear_targets();
     background_textures_.clear();
+    background_.wallpaper_texture.Release();
     white_texture_.Release();
     sprite_.Release();  
      
@@ -522,7 +1095,25 @@ namespace console {
   
   IDirect3DRoot::~IDirect3DRoot() {}
 
+  // Remote desktop and virtual machine sessions often have no Direct3D 9
+  //   device to give, which isn't an error: the console windows are drawn in
+  //   software instead.
   RootPtr get_direct3d_root(HWND hwnd) {
-    return RootPtr(new Direct3DRoot(hwnd));
+    Direct3DPtr iface;
+    // Swap these two lines to force a memory leak.
+    //iface = Direct3DCreate9(D3D_SDK_VERSION);
+    iface.Attach(Direct3DCreate9(D3D_SDK_VERSION));
+    if (!iface) return RootPtr();
+  
+    D3DPRESENT_PARAMETERS present_parameters = get_present_parameters();
+    DevicePtr device;
+    HRESULT hr = iface->CreateDevice(D3DADAPTER_DEFAULT,
+                                     D3DDEVTYPE_HAL,
+                                     hwnd,
+                                     D3DCREATE_SOFTWARE_VERTEXPROCESSING,
+                                     &present_parameters,
+                                     &device);
+    if (FAILED(hr)) return RootPtr();
+    return RootPtr(new Direct3DRoot(hwnd, iface, device));
   }
 }
\ No newline at end of file
@@ -21,17 +21,20 @@
 #ifndef CONREP_D3ROOT_H
 #define CONREP_D3ROOT_H
 
+#include <vector>
+
 #include <d3d9.h>
 #include <d3dx9.h>
 #include <boost/shared_ptr.hpp>
 
 #include "atl.h"
 #include "color_table.h"
+#include "device_recovery.h"
+#include "shadow_store.h"
+#include "target_pool.h"
 #include "windows.h"
 
 namespace console {
-  struct Dimension;
-
   const int SPRITE_BEGIN_FLAGS = D3DXSPRITE_ALPHABLEND |
                                  D3DXSPRITE_DONOTMODIFY_RENDERSTATE |
                                  D3DXSPRITE_DONOTSAVESTATE |
@@ -53,19 +56,58 @@ namespace console {
   typedef ATL::CComPtr<SwapChain> SwapChainPtr;
   typedef ATL::CComPtr<ID3DXFont> FontPtr;
 
-  class __declspec(novtable) IDirect3DRoot {
+  struct WallpaperTimings {
+    double decode_ms; // on the worker thread
+    double upload_ms; // creating and filling the texture
+  };
+
+  // Recovery after the device is lost is driven through IRecoverableDevice.
+  class __declspec(novtable) IDirect3DRoot : public IRecoverableDevice {
     public:
       virtual ~IDirect3DRoot() = 0;
       
       virtual DevicePtr    device(void) const = 0;
       virtual SpritePtr    sprite(void) const = 0;
-      virtual TexturePtr   background_texture(HMONITOR monitor) const = 0;
+      // built the first time it is asked for
+      virtual TexturePtr   background_texture(HMONITOR monitor) = 0;
       virtual TexturePtr   white_texture(void) const = 0;
       virtual TexturePtr   create_texture(Dimension dim) = 0;
       virtual TexturePtr   create_texture(Dimension dim, D3DCOLOR color) = 0;
+      // Render targets for console windows, which are resized often, come
+      //   from a pool and may be larger than dim; only the top left dim of
+      //   them is drawn to or from. A target goes back to the pool once the
+      //   pool holds the last reference to it, so release the old target
+      //   before acquiring its replacement.
+      virtual TexturePtr   acquire_target(Dimension dim) = 0;
+      virtual TexturePtr   acquire_target(Dimension dim, D3DCOLOR color) = 0;
+      // Pooled the same way, but only reused for the same window. Present()
+      //   with the client rectangle as the source and hwnd as the
+      //   destination window.
       virtual SwapChainPtr get_swap_chain(HWND hwnd, Dimension client_dim) = 0;
+      // frees pooled targets that have gone unused for TARGET_IDLE_TIME
+      virtual void trim_targets(void) = 0;
+      virtual TargetPoolCounts target_counts(void) const = 0; // for debugging
+      // Copies the top left dim of a render target into image. Stalls until
+      //   the device has drawn to it, so it shouldn't be done every frame.
+      //   Returns false if the copy failed, such as with the device lost.
+      virtual bool read_target(TexturePtr texture, Dimension dim, ShadowImage & image) = 0;
+      // copies image into the top left of a render target
+      virtual void upload_target(TexturePtr texture, const ShadowImage & image) = 0;
       
-      virtual void reset_background(void) = 0;
+      // Rereads the background settings. Returns true if the new background
+      //   is in place already; otherwise the old one stays until the new
+      //   wallpaper has been decoded and install_wallpaper() is called.
+      virtual bool reset_background(void) = 0;
+      // Called on CRM_WALLPAPER_DECODED. Returns true if the background
+      //   changed, in which case the windows need to be told.
+      virtual bool install_wallpaper(void) = 0;
+      virtual WallpaperTimings wallpaper_timings(void) const = 0; // for debugging
+      // Records which monitors' background textures window may need, an
+      //   empty list once it is closed. trim_backgrounds() releases textures
+      //   no window has been over for BACKGROUND_IDLE_TIME.
+      virtual void cover_monitors(HWND window, const std::vector<HMONITOR> & monitors) = 0;
+      virtual void trim_backgrounds(void) = 0;
+      virtual size_t background_bytes(void) const = 0; // for debugging
       
       virtual void begin_scene(void) = 0;
       virtual void end_scene(void)   = 0;
@@ -73,15 +115,41 @@ namespace console {
       virtual void set_render_target(TexturePtr texture) = 0;
       virtual void set_render_target(SurfacePtr surface) = 0;
       virtual void clear(D3DCOLOR color) = 0;
+      virtual void clear(D3DCOLOR color, const RECT & rect) = 0;
+      // limits drawing to rect until clear_scissor(); setting the render
+      //   target resets the rectangle to the whole target
+      virtual void set_scissor(const RECT & rect) = 0;
+      virtual void clear_scissor(void) = 0;
+      // copies between two render target textures; must be called outside
+      //   of a scene
+      virtual void copy_rect(TexturePtr source, const RECT & source_rect, TexturePtr dest, const RECT & dest_rect) = 0;
+      // as above, but into a render target surface such as a back buffer
+      virtual void copy_rect(TexturePtr source, const RECT & source_rect, SurfacePtr dest, const RECT & dest_rect) = 0;
+      
+      // Whether the device can apply the pre and post alphas in a single
+      //   pass over a text texture holding transmittance (see AlphaMode in
+      //   framebuffer.h). If not, the text is drawn with the pre alpha
+      //   already in it and only the post alpha is applied when composing.
+      virtual bool supports_fused_alpha(void) const = 0;
+      // While enabled, drawing leaves the colors blended as usual but
+      //   multiplies the alpha of the render target by one minus the source
+      //   alpha. Must be called inside a scene.
+      virtual void set_transmittance_blend(bool enable) = 0;
+      // Sets up the texture stages so that sprite draws of text, a texture
+      //   drawn with set_transmittance_blend(true), come out with the alpha
+      //   they would have had over a clear of pre_alpha. The post alpha is the
+      //   color the sprite draws with, as usual. Only valid if
+      //   supports_fused_alpha(); the sprite must be flushed before and after.
+      virtual void begin_fused_alpha(TexturePtr text, unsigned char pre_alpha) = 0;
+      virtual void end_fused_alpha(void) = 0;
       
       virtual bool is_device_lost(void) = 0;
       virtual void set_device_lost(void) = 0;
-      
-      virtual HRESULT try_recover(void) = 0;
 
       virtual ColorTable & get_color_table(void) = 0;
   };
   typedef boost::shared_ptr<IDirect3DRoot> RootPtr;
+  // Returns an empty pointer if Direct3D 9 or a device for it can't be had.
   RootPtr get_direct3d_root(HWND hwnd);
 
   class SceneLock {
@@ -0,0 +1,122 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// damage_set.cpp
+// implementation of the DamageSet class and the cell comparison that fills it
+
+#include "damage_set.h"
+
+#include "cell_compare.h"
+
+namespace console {
+  DamageSet::DamageSet() : dim_(0, 0), full_(false), scroll_(0) {}
+
+  void DamageSet::reset(Dimension dim) {
+    dim_ = dim;
+    full_ = false;
+    scroll_ = 0;
+    spans_.clear();
+  }
+
+  void DamageSet::mark_all(void) {
+    spans_.clear();
+    for (int i = 0; i < dim_.height; ++i) {
+      RowSpan span = { i, 0, dim_.width };
+      spans_.push_back(span);
+    }
+    full_ = true;
+    scroll_ = 0;
+  }
+
+  // Rows are expected to be added in increasing order; adding to the last
+  //   row again widens its span.
+  void DamageSet::add(int row, int begin, int end) {
+    if (!spans_.empty() && (spans_.back().row == row)) {
+      RowSpan & span = spans_.back();
+      if (begin < span.begin) span.begin = begin;
+      if (end > span.end) span.end = end;
+      return;
+    }
+    RowSpan span = { row, begin, end };
+    spans_.push_back(span);
+  }
+
+  void DamageSet::set_scroll(int rows) {
+    scroll_ = rows;
+  }
+
+  bool DamageSet::empty(void) const {
+    return spans_.empty() && !scroll_;
+  }
+
+  bool DamageSet::full(void) const {
+    return full_;
+  }
+
+  size_t DamageSet::size(void) const {
+    return spans_.size();
+  }
+
+  Dimension DamageSet::dim(void) const {
+    return dim_;
+  }
+
+  int DamageSet::scroll(void) const {
+    return scroll_;
+  }
+
+  DamageSet::const_iterator DamageSet::begin(void) const {
+    return spans_.begin();
+  }
+
+  DamageSet::const_iterator DamageSet::end(void) const {
+    return spans_.end();
+  }
+
+  void compute_damage(const Cell * current,
+                      const Cell * previous,
+                      Dimension dim,
+                      Cell mask,
+                      DamageSet & damage) {
+    compute_damage(current, previous, dim, mask, 0, damage);
+  }
+
+  void compute_damage(const Cell * current,
+                      const Cell * previous,
+                      Dimension dim,
+                      Cell mask,
+                      int shift,
+                      DamageSet & damage) {
+    damage.reset(dim);
+    damage.set_scroll(shift);
+    for (int i = 0; i < dim.height; ++i) {
+      int j = i + shift;
+      if ((j < 0) || (j >= dim.height)) {
+        damage.add(i, 0, dim.width);
+        continue;
+      }
+      DiffRange r = find_cell_differences(current  + i * dim.width,
+                                          previous + j * dim.width,
+                                          dim.width,
+                                          mask);
+      if (r.first != static_cast<size_t>(dim.width)) {
+        damage.add(i, static_cast<int>(r.first), static_cast<int>(r.last) + 1);
+      }
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Per row record of which console cells changed between two snapshots.
+//   Doesn't depend on any Windows headers so it can be built anywhere.
+
+#ifndef CONREP_DAMAGE_SET_H
+#define CONREP_DAMAGE_SET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dimension.h"
+
+namespace console {
+  // Cells are compared as packed 32-bit values: the low word is the character
+  //   and the high word is the attributes, which is the layout of CHAR_INFO.
+  typedef std::uint32_t Cell;
+
+  // Columns [begin, end) of row have changed.
+  struct RowSpan {
+    int row;
+    int begin;
+    int end;
+  };
+
+  class DamageSet {
+    public:
+      typedef std::vector<RowSpan>::const_iterator const_iterator;
+
+      DamageSet();
+
+      void reset(Dimension dim);
+      void mark_all(void);
+      void add(int row, int begin, int end);
+      void set_scroll(int rows);
+
+      bool empty(void) const;
+      bool full(void) const;
+      size_t size(void) const;
+      Dimension dim(void) const;
+      // Number of rows the previous contents moved up (or down if negative)
+      //   before the damaged spans are applied.
+      int scroll(void) const;
+
+      const_iterator begin(void) const;
+      const_iterator end(void) const;
+    private:
+      Dimension dim_;
+      bool full_; // every cell should be treated as changed
+      int scroll_;
+      std::vector<RowSpan> spans_; // at most one span per row, in row order
+  };
+
+  // Fills damage with the rows of current that differ from previous. Only
+  //   bits set in mask take part in the comparison.
+  void compute_damage(const Cell * current,
+                      const Cell * previous,
+                      Dimension dim,
+                      Cell mask,
+                      DamageSet & damage);
+  // As above, but row i of current is compared against row i + shift of
+  //   previous. Rows with nothing to compare against are damaged in full.
+  void compute_damage(const Cell * current,
+                      const Cell * previous,
+                      Dimension dim,
+                      Cell mask,
+                      int shift,
+                      DamageSet & damage);
+}
+
+#endif
\ No newline at end of file
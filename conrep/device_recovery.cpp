@@ -0,0 +1,86 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// device_recovery.cpp
+// implementation of the DeviceRecovery class
+
+#include "device_recovery.h"
+
+#include <algorithm>
+
+namespace console {
+  namespace {
+    double elapsed_ms(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+      return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+  }
+
+  IRecoverableDevice::~IRecoverableDevice() {}
+  IDeviceResources::~IDeviceResources() {}
+
+  DeviceRecovery::DeviceRecovery() : recovering_(false) {
+    timings_.recoveries = 0;
+    timings_.failed_resets = 0;
+    timings_.lost_ms = 0;
+    timings_.reset_ms = 0;
+    timings_.restore_ms = 0;
+  }
+
+  void DeviceRecovery::add(IDeviceResources * resources) {
+    resources_.push_back(resources);
+  }
+
+  void DeviceRecovery::remove(IDeviceResources * resources) {
+    resources_.erase(std::remove(resources_.begin(), resources_.end(), resources), resources_.end());
+  }
+
+  bool DeviceRecovery::poll(IRecoverableDevice & device) {
+    if (!recovering_) {
+      recovering_ = true;
+      lost_at_ = Clock::now();
+    }
+    // Releasing is repeated at every poll so that anything created while
+    //   the device was lost, such as by a new window, is gone too.
+    for (size_t i = 0; i < resources_.size(); ++i) {
+      resources_[i]->dispose_resources();
+    }
+    if (device.test_device() == DEVICE_LOST) return false;
+
+    Clock::time_point reset_start = Clock::now();
+    if (!device.reset_device()) {
+      ++timings_.failed_resets;
+      return false;
+    }
+    Clock::time_point restore_start = Clock::now();
+    for (size_t i = 0; i < resources_.size(); ++i) {
+      resources_[i]->restore_resources();
+    }
+    Clock::time_point done = Clock::now();
+
+    ++timings_.recoveries;
+    timings_.lost_ms    = elapsed_ms(lost_at_, reset_start);
+    timings_.reset_ms   = elapsed_ms(reset_start, restore_start);
+    timings_.restore_ms = elapsed_ms(restore_start, done);
+    recovering_ = false;
+    return true;
+  }
+
+  RecoveryTimings DeviceRecovery::timings(void) const {
+    return timings_;
+  }
+}
\ No newline at end of file
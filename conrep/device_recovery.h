@@ -0,0 +1,97 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Steps the recovery of the shared device once it has been lost. Every
+//   resource in the default pool is released, the device is reset as soon
+//   as it can be, and the resources are then restored, from shadow copies
+//   where they have them (see shadow_store.h). Doesn't depend on Direct3D,
+//   so the sequencing can be checked against a fake device.
+
+#ifndef CONREP_DEVICE_RECOVERY_H
+#define CONREP_DEVICE_RECOVERY_H
+
+#include <chrono>
+#include <vector>
+
+namespace console {
+  enum DeviceStatus {
+    DEVICE_READY,
+    DEVICE_LOST,     // can't be reset yet, such as while the screen is locked
+    DEVICE_NOT_RESET // can be reset now
+  };
+
+  // what recovery needs of the shared device
+  class IRecoverableDevice {
+    public:
+      virtual ~IRecoverableDevice();
+
+      virtual DeviceStatus test_device(void) = 0;
+      // Releases the device's own default pool resources, resets it and
+      //   creates them again. Called once every other resource has been
+      //   released. Returns false if the device was lost again.
+      virtual bool reset_device(void) = 0;
+  };
+
+  // what recovery needs of everything else holding device resources, such
+  //   as the console windows
+  class IDeviceResources {
+    public:
+      virtual ~IDeviceResources();
+
+      // releases every resource in the default pool; may be called again
+      //   before restore_resources()
+      virtual void dispose_resources(void) = 0;
+      virtual void restore_resources(void) = 0;
+  };
+
+  struct RecoveryTimings {
+    unsigned recoveries;
+    unsigned failed_resets;
+    // of the last recovery: how long the device was unusable, then how
+    //   long the reset and the restoring of resources took
+    double lost_ms;
+    double reset_ms;
+    double restore_ms;
+  };
+
+  class DeviceRecovery {
+    public:
+      DeviceRecovery();
+
+      void add(IDeviceResources * resources);
+      void remove(IDeviceResources * resources);
+
+      // Called at every tick while the device is lost. Returns true once the
+      //   device has been reset and every resource restored.
+      bool poll(IRecoverableDevice & device);
+
+      RecoveryTimings timings(void) const; // for debugging
+    private:
+      typedef std::chrono::steady_clock Clock;
+
+      std::vector<IDeviceResources *> resources_;
+      bool recovering_;
+      Clock::time_point lost_at_; // first poll of the current recovery
+      RecoveryTimings timings_;
+
+      DeviceRecovery(const DeviceRecovery &);
+      DeviceRecovery & operator=(const DeviceRecovery &);
+  };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,119 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// dirty_region.cpp
+// implementation of the DirtyRegion class
+
+#include "dirty_region.h"
+
+#include <algorithm>
+
+namespace console {
+  namespace {
+    long long rect_area(const PixelRect & r) {
+      return static_cast<long long>(r.right - r.left) * (r.bottom - r.top);
+    }
+
+    PixelRect unite(const PixelRect & a, const PixelRect & b) {
+      PixelRect r = {
+        std::min(a.left, b.left),
+        std::min(a.top, b.top),
+        std::max(a.right, b.right),
+        std::max(a.bottom, b.bottom)
+      };
+      return r;
+    }
+
+    long long overlap_area(const PixelRect & a, const PixelRect & b) {
+      int width  = std::min(a.right, b.right) - std::max(a.left, b.left);
+      int height = std::min(a.bottom, b.bottom) - std::max(a.top, b.top);
+      if ((width <= 0) || (height <= 0)) return 0;
+      return static_cast<long long>(width) * height;
+    }
+
+    // pixels the union of a and b covers that neither of them does
+    long long merge_waste(const PixelRect & a, const PixelRect & b) {
+      return rect_area(unite(a, b)) - (rect_area(a) + rect_area(b) - overlap_area(a, b));
+    }
+  }
+
+  DirtyRegion::DirtyRegion() {}
+
+  void DirtyRegion::add(PixelRect rect) {
+    if ((rect.left >= rect.right) || (rect.top >= rect.bottom)) return;
+
+    // a merged rectangle can make others mergeable that weren't before
+    for (size_t i = 0; i < rects_.size();) {
+      if (merge_waste(rects_[i], rect) == 0) {
+        rect = unite(rects_[i], rect);
+        rects_.erase(rects_.begin() + i);
+        i = 0;
+      } else {
+        ++i;
+      }
+    }
+    rects_.push_back(rect);
+    if (rects_.size() > MAX_RECTS) merge_cheapest();
+  }
+
+  void DirtyRegion::merge_cheapest(void) {
+    size_t best_i = 0;
+    size_t best_j = 1;
+    long long best_waste = merge_waste(rects_[0], rects_[1]);
+    for (size_t i = 0; i < rects_.size(); ++i) {
+      for (size_t j = i + 1; j < rects_.size(); ++j) {
+        long long waste = merge_waste(rects_[i], rects_[j]);
+        if (waste < best_waste) {
+          best_waste = waste;
+          best_i = i;
+          best_j = j;
+        }
+      }
+    }
+    PixelRect merged = unite(rects_[best_i], rects_[best_j]);
+    rects_.erase(rects_.begin() + best_j);
+    rects_.erase(rects_.begin() + best_i);
+    add(merged);
+  }
+
+  void DirtyRegion::clear(void) {
+    rects_.clear();
+  }
+
+  bool DirtyRegion::empty(void) const {
+    return rects_.empty();
+  }
+
+  const std::vector<PixelRect> & DirtyRegion::rects(void) const {
+    return rects_;
+  }
+
+  PixelRect DirtyRegion::bounds(void) const {
+    PixelRect r = { 0, 0, 0, 0 };
+    if (rects_.empty()) return r;
+    r = rects_[0];
+    for (size_t i = 1; i < rects_.size(); ++i) r = unite(r, rects_[i]);
+    return r;
+  }
+
+  long long DirtyRegion::area(void) const {
+    long long total = 0;
+    for (size_t i = 0; i < rects_.size(); ++i) total += rect_area(rects_[i]);
+    return total;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Collects the rectangles of a frame that changed since it was last
+//   presented, coalescing them so that a partial present stays a short list
+//   of rectangles that covers few unchanged pixels.
+
+#ifndef CONREP_DIRTY_REGION_H
+#define CONREP_DIRTY_REGION_H
+
+#include <vector>
+
+#include "framebuffer.h"
+
+namespace console {
+  class DirtyRegion {
+    public:
+      // past this many rectangles the cheapest pair to combine is merged
+      static const size_t MAX_RECTS = 8;
+
+      DirtyRegion();
+
+      // Rectangles are merged with any they can be combined with without
+      //   covering more pixels, such as neighbouring rows of text or a cell
+      //   inside an already dirty row.
+      void add(PixelRect rect);
+      void clear(void);
+
+      bool empty(void) const;
+      const std::vector<PixelRect> & rects(void) const;
+      PixelRect bounds(void) const;
+      // pixels covered, counting overlaps once per rectangle
+      long long area(void) const;
+    private:
+      std::vector<PixelRect> rects_;
+
+      void merge_cheapest(void);
+  };
+}
+
+#endif
\ No newline at end of file
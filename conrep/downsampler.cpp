@@ -0,0 +1,138 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// downsampler.cpp
+// implementation of the Downsampler class
+
+#include "downsampler.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace console {
+  // Positions are measured in units where a source pixel is dest pixels
+  //   long and a destination pixel is source pixels long, so every overlap
+  //   between the two is an exact integer.
+  Downsampler::Downsampler(Dimension source, Dimension dest)
+    : source_(source),
+      dest_(dest),
+      next_row_(0),
+      dest_row_(0),
+      max_taps_(source.width / dest.width + 2),
+      row_(dest.width * 4),
+      acc_(dest.width * 4),
+      next_acc_(dest.width * 4),
+      image_(dest.width * dest.height)
+  {
+    column_start_.resize(dest.width);
+    column_taps_.resize(dest.width);
+    column_weights_.resize(dest.width * max_taps_);
+    const long long sw = source.width;
+    const long long dw = dest.width;
+    for (int x = 0; x < dest.width; ++x) {
+      long long begin = x * sw;
+      long long end = begin + sw;
+      int first = static_cast<int>(begin / dw);
+      int last = static_cast<int>((end - 1) / dw);
+      column_start_[x] = first;
+      column_taps_[x] = last - first + 1;
+      for (int i = first; i <= last; ++i) {
+        long long overlap = std::min(end, (i + 1) * dw) - std::max(begin, i * dw);
+        column_weights_[x * max_taps_ + i - first] = static_cast<float>(overlap) / sw;
+      }
+    }
+  }
+
+  void Downsampler::filter_row(const Pixel * row) {
+    for (int x = 0; x < dest_.width; ++x) {
+      const Pixel * src = row + column_start_[x];
+      const float * weights = &column_weights_[x * max_taps_];
+      float a = 0, r = 0, g = 0, b = 0;
+      for (int i = 0; i < column_taps_[x]; ++i) {
+        Pixel p = src[i];
+        float w = weights[i];
+        a += (p >> 24) * w;
+        r += ((p >> 16) & 0xff) * w;
+        g += ((p >> 8) & 0xff) * w;
+        b += (p & 0xff) * w;
+      }
+      float * out = &row_[x * 4];
+      out[0] = a;
+      out[1] = r;
+      out[2] = g;
+      out[3] = b;
+    }
+  }
+
+  void Downsampler::emit_row(void) {
+    Pixel * out = &image_[dest_row_ * dest_.width];
+    for (int x = 0; x < dest_.width; ++x) {
+      const float * c = &acc_[x * 4];
+      Pixel p = 0;
+      for (int i = 0; i < 4; ++i) {
+        // weights sum to one, so only rounding can take a channel past 255
+        unsigned v = static_cast<unsigned>(c[i] + 0.5f);
+        p = (p << 8) | std::min(v, 255u);
+      }
+      out[x] = p;
+    }
+    ++dest_row_;
+    acc_.swap(next_acc_);
+    std::fill(next_acc_.begin(), next_acc_.end(), 0.0f);
+  }
+
+  void Downsampler::add_rows(const Pixel * rows, int count, int stride) {
+    if ((source_.width == dest_.width) && (source_.height == dest_.height)) {
+      for (int i = 0; i < count; ++i) {
+        std::memcpy(&image_[(next_row_ + i) * dest_.width], rows + i * stride, dest_.width * sizeof(Pixel));
+      }
+      next_row_ += count;
+      return;
+    }
+
+    const long long sh = source_.height;
+    const long long dh = dest_.height;
+    for (int i = 0; i < count; ++i, ++next_row_) {
+      filter_row(rows + i * stride);
+
+      long long begin = next_row_ * dh;
+      long long end = begin + dh;
+      long long row_end = (dest_row_ + 1) * sh; // end of the destination row
+      float w = static_cast<float>(std::min(end, row_end) - begin) / sh;
+      for (size_t j = 0; j < acc_.size(); ++j) acc_[j] += row_[j] * w;
+      if (end > row_end) {
+        // the source row straddles two destination rows
+        w = static_cast<float>(end - row_end) / sh;
+        for (size_t j = 0; j < next_acc_.size(); ++j) next_acc_[j] += row_[j] * w;
+      }
+      if (end >= row_end) emit_row();
+    }
+  }
+
+  bool Downsampler::done(void) const {
+    return next_row_ == source_.height;
+  }
+
+  Dimension Downsampler::dest_dim(void) const {
+    return dest_;
+  }
+
+  const Pixel * Downsampler::image(void) const {
+    return &image_[0];
+  }
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Shrinks an image that arrives a strip of rows at a time, averaging each
+//   destination pixel over the exact area of the source it covers (a box
+//   filter with fractional edge weights). Only one source row is held at a
+//   time besides the result, so very large images can be reduced without
+//   ever being decoded in full.
+
+#ifndef CONREP_DOWNSAMPLER_H
+#define CONREP_DOWNSAMPLER_H
+
+#include <vector>
+
+#include "dimension.h"
+#include "framebuffer.h"
+
+namespace console {
+  class Downsampler {
+    public:
+      // dest must be no larger than source in either direction
+      Downsampler(Dimension source, Dimension dest);
+
+      // Feeds the next count rows of the source, stride pixels apart.
+      void add_rows(const Pixel * rows, int count, int stride);
+      // whether every source row has been fed
+      bool done(void) const;
+
+      Dimension dest_dim(void) const;
+      // dest_dim().width pixels per row; complete once done() returns true
+      const Pixel * image(void) const;
+    private:
+      Dimension source_;
+      Dimension dest_;
+      int next_row_;  // next source row expected
+      int dest_row_;  // destination row being accumulated
+
+      // horizontal taps for each destination column
+      std::vector<int> column_start_;
+      std::vector<int> column_taps_;
+      std::vector<float> column_weights_; // max_taps_ per column
+      int max_taps_;
+
+      std::vector<float> row_;      // source row filtered horizontally, four
+      std::vector<float> acc_;      //   channels per destination column
+      std::vector<float> next_acc_; // share of the following destination row
+      std::vector<Pixel> image_;
+
+      void filter_row(const Pixel * row);
+      void emit_row(void);
+
+      Downsampler(const Downsampler &);
+      Downsampler & operator=(const Downsampler &);
+  };
+}
+
+#endif
\ No newline at end of file
@@ -191,4 +191,53 @@ namespace console {
     *lf = f;
   }
 
+  LOGFONT get_gdi_logfont(const tstring & font_name, int font_size) {
+    HDC dc = GetDC(NULL);
+    if (!dc) WIN_EXCEPT("Failed call to GetDC(NULL).");
+    int log_pixels_y = GetDeviceCaps(dc, LOGPIXELSY);
+    ReleaseDC(NULL, dc);
+
+    LOGFONT lf = {};
+    if (is_fixed_width(font_name)) {
+      if (get_logfont(font_name, font_size, &lf)) {
+        lf.lfQuality = QUALITY;
+        return lf;
+      }
+      _tcscpy(lf.lfFaceName, font_name.c_str());
+    } else {
+      tstringstream sstr;
+      sstr << _T("Unable to use the font ") << font_name << ".";
+      MessageBox(NULL, sstr.str().c_str(), _T("Font error"), MB_OK);
+      _tcscpy(lf.lfFaceName, _T("Lucida Console"));
+    }
+    lf.lfHeight = -MulDiv(font_size, log_pixels_y, 72 * POINT_SIZE_SCALE);
+    lf.lfWeight = FW_NORMAL;
+    lf.lfCharSet = DEFAULT_CHARSET;
+    lf.lfOutPrecision = OUT_DEFAULT_PRECIS;
+    lf.lfClipPrecision = CLIP_DEFAULT_PRECIS;
+    lf.lfQuality = QUALITY;
+    lf.lfPitchAndFamily = FIXED_PITCH | FF_DONTCARE;
+    return lf;
+  }
+
+  Dimension get_char_dim(const LOGFONT & lf) {
+    HFONT font = CreateFontIndirect(&lf);
+    if (!font) WIN_EXCEPT("Failed call to CreateFontIndirect(). ");
+    HDC dc = CreateCompatibleDC(NULL);
+    if (!dc) {
+      DWORD err = GetLastError();
+      DeleteObject(font);
+      WIN_EXCEPT2("Failed call to CreateCompatibleDC(). ", err);
+    }
+    HGDIOBJ old_font = SelectObject(dc, font);
+    TEXTMETRIC tm;
+    BOOL ok = GetTextMetrics(dc, &tm);
+    DWORD err = GetLastError();
+    SelectObject(dc, old_font);
+    DeleteDC(dc);
+    DeleteObject(font);
+    if (!ok) WIN_EXCEPT2("Failed call to GetTextMetrics(). ", err);
+    return Dimension(tm.tmAveCharWidth, tm.tmHeight);
+  }
+
 }
\ No newline at end of file
@@ -32,6 +32,11 @@ namespace console {
 
   Dimension get_char_dim(FontPtr font);
   void get_logfont(FontPtr font, LOGFONT * lf);
+
+  // The GDI counterparts of the above, for drawing without a device. Falls
+  //   back to Lucida Console the same way create_font() does.
+  LOGFONT get_gdi_logfont(const tstring & font_name, int font_size);
+  Dimension get_char_dim(const LOGFONT & lf);
 }
 
 #endif
\ No newline at end of file
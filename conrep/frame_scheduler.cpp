@@ -0,0 +1,123 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// frame_scheduler.cpp
+// implementation of the FrameScheduler class
+
+#include "frame_scheduler.h"
+
+#include <algorithm>
+
+namespace console {
+  namespace {
+    // ends the scene even if a window's step throws
+    class SceneGuard {
+      public:
+        SceneGuard(ISceneDevice & device) : device_(device) {
+          device_.begin_scene();
+        }
+        ~SceneGuard() {
+          device_.end_scene();
+        }
+      private:
+        ISceneDevice & device_;
+
+        SceneGuard(const SceneGuard &);
+        SceneGuard & operator=(const SceneGuard &);
+    };
+  }
+
+  ISceneDevice::~ISceneDevice() {}
+  IScheduledWindow::~IScheduledWindow() {}
+
+  FrameScheduler::FrameScheduler() : pending_(false) {
+    counts_.ticks = 0;
+    counts_.frames = 0;
+    counts_.scenes = 0;
+  }
+
+  void FrameScheduler::add(IScheduledWindow * window) {
+    windows_.push_back(window);
+  }
+
+  void FrameScheduler::remove(IScheduledWindow * window) {
+    windows_.erase(std::remove(windows_.begin(), windows_.end(), window), windows_.end());
+  }
+
+  bool FrameScheduler::request(void) {
+    if (pending_) return false;
+    pending_ = true;
+    return true;
+  }
+
+  // Each window's drawing is flushed before the next window's, as that
+  //   will be to a different render target.
+  void FrameScheduler::draw_step(ISceneDevice & device, unsigned step) {
+    for (size_t i = 0; i < stepping_.size(); ++i) {
+      if (!(work_[i] & step)) continue;
+      switch (step) {
+        case WORK_TEXT:    stepping_[i]->draw_text();    break;
+        case WORK_COMPOSE: stepping_[i]->compose();      break;
+        case WORK_OVERLAY: stepping_[i]->draw_overlay(); break;
+      }
+      device.flush();
+    }
+  }
+
+  void FrameScheduler::tick(ISceneDevice & device) {
+    pending_ = false;
+    ++counts_.ticks;
+
+    // a window may close while it prepares, so the windows being stepped
+    //   are fixed first
+    stepping_ = windows_;
+    work_.resize(stepping_.size());
+    unsigned all = 0;
+    for (size_t i = 0; i < stepping_.size(); ++i) {
+      work_[i] = stepping_[i]->prepare();
+      all |= work_[i];
+    }
+
+    if (all & (WORK_TEXT | WORK_COMPOSE)) {
+      SceneGuard guard(device);
+      ++counts_.scenes;
+      // every text texture is drawn before any frame is composed from one
+      draw_step(device, WORK_TEXT);
+      draw_step(device, WORK_COMPOSE);
+    }
+    if (!(all & WORK_PRESENT)) return;
+
+    for (size_t i = 0; i < stepping_.size(); ++i) {
+      if (work_[i] & WORK_PRESENT) stepping_[i]->copy_frame();
+    }
+    if (all & WORK_OVERLAY) {
+      SceneGuard guard(device);
+      ++counts_.scenes;
+      draw_step(device, WORK_OVERLAY);
+    }
+    for (size_t i = 0; i < stepping_.size(); ++i) {
+      if (!(work_[i] & WORK_PRESENT)) continue;
+      stepping_[i]->present();
+      ++counts_.frames;
+    }
+  }
+
+  SchedulerCounts FrameScheduler::counts(void) const {
+    return counts_;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Drives the drawing of every console window from a single tick of the root
+//   window. All the windows share one device, so rather than each window
+//   beginning and ending its own scenes, the text and composition of every
+//   window that needs a frame are drawn in one scene and the cursors in a
+//   second, whatever the number of windows. Doesn't depend on Direct3D, so
+//   the grouping can be checked against a fake device.
+
+#ifndef CONREP_FRAME_SCHEDULER_H
+#define CONREP_FRAME_SCHEDULER_H
+
+#include <cstdint>
+#include <vector>
+
+namespace console {
+  // what the scheduler needs of the shared device
+  class ISceneDevice {
+    public:
+      virtual ~ISceneDevice();
+
+      virtual void begin_scene(void) = 0;
+      virtual void end_scene(void) = 0;
+      // submits batched draws, which has to happen before another window
+      //   changes the render target
+      virtual void flush(void) = 0;
+  };
+
+  // what a window returns from prepare(), as a combination of flags
+  enum FrameWork {
+    WORK_TEXT    = 0x01, // draw_text()
+    WORK_COMPOSE = 0x02, // compose()
+    WORK_PRESENT = 0x04, // copy_frame() and present()
+    WORK_OVERLAY = 0x08  // draw_overlay()
+  };
+
+  // The steps of a window's frame, in the order they are called. Each step
+  //   is called on every window that asked for it before the next step is
+  //   called on any.
+  class IScheduledWindow {
+    public:
+      virtual ~IScheduledWindow();
+
+      // Outside of any scene. Takes in new console contents and does
+      //   whatever can't be done inside a scene, such as copying between
+      //   render targets. Returns the steps the window needs this tick.
+      virtual unsigned prepare(void) = 0;
+      // in the shared scene
+      virtual void draw_text(void) = 0;
+      virtual void compose(void) = 0;
+      // outside of any scene
+      virtual void copy_frame(void) = 0;
+      // in the overlay scene
+      virtual void draw_overlay(void) = 0;
+      // outside of any scene
+      virtual void present(void) = 0;
+  };
+
+  struct SchedulerCounts {
+    std::uint64_t ticks;
+    std::uint64_t frames; // windows that presented
+    std::uint64_t scenes;
+  };
+
+  class FrameScheduler {
+    public:
+      FrameScheduler();
+
+      // windows are stepped in the order they were added
+      void add(IScheduledWindow * window);
+      void remove(IScheduledWindow * window);
+
+      // Returns true if a tick isn't already pending, in which case the
+      //   caller arranges for tick() to be called soon. Lets any number of
+      //   windows ask for a frame at once for the cost of one tick.
+      bool request(void);
+      // Steps every window through a frame. Must not be called in a scene.
+      void tick(ISceneDevice & device);
+
+      SchedulerCounts counts(void) const;
+    private:
+      std::vector<IScheduledWindow *> windows_;
+      std::vector<IScheduledWindow *> stepping_; // work buffers for tick()
+      std::vector<unsigned> work_;
+      bool pending_;
+      SchedulerCounts counts_;
+
+      void draw_step(ISceneDevice & device, unsigned step);
+
+      FrameScheduler(const FrameScheduler &);
+      FrameScheduler & operator=(const FrameScheduler &);
+  };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,84 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// frame_tracker.cpp
+// implementation of the FrameTracker class
+
+#include "frame_tracker.h"
+
+namespace console {
+  FrameTracker::FrameTracker()
+    : changes_(FRAME_RESET)
+  {
+    CursorCell hidden = { 0, 0, false };
+    cursor_ = hidden;
+    presented_cursor_ = hidden;
+    counts_.presented = 0;
+    counts_.skipped = 0;
+  }
+
+  void FrameTracker::mark(unsigned changes) {
+    changes_ |= changes;
+  }
+
+  void FrameTracker::set_cursor(CursorCell cursor) {
+    // where a hidden cursor is makes no difference to the frame
+    bool moved = (cursor.column != cursor_.column) || (cursor.row != cursor_.row);
+    if ((cursor.visible != cursor_.visible) || (cursor.visible && moved)) changes_ |= FRAME_CURSOR;
+    cursor_ = cursor;
+  }
+
+  bool FrameTracker::partial(void) const {
+    return !(changes_ & ~(FRAME_TEXT | FRAME_CURSOR));
+  }
+
+  DirtyRegion & FrameTracker::region(void) {
+    return region_;
+  }
+
+  int FrameTracker::cursor_cells(CursorCell cells[2]) const {
+    int count = 0;
+    if (presented_cursor_.visible) cells[count++] = presented_cursor_;
+    if (cursor_.visible &&
+        !((count == 1) && (cells[0].column == cursor_.column) && (cells[0].row == cursor_.row))) {
+      cells[count++] = cursor_;
+    }
+    return count;
+  }
+
+  bool FrameTracker::request(void) {
+    if (changes_) return true;
+    ++counts_.skipped;
+    return false;
+  }
+
+  void FrameTracker::presented(void) {
+    changes_ = 0;
+    region_.clear();
+    presented_cursor_ = cursor_;
+    ++counts_.presented;
+  }
+
+  unsigned FrameTracker::changes(void) const {
+    return changes_;
+  }
+
+  FrameCounts FrameTracker::counts(void) const {
+    return counts_;
+  }
+}
\ No newline at end of file
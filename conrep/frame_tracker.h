@@ -0,0 +1,88 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Records what has changed since a console window last presented a frame, so
+//   the window only recomposes and presents when something visible changed.
+
+#ifndef CONREP_FRAME_TRACKER_H
+#define CONREP_FRAME_TRACKER_H
+
+#include <cstdint>
+
+#include "dirty_region.h"
+
+namespace console {
+  enum FrameChange {
+    FRAME_TEXT       = 0x01, // text texture was redrawn
+    FRAME_CURSOR     = 0x02, // cursor blink phase or position
+    FRAME_POSITION   = 0x04, // window moved, so the background behind it moved
+    FRAME_BACKGROUND = 0x08, // wallpaper changed
+    FRAME_ACTIVATION = 0x10, // post alpha and cursor visibility
+    FRAME_RESET      = 0x20, // window resized or Direct3D resources recreated
+    FRAME_EXPOSE     = 0x40  // the system asked for the window to be repainted
+  };
+
+  struct CursorCell {
+    int column;
+    int row;
+    bool visible;
+  };
+
+  struct FrameCounts {
+    std::uint64_t presented;
+    std::uint64_t skipped;
+  };
+
+  class FrameTracker {
+    public:
+      FrameTracker();
+
+      // changes is a combination of FrameChange flags
+      void mark(unsigned changes);
+      // Marks FRAME_CURSOR if the cursor looks different from the one last
+      //   set.
+      void set_cursor(CursorCell cursor);
+
+      // If only the text and the cursor changed, the frame can be patched
+      //   instead of recomposed: region() and the cells returned by
+      //   cursor_cells() are recomposed and only they are presented.
+      bool partial(void) const;
+      // areas changed by FRAME_TEXT; filled in by whoever marks it
+      DirtyRegion & region(void);
+      // Stores the cells the cursor covered in the last presented frame or
+      //   covers now, at most two, and returns how many there are.
+      int cursor_cells(CursorCell cells[2]) const;
+
+      // Returns whether a new frame is needed, counting a skipped frame if
+      //   not.
+      bool request(void);
+      // A frame was presented; clears the recorded changes.
+      void presented(void);
+
+      unsigned changes(void) const;
+      FrameCounts counts(void) const;
+    private:
+      unsigned changes_;
+      DirtyRegion region_;
+      CursorCell cursor_;
+      CursorCell presented_cursor_; // cursor in the last presented frame
+      FrameCounts counts_;
+  };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,279 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// framebuffer.cpp
+// implementation of the Framebuffer class and the scalar and SSE2 blending
+//   kernels
+
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace console {
+  namespace {
+    // x / 255 rounded to nearest, exact for x in [0, 255 * 255]
+    inline unsigned div255(unsigned x) {
+      x += 128;
+      return (x + (x >> 8)) >> 8;
+    }
+
+    inline Pixel blend_pixel(Pixel dest, Pixel source) {
+      unsigned a = source >> 24;
+      unsigned inv = 255 - a;
+      Pixel result = 0;
+      for (int shift = 0; shift < 32; shift += 8) {
+        unsigned s = (source >> shift) & 0xff;
+        unsigned d = (dest >> shift) & 0xff;
+        result |= div255(s * a + d * inv) << shift;
+      }
+      return result;
+    }
+
+    // as blend_pixel(), but the source contributes nothing to the alpha
+    inline Pixel blend_pixel_transmittance(Pixel dest, Pixel source) {
+      return (blend_pixel(dest, source) & 0x00ffffff) |
+             (div255((dest >> 24) * (255 - (source >> 24))) << 24);
+    }
+
+    inline Pixel modulate_pixel(Pixel p, Pixel modulate) {
+      Pixel result = 0;
+      for (int shift = 0; shift < 32; shift += 8) {
+        result |= div255(((p >> shift) & 0xff) * ((modulate >> shift) & 0xff)) << shift;
+      }
+      return result;
+    }
+
+    void blend_scalar(Pixel * dest, const Pixel * source, size_t count) {
+      for (size_t i = 0; i < count; ++i) {
+        dest[i] = blend_pixel(dest[i], source[i]);
+      }
+    }
+
+    void blend_transmittance_scalar(Pixel * dest, const Pixel * source, size_t count) {
+      for (size_t i = 0; i < count; ++i) {
+        dest[i] = blend_pixel_transmittance(dest[i], source[i]);
+      }
+    }
+
+    #ifdef CONREP_X86
+      // Two pixels as 16-bit channels; the same arithmetic as blend_pixel()
+      //   and no intermediate exceeds 16 bits. The source channels are
+      //   masked with keep before being weighted, so clearing the alpha
+      //   lanes of keep gives blend_pixel_transmittance().
+      CONREP_TARGET_SSE2 inline __m128i sse2_blend_half(__m128i d, __m128i s, __m128i keep) {
+        const __m128i all = _mm_set1_epi16(255);
+        const __m128i round = _mm_set1_epi16(128);
+        __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xff), 0xff);
+        __m128i inv = _mm_sub_epi16(all, a);
+        __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(s, keep), a),
+                                                _mm_mullo_epi16(d, inv)),
+                                  round);
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+      }
+
+      CONREP_TARGET_SSE2 void blend_sse2(Pixel * dest, const Pixel * source, size_t count, __m128i keep) {
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+          __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+          // fully transparent source pixels are common in glyph coverage
+          if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_srli_epi32(s, 24), zero)) == 0xffff) continue;
+          __m128i * dp = reinterpret_cast<__m128i *>(dest + i);
+          __m128i d = _mm_loadu_si128(dp);
+          __m128i lo = sse2_blend_half(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), keep);
+          __m128i hi = sse2_blend_half(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), keep);
+          _mm_storeu_si128(dp, _mm_packus_epi16(lo, hi));
+        }
+      }
+    #endif
+
+    // Rebuilds the alpha a pixel of text drawn with ALPHA_TRANSMITTANCE would
+    //   have had over a clear of pre_alpha with ALPHA_OPACITY, then scales it
+    //   by post_alpha. With a single layer of coverage c over the clear the
+    //   transmittance is 255 - c, and blending alpha with itself gave
+    //   c * c + pre_alpha * (255 - c).
+    inline Pixel fuse_pixel(Pixel source, unsigned pre_alpha, unsigned post_alpha) {
+      unsigned t = source >> 24;
+      unsigned c = 255 - t;
+      unsigned alpha = div255(div255(c * c + pre_alpha * t) * post_alpha);
+      return (source & 0x00ffffff) | (alpha << 24);
+    }
+
+  }
+
+  void blend_span(Pixel * dest, const Pixel * source, size_t count) {
+    blend_span(dest, source, count, get_simd_level());
+  }
+
+  void blend_span(Pixel * dest, const Pixel * source, size_t count, SimdLevel level) {
+    if (level > get_simd_level()) level = get_simd_level();
+    #ifdef CONREP_X86
+      if (level >= SIMD_SSE2) {
+        blend_sse2(dest, source, count, _mm_set1_epi16(-1));
+        size_t done = count & ~size_t(3);
+        blend_scalar(dest + done, source + done, count - done);
+        return;
+      }
+    #endif
+    blend_scalar(dest, source, count);
+  }
+
+  void blend_span_transmittance(Pixel * dest, const Pixel * source, size_t count) {
+    blend_span_transmittance(dest, source, count, get_simd_level());
+  }
+
+  void blend_span_transmittance(Pixel * dest, const Pixel * source, size_t count, SimdLevel level) {
+    if (level > get_simd_level()) level = get_simd_level();
+    #ifdef CONREP_X86
+      if (level >= SIMD_SSE2) {
+        blend_sse2(dest, source, count, _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1));
+        size_t done = count & ~size_t(3);
+        blend_transmittance_scalar(dest + done, source + done, count - done);
+        return;
+      }
+    #endif
+    blend_transmittance_scalar(dest, source, count);
+  }
+
+  Framebuffer::Framebuffer() : dim_(0, 0), alpha_mode_(ALPHA_OPACITY) {}
+
+  void Framebuffer::set_alpha_mode(AlphaMode mode) {
+    alpha_mode_ = mode;
+  }
+
+  void Framebuffer::blend(Pixel * dest, const Pixel * source, size_t count) const {
+    if (alpha_mode_ == ALPHA_TRANSMITTANCE) {
+      blend_span_transmittance(dest, source, count);
+    } else {
+      blend_span(dest, source, count);
+    }
+  }
+
+  void Framebuffer::resize(Dimension dim) {
+    dim_ = dim;
+    pixels_.resize(dim.width * dim.height);
+    span_.resize(dim.width);
+  }
+
+  Dimension Framebuffer::dim(void) const {
+    return dim_;
+  }
+
+  Pixel * Framebuffer::row(int y) {
+    return &pixels_[y * dim_.width];
+  }
+
+  const Pixel * Framebuffer::row(int y) const {
+    return &pixels_[y * dim_.width];
+  }
+
+  bool Framebuffer::clip(PixelRect & rect) const {
+    rect.left   = std::max(rect.left, 0);
+    rect.top    = std::max(rect.top, 0);
+    rect.right  = std::min(rect.right, dim_.width);
+    rect.bottom = std::min(rect.bottom, dim_.height);
+    return (rect.left < rect.right) && (rect.top < rect.bottom);
+  }
+
+  void Framebuffer::clear(Pixel color) {
+    std::fill(pixels_.begin(), pixels_.end(), color);
+  }
+
+  void Framebuffer::clear(Pixel color, PixelRect rect) {
+    if (!clip(rect)) return;
+    for (int y = rect.top; y < rect.bottom; ++y) {
+      std::fill(row(y) + rect.left, row(y) + rect.right, color);
+    }
+  }
+
+  void Framebuffer::copy_rect(const Framebuffer & source, PixelRect rect) {
+    if (!clip(rect) || !source.clip(rect)) return;
+    size_t bytes = (rect.right - rect.left) * sizeof(Pixel);
+    for (int y = rect.top; y < rect.bottom; ++y) {
+      std::memcpy(row(y) + rect.left, source.row(y) + rect.left, bytes);
+    }
+  }
+
+  void Framebuffer::fill(Pixel color, PixelRect rect) {
+    if (!clip(rect)) return;
+    int width = rect.right - rect.left;
+    std::fill_n(span_.begin(), width, color);
+    for (int y = rect.top; y < rect.bottom; ++y) {
+      blend(row(y) + rect.left, &span_[0], width);
+    }
+  }
+
+  void Framebuffer::draw_coverage(int x, int y, const std::uint8_t * coverage, Dimension dim, Pixel color) {
+    PixelRect rect = { x, y, x + dim.width, y + dim.height };
+    if (!clip(rect)) return;
+    int width = rect.right - rect.left;
+    Pixel rgb = color & 0x00ffffff;
+    unsigned alpha = color >> 24;
+    for (int j = rect.top; j < rect.bottom; ++j) {
+      const std::uint8_t * src = coverage + (j - y) * dim.width + (rect.left - x);
+      for (int i = 0; i < width; ++i) {
+        span_[i] = rgb | (div255(src[i] * alpha) << 24);
+      }
+      blend(row(j) + rect.left, &span_[0], width);
+    }
+  }
+
+  void Framebuffer::draw(const Framebuffer & source, int x, int y, Pixel modulate) {
+    Dimension dim = source.dim();
+    PixelRect rect = { x, y, x + dim.width, y + dim.height };
+    if (!clip(rect)) return;
+    int width = rect.right - rect.left;
+    for (int j = rect.top; j < rect.bottom; ++j) {
+      const Pixel * src = source.row(j - y) + (rect.left - x);
+      if (modulate == 0xffffffff) {
+        blend(row(j) + rect.left, src, width);
+      } else {
+        for (int i = 0; i < width; ++i) span_[i] = modulate_pixel(src[i], modulate);
+        blend(row(j) + rect.left, &span_[0], width);
+      }
+    }
+  }
+
+  void Framebuffer::draw_fused(const Framebuffer & source, int x, int y, unsigned pre_alpha, unsigned post_alpha) {
+    Dimension dim = source.dim();
+    PixelRect rect = { x, y, x + dim.width, y + dim.height };
+    if (!clip(rect)) return;
+    int width = rect.right - rect.left;
+    for (int j = rect.top; j < rect.bottom; ++j) {
+      const Pixel * src = source.row(j - y) + (rect.left - x);
+      for (int i = 0; i < width; ++i) span_[i] = fuse_pixel(src[i], pre_alpha, post_alpha);
+      blend(row(j) + rect.left, &span_[0], width);
+    }
+  }
+
+  void Framebuffer::move_rows(int top, int bottom, int offset) {
+    int first = std::max(top, top + offset);
+    int last  = std::min(bottom, bottom + offset);
+    if (first >= last) return;
+    std::memmove(row(first), row(first - offset), (last - first) * dim_.width * sizeof(Pixel));
+  }
+
+  std::uint64_t Framebuffer::hash(void) const {
+    std::uint64_t h = 14695981039346656037ull;
+    for (std::vector<Pixel>::const_iterator itr = pixels_.begin(); itr != pixels_.end(); ++itr) {
+      h = (h ^ *itr) * 1099511628211ull;
+    }
+    return h;
+  }
+}
\ No newline at end of file
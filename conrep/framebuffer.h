@@ -0,0 +1,120 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// CPU side ARGB render target with the blending operations the console
+//   renderer needs. Blending follows the D3DXSPRITE_ALPHABLEND state used on
+//   the GPU: every channel, alpha included, is src * srcalpha +
+//   dest * (1 - srcalpha).
+
+#ifndef CONREP_FRAMEBUFFER_H
+#define CONREP_FRAMEBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpu_features.h"
+#include "dimension.h"
+
+namespace console {
+  // same layout as D3DCOLOR: 0xAARRGGBB
+  typedef std::uint32_t Pixel;
+
+  // right and bottom are exclusive
+  struct PixelRect {
+    int left;
+    int top;
+    int right;
+    int bottom;
+  };
+
+  // What the alpha channel of a framebuffer holds.
+  enum AlphaMode {
+    // blended like the colors, as D3DXSPRITE_ALPHABLEND does
+    ALPHA_OPACITY,
+    // how much of whatever the framebuffer is drawn over shows through: each
+    //   blend multiplies it by one minus the source alpha, as separate alpha
+    //   blending with D3DBLEND_ZERO and D3DBLEND_INVSRCALPHA does
+    ALPHA_TRANSMITTANCE
+  };
+
+  // Blends count source pixels over dest. The versions taking a level force
+  //   a specific kernel, which is clamped to what the processor supports.
+  void blend_span(Pixel * dest, const Pixel * source, size_t count);
+  void blend_span(Pixel * dest, const Pixel * source, size_t count, SimdLevel level);
+  // as blend_span(), for a dest holding transmittance
+  void blend_span_transmittance(Pixel * dest, const Pixel * source, size_t count);
+  void blend_span_transmittance(Pixel * dest, const Pixel * source, size_t count, SimdLevel level);
+
+  class Framebuffer {
+    public:
+      Framebuffer();
+
+      // contents are undefined after a resize
+      void resize(Dimension dim);
+      Dimension dim(void) const;
+
+      // how fill(), draw_coverage() and draw() treat the alpha channel;
+      //   ALPHA_OPACITY to begin with
+      void set_alpha_mode(AlphaMode mode);
+
+      Pixel       * row(int y);
+      const Pixel * row(int y) const;
+
+      // replace the pixels, like IDirect3DDevice9::Clear()
+      void clear(Pixel color);
+      void clear(Pixel color, PixelRect rect);
+      // Replaces the pixels in rect with the same pixels of source, like
+      //   IDirect3DDevice9::StretchRect() with matching rectangles.
+      void copy_rect(const Framebuffer & source, PixelRect rect);
+      // blend a solid rectangle
+      void fill(Pixel color, PixelRect rect);
+      // Blends color through a dim.width * dim.height coverage mask, as when
+      //   drawing a glyph tinted with color.
+      void draw_coverage(int x, int y, const std::uint8_t * coverage, Dimension dim, Pixel color);
+      // Blends source with its channels scaled by modulate, as when drawing
+      //   a texture with a sprite color.
+      void draw(const Framebuffer & source, int x, int y, Pixel modulate);
+      // Blends source, whose alpha channel holds transmittance, exactly as
+      //   draw() blends the same drawing made over a clear of pre_alpha,
+      //   modulated by post_alpha, as long as nothing partly covering was
+      //   drawn over an earlier drawing: a glyph edge over an opaque cell
+      //   background comes out opaque, where draw() leaves it up to a quarter
+      //   see through. Callers keep to drawings without cell backgrounds.
+      void draw_fused(const Framebuffer & source, int x, int y, unsigned pre_alpha, unsigned post_alpha);
+      // Moves rows [top, bottom) by offset rows. Rows moved outside the
+      //   range are dropped and the rows uncovered are left unchanged.
+      void move_rows(int top, int bottom, int offset);
+
+      // FNV-1a over the pixels, for comparing renders
+      std::uint64_t hash(void) const;
+    private:
+      Dimension dim_;
+      AlphaMode alpha_mode_;
+      std::vector<Pixel> pixels_;
+      std::vector<Pixel> span_; // work buffer for a row of source pixels
+
+      bool clip(PixelRect & rect) const;
+      void blend(Pixel * dest, const Pixel * source, size_t count) const;
+
+      Framebuffer(const Framebuffer &);
+      Framebuffer & operator=(const Framebuffer &);
+  };
+}
+
+#endif
\ No newline at end of file
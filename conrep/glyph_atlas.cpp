@@ -0,0 +1,118 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// glyph_atlas.cpp
+// implementation of the GlyphAtlas class and glyph quad generation
+
+#include "glyph_atlas.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace console {
+  const int GlyphAtlas::MISSING;
+  const int GlyphAtlas::BLANK;
+
+  GlyphAtlas::GlyphAtlas()
+    : glyph_dim_(0, 0),
+      columns_(0),
+      capacity_(0),
+      used_(0),
+      slots_(std::numeric_limits<CellChar>::max() + 1, MISSING)
+  {}
+
+  void GlyphAtlas::reset(Dimension atlas_dim, Dimension glyph_dim) {
+    glyph_dim_ = glyph_dim;
+    columns_ = atlas_dim.width / (glyph_dim.width + 1);
+    int rows = atlas_dim.height / (glyph_dim.height + 1);
+    capacity_ = columns_ * rows;
+    clear();
+  }
+
+  void GlyphAtlas::clear(void) {
+    for (std::vector<CellChar>::const_iterator itr = entries_.begin(); itr != entries_.end(); ++itr) {
+      slots_[*itr] = MISSING;
+    }
+    entries_.clear();
+    used_ = 0;
+  }
+
+  int GlyphAtlas::find(CellChar c) const {
+    return slots_[c];
+  }
+
+  int GlyphAtlas::add(CellChar c) {
+    if (slots_[c] != MISSING) return slots_[c];
+    if (used_ == capacity_) return MISSING;
+    slots_[c] = used_;
+    entries_.push_back(c);
+    return used_++;
+  }
+
+  void GlyphAtlas::add_blank(CellChar c) {
+    if (slots_[c] != MISSING) return;
+    slots_[c] = BLANK;
+    entries_.push_back(c);
+  }
+
+  int GlyphAtlas::capacity(void) const {
+    return capacity_;
+  }
+
+  int GlyphAtlas::free_slots(void) const {
+    return capacity_ - used_;
+  }
+
+  Dimension GlyphAtlas::glyph_dim(void) const {
+    return glyph_dim_;
+  }
+
+  int GlyphAtlas::slot_x(int slot) const {
+    return (slot % columns_) * (glyph_dim_.width + 1);
+  }
+
+  int GlyphAtlas::slot_y(int slot) const {
+    return (slot / columns_) * (glyph_dim_.height + 1);
+  }
+
+  void GlyphAtlas::find_missing(const CellChar * chars, int width, std::vector<CellChar> & missing) const {
+    size_t first = missing.size();
+    for (int i = 0; i < width; ++i) {
+      if (slots_[chars[i]] == MISSING) missing.push_back(chars[i]);
+    }
+    std::sort(missing.begin() + first, missing.end());
+    missing.erase(std::unique(missing.begin() + first, missing.end()), missing.end());
+  }
+
+  void build_glyph_quads(const GlyphAtlas & atlas,
+                         const CellChar * chars,
+                         const CellAttribute * attributes,
+                         int width,
+                         bool intensify,
+                         std::vector<GlyphQuad> & quads) {
+    quads.clear();
+    for (int i = 0; i < width; ++i) {
+      int slot = atlas.find(chars[i]);
+      if (slot < 0) continue;
+      int color = attributes[i] & 0xf;
+      if (intensify && color) color |= 0x8;
+      GlyphQuad q = { i, slot, color };
+      quads.push_back(q);
+    }
+  }
+}
\ No newline at end of file
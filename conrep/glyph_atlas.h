@@ -0,0 +1,90 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Slot bookkeeping for a texture atlas holding one glyph per character of a
+//   monospaced font, and generation of the quads that draw a row of cells
+//   from it. The texture itself is managed by the caller.
+
+#ifndef CONREP_GLYPH_ATLAS_H
+#define CONREP_GLYPH_ATLAS_H
+
+#include <vector>
+
+#include "cell_planes.h"
+#include "dimension.h"
+
+namespace console {
+  class GlyphAtlas {
+    public:
+      static const int MISSING = -1; // character not yet rasterized
+      static const int BLANK   = -2; // character draws nothing
+
+      GlyphAtlas();
+
+      // Lays the atlas out as a grid of glyph_dim slots, separated by a pixel
+      //   so that filtering never picks up a neighbouring glyph. Forgets all
+      //   glyphs.
+      void reset(Dimension atlas_dim, Dimension glyph_dim);
+      // forgets all glyphs, keeping the layout
+      void clear(void);
+
+      int find(CellChar c) const;
+      // Assigns the next free slot to c and returns it, or MISSING if the
+      //   atlas is full.
+      int add(CellChar c);
+      void add_blank(CellChar c);
+
+      int capacity(void) const;
+      int free_slots(void) const;
+      Dimension glyph_dim(void) const;
+      // pixel position of the top left corner of a slot
+      int slot_x(int slot) const;
+      int slot_y(int slot) const;
+
+      // Appends the distinct characters of chars that have no entry yet.
+      void find_missing(const CellChar * chars, int width, std::vector<CellChar> & missing) const;
+    private:
+      Dimension glyph_dim_;
+      int columns_;
+      int capacity_;
+      int used_;
+      std::vector<int> slots_;        // indexed by character
+      std::vector<CellChar> entries_; // characters with an entry, for clear()
+
+      GlyphAtlas(const GlyphAtlas &);
+      GlyphAtlas & operator=(const GlyphAtlas &);
+  };
+
+  struct GlyphQuad {
+    int column;
+    int slot;
+    int color; // foreground color index
+  };
+
+  // Replaces the contents of quads with one quad per cell of the row whose
+  //   character has a glyph in the atlas. With intensify, non-black
+  //   foregrounds use the bright half of the color table.
+  void build_glyph_quads(const GlyphAtlas & atlas,
+                         const CellChar * chars,
+                         const CellAttribute * attributes,
+                         int width,
+                         bool intensify,
+                         std::vector<GlyphQuad> & quads);
+}
+
+#endif
\ No newline at end of file
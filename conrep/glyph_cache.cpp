@@ -0,0 +1,146 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// glyph_cache.cpp
+// implementation of the GlyphCache class
+
+#include "glyph_cache.h"
+
+#include "assert.h"
+#include "exception.h"
+
+namespace console {
+  namespace {
+    // Large enough for a few thousand glyphs of typical console fonts while
+    //   staying within the texture size limits of any D3D9 hardware.
+    const int MIN_ATLAS_SIZE = 1024;
+    // the atlas is grown for very large fonts so it still holds at least
+    //   this many glyphs in each direction
+    const int MIN_ATLAS_GLYPHS = 16;
+
+    int atlas_side(int glyph_size) {
+      int side = MIN_ATLAS_SIZE;
+      while (side / (glyph_size + 1) < MIN_ATLAS_GLYPHS) side *= 2;
+      return side;
+    }
+  }
+
+  GlyphCache::GlyphCache() : texture_dim_(0, 0) {}
+
+  void GlyphCache::set_font(const DevicePtr & device, const LOGFONT & lf, Dimension char_dim) {
+    rasterizer_.set_font(lf, char_dim, true);
+    Dimension glyph_dim = rasterizer_.glyph_dim();
+
+    Dimension texture_dim(atlas_side(glyph_dim.width), atlas_side(glyph_dim.height));
+    if (!texture_ || (texture_dim.width != texture_dim_.width) || (texture_dim.height != texture_dim_.height)) {
+      texture_ = 0;
+      // managed so that the glyphs survive a device reset
+      HRESULT hr = D3DXCreateTexture(device,
+                                     texture_dim.width,
+                                     texture_dim.height,
+                                     1,
+                                     0,
+                                     D3DFMT_A8R8G8B8,
+                                     D3DPOOL_MANAGED,
+                                     &texture_);
+      if (FAILED(hr)) DX_EXCEPT("Failure in D3DXCreateTexture(). ", hr);
+      texture_dim_ = texture_dim;
+    }
+    atlas_.reset(texture_dim_, glyph_dim);
+  }
+
+  void GlyphCache::clear(void) {
+    atlas_.clear();
+  }
+
+  void GlyphCache::dispose(void) {
+    texture_ = 0;
+    rasterizer_.release();
+  }
+
+  void GlyphCache::prepare_row(SpritePtr & sprite, const CellChar * chars, int width, bool extended_chars) {
+    missing_.clear();
+    atlas_.find_missing(chars, width, missing_);
+    if (missing_.empty()) return;
+
+    if (static_cast<int>(missing_.size()) > atlas_.free_slots()) {
+      // Draws already queued still refer to the current slots. Once they
+      //   are submitted the atlas can start over with just this row.
+      HRESULT hr = sprite->Flush();
+      if (FAILED(hr)) DX_EXCEPT("Failed call to ID3DXSprite::Flush(). ", hr);
+      atlas_.clear();
+      missing_.clear();
+      atlas_.find_missing(chars, width, missing_);
+    }
+    rasterize(missing_, extended_chars);
+  }
+
+  void GlyphCache::rasterize(const std::vector<CellChar> & chars, bool extended_chars) {
+    ASSERT(texture_ != nullptr);
+    Dimension glyph_dim = atlas_.glyph_dim();
+
+    for (std::vector<CellChar>::const_iterator itr = chars.begin(); itr != chars.end(); ++itr) {
+      if (!GlyphRasterizer::draws(*itr, extended_chars)) {
+        atlas_.add_blank(*itr);
+        continue;
+      }
+      int slot = atlas_.add(*itr);
+      if (slot < 0) continue; // full; the character is left undrawn
+      const std::uint8_t * coverage = rasterizer_.rasterize(*itr);
+
+      RECT dest = slot_rect(slot);
+      D3DLOCKED_RECT locked;
+      HRESULT hr = texture_->LockRect(0, &locked, &dest, 0);
+      if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DTexture9::LockRect(). ", hr);
+      // The glyph is stored as white with coverage as alpha so the sprite
+      //   color tints it.
+      for (int y = 0; y < glyph_dim.height; ++y) {
+        const std::uint8_t * src = coverage + y * glyph_dim.width;
+        DWORD * dest_row = reinterpret_cast<DWORD *>(static_cast<BYTE *>(locked.pBits) + y * locked.Pitch);
+        for (int x = 0; x < glyph_dim.width; ++x) {
+          dest_row[x] = (static_cast<DWORD>(src[x]) << 24) | 0x00ffffff;
+        }
+      }
+      hr = texture_->UnlockRect(0);
+      if (FAILED(hr)) DX_EXCEPT("Failed call to IDirect3DTexture9::UnlockRect(). ", hr);
+    }
+  }
+
+  const GlyphAtlas & GlyphCache::atlas(void) const {
+    return atlas_;
+  }
+
+  TexturePtr GlyphCache::texture(void) const {
+    return texture_;
+  }
+
+  int GlyphCache::overhang(void) const {
+    return rasterizer_.overhang();
+  }
+
+  RECT GlyphCache::slot_rect(int slot) const {
+    Dimension glyph_dim = atlas_.glyph_dim();
+    RECT r = {
+      atlas_.slot_x(slot),
+      atlas_.slot_y(slot),
+      atlas_.slot_x(slot) + glyph_dim.width,
+      atlas_.slot_y(slot) + glyph_dim.height
+    };
+    return r;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Owns the texture behind a GlyphAtlas and copies glyphs into it from a
+//   GlyphRasterizer the first time each character is drawn.
+
+#ifndef CONREP_GLYPH_CACHE_H
+#define CONREP_GLYPH_CACHE_H
+
+#include <vector>
+
+#include "d3root.h"
+#include "dimension.h"
+#include "glyph_atlas.h"
+#include "glyph_rasterizer.h"
+#include "windows.h"
+
+namespace console {
+  class GlyphCache {
+    public:
+      GlyphCache();
+
+      // Creates the atlas texture if necessary and switches to the given
+      //   font, forgetting all glyphs.
+      void set_font(const DevicePtr & device, const LOGFONT & lf, Dimension char_dim);
+      // forgets all glyphs, for when the set of drawable characters changes
+      void clear(void);
+      void dispose(void);
+
+      // Rasterizes the characters of a row that aren't in the atlas yet.
+      //   Characters that aren't drawn are recorded as blank. If the atlas
+      //   fills up, sprite is flushed before its slots are reused.
+      void prepare_row(SpritePtr & sprite, const CellChar * chars, int width, bool extended_chars);
+
+      const GlyphAtlas & atlas(void) const;
+      TexturePtr texture(void) const;
+      RECT slot_rect(int slot) const;
+      // Slots are this many pixels wider than a cell on each side, for
+      //   glyphs that reach past their cell, and the glyph starts this far
+      //   into its slot. Anything further out, or above or below the cell,
+      //   is clipped.
+      int overhang(void) const;
+    private:
+      GlyphAtlas atlas_;
+      TexturePtr texture_;
+      Dimension texture_dim_;
+      GlyphRasterizer rasterizer_;
+
+      std::vector<CellChar> missing_; // work buffer
+
+      void rasterize(const std::vector<CellChar> & chars, bool extended_chars);
+
+      GlyphCache(const GlyphCache &);
+      GlyphCache & operator=(const GlyphCache &);
+  };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,146 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// glyph_rasterizer.cpp
+// implementation of the GlyphRasterizer class
+
+#include "glyph_rasterizer.h"
+
+#include <algorithm>
+
+#include "assert.h"
+#include "exception.h"
+#include "tchar.h"
+
+namespace console {
+  namespace {
+    // Pixels the printable ASCII glyphs of the font selected into dc reach
+    //   past either side of their cell, at most a cell's width. Fonts
+    //   without ABC widths, such as raster fonts, don't overhang.
+    int find_overhang(HDC dc, int cell_width) {
+      ABC abc[0x7f - 0x20];
+      if (!GetCharABCWidths(dc, 0x20, 0x7e, abc)) return 0;
+      int overhang = 0;
+      for (int i = 0; i < 0x7f - 0x20; ++i) {
+        overhang = std::max(overhang, -abc[i].abcA);
+        overhang = std::max(overhang, -abc[i].abcC);
+      }
+      return std::min(overhang, cell_width);
+    }
+  }
+
+  GlyphRasterizer::GlyphRasterizer()
+    : dc_(0),
+      font_(0),
+      bitmap_(0),
+      bits_(0),
+      old_font_(0),
+      old_bitmap_(0),
+      glyph_dim_(0, 0),
+      overhang_(0)
+  {}
+
+  GlyphRasterizer::~GlyphRasterizer() {
+    release();
+  }
+
+  void GlyphRasterizer::release(void) {
+    if (dc_) {
+      if (old_font_) SelectObject(dc_, old_font_);
+      if (old_bitmap_) SelectObject(dc_, old_bitmap_);
+      DeleteDC(dc_);
+      dc_ = 0;
+      old_font_ = 0;
+      old_bitmap_ = 0;
+    }
+    if (font_) {
+      DeleteObject(font_);
+      font_ = 0;
+    }
+    if (bitmap_) {
+      DeleteObject(bitmap_);
+      bitmap_ = 0;
+      bits_ = 0;
+    }
+  }
+
+  void GlyphRasterizer::set_font(const LOGFONT & lf, Dimension char_dim, bool with_overhang) {
+    release();
+    dc_ = CreateCompatibleDC(NULL);
+    if (!dc_) WIN_EXCEPT("Failed call to CreateCompatibleDC(). ");
+    // With ClearType each channel would get its own coverage, and glyphs
+    //   are stored with just one.
+    LOGFONT glyph_lf = lf;
+    glyph_lf.lfQuality = ANTIALIASED_QUALITY;
+    font_ = CreateFontIndirect(&glyph_lf);
+    if (!font_) WIN_EXCEPT("Failed call to CreateFontIndirect(). ");
+    old_font_ = SelectObject(dc_, font_);
+    overhang_ = with_overhang ? find_overhang(dc_, char_dim.width) : 0;
+    glyph_dim_ = Dimension(char_dim.width + 2 * overhang_, char_dim.height);
+    coverage_.resize(glyph_dim_.width * glyph_dim_.height);
+
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = glyph_dim_.width;
+    bmi.bmiHeader.biHeight = -glyph_dim_.height;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    void * bits = 0;
+    bitmap_ = CreateDIBSection(dc_, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+    if (!bitmap_) WIN_EXCEPT("Failed call to CreateDIBSection(). ");
+    bits_ = static_cast<DWORD *>(bits);
+
+    old_bitmap_ = SelectObject(dc_, bitmap_);
+    SetTextColor(dc_, RGB(255, 255, 255));
+    SetBkColor(dc_, RGB(0, 0, 0));
+    SetBkMode(dc_, OPAQUE);
+    SetTextAlign(dc_, TA_TOP | TA_LEFT | TA_NOUPDATECP);
+  }
+
+  Dimension GlyphRasterizer::glyph_dim(void) const {
+    return glyph_dim_;
+  }
+
+  int GlyphRasterizer::overhang(void) const {
+    return overhang_;
+  }
+
+  bool GlyphRasterizer::draws(CellChar c, bool extended_chars) {
+    // for ANSI builds the cast keeps only the AsciiChar byte
+    TCHAR ch = static_cast<TCHAR>(c);
+    return (ch != 0) && (extended_chars || (_istprint(ch) && !_istspace(ch)));
+  }
+
+  const std::uint8_t * GlyphRasterizer::rasterize(CellChar c) {
+    ASSERT(dc_ != 0);
+    TCHAR ch = static_cast<TCHAR>(c);
+    RECT glyph_rect = { 0, 0, glyph_dim_.width, glyph_dim_.height };
+    if (!ExtTextOut(dc_, overhang_, 0, ETO_OPAQUE, &glyph_rect, &ch, 1, NULL)) WIN_EXCEPT("Failed call to ExtTextOut(). ");
+    GdiFlush();
+
+    // White text on black with grayscale antialiasing, so the channels
+    //   should agree; the brightest is used in case the font ignored the
+    //   requested quality.
+    for (size_t i = 0; i < coverage_.size(); ++i) {
+      DWORD p = bits_[i];
+      coverage_[i] = static_cast<std::uint8_t>(std::max(std::max(p & 0xff, (p >> 8) & 0xff), (p >> 16) & 0xff));
+    }
+    return &coverage_[0];
+  }
+}
\ No newline at end of file
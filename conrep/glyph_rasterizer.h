@@ -0,0 +1,73 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Renders single glyphs with GDI into coverage masks, for GlyphCache to
+//   copy into its texture and for the software renderer to draw directly.
+
+#ifndef CONREP_GLYPH_RASTERIZER_H
+#define CONREP_GLYPH_RASTERIZER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "cell_planes.h"
+#include "dimension.h"
+#include "windows.h"
+
+namespace console {
+  class GlyphRasterizer {
+    public:
+      GlyphRasterizer();
+      ~GlyphRasterizer();
+
+      // Switches to the given font. If with_overhang is set, glyphs are
+      //   overhang() pixels wider than a cell on each side, for glyphs that
+      //   reach past their cell, and start that far into the mask; otherwise
+      //   they are clipped to the cell.
+      void set_font(const LOGFONT & lf, Dimension char_dim, bool with_overhang);
+      void release(void);
+
+      Dimension glyph_dim(void) const;
+      int overhang(void) const;
+
+      // Whether c is drawn at all. Null characters are left blank, and so
+      //   are spaces and unprintable characters unless extended characters
+      //   are shown.
+      static bool draws(CellChar c, bool extended_chars);
+      // Returns glyph_dim().width * glyph_dim().height bytes of coverage for
+      //   c, valid until the next call.
+      const std::uint8_t * rasterize(CellChar c);
+    private:
+      // the bitmap is a single glyph sized 32-bit top down DIB
+      HDC dc_;
+      HFONT font_;
+      HBITMAP bitmap_;
+      DWORD * bits_;
+      HGDIOBJ old_font_;
+      HGDIOBJ old_bitmap_;
+
+      Dimension glyph_dim_;
+      int overhang_;
+      std::vector<std::uint8_t> coverage_;
+
+      GlyphRasterizer(const GlyphRasterizer &);
+      GlyphRasterizer & operator=(const GlyphRasterizer &);
+  };
+}
+
+#endif
\ No newline at end of file
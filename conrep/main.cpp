@@ -30,12 +30,14 @@
 
 #include "assert.h"
 #include "atl.h"
+#include "capture_agent.h"
 #include "except_handle.h"
 #include "exception.h"
 #include "file_util.h"
 #include "gdiplus.h"
 #include "root_window.h"
 #include "settings.h"
+#include "shell_process.h"
 
 using namespace ATL;
 using namespace Gdiplus;
@@ -265,6 +267,12 @@ int do_winmain1(HINSTANCE hInstance,
   if (opt.help) {
     return try_print_help();
   }
+  // Agents are started by the main process and must not go through the
+  //   single instance handshake below.
+  if (!opt.capture_agent.empty()) {
+    execute_filter = false;
+    return run_capture_agent(opt.capture_agent);
+  }
 
   // Use a mutex object to ensure only one instance of the application is active
   //   at a time; this allows different console windows to share resources like
@@ -311,6 +319,7 @@ int do_winmain1(HINSTANCE hInstance,
     return 0;
   }
 
+  ShellProcess::install_ctrl_handler();
   GDIPlusInit gdi_initializer;
   COMInit com_initializer;
   
@@ -26,8 +26,11 @@ namespace console {
     CRM_CONSOLE_CLOSE = WM_USER + 0,
     CRM_BACKGROUND_CHANGE,
     CRM_WORKAREA_CHANGE,
-    CRM_LOST_DEVICE,
-    CRM_ADJUST_WINDOW
+    CRM_ADJUST_WINDOW,
+    CRM_CONSOLE_CAPTURE,
+    CRM_WALLPAPER_DECODED,
+    CRM_FRAME_REQUEST, // a console window wants a frame at the next tick
+    CRM_FRAME_TICK
   };
 }
 
@@ -0,0 +1,54 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// poll_scheduler.cpp
+// implementation of the PollScheduler class
+
+#include "poll_scheduler.h"
+
+#include <algorithm>
+
+namespace console {
+  PollScheduler::PollScheduler(unsigned min_interval, unsigned max_interval, unsigned idle_grace)
+    : min_interval_(min_interval),
+      max_interval_(std::max(min_interval, max_interval)),
+      idle_grace_(idle_grace),
+      interval_(min_interval),
+      last_activity_(0)
+  {}
+
+  unsigned PollScheduler::polled(std::uint32_t now, bool changed) {
+    if (changed) {
+      last_activity_ = now;
+      interval_ = min_interval_;
+    } else if (static_cast<std::uint32_t>(now - last_activity_) >= idle_grace_) {
+      // unsigned subtraction so the clock wrapping around is harmless
+      interval_ = std::min(interval_ * 2, max_interval_);
+    }
+    return interval_;
+  }
+
+  void PollScheduler::input(std::uint32_t now) {
+    last_activity_ = now;
+    interval_ = min_interval_;
+  }
+
+  unsigned PollScheduler::interval(void) const {
+    return interval_;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Decides how often the console is polled: quickly while its contents keep
+//   changing, backing off exponentially once it has been idle for a while.
+//   Time is passed in by the caller, in milliseconds from any clock that
+//   wraps at 2^32, so the policy can be driven by a virtual clock.
+
+#ifndef CONREP_POLL_SCHEDULER_H
+#define CONREP_POLL_SCHEDULER_H
+
+#include <cstdint>
+
+namespace console {
+  class PollScheduler {
+    public:
+      // idle_grace is how long the console must go unchanged before the
+      //   interval starts to grow
+      PollScheduler(unsigned min_interval, unsigned max_interval, unsigned idle_grace);
+
+      // Records the result of a poll made at now and returns how long to
+      //   wait before the next one.
+      unsigned polled(std::uint32_t now, bool changed);
+      // Input was sent to the console, so output is likely to follow.
+      void input(std::uint32_t now);
+
+      unsigned interval(void) const;
+    private:
+      unsigned min_interval_;
+      unsigned max_interval_;
+      unsigned idle_grace_;
+      unsigned interval_;
+      std::uint32_t last_activity_;
+  };
+}
+
+#endif
\ No newline at end of file
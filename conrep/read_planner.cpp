@@ -0,0 +1,87 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// read_planner.cpp
+// implementation of the console read planner
+
+#include "read_planner.h"
+
+#include <algorithm>
+
+namespace console {
+  namespace {
+    bool range_less(const RowRange & lhs, const RowRange & rhs) {
+      return lhs.first < rhs.first;
+    }
+  }
+
+  int rows_per_read(int width, size_t cell_bytes, size_t max_bytes) {
+    size_t row_bytes = static_cast<size_t>(std::max(width, 1)) * cell_bytes;
+    if (!row_bytes || (max_bytes <= row_bytes)) return 1;
+    return static_cast<int>((max_bytes - 1) / row_bytes);
+  }
+
+  void plan_reads(Dimension dim, size_t cell_bytes, size_t max_bytes, std::vector<ReadBand> & plan) {
+    std::vector<RowRange> all(1);
+    all[0].first = 0;
+    all[0].last = dim.height;
+    plan_reads(dim, cell_bytes, max_bytes, all, plan);
+  }
+
+  void plan_reads(Dimension dim,
+                  size_t cell_bytes,
+                  size_t max_bytes,
+                  const std::vector<RowRange> & hint,
+                  std::vector<ReadBand> & plan) {
+    plan.clear();
+    if ((dim.width <= 0) || (dim.height <= 0)) return;
+
+    std::vector<RowRange> ranges;
+    ranges.reserve(hint.size());
+    for (size_t i = 0; i < hint.size(); ++i) {
+      RowRange r = { std::max(hint[i].first, 0), std::min(hint[i].last, dim.height) };
+      if (r.first < r.last) ranges.push_back(r);
+    }
+    std::sort(ranges.begin(), ranges.end(), &range_less);
+
+    // Each band starts at the first row not yet covered and takes in every
+    //   hinted row that fits, which for bands of at most a fixed height is
+    //   the fewest bands possible. A band stops at its last hinted row
+    //   rather than reading unhinted rows past it.
+    int rows = rows_per_read(dim.width, cell_bytes, max_bytes);
+    size_t i = 0;
+    int covered = 0; // rows before this are already in the plan
+    while (i < ranges.size()) {
+      int top = std::max(ranges[i].first, covered);
+      if (top >= ranges[i].last) {
+        ++i;
+        continue;
+      }
+      int limit = top + rows;
+      int bottom = top;
+      while ((i < ranges.size()) && (ranges[i].first < limit)) {
+        bottom = std::max(bottom, std::min(ranges[i].last, limit));
+        if (ranges[i].last > limit) break;
+        ++i;
+      }
+      ReadBand band = { top, bottom };
+      plan.push_back(band);
+      covered = bottom;
+    }
+  }
+}
\ No newline at end of file
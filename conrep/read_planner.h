@@ -0,0 +1,69 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Plans how the console's viewport is read with ReadConsoleOutput(). The
+//   console host passes each call's cells through a buffer of limited size,
+//   so a large viewport takes several calls, and every call is a round trip
+//   to another process, so there should be as few as possible. Pure
+//   functions without Windows types, so plans can be checked anywhere.
+
+#ifndef CONREP_READ_PLANNER_H
+#define CONREP_READ_PLANNER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "dimension.h"
+
+namespace console {
+  // ReadConsoleOutput() fails for reads of this many bytes or more
+  const size_t CONSOLE_READ_LIMIT = 64 * 1024;
+
+  // rows [first, last) of the viewport
+  struct RowRange {
+    int first;
+    int last;
+  };
+
+  // Rows [top, bottom) of the viewport, read with one call. Reads always
+  //   cover whole rows, since no console is wide enough for a row to go
+  //   over the limit by itself.
+  struct ReadBand {
+    int top;
+    int bottom;
+  };
+
+  // How many whole rows of width cells of cell_bytes each fit in one read of
+  //   less than max_bytes; at least one.
+  int rows_per_read(int width, size_t cell_bytes, size_t max_bytes);
+
+  // Fills plan with the fewest bands that read every row of a viewport of
+  //   dim.
+  void plan_reads(Dimension dim, size_t cell_bytes, size_t max_bytes, std::vector<ReadBand> & plan);
+  // Fills plan with the fewest bands that read every row in hint, such as
+  //   the rows around the cursor or the rows that changed recently. hint
+  //   may be in any order, overlap and go past the viewport. Rows between
+  //   hinted rows are read as well when that saves a call.
+  void plan_reads(Dimension dim,
+                  size_t cell_bytes,
+                  size_t max_bytes,
+                  const std::vector<RowRange> & hint,
+                  std::vector<ReadBand> & plan);
+}
+
+#endif
\ No newline at end of file
@@ -23,14 +23,18 @@
 #include "windows.h"
 
 #include <map>
+#include <memory>
 #include <sstream>
 
 #include "assert.h"
+#include "color_table.h"
 #include "console_window.h"
 #include "d3root.h"
+#include "device_recovery.h"
 #include "except_handle.h"
 #include "exception.h"
 #include "file_util.h"
+#include "frame_scheduler.h"
 #include "message.h"
 #include "program_options.h"
 #include "reg.h"
@@ -40,6 +44,38 @@
 #include "window.h"
 
 namespace console {
+  namespace {
+    // the shared device as the frame scheduler sees it
+    class RootSceneDevice : public ISceneDevice {
+      public:
+        RootSceneDevice(IDirect3DRoot & root) : root_(root), sprite_(root.sprite()) {}
+
+        void begin_scene(void) {
+          root_.begin_scene();
+        }
+        void end_scene(void) {
+          root_.end_scene();
+        }
+        void flush(void) {
+          HRESULT hr = sprite_->Flush();
+          if (FAILED(hr)) DX_EXCEPT("Failed call to ID3DXSprite::Flush(). ", hr);
+        }
+      private:
+        IDirect3DRoot & root_;
+        SpritePtr sprite_;
+
+        RootSceneDevice(const RootSceneDevice &);
+        RootSceneDevice & operator=(const RootSceneDevice &);
+    };
+
+    // windows drawn in software have no scenes and nothing batched
+    class SoftwareSceneDevice : public ISceneDevice {
+      public:
+        void begin_scene(void) {}
+        void end_scene(void) {}
+        void flush(void) {}
+    };
+  }
 
   class RootWindow : public IRootWindow, public Window<RootWindow> {
     public:
@@ -53,29 +89,43 @@ namespace console {
     private:
       typedef std::map<HWND, WindowPtr> WindowMap;
 
-      RootPtr         root_;
+      RootPtr         root_;        // empty if the windows are drawn in software
+      std::unique_ptr<ColorTable> color_table_; // the software windows' colors,
+                                                //   which root_ has otherwise
       WindowMap       window_map_;
+      FrameScheduler  scheduler_;   // steps the windows in window_map_
+      DeviceRecovery  recovery_;    //   and restores them
       HINSTANCE       hInstance_;
       WallpaperInfo   wallpaper_info_;
       FILETIME        wallpaper_write_time_;
 
       void on_close_msg(HWND window);
       void on_lost_device(void) {
-        if (root_->is_device_lost()) {
-          for (WindowMap::iterator itr = window_map_.begin(); itr != window_map_.end(); ++itr) {
-            itr->second->dispose_resources();
-          }
-          HRESULT hr = root_->try_recover();
-          if (hr == D3DERR_DEVICENOTRESET) {
-            // restore surfaces
-            for (WindowMap::iterator itr = window_map_.begin(); itr != window_map_.end(); ++itr) {
-              itr->second->restore_resources();
-            }
-          } else if (hr == D3DERR_DEVICELOST) {
-            // something still has the device; do nothing
-          } else if (FAILED(hr)) {
-            DX_EXCEPT("Failure to recover device. ", hr);
-          }
+        if (!root_->is_device_lost() || !recovery_.poll(*root_)) return;
+        RecoveryTimings timings = recovery_.timings();
+        tostringstream sstr;
+        sstr << _T("conrep: device recovered after ") << timings.lost_ms
+             << _T(" ms lost; reset ") << timings.reset_ms
+             << _T(" ms, restore ") << timings.restore_ms << _T(" ms\n");
+        OutputDebugString(sstr.str().c_str());
+      }
+      // Every console window is drawn from this one tick, driven by
+      //   TIMER_REPAINT for the cursor blink and by CRM_FRAME_REQUEST when a
+      //   window has something new to show.
+      void on_tick(void) {
+        if (!root_) {
+          SoftwareSceneDevice device;
+          scheduler_.tick(device);
+          return;
+        }
+        // while the device stays lost the windows prepare nothing
+        on_lost_device();
+        RootSceneDevice device(*root_);
+        scheduler_.tick(device);
+      }
+      void on_frame_request(void) {
+        if (scheduler_.request()) {
+          if (!PostMessage(get_hwnd(), CRM_FRAME_TICK, 0, 0)) WIN_EXCEPT("Failed call to PostMessage(). ");
         }
       }
       void broadcast_message(AppMessage message,  WPARAM wParam = 0, LPARAM lParam = 0) {
@@ -87,38 +137,34 @@ namespace console {
       }
         
       void on_settingchange(void) {
-        if (root_) {
-          if (!root_->is_device_lost()) {
-            // check if wallpaper changed; no point in doing so if the device is lost
-            //   as when the device is restored the wallpaper needs to be reloaded
-            //   from scratch anyways.
-            WallpaperInfo current_wallpaper_info = get_wallpaper_info();
-            if (wallpaper_info_ != current_wallpaper_info) {
-              // different wallpaper name
-              wallpaper_info_ = current_wallpaper_info;
-              if (!wallpaper_info_.wallpaper_name.empty()) {
-                wallpaper_write_time_ = get_modify_time(current_wallpaper_info.wallpaper_name);
-              }
-              root_->reset_background();
-              broadcast_message(CRM_BACKGROUND_CHANGE);
-            } else {
-              // same wallpaper name; check to see if the modify time has
-              //   changed
-              if (!wallpaper_info_.wallpaper_name.empty()) {
-                FILETIME ft = get_modify_time(current_wallpaper_info.wallpaper_name);
-                if (CompareFileTime(&ft, &wallpaper_write_time_)) {
-                  wallpaper_write_time_ = ft;
-                  root_->reset_background();
-                  broadcast_message(CRM_BACKGROUND_CHANGE);
-                }
+        if (root_ && !root_->is_device_lost()) {
+          // check if wallpaper changed; no point in doing so if the device is lost
+          //   as when the device is restored the wallpaper needs to be reloaded
+          //   from scratch anyways.
+          WallpaperInfo current_wallpaper_info = get_wallpaper_info();
+          if (wallpaper_info_ != current_wallpaper_info) {
+            // different wallpaper name
+            wallpaper_info_ = current_wallpaper_info;
+            if (!wallpaper_info_.wallpaper_name.empty()) {
+              wallpaper_write_time_ = get_modify_time(current_wallpaper_info.wallpaper_name);
+            }
+            if (root_->reset_background()) broadcast_message(CRM_BACKGROUND_CHANGE);
+          } else {
+            // same wallpaper name; check to see if the modify time has
+            //   changed
+            if (!wallpaper_info_.wallpaper_name.empty()) {
+              FILETIME ft = get_modify_time(current_wallpaper_info.wallpaper_name);
+              if (CompareFileTime(&ft, &wallpaper_write_time_)) {
+                wallpaper_write_time_ = ft;
+                if (root_->reset_background()) broadcast_message(CRM_BACKGROUND_CHANGE);
               }
             }
           }
-          // unconditionally send a workarea change message. this can be modified
-          //   to conditionally send if the workarea actually changes but the cost
-          //   of the check is about as expensive as the actual message processing
-          broadcast_message(CRM_WORKAREA_CHANGE);
         }
+        // unconditionally send a workarea change message. this can be modified
+        //   to conditionally send if the workarea actually changes but the cost
+        //   of the check is about as expensive as the actual message processing
+        broadcast_message(CRM_WORKAREA_CHANGE);
       }
 
       LRESULT actual_wnd_proc(UINT Msg, WPARAM wParam, LPARAM lParam);
@@ -139,9 +185,13 @@ namespace console {
       
     try {
       root_ = get_direct3d_root(get_hwnd());
-      ASSERT(root_ != nullptr);
+      if (!root_) {
+        OutputDebugString(_T("conrep: no Direct3D device; drawing in software\n"));
+        color_table_.reset(new ColorTable());
+      }
 
       if (!SetTimer(get_hwnd(), TIMER_POLL_REGISTRY, POLL_TIME, 0)) WIN_EXCEPT("Failed SetTimer() call. ");
+      if (!SetTimer(get_hwnd(), TIMER_REPAINT, REPAINT_TIME, 0)) WIN_EXCEPT("Failed SetTimer() call. ");
     } catch (...) {
       // if this fails reset the WndProc to DefWindowProc() as the object
       //   invariants won't hold during subsequent window messages that come
@@ -167,11 +217,12 @@ namespace console {
   bool RootWindow::spawn_window(const Settings & settings) {
     if (!settings.run_app) return false;
 
-    ASSERT(root_ != nullptr);
-      
-    WindowPtr window(create_console_window(get_hwnd(), hInstance_, settings, root_, get_exe_dir(), get_message()));
+    WindowPtr window(root_ ? create_console_window(get_hwnd(), hInstance_, settings, root_, get_exe_dir(), get_message())
+                           : create_software_console_window(get_hwnd(), hInstance_, settings, *color_table_, get_exe_dir(), get_message()));
     ASSERT(window_map_.find(window->get_hwnd()) == window_map_.end());
     window_map_[window->get_hwnd()] = window;
+    scheduler_.add(window.get());
+    recovery_.add(window.get());
 
     return true;
   }
@@ -184,6 +235,8 @@ namespace console {
     WindowMap::iterator itr = window_map_.find(window);
     ASSERT(itr != window_map_.end());
     ASSERT(itr->second->get_state() == DEAD);
+    scheduler_.remove(itr->second.get());
+    recovery_.remove(itr->second.get());
     window_map_.erase(itr);
     if (window_map_.empty()) {
       if (!PostMessage(get_hwnd(), WM_CLOSE, 0, 0)) WIN_EXCEPT("Failed call to PostMessage(). ");
@@ -195,8 +248,14 @@ namespace console {
       case CRM_CONSOLE_CLOSE:
         on_close_msg(reinterpret_cast<HWND>(lParam));
         break;
-      case CRM_LOST_DEVICE:
-        on_lost_device();
+      case CRM_FRAME_REQUEST:
+        on_frame_request();
+        break;
+      case CRM_FRAME_TICK:
+        on_tick();
+        break;
+      case CRM_WALLPAPER_DECODED:
+        if (root_ && root_->install_wallpaper()) broadcast_message(CRM_BACKGROUND_CHANGE);
         break;
       case WM_COPYDATA:
         { COPYDATASTRUCT * cbs = reinterpret_cast<COPYDATASTRUCT *>(lParam);
@@ -217,8 +276,23 @@ namespace console {
         }
         break;
       case WM_TIMER:
-        root_->get_color_table().poll_registry_change();
-        if (!SetTimer(get_hwnd(), TIMER_POLL_REGISTRY, POLL_TIME, 0)) WIN_EXCEPT("Failed SetTimer() call. ");
+        if (wParam == TIMER_REPAINT) {
+          on_tick();
+        } else {
+          if (root_) {
+            root_->get_color_table().poll_registry_change();
+            root_->trim_backgrounds();
+            root_->trim_targets();
+          } else {
+            color_table_->poll_registry_change();
+          }
+          if (!root_ || !root_->is_device_lost()) {
+            for (WindowMap::iterator itr = window_map_.begin(); itr != window_map_.end(); ++itr) {
+              itr->second->update_shadows();
+            }
+          }
+          if (!SetTimer(get_hwnd(), TIMER_POLL_REGISTRY, POLL_TIME, 0)) WIN_EXCEPT("Failed SetTimer() call. ");
+        }
         break;
       case WM_DESTROY:
         PostQuitMessage(0);
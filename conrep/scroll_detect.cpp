@@ -0,0 +1,87 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// scroll_detect.cpp
+// implementation of row hashing and the ScrollDetector class
+
+#include "scroll_detect.h"
+
+#include <algorithm>
+
+namespace console {
+  RowHash hash_row(const Cell * row, int width, Cell mask) {
+    // FNV-1a applied a cell at a time followed by a final mix so that rows
+    //   differing only in the last cell still spread across all bits
+    RowHash h = 2166136261u;
+    for (int i = 0; i < width; ++i) {
+      h = (h ^ (row[i] & mask)) * 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return h;
+  }
+
+  void hash_rows(const Cell * cells, Dimension dim, Cell mask, std::vector<RowHash> & hashes) {
+    hashes.resize(dim.height);
+    for (int i = 0; i < dim.height; ++i) {
+      hashes[i] = hash_row(cells + i * dim.width, dim.width, mask);
+    }
+  }
+
+  ScrollDetector::ScrollDetector() {}
+
+  int ScrollDetector::detect(const std::vector<RowHash> & previous, const std::vector<RowHash> & current) {
+    int height = static_cast<int>(std::min(previous.size(), current.size()));
+    if (height < 2) return 0;
+
+    sorted_.clear();
+    for (int i = 0; i < height; ++i) {
+      sorted_.push_back(std::make_pair(previous[i], i));
+    }
+    std::sort(sorted_.begin(), sorted_.end());
+
+    // votes_[s + height - 1] counts rows that match with shift s
+    votes_.assign(2 * height - 1, 0);
+    for (int i = 0; i < height; ++i) {
+      typedef std::vector<std::pair<RowHash, int> >::const_iterator Itr;
+      std::pair<Itr, Itr> range = std::equal_range(sorted_.begin(),
+                                                   sorted_.end(),
+                                                   std::make_pair(current[i], 0),
+                                                   [](const std::pair<RowHash, int> & lhs,
+                                                      const std::pair<RowHash, int> & rhs) {
+                                                     return lhs.first < rhs.first;
+                                                   });
+      // Rows that appear more than once, most commonly blank lines, don't say
+      //   anything about which way the text moved.
+      if (range.second - range.first != 1) continue;
+      int shift = range.first->second - i;
+      ++votes_[shift + height - 1];
+    }
+
+    int best_shift = 0;
+    int best_votes = votes_[height - 1];
+    for (int s = -(height - 1); s < height; ++s) {
+      if (votes_[s + height - 1] > best_votes) {
+        best_votes = votes_[s + height - 1];
+        best_shift = s;
+      }
+    }
+    return best_shift;
+  }
+}
\ No newline at end of file
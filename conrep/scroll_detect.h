@@ -0,0 +1,57 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Detection of vertical scrolling between two console snapshots by matching
+//   per row hashes.
+
+#ifndef CONREP_SCROLL_DETECT_H
+#define CONREP_SCROLL_DETECT_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "damage_set.h"
+
+namespace console {
+  typedef std::uint32_t RowHash;
+
+  RowHash hash_row(const Cell * row, int width, Cell mask);
+  // hashes is resized to dim.height
+  void hash_rows(const Cell * cells, Dimension dim, Cell mask, std::vector<RowHash> & hashes);
+
+  class ScrollDetector {
+    public:
+      ScrollDetector();
+
+      // Returns the shift s that best explains current in terms of previous,
+      //   with current row i matching previous row i + s; positive values
+      //   mean the contents moved up. Returns 0 if no shift was found. Since
+      //   only hashes are compared the caller must verify the result.
+      int detect(const std::vector<RowHash> & previous, const std::vector<RowHash> & current);
+    private:
+      // work buffers kept as members to avoid reallocating on every frame
+      std::vector<std::pair<RowHash, int> > sorted_;
+      std::vector<int> votes_;
+
+      ScrollDetector(const ScrollDetector &);
+      ScrollDetector & operator=(const ScrollDetector &);
+  };
+}
+
+#endif
\ No newline at end of file
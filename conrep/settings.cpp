@@ -124,6 +124,11 @@ namespace console {
       ( "inactive_post_alpha", 
         tvalue(s ? &(s->inactive_post_alpha) : nullptr)->default_value(0x50), 
         "* post-multiply alpha for inactive window" )
+      ( "sweep_time", 
+        tvalue(s ? &(s->sweep_time) : nullptr)->default_value(250), 
+        "milliseconds between reads of the whole console; polls in between only read "
+        "the rows around the cursor and rows that changed recently. 0 reads the whole "
+        "console on every poll" )
     ;
     opt.add(both_desc);
   }
@@ -138,6 +143,17 @@ namespace console {
     opt.add(hidden_desc);
   }
 
+  // only ever passed by conrep itself when starting a capture agent
+  void add_agent_options(options_description & opt, tstring * channel_name) {
+    options_description agent_desc;
+    agent_desc.add_options()
+      ( "capture_agent",
+        tvalue(channel_name)->DEFAULT_VALUE(""),
+        "capture the console of a shell for the main process" )
+    ;
+    opt.add(agent_desc);
+  }
+
   void print_help(void) {
     options_description cmd_line_desc;
     add_cmd_line_options(cmd_line_desc, nullptr);
@@ -153,6 +169,7 @@ namespace console {
     const std::vector<tstring> args = split_winmain(command_line);
     options_description cmd_line_desc;
     add_cmd_line_options(cmd_line_desc, nullptr);
+    add_agent_options(cmd_line_desc, &capture_agent);
 
     variables_map vm;
     store(basic_command_line_parser<TCHAR>(args).options(cmd_line_desc).allow_unregistered().run(), vm);
@@ -223,6 +240,7 @@ namespace console {
                                                           std::numeric_limits<unsigned char>::max());
 
     if (settings.snap_distance < 0) settings.snap_distance = 0;
+    if (settings.sweep_time < 0) settings.sweep_time = 0;
   }
 
   Settings::Settings(LPCTSTR command_line)
@@ -38,6 +38,7 @@ namespace console {
 
     bool help;
     bool adjust;
+    tstring capture_agent; // channel name when started as a capture agent
   };
 
   struct Settings {
@@ -70,6 +71,8 @@ namespace console {
     unsigned int inactive_pre_alpha;
     unsigned int inactive_post_alpha;
 
+    int sweep_time; // milliseconds
+
     bool scl_cfgfile;
 
     bool scl_font_name;
@@ -0,0 +1,87 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// shadow_store.cpp
+// implementation of the ShadowStore class
+
+#include "shadow_store.h"
+
+#include <cstring>
+
+namespace console {
+  void copy_shadow(const Pixel * pixels, int stride, Dimension dim, ShadowImage & image) {
+    image.dim = dim;
+    image.pixels.resize(static_cast<size_t>(dim.width) * dim.height);
+    for (int y = 0; y < dim.height; ++y) {
+      std::memcpy(&image.pixels[static_cast<size_t>(y) * dim.width],
+                  pixels + static_cast<size_t>(y) * stride,
+                  dim.width * sizeof(Pixel));
+    }
+  }
+
+  ShadowStore::ShadowStore(std::uint64_t max_bytes)
+    : max_bytes_(max_bytes),
+      bytes_(0),
+      next_serial_(0)
+  {}
+
+  std::uint64_t ShadowStore::image_bytes(const ShadowImage & image) {
+    return static_cast<std::uint64_t>(image.pixels.size()) * sizeof(Pixel);
+  }
+
+  void ShadowStore::store(std::uintptr_t key, ShadowImage & image) {
+    erase(key);
+    Entry & entry = entries_[key];
+    entry.image.dim = image.dim;
+    entry.image.pixels.swap(image.pixels);
+    entry.serial = next_serial_++;
+    bytes_ += image_bytes(entry.image);
+
+    // the copy just stored is kept even if it is over the limit by itself
+    while ((bytes_ > max_bytes_) && (entries_.size() > 1)) {
+      EntryMap::iterator oldest = entries_.begin();
+      for (EntryMap::iterator itr = entries_.begin(); itr != entries_.end(); ++itr) {
+        if (itr->second.serial < oldest->second.serial) oldest = itr;
+      }
+      bytes_ -= image_bytes(oldest->second.image);
+      entries_.erase(oldest);
+    }
+  }
+
+  const ShadowImage * ShadowStore::find(std::uintptr_t key) const {
+    EntryMap::const_iterator itr = entries_.find(key);
+    if (itr == entries_.end()) return 0;
+    return &itr->second.image;
+  }
+
+  void ShadowStore::erase(std::uintptr_t key) {
+    EntryMap::iterator itr = entries_.find(key);
+    if (itr == entries_.end()) return;
+    bytes_ -= image_bytes(itr->second.image);
+    entries_.erase(itr);
+  }
+
+  void ShadowStore::clear(void) {
+    entries_.clear();
+    bytes_ = 0;
+  }
+
+  std::uint64_t ShadowStore::bytes(void) const {
+    return bytes_;
+  }
+}
\ No newline at end of file
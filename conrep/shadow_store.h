@@ -0,0 +1,78 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// System memory copies of render targets. Render targets lose their
+//   contents along with the device, and restoring one from its copy is a
+//   plain upload where rebuilding it can mean decoding the wallpaper again.
+
+#ifndef CONREP_SHADOW_STORE_H
+#define CONREP_SHADOW_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "dimension.h"
+#include "framebuffer.h"
+
+namespace console {
+  struct ShadowImage {
+    Dimension dim;
+    std::vector<Pixel> pixels; // dim.width pixels per row
+  };
+
+  // Copies the top left dim of an image with stride pixels per row into
+  //   image, such as from a locked surface.
+  void copy_shadow(const Pixel * pixels, int stride, Dimension dim, ShadowImage & image);
+
+  // Shadow copies by key, such as a monitor handle. Once the copies take up
+  //   more than the limit the oldest are dropped; that target is then
+  //   rebuilt the slow way.
+  class ShadowStore {
+    public:
+      explicit ShadowStore(std::uint64_t max_bytes);
+
+      // takes the pixels out of image rather than copying them
+      void store(std::uintptr_t key, ShadowImage & image);
+      // 0 if there is no copy for key
+      const ShadowImage * find(std::uintptr_t key) const;
+      void erase(std::uintptr_t key);
+      void clear(void);
+
+      std::uint64_t bytes(void) const; // for debugging
+    private:
+      struct Entry {
+        ShadowImage image;
+        std::uint64_t serial; // order stored in
+      };
+      typedef std::map<std::uintptr_t, Entry> EntryMap;
+
+      std::uint64_t max_bytes_;
+      std::uint64_t bytes_;
+      std::uint64_t next_serial_;
+      EntryMap entries_;
+
+      static std::uint64_t image_bytes(const ShadowImage & image);
+
+      ShadowStore(const ShadowStore &);
+      ShadowStore & operator=(const ShadowStore &);
+  };
+}
+
+#endif
\ No newline at end of file
@@ -21,38 +21,175 @@
 
 #include "shell_process.h"
 
+#include <exception>
 #include <functional>
+#include <sstream>
 
 #include "assert.h"
 #include "atl.h"
+#include "capture_agent.h"
+#include "capture_policy.h"
 #include "char_info_buffer.h"
+#include "console_capture.h"
 #include "dimension.h"
 #include "dimension_ops.h"
 #include "exception.h"
+#include "read_planner.h"
 #include "settings.h"
 
 using namespace ATL;
 
 namespace console {
-  int ShellProcess::attach_count_ = 0;
+  namespace {
+    // reads the rows of the viewport described by csbi that are in plan
+    void read_bands(HANDLE output, const CONSOLE_SCREEN_BUFFER_INFO & csbi, const std::vector<ReadBand> & plan, CHAR_INFO * buffer) {
+      int width = csbi.srWindow.Right - csbi.srWindow.Left + 1;
+      COORD origin = {};
+      for (size_t i = 0; i < plan.size(); ++i) {
+        const ReadBand & band = plan[i];
+        COORD band_size = { static_cast<SHORT>(width), static_cast<SHORT>(band.bottom - band.top) };
+        SMALL_RECT sr = { csbi.srWindow.Left,
+                          static_cast<SHORT>(csbi.srWindow.Top + band.top),
+                          csbi.srWindow.Right,
+                          static_cast<SHORT>(csbi.srWindow.Top + band.bottom - 1) };
+        if (!ReadConsoleOutput(output, buffer + band.top * width, band_size, origin, &sr))
+          WIN_EXCEPT("Failed call to ReadConsoleOutput(). ");
+      }
+    }
+
+    // reads the visible part of the screen buffer described by csbi
+    void read_output(HANDLE output, const CONSOLE_SCREEN_BUFFER_INFO & csbi, CHAR_INFO * buffer) {
+      Dimension size(csbi.srWindow.Right - csbi.srWindow.Left + 1, csbi.srWindow.Bottom - csbi.srWindow.Top + 1);
+      // ReadConsoleOutput() can only read 64K at a time, so large consoles
+      //   are read in bands of as many rows as fit
+      std::vector<ReadBand> plan;
+      plan_reads(size, sizeof(CHAR_INFO), CONSOLE_READ_LIMIT, plan);
+      read_bands(output, csbi, plan, buffer);
+    }
+
+    // everything in a snapshot but the screen buffer contents
+    void capture_state(HWND console_window, const CONSOLE_SCREEN_BUFFER_INFO & csbi, ConsoleSnapshot & snapshot) {
+      snapshot.cursor_pos.X = csbi.dwCursorPosition.X;
+      snapshot.cursor_pos.Y = csbi.dwCursorPosition.Y - csbi.srWindow.Top;
+
+      const int BUFFER_SIZE = 0x800;
+      TCHAR console_title[BUFFER_SIZE] = {};
+      if (!GetConsoleTitle(console_title, BUFFER_SIZE)) WIN_EXCEPT("Failed call to GetConsoleTitle(). ");
+      snapshot.title = console_title;
+
+      SCROLLINFO si = { sizeof(SCROLLINFO), SIF_ALL };
+      if (!GetScrollInfo(console_window, SB_VERT, &si)) WIN_EXCEPT("Failed call to GetScrollInfo(). ");
+      snapshot.scroll_info = si;
+    }
+  }
+
+  // Gathers everything the window polls the console for. Called on the
+  //   capture thread, or in a capture agent.
+  void capture_console(HANDLE output, HWND console_window, ConsoleSnapshot & snapshot) {
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    if (!GetConsoleScreenBufferInfo(output, &csbi)) WIN_EXCEPT("Failed call to GetConsoleScreenBufferInfo(). ");
+
+    snapshot.dim = Dimension(csbi.srWindow.Right - csbi.srWindow.Left + 1, csbi.srWindow.Bottom - csbi.srWindow.Top + 1);
+    snapshot.cells.resize(snapshot.dim.width * snapshot.dim.height);
+    read_output(output, csbi, &snapshot.cells[0]);
+    capture_state(console_window, csbi, snapshot);
+  }
+
+  void capture_console(HANDLE output, HWND console_window, CapturePolicy & policy, std::uint32_t now, ConsoleSnapshot & snapshot) {
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    if (!GetConsoleScreenBufferInfo(output, &csbi)) WIN_EXCEPT("Failed call to GetConsoleScreenBufferInfo(). ");
+
+    // A change of size makes the policy read everything, so the cells
+    //   shuffled by resizing the vector all get replaced.
+    Dimension dim(csbi.srWindow.Right - csbi.srWindow.Left + 1, csbi.srWindow.Bottom - csbi.srWindow.Top + 1);
+    snapshot.dim = dim;
+    snapshot.cells.resize(dim.width * dim.height);
+
+    std::vector<RowRange> hint;
+    std::vector<ReadBand> plan;
+    int cursor_row = csbi.dwCursorPosition.Y - csbi.srWindow.Top;
+    if (policy.plan(now, dim, csbi.srWindow.Top, cursor_row, hint)) {
+      plan_reads(dim, sizeof(CHAR_INFO), CONSOLE_READ_LIMIT, plan);
+    } else {
+      plan_reads(dim, sizeof(CHAR_INFO), CONSOLE_READ_LIMIT, hint, plan);
+    }
+    read_bands(output, csbi, plan, &snapshot.cells[0]);
+    policy.observe(now, reinterpret_cast<const Cell *>(&snapshot.cells[0]), plan);
+    capture_state(console_window, csbi, snapshot);
+  }
+
+  namespace {
+    class WinConsoleApi : public IConsoleApi {
+      public:
+        WinConsoleApi() {
+          QueryPerformanceFrequency(&frequency_);
+        }
+
+        AttachStatus attach_console(std::uint32_t process_id, std::uint32_t & error) {
+          if (AttachConsole(process_id)) return ATTACH_OK;
+          // I don't know why, but sometimes AttachConsole() can say the process has closed when it hasn't. So
+          //   ignore errors that say it has and check if the process has closed another way.
+          DWORD err = GetLastError();
+          //  5 is access is denied, can happen with a closed console window
+          // 31 is device not functioning, can occur if trying to attach to a freshly created console window
+          if (err == 31 || err == 5) return ATTACH_BUSY;
+          error = err;
+          return ATTACH_ERROR;
+        }
+
+        void free_console(void) {
+          FreeConsole();
+        }
+
+        bool process_exited(std::uintptr_t process) {
+          // a signalled process handle indicates process has closed
+          DWORD ret = WaitForSingleObject(reinterpret_cast<HANDLE>(process), 0);
+          if (ret == WAIT_FAILED) WIN_EXCEPT("Failed call to WaitForSingleObject(). ");
+          return ret == WAIT_OBJECT_0;
+        }
+
+        std::uint64_t now_us(void) {
+          LARGE_INTEGER counter;
+          QueryPerformanceCounter(&counter);
+          std::uint64_t ticks = counter.QuadPart;
+          std::uint64_t frequency = frequency_.QuadPart;
+          return (ticks / frequency) * 1000000 + (ticks % frequency) * 1000000 / frequency;
+        }
+      private:
+        LARGE_INTEGER frequency_;
+    };
+
+    WinConsoleApi console_api;
+  }
 
-  class Cleaner {
-    public:
-      typedef void (ShellProcess::*MemFn)(void);
+  ConsoleAttachment ShellProcess::attachment_(console_api);
+  std::recursive_mutex ShellProcess::attach_mutex_;
 
-      Cleaner(MemFn fn, ShellProcess * obj) : fn_(fn), obj_(obj) {}
-      ~Cleaner() { (obj_->*fn_)(); }
-    private:
-      MemFn fn_;
-      ShellProcess * obj_;
+  void ShellProcess::install_ctrl_handler(void) {
+    if (!SetConsoleCtrlHandler(&ctrl_handler, TRUE)) WIN_EXCEPT("Failed call to SetConsoleCtrlHandler(). ");
+  }
 
-      Cleaner(const Cleaner &);
-      Cleaner & operator=(const Cleaner &);
-  };
+  // While attached, Ctrl+C and Ctrl+Break typed into the console are sent
+  //   to this process as well. Unlike ignoring them outright, a handler
+  //   isn't inherited by the shells started afterwards. Closing the console
+  //   would end this process along with the shell, so the attachment is
+  //   dropped instead and the shell's window closes once it sees the shell
+  //   has exited.
+  BOOL WINAPI ShellProcess::ctrl_handler(DWORD ctrl_type) {
+    if ((ctrl_type == CTRL_C_EVENT) || (ctrl_type == CTRL_BREAK_EVENT)) return TRUE;
+    if (ctrl_type == CTRL_CLOSE_EVENT) {
+      // runs on its own thread; no acquires are outstanding once the lock is held
+      std::lock_guard<std::recursive_mutex> lock(attach_mutex_);
+      attachment_.detach();
+      return TRUE;
+    }
+    return FALSE;
+  }
 
   ShellProcess::ShellProcess(Settings & settings)
     : process_id_(0),
       window_handle_(0),
+      resize_generation_(0),
       #ifdef DEBUG
         console_visible_(true)
       #else
@@ -60,17 +197,27 @@ namespace console {
       #endif
   {
     ASSERT(!settings.shell.empty());
-    ASSERT(!attach_count_);
+    std::lock_guard<std::recursive_mutex> lock(attach_mutex_);
+    ASSERT(!attachment_.depth());
       
     // Allocate a new console window. This window will be eventually owned by the new
-    //   shell process.
+    //   shell process. AllocConsole() fails while attached to another console.
+    attachment_.detach();
     if (!AllocConsole()) WIN_EXCEPT("Failed call to AllocConsole(). ");
-    ++attach_count_;
-    {
-      Cleaner cl(&ShellProcess::detach, this);
+    try {
       create_shell_process(settings);
+    } catch (...) {
+      FreeConsole();
+      throw;
+    }
+    // stay attached, so the first poll of the new console doesn't attach again
+    attachment_.adopt(process_id_);
+
+    try {
+      capture_agent_.reset(new CaptureAgentHost(process_id_, static_cast<unsigned>(settings.sweep_time)));
+    } catch (std::exception &) {
+      // ConsoleCapture falls back to attaching on its own thread
     }
-    ASSERT(!attach_count_);
   }
     
   void ShellProcess::create_shell_process(Settings & settings) {
@@ -129,11 +276,26 @@ namespace console {
   }
 
   ShellProcess::~ShellProcess() {
+    {
+      // Closing the console while attached to it would close this process
+      //   along with it.
+      std::lock_guard<std::recursive_mutex> lock(attach_mutex_);
+      if (attachment_.attached_process() == process_id_) attachment_.detach();
+
+      const AttachmentCounts & counts = attachment_.counts();
+      tstringstream sstr;
+      sstr << _T("conrep: ") << counts.acquires << _T(" console acquires, ")
+           << counts.reuses << _T(" reused; ")
+           << counts.attaches << _T(" attaches in ") << counts.attach_us << _T(" us (")
+           << counts.retries << _T(" retries), ")
+           << counts.detaches << _T(" detaches in ") << counts.detach_us << _T(" us\n");
+      OutputDebugString(sstr.str().c_str());
+    }
     PostMessage(window_handle_, WM_CLOSE, 0, 0);
   }
 
   bool ShellProcess::attached(void) {
-    return attach_count_ != 0;
+    return attachment_.depth() != 0;
   }
         
   HWND ShellProcess::window_handle(void) const {
@@ -154,44 +316,52 @@ namespace console {
     console_visible_ = !console_visible_;
     // ShowWindow()'s return value doesn't contain error information so can be ignored
     if (console_visible_) {
+      {
+        std::lock_guard<std::recursive_mutex> lock(attach_mutex_);
+        if (attachment_.attached_process() == process_id_) attachment_.detach();
+      }
       ShowWindow(window_handle_, SW_SHOW);
     } else {
       ShowWindow(window_handle_, SW_HIDE);
     }
   }
 
+  unsigned ShellProcess::resize_generation(void) const {
+    return resize_generation_.load();
+  }
+
+  CaptureAgentHost * ShellProcess::capture_agent(void) const {
+    return capture_agent_.get();
+  }
+
+  AttachmentCounts ShellProcess::attachment_counts(void) {
+    std::lock_guard<std::recursive_mutex> lock(attach_mutex_);
+    return attachment_.counts();
+  }
+
   bool ShellProcess::attach(void) {
-    ++attach_count_;
-    if (attach_count_ == 1) {
-      while (!AttachConsole(process_id_)) {
-        // I don't know why, but sometimes AttachConsole() can say the process has closed when it hasn't. So
-        //   ignore errors that say it has and check if the process has closed another way.
-        DWORD err = GetLastError();
-		//  5 is access is denied, can happen with a closed console window
-		// 31 is device not functioning, can occur if trying to attach to a freshly created console window
-        if (err != 31 && err != 5) {
-          WIN_EXCEPT2("Failed call to AttachConsole(). ", err);
-        }
-        DWORD ret = WaitForSingleObject(process_handle_, 0);
-        if (ret == WAIT_OBJECT_0) {
-          // a signalled process handle indicates process has closed
-          return false;
-        } else if (ret == WAIT_FAILED) {
-          WIN_EXCEPT("Failed call to WaitForSingleObject(). ");
-        }
-      }
-    }
+    std::uint32_t err = 0;
+    AcquireResult result = attachment_.acquire(process_id_, reinterpret_cast<std::uintptr_t>(process_handle_.m_h), err);
+    if (result == ACQUIRE_EXITED) return false;
+    if (result == ACQUIRE_ERROR) WIN_EXCEPT2("Failed call to AttachConsole(). ", err);
+    if (result == ACQUIRE_CONFLICT) MISC_EXCEPT("Fatal Error: double console attachment.");
     HWND console_window = GetConsoleWindow();
-    if (!console_window) WIN_EXCEPT("Failed call to GetConsoleWindow(). ");
     ASSERT(console_window == window_handle_);
-    if (console_window != window_handle_) MISC_EXCEPT("Fatal Error: double console attachment.");
+    if (console_window != window_handle_) {
+      // ProcessLock won't release an attach that throws
+      attachment_.release();
+      if (!console_window) WIN_EXCEPT("Failed call to GetConsoleWindow(). ");
+      MISC_EXCEPT("Fatal Error: double console attachment.");
+    }
     return true;
   }
 
   void ShellProcess::detach(void) {
-    ASSERT(attach_count_);
-    --attach_count_;
-    if (!attach_count_) FreeConsole();
+    ASSERT(attachment_.depth());
+    attachment_.release();
+    // A visible console can be closed at any time, which would also close
+    //   every process attached to it, so its attachment isn't kept.
+    if (console_visible_ && !attachment_.depth()) attachment_.detach();
   }
         
     
@@ -220,6 +390,10 @@ namespace console {
       if (!SetConsoleWindowInfo(stdout_handle_, TRUE, &viewport)) WIN_EXCEPT("Failed call to SetConsoleWindowInfo(). ");
       if (!SetConsoleScreenBufferSize(stdout_handle_, buffer_size)) WIN_EXCEPT("Failed call to SetConsoleScreenBufferSize(). ");
     }
+    // Published only once the console has its new size, so a snapshot
+    //   stamped with the new generation can't have been read at the old one.
+    unsigned generation = ++resize_generation_;
+    if (capture_agent_) capture_agent_->set_resize_generation(generation);
 
     if (!GetConsoleScreenBufferInfo(stdout_handle_, &csbi)) WIN_EXCEPT("Failed call to GetConsoleScreenBufferInfo(). ");
     console_dim.width  = csbi.srWindow.Right - csbi.srWindow.Left + 1;
@@ -229,42 +403,31 @@ namespace console {
   }
     
   void ShellProcess::get_console_info(const Dimension & console_dim, CharInfoBuffer & buffer, COORD & cursor_pos) {
-    ASSERT(attach_count_);
+    ASSERT(attachment_.depth());
     
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     if (!GetConsoleScreenBufferInfo(stdout_handle_, &csbi)) WIN_EXCEPT("Failed call to GetConsoleScreenBufferInfo(). ");
 
     COORD size = { csbi.srWindow.Right - csbi.srWindow.Left + 1, csbi.srWindow.Bottom - csbi.srWindow.Top + 1 };
-    COORD origin = {};
-
-    size_t required_size = size.X * size.Y;
 
     Dimension size_dim = Dimension(size.X, size.Y);
     if (size_dim != console_dim) {
       buffer.resize(size_dim);
     }
       
-    // ReadConsoleOutput() can only read 64K at a time
-    if (required_size * sizeof(CHAR_INFO) < 64 * 1024) {
-      if (!ReadConsoleOutput(stdout_handle_, &buffer[0], size, origin, &csbi.srWindow))
-        WIN_EXCEPT("Failed call to ReadConsoleOutput(). ");
-    } else {
-      // read in one line at a time
-      COORD line_size = { size.X, 1 };
-      for (short i = 0; i < size.Y; i++) {
-        SMALL_RECT sr = { csbi.srWindow.Left,
-                          csbi.srWindow.Top + i,
-                          csbi.srWindow.Right,
-                          csbi.srWindow.Top + i };
-        if (!ReadConsoleOutput(stdout_handle_, &buffer[i * size.X], line_size, origin, &sr))
-          WIN_EXCEPT("Failed call to ReadConsoleOutput(). ");
-      }
-    }
+    read_output(stdout_handle_, csbi, &buffer[0]);
       
     cursor_pos.X = csbi.dwCursorPosition.X;
     cursor_pos.Y = csbi.dwCursorPosition.Y - csbi.srWindow.Top;
   }
 
+  // Only used when there is no capture agent.
+  void ShellProcess::capture(ConsoleSnapshot & snapshot) {
+    ASSERT(attachment_.depth());
+    snapshot.resize_generation = resize_generation_.load();
+    capture_console(stdout_handle_, window_handle_, snapshot);
+  }
+
   Dimension ShellProcess::get_console_size(void) {
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     if (!GetConsoleScreenBufferInfo(stdout_handle_, &csbi)) {
@@ -290,10 +453,11 @@ namespace console {
   
   ProcessLock::ProcessLock(ShellProcess & shell_process)
     : shell_process_(shell_process),
+      lock_(ShellProcess::attach_mutex_),
       attached_(shell_process.attach())
   {}
   ProcessLock::~ProcessLock() {
-    shell_process_.detach();
+    if (attached_) shell_process_.detach();
   }
 
   Dimension ProcessLock::resize(Dimension console_dim) {
@@ -305,6 +469,11 @@ namespace console {
     shell_process_.get_console_info(console_dim, buffer, cursor_pos);
   }
       
+  void ProcessLock::capture(ConsoleSnapshot & snapshot) {
+    ASSERT(attached_);
+    shell_process_.capture(snapshot);
+  }
+
   Dimension ProcessLock::get_console_size(void) {
     ASSERT(attached_);
     return shell_process_.get_console_size();
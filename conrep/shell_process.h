@@ -23,15 +23,31 @@
 
 #include "windows.h"
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include "atl.h"
+#include "console_attachment.h"
 #include "tchar.h"
 
 namespace console {
   struct Dimension;
   struct Settings;
   class CharInfoBuffer;
+  struct ConsoleSnapshot;
   class ProcessLock;
+  class CaptureAgentHost;
+  class CapturePolicy;
+
+  // Fills in snapshot, all but its resize generation, from the console this
+  //   process is attached to; output is its screen buffer and console_window
+  //   its window. Also used by capture agents.
+  void capture_console(HANDLE output, HWND console_window, ConsoleSnapshot & snapshot);
+  // As above, but only reads the rows policy picks for a poll at now; the
+  //   rest keep what snapshot held, so it has to be the same snapshot every
+  //   time.
+  void capture_console(HANDLE output, HWND console_window, CapturePolicy & policy, std::uint32_t now, ConsoleSnapshot & snapshot);
   
   // ProcessLock should be considered to be part of the public interface of 
   //   ShellProcess. Since there are function calls in the ShellProcess
@@ -44,6 +60,9 @@ namespace console {
       ShellProcess(Settings & settings);
       ~ShellProcess();
 
+      // Call once at startup, before any ShellProcess is created.
+      static void install_ctrl_handler(void);
+
       bool attached(void);
         
       HWND window_handle(void) const;
@@ -51,6 +70,17 @@ namespace console {
 
       bool is_console_visible(void) const;
       void toggle_console_visible(void);
+
+      // incremented every time the console is successfully resized, so
+      //   snapshots taken before a resize can be recognized
+      unsigned resize_generation(void) const;
+
+      // of the attachment shared by every console window
+      static AttachmentCounts attachment_counts(void); // for debugging
+
+      // The agent reading this console from another process, or null if one
+      //   couldn't be started and the console has to be read by attaching.
+      CaptureAgentHost * capture_agent(void) const;
     private:
       ShellProcess(const ShellProcess &);
       ShellProcess & operator=(const ShellProcess &);
@@ -59,9 +89,19 @@ namespace console {
       CHandle stdout_handle_;
       DWORD   process_id_;
       HWND    window_handle_;
-      bool    console_visible_; // if the console associated with the shell process is visible
+      std::atomic<bool> console_visible_; // if the console associated with the shell process is visible
+      std::atomic<unsigned> resize_generation_;
+      std::unique_ptr<CaptureAgentHost> capture_agent_;
         
-      static int attach_count_;
+      // A process can only be attached to one console at a time, so attaching
+      //   is serialized between the window and capture threads of every
+      //   console window. Recursive as attachments nest. The attachment
+      //   outlives each ProcessLock and only moves when another console
+      //   window needs its own console.
+      static ConsoleAttachment attachment_;
+      static std::recursive_mutex attach_mutex_;
+
+      static BOOL WINAPI ctrl_handler(DWORD ctrl_type);
 
       bool attach(void);
       void detach(void);
@@ -69,6 +109,7 @@ namespace console {
       void create_shell_process(Settings & settings);
         
       void get_console_info(const Dimension & console_dim, CharInfoBuffer & buffer, COORD & cursor_pos);
+      void capture(ConsoleSnapshot & snapshot);
       Dimension resize(Dimension console_dim);
 
       Dimension get_console_size(void);
@@ -85,11 +126,13 @@ namespace console {
 
       Dimension resize(Dimension console_dim);
       void get_console_info(const Dimension & console_dim, CharInfoBuffer & buffer, COORD & cursor_pos);
+      void capture(ConsoleSnapshot & snapshot);
       Dimension get_console_size(void);
 
       operator bool(void) const;
     private:
       ShellProcess & shell_process_;
+      std::unique_lock<std::recursive_mutex> lock_;
       bool attached_;
       
       ProcessLock(const ProcessLock &);
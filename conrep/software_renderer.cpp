@@ -0,0 +1,202 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// software_renderer.cpp
+// implementation of the SoftwareRenderer class and glyph sources
+
+#include "software_renderer.h"
+
+#include <algorithm>
+
+namespace console {
+  GlyphSource::~GlyphSource() {}
+
+  PatternGlyphSource::PatternGlyphSource(Dimension glyph_dim)
+    : glyph_dim_(glyph_dim),
+      coverage_(glyph_dim.width * glyph_dim.height)
+  {}
+
+  Dimension PatternGlyphSource::glyph_dim(void) const {
+    return glyph_dim_;
+  }
+
+  const std::uint8_t * PatternGlyphSource::glyph(CellChar c) {
+    if (c <= ' ') return 0;
+    // a one pixel empty border, like the side bearings of a real glyph
+    std::uint32_t bits = c * 2654435761u;
+    for (int y = 0; y < glyph_dim_.height; ++y) {
+      for (int x = 0; x < glyph_dim_.width; ++x) {
+        bool border = (x == 0) || (y == 0) || (x == glyph_dim_.width - 1) || (y == glyph_dim_.height - 1);
+        bool on = !border && ((bits >> ((x + y * glyph_dim_.width) % 32)) & 1);
+        coverage_[y * glyph_dim_.width + x] = on ? 0xff : 0;
+      }
+    }
+    return &coverage_[0];
+  }
+
+  SoftwareRenderer::SoftwareRenderer(GlyphSource & glyphs, const Pixel * colors, int gutter_size)
+    : glyphs_(glyphs),
+      gutter_size_(gutter_size),
+      fused_supported_(false),
+      fused_alpha_(false),
+      char_dim_(glyphs.glyph_dim()),
+      console_dim_(0, 0)
+  {
+    std::copy(colors, colors + CONSOLE_COLORS, colors_);
+  }
+
+  void SoftwareRenderer::set_colors(const Pixel * colors) {
+    std::copy(colors, colors + CONSOLE_COLORS, colors_);
+  }
+
+  void SoftwareRenderer::set_fused_alpha(bool fused) {
+    fused_supported_ = fused;
+  }
+
+  bool SoftwareRenderer::fused_alpha(void) const {
+    return fused_alpha_;
+  }
+
+  void SoftwareRenderer::resize(Dimension console_dim) {
+    console_dim_ = console_dim;
+    fused_alpha_ = fused_supported_;
+    text_.resize(get_client_size());
+    text_.set_alpha_mode(fused_alpha_ ? ALPHA_TRANSMITTANCE : ALPHA_OPACITY);
+    text_.clear(fused_alpha_ ? TRANSMITTANCE_CLEAR : 0);
+    planes_.resize(console_dim);
+  }
+
+  Dimension SoftwareRenderer::get_client_size(void) const {
+    return Dimension(char_dim_.width * console_dim_.width + 2 * gutter_size_,
+                     char_dim_.height * console_dim_.height + 2 * gutter_size_);
+  }
+
+  PixelRect SoftwareRenderer::cell_rect(int column, int row, int columns, int rows) const {
+    PixelRect r = {
+      gutter_size_ + char_dim_.width * column,
+      gutter_size_ + char_dim_.height * row,
+      gutter_size_ + char_dim_.width * (column + columns),
+      gutter_size_ + char_dim_.height * (row + rows)
+    };
+    return r;
+  }
+
+  PixelRect SoftwareRenderer::row_rect(int row) const {
+    return cell_rect(0, row, console_dim_.width, 1);
+  }
+
+  void SoftwareRenderer::update_text(const Cell * cells, const DamageSet & damage, unsigned pre_alpha, bool intensify) {
+    if (damage.empty()) return;
+
+    bool fused = fused_supported_ && !has_backgrounds(cells, console_dim_.width * console_dim_.height);
+    if (fused != fused_alpha_) {
+      fused_alpha_ = fused;
+      text_.set_alpha_mode(fused_alpha_ ? ALPHA_TRANSMITTANCE : ALPHA_OPACITY);
+      all_rows_.reset(console_dim_);
+      all_rows_.mark_all();
+      update_text(cells, all_rows_, pre_alpha, intensify);
+      return;
+    }
+    Pixel clear_color = fused_alpha_ ? TRANSMITTANCE_CLEAR : (pre_alpha << 24);
+
+    if (damage.scroll()) {
+      int rows = damage.scroll();
+      PixelRect area = cell_rect(0, 0, console_dim_.width, console_dim_.height);
+      text_.move_rows(area.top, area.bottom, -rows * char_dim_.height);
+
+      // as in TextRenderer::scroll_text_texture() everything but the shifted
+      //   rows is cleared
+      int first = std::max(0, -rows);
+      int last  = std::min(console_dim_.height, console_dim_.height - rows);
+      PixelRect kept = cell_rect(0, first, console_dim_.width, std::max(0, last - first));
+      Dimension dim = text_.dim();
+      PixelRect above = { 0, 0, dim.width, kept.top };
+      PixelRect below = { 0, kept.bottom, dim.width, dim.height };
+      PixelRect left  = { 0, kept.top, kept.left, kept.bottom };
+      PixelRect right = { kept.right, kept.top, dim.width, kept.bottom };
+      text_.clear(clear_color, above);
+      text_.clear(clear_color, below);
+      text_.clear(clear_color, left);
+      text_.clear(clear_color, right);
+    }
+
+    if (damage.full()) {
+      text_.clear(clear_color);
+    } else {
+      for (DamageSet::const_iterator itr = damage.begin(); itr != damage.end(); ++itr) {
+        text_.clear(clear_color, row_rect(itr->row));
+      }
+    }
+
+    DamageSet::const_iterator itr = damage.begin();
+    while (itr != damage.end()) {
+      int first_row = itr->row;
+      int last_row = first_row + 1;
+      for (++itr; (itr != damage.end()) && (itr->row == last_row); ++itr) ++last_row;
+      planes_.assign_rows(cells, first_row, last_row);
+
+      const std::vector<BackgroundRect> & rects = background_.merge(planes_.attributes(first_row),
+                                                                    console_dim_.width,
+                                                                    first_row,
+                                                                    last_row,
+                                                                    true);
+      for (std::vector<BackgroundRect>::const_iterator r = rects.begin(); r != rects.end(); ++r) {
+        text_.fill(colors_[r->color], cell_rect(r->left, r->top, r->right - r->left, r->bottom - r->top));
+      }
+    }
+
+    for (itr = damage.begin(); itr != damage.end(); ++itr) {
+      draw_row_text(itr->row, intensify);
+    }
+  }
+
+  void SoftwareRenderer::draw_row_text(int row, bool intensify) {
+    const CellChar * chars = planes_.chars(row);
+    const CellAttribute * attributes = planes_.attributes(row);
+    for (int j = 0; j < console_dim_.width; ++j) {
+      const std::uint8_t * coverage = glyphs_.glyph(chars[j]);
+      if (!coverage) continue;
+      int color = attributes[j] & 0xf;
+      if (intensify && color) color |= 0x8;
+      PixelRect r = cell_rect(j, row, 1, 1);
+      text_.draw_coverage(r.left, r.top, coverage, char_dim_, colors_[color]);
+    }
+  }
+
+  void SoftwareRenderer::render(Framebuffer & target, unsigned pre_alpha, unsigned post_alpha) const {
+    if (fused_alpha_) {
+      target.draw_fused(text_, 0, 0, pre_alpha, post_alpha);
+    } else {
+      target.draw(text_, 0, 0, (post_alpha << 24) | 0x00ffffff);
+    }
+  }
+
+  void SoftwareRenderer::draw_cursor(Framebuffer & target, int column, int row) const {
+    if ((column < console_dim_.width) && (row < console_dim_.height)) {
+      target.fill(CURSOR_COLOR, cell_rect(column, row, 1, 1));
+    }
+  }
+
+  void SoftwareRenderer::restore_cell(Framebuffer & target, const Framebuffer & composed, int column, int row) const {
+    target.copy_rect(composed, cell_rect(column, row, 1, 1));
+  }
+
+  const Framebuffer & SoftwareRenderer::text(void) const {
+    return text_;
+  }
+}
\ No newline at end of file
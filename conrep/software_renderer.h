@@ -0,0 +1,124 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Renders the console text into a Framebuffer on the CPU, following the same
+//   steps as TextRenderer does with Direct3D. Doesn't depend on any Windows
+//   headers, so rendering can be measured and checked anywhere.
+
+#ifndef CONREP_SOFTWARE_RENDERER_H
+#define CONREP_SOFTWARE_RENDERER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "background_rects.h"
+#include "cell_planes.h"
+#include "damage_set.h"
+#include "dimension.h"
+#include "framebuffer.h"
+
+namespace console {
+  class GlyphSource {
+    public:
+      virtual ~GlyphSource();
+
+      virtual Dimension glyph_dim(void) const = 0;
+      // Returns glyph_dim().width * glyph_dim().height bytes of coverage,
+      //   valid until the next call, or null if c draws nothing.
+      virtual const std::uint8_t * glyph(CellChar c) = 0;
+  };
+
+  // Deterministic made up glyphs derived from the character code, for when
+  //   no font rasterizer is available. Characters up to and including the
+  //   space are blank.
+  class PatternGlyphSource : public GlyphSource {
+    public:
+      PatternGlyphSource(Dimension glyph_dim);
+
+      Dimension glyph_dim(void) const;
+      const std::uint8_t * glyph(CellChar c);
+    private:
+      Dimension glyph_dim_;
+      std::vector<std::uint8_t> coverage_;
+  };
+
+  class SoftwareRenderer {
+    public:
+      static const int CONSOLE_COLORS = 16;
+      static const Pixel CURSOR_COLOR = 0xB0C0C0C0;
+
+      // colors must point to CONSOLE_COLORS entries
+      SoftwareRenderer(GlyphSource & glyphs, const Pixel * colors, int gutter_size);
+
+      // for text drawn from now on
+      void set_colors(const Pixel * colors);
+
+      // In fused mode the text framebuffer holds transmittance instead of
+      //   alpha and the pre alpha is only applied by render(), so changing it
+      //   doesn't need the text redrawn. As with TextRenderer the mode is only
+      //   used while no cell has a background, as Framebuffer::draw_fused()
+      //   isn't exact over them; update_text() switches modes as the console
+      //   contents require, redrawing everything when it does. fused_alpha()
+      //   is the mode the text is currently drawn in; set_fused_alpha() only
+      //   allows it.
+      static const Pixel TRANSMITTANCE_CLEAR = 0xff000000;
+      void set_fused_alpha(bool fused);
+      bool fused_alpha(void) const;
+
+      // Sizes the text framebuffer for the console and clears it.
+      void resize(Dimension console_dim);
+      Dimension get_client_size(void) const;
+
+      // Applies a console snapshot to the text framebuffer: scrolls it, then
+      //   clears the damaged rows and draws their backgrounds and text. Out of
+      //   fused mode the rows are cleared to pre_alpha, so the text has to be
+      //   redrawn whole for it to change.
+      void update_text(const Cell * cells, const DamageSet & damage, unsigned pre_alpha, bool intensify);
+      // Draws the text over target with the post alpha, and in fused mode
+      //   the pre alpha, applied.
+      void render(Framebuffer & target, unsigned pre_alpha, unsigned post_alpha) const;
+      void draw_cursor(Framebuffer & target, int column, int row) const;
+      // Copies a cell from a composed frame without the cursor, undoing
+      //   draw_cursor() on a presented frame.
+      void restore_cell(Framebuffer & target, const Framebuffer & composed, int column, int row) const;
+
+      const Framebuffer & text(void) const;
+    private:
+      GlyphSource & glyphs_;
+      Pixel colors_[CONSOLE_COLORS];
+      int gutter_size_;
+      bool fused_supported_; // as set by set_fused_alpha()
+      bool fused_alpha_;
+      Dimension char_dim_;
+      Dimension console_dim_;
+
+      Framebuffer text_;
+      CellPlanes planes_;
+      BackgroundMerger background_;
+      DamageSet all_rows_; // damage for redrawing in the other mode
+
+      PixelRect row_rect(int row) const;
+      PixelRect cell_rect(int column, int row, int columns, int rows) const;
+      void draw_row_text(int row, bool intensify);
+
+      SoftwareRenderer(const SoftwareRenderer &);
+      SoftwareRenderer & operator=(const SoftwareRenderer &);
+  };
+}
+
+#endif
\ No newline at end of file
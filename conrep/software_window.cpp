@@ -0,0 +1,397 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// software_window.cpp
+// implementation of the console window drawn without Direct3D
+
+#include "console_window.h"
+
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+
+#include "char_info_buffer.h"
+#include "color_table.h"
+#include "console_window_base.h"
+#include "except_handle.h"
+#include "font_util.h"
+#include "framebuffer.h"
+#include "glyph_rasterizer.h"
+#include "software_renderer.h"
+
+namespace console {
+  namespace {
+    // Keeps every glyph drawn so far, rasterized as for GlyphCache but
+    //   clipped to their cell.
+    class GdiGlyphSource : public GlyphSource {
+      public:
+        GdiGlyphSource(const LOGFONT & lf, Dimension char_dim, bool extended_chars);
+
+        Dimension glyph_dim(void) const;
+        const std::uint8_t * glyph(CellChar c);
+      private:
+        GlyphRasterizer rasterizer_;
+        bool extended_chars_;
+        // empty for characters that draw nothing
+        std::map<CellChar, std::vector<std::uint8_t> > glyphs_;
+
+        GdiGlyphSource(const GdiGlyphSource &);
+        GdiGlyphSource & operator=(const GdiGlyphSource &);
+    };
+
+    GdiGlyphSource::GdiGlyphSource(const LOGFONT & lf, Dimension char_dim, bool extended_chars)
+      : extended_chars_(extended_chars)
+    {
+      rasterizer_.set_font(lf, char_dim, false);
+    }
+
+    Dimension GdiGlyphSource::glyph_dim(void) const {
+      return rasterizer_.glyph_dim();
+    }
+
+    const std::uint8_t * GdiGlyphSource::glyph(CellChar c) {
+      std::map<CellChar, std::vector<std::uint8_t> >::iterator itr = glyphs_.find(c);
+      if (itr == glyphs_.end()) {
+        itr = glyphs_.insert(std::make_pair(c, std::vector<std::uint8_t>())).first;
+        if (GlyphRasterizer::draws(c, extended_chars_)) {
+          Dimension dim = rasterizer_.glyph_dim();
+          const std::uint8_t * coverage = rasterizer_.rasterize(c);
+          itr->second.assign(coverage, coverage + dim.width * dim.height);
+        }
+      }
+      return itr->second.empty() ? 0 : &itr->second[0];
+    }
+
+    void get_colors(const ColorTable & table, Pixel * colors) {
+      for (int i = 0; i < SoftwareRenderer::CONSOLE_COLORS; ++i) colors[i] = table[i];
+    }
+
+    // stands in for the wallpaper, which is only drawn with Direct3D
+    Pixel desktop_color(void) {
+      DWORD c = GetSysColor(COLOR_DESKTOP);
+      return 0xff000000 | (static_cast<Pixel>(GetRValue(c)) << 16) | (static_cast<Pixel>(GetGValue(c)) << 8) | GetBValue(c);
+    }
+  }
+
+  // A console window for when there is no Direct3D device. The text is drawn
+  //   by SoftwareRenderer over the desktop color and presented with GDI, one
+  //   whole frame at a time. Everything else is shared with the Direct3D
+  //   window through ConsoleWindowBase.
+  class SoftwareConsoleWindow : public ConsoleWindowBase<SoftwareConsoleWindow> {
+    public:
+      SoftwareConsoleWindow(HWND hub,
+                            HINSTANCE hInstance,
+                            Settings settings,
+                            const ColorTable & color_table,
+                            const tstring & exe_dir,
+                            tstring & message)
+        : ConsoleWindowBase<SoftwareConsoleWindow>(hub, hInstance, settings, exe_dir, message),
+          gutter_size_(settings.gutter_size),
+          extended_chars_(settings.extended_chars),
+          intensify_(settings.intensify),
+          font_size_(settings.font_size * POINT_SIZE_SCALE),
+          lf_(get_gdi_logfont(settings.font_name, font_size_)),
+          char_dim_(get_char_dim(lf_)),
+          console_dim_(settings.columns, settings.rows),
+          client_dim_(0, 0),
+          text_pending_(false),
+          damage_(0),
+          active_pre_alpha_(static_cast<unsigned char>(settings.active_pre_alpha)),
+          inactive_pre_alpha_(static_cast<unsigned char>(settings.inactive_pre_alpha)),
+          color_table_(color_table),
+          background_color_(desktop_color())
+      {
+        ASSERT(settings.active_pre_alpha <= std::numeric_limits<unsigned char>::max());
+        ASSERT(settings.inactive_pre_alpha <= std::numeric_limits<unsigned char>::max());
+        cursor_pos_.X = 0;
+        cursor_pos_.Y = 0;
+        create_renderer();
+        start(settings);
+      }
+
+      ~SoftwareConsoleWindow() {}
+
+      // nothing to lose without a device
+      void dispose_resources(void) {}
+      void restore_resources(void) {}
+      // nor any shadows to keep
+      void update_shadows(void) {}
+
+      // The same steps as ConsoleWindowImpl takes. Frames are presented whole.
+      unsigned prepare(void) {
+        if (state_ != RUNNING) return 0;
+        if (!take_changes()) return 0;
+
+        unsigned work = 0;
+        if (prepare_text()) {
+          frame_.mark(FRAME_TEXT);
+          work |= WORK_TEXT;
+        }
+        cursor_ = current_cursor();
+        frame_.set_cursor(cursor_);
+        if (!frame_.request()) return work;
+
+        if (frame_.changes() & ~(FRAME_CURSOR | FRAME_EXPOSE)) work |= WORK_COMPOSE;
+        work |= WORK_PRESENT;
+        if (cursor_.visible) work |= WORK_OVERLAY;
+        return work;
+      }
+
+      // The colors are read from the root window's table as the rows are
+      //   drawn, as TextRenderer does.
+      void draw_text(void) {
+        ASSERT(damage_ != nullptr);
+        get_colors(color_table_, colors_);
+        renderer_->set_colors(colors_);
+        renderer_->update_text(char_info_buffer_.cells(), *damage_, pre_alpha(), intensify_);
+        damage_ = 0;
+        char_info_buffer_.swap();
+      }
+
+      void compose(void) {
+        composed_.clear(background_color_);
+        renderer_->render(composed_, pre_alpha(), post_alpha());
+      }
+
+      void copy_frame(void) {
+        PixelRect all = { 0, 0, client_dim_.width, client_dim_.height };
+        frame_buffer_.copy_rect(composed_, all);
+      }
+
+      void draw_overlay(void) {
+        renderer_->draw_cursor(frame_buffer_, cursor_.column, cursor_.row);
+      }
+
+      // A frame that couldn't be drawn, such as while the session is
+      //   disconnected, is tried again at the next tick.
+      void present(void) {
+        if ((client_dim_.width <= 0) || (client_dim_.height <= 0)) return;
+        BITMAPINFO bmi = {};
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = client_dim_.width;
+        bmi.bmiHeader.biHeight = -client_dim_.height;
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+
+        HDC dc = GetDC(get_hwnd());
+        if (!dc) return;
+        int lines = SetDIBitsToDevice(dc,
+                                      0, 0, client_dim_.width, client_dim_.height,
+                                      0, 0, 0, client_dim_.height,
+                                      frame_buffer_.row(0),
+                                      &bmi,
+                                      DIB_RGB_COLORS);
+        ReleaseDC(get_hwnd(), dc);
+        if (!lines) return;
+        frame_.presented();
+        if (!ValidateRect(get_hwnd(), NULL)) WIN_EXCEPT("Failed call to ValidateRect(). ");
+      }
+    private:
+      int gutter_size_;   // manually enforced inside border width
+      bool extended_chars_;
+      bool intensify_;
+
+      int font_size_; // in units of POINT_SIZE_SCALE of a point
+      LOGFONT lf_;
+      Dimension char_dim_;
+      Dimension console_dim_;
+      Dimension client_dim_;
+      COORD cursor_pos_;
+      bool text_pending_;        // contents taken in but not yet compared
+      const DamageSet * damage_; // between prepare() and draw_text()
+
+      unsigned char active_pre_alpha_;
+      unsigned char inactive_pre_alpha_;
+
+      const ColorTable & color_table_; // owned by the root window
+      Pixel colors_[SoftwareRenderer::CONSOLE_COLORS];
+      Pixel background_color_;
+
+      // the renderer takes its cell size from the glyphs, so both are
+      //   replaced when the font changes
+      std::unique_ptr<GdiGlyphSource> glyphs_;
+      std::unique_ptr<SoftwareRenderer> renderer_;
+      CharInfoBuffer char_info_buffer_;
+
+      Framebuffer composed_;     // last composed frame, without the cursor
+      Framebuffer frame_buffer_; // with the cursor, as presented
+
+      void create_renderer(void) {
+        renderer_.reset();
+        glyphs_.reset(new GdiGlyphSource(lf_, char_dim_, extended_chars_));
+        get_colors(color_table_, colors_);
+        renderer_.reset(new SoftwareRenderer(*glyphs_, colors_, gutter_size_));
+        renderer_->set_fused_alpha(true);
+        renderer_->resize(console_dim_);
+        char_info_buffer_.invalidate();
+        damage_ = 0;
+      }
+
+      unsigned char pre_alpha(void) const {
+        return active_ ? active_pre_alpha_ : inactive_pre_alpha_;
+      }
+
+      // The current buffer was swapped out when the text was last drawn, so
+      //   a fresh snapshot is needed to draw it all again.
+      void invalidate_text(void) {
+        char_info_buffer_.invalidate();
+        damage_ = 0;
+        request_snapshot();
+      }
+
+      bool prepare_text(void) {
+        if (!text_pending_) return damage_ != 0;
+        if (damage_) char_info_buffer_.invalidate();
+        text_pending_ = false;
+        damage_ = 0;
+        const DamageSet & damage = char_info_buffer_.compare();
+        if (damage.empty()) return false;
+        damage_ = &damage;
+        return true;
+      }
+
+      Dimension console_dim_from_window_size(Dimension window_dim, INT scrollbar_width) {
+        Dimension usable = get_max_usable_client_dim(window_dim, gutter_size_, scrollbar_width, CONSOLE_WINDOW_STYLE);
+        return usable / char_dim_;
+      }
+
+      Dimension get_client_size(void) {
+        return renderer_->get_client_size();
+      }
+
+      void resize_buffers(Dimension console_dim) {
+        console_dim_ = console_dim;
+        char_info_buffer_.resize(console_dim);
+        renderer_->resize(console_dim);
+        damage_ = 0;
+      }
+
+      bool poll_console_size(const ConsoleSnapshot & snapshot) {
+        if (snapshot.dim == console_dim_) return false;
+        resize_buffers(snapshot.dim);
+        return true;
+      }
+
+      void take_snapshot(const ConsoleSnapshot & snapshot) {
+        ASSERT(!snapshot.exited);
+        if (!snapshot.cells.empty()) {
+          std::memcpy(&char_info_buffer_[0], &snapshot.cells[0], snapshot.cells.size() * sizeof(CHAR_INFO));
+        }
+        cursor_pos_ = snapshot.cursor_pos;
+        text_pending_ = true;
+      }
+
+      void take_console_info(ProcessLock & pl) {
+        pl.get_console_info(console_dim_, char_info_buffer_, cursor_pos_);
+        text_pending_ = true;
+      }
+
+      COORD get_cursor_pos(void) const {
+        return cursor_pos_;
+      }
+
+      bool choose_font(void) {
+        LOGFONT lf = lf_;
+        CHOOSEFONT cf = {
+          sizeof(CHOOSEFONT),
+          get_hwnd(),
+          0,
+          &lf,
+          0,
+          CF_INITTOLOGFONTSTRUCT | CF_FIXEDPITCHONLY | CF_FORCEFONTEXIST | CF_NOSIMULATIONS | CF_NOVERTFONTS
+                                 | CF_SCREENFONTS
+        };
+        if (!ChooseFont(&cf)) return false;
+        lf_ = lf;
+        char_dim_ = get_char_dim(lf_);
+        font_size_ = cf.iPointSize;
+        create_renderer();
+        return true;
+      }
+
+      // As TextRenderer::adjust(), the text is redrawn whatever changed.
+      void adjust_text(const Settings & settings) {
+        if (settings.scl_font_name || settings.scl_font_size) {
+          if (settings.scl_font_size) {
+            font_size_ = settings.font_size * POINT_SIZE_SCALE;
+          }
+          if (settings.scl_font_name) {
+            lf_ = get_gdi_logfont(settings.font_name, font_size_);
+          } else {
+            lf_ = get_gdi_logfont(lf_.lfFaceName, font_size_);
+          }
+          char_dim_ = get_char_dim(lf_);
+        }
+
+        if (settings.scl_gutter_size) gutter_size_ = settings.gutter_size;
+        if (settings.scl_extended_chars) extended_chars_ = settings.extended_chars;
+        if (settings.scl_intensify) intensify_ = settings.intensify;
+        if (settings.scl_active_pre_alpha) {
+          ASSERT(settings.active_pre_alpha <= std::numeric_limits<unsigned char>::max());
+          active_pre_alpha_ = static_cast<unsigned char>(settings.active_pre_alpha);
+        }
+        if (settings.scl_inactive_pre_alpha) {
+          ASSERT(settings.inactive_pre_alpha <= std::numeric_limits<unsigned char>::max());
+          inactive_pre_alpha_ = static_cast<unsigned char>(settings.inactive_pre_alpha);
+        }
+        create_renderer();
+        invalidate_text();
+      }
+
+      void toggle_extended_chars(void) {
+        extended_chars_ = !extended_chars_;
+        create_renderer();
+        invalidate_text();
+      }
+
+      void set_menu_options(MenuPtr & menu) {
+        menu->set_extended_chars(extended_chars_);
+      }
+
+      bool activation_changed(void) {
+        if (renderer_->fused_alpha()) return false;
+        char_info_buffer_.invalidate();
+        damage_ = 0;
+        return true;
+      }
+
+      void resize_targets(Dimension client_dim) {
+        client_dim_ = client_dim;
+        composed_.resize(client_dim);
+        frame_buffer_.resize(client_dim);
+      }
+  };
+
+  LPCTSTR SoftwareConsoleWindow::class_name = _T("{a6d2b556-e572-483c-8499-64d23082680d}");
+  ATOM    SoftwareConsoleWindow::class_atom = 0;
+
+  WindowPtr create_software_console_window(HWND hub,
+                                           HINSTANCE hInstance,
+                                           const Settings & settings,
+                                           const ColorTable & color_table,
+                                           const tstring & exe_dir,
+                                           tstring & message) {
+    if (!SoftwareConsoleWindow::get_class_atom()) SoftwareConsoleWindow::register_window_class(hInstance);
+    return boost::make_shared<SoftwareConsoleWindow>(hub, hInstance, settings, color_table, exe_dir, message);
+  }
+}
\ No newline at end of file
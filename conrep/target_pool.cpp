@@ -0,0 +1,145 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// target_pool.cpp
+// implementation of target bucketing and the TargetPool class
+
+#include "target_pool.h"
+
+namespace console {
+  namespace {
+    int bucket_side(int n) {
+      if (n <= 64) return 64;
+      int high = 1;
+      while (high * 2 <= n) high *= 2;
+      int step = (high / 4 < 64) ? 64 : high / 4;
+      return (n + step - 1) / step * step;
+    }
+
+    std::uint64_t area(Dimension dim) {
+      return static_cast<std::uint64_t>(dim.width) * dim.height;
+    }
+  }
+
+  Dimension target_bucket(Dimension dim) {
+    return Dimension(bucket_side(dim.width), bucket_side(dim.height));
+  }
+
+  TargetPool::TargetPool(unsigned idle_time, std::uint64_t max_free_bytes, unsigned bytes_per_pixel)
+    : idle_time_(idle_time),
+      max_free_bytes_(max_free_bytes),
+      bytes_per_pixel_(bytes_per_pixel)
+  {
+    clear();
+    counts_.hits = 0;
+    counts_.misses = 0;
+    counts_.evictions = 0;
+  }
+
+  std::uint64_t TargetPool::bytes(Dimension size) const {
+    return area(size) * bytes_per_pixel_;
+  }
+
+  int TargetPool::acquire(Dimension dim, std::uintptr_t key, std::uint32_t) {
+    std::uint64_t limit = 2 * area(target_bucket(dim));
+    int best = -1;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      const Entry & e = entries_[i];
+      if (!e.live || e.used || (e.key != key)) continue;
+      if ((e.size.width < dim.width) || (e.size.height < dim.height)) continue;
+      if (area(e.size) > limit) continue;
+      if ((best < 0) || (area(e.size) < area(entries_[best].size))) best = static_cast<int>(i);
+    }
+    if (best < 0) {
+      ++counts_.misses;
+      return -1;
+    }
+    Entry & e = entries_[best];
+    e.used = true;
+    counts_.free_bytes -= bytes(e.size);
+    counts_.used_bytes += bytes(e.size);
+    ++counts_.hits;
+    return best;
+  }
+
+  int TargetPool::add(Dimension size, std::uintptr_t key, std::uint32_t now) {
+    Entry e = { true, true, size, key, now };
+    counts_.used_bytes += bytes(size);
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      if (!entries_[i].live) {
+        entries_[i] = e;
+        return static_cast<int>(i);
+      }
+    }
+    entries_.push_back(e);
+    return static_cast<int>(entries_.size() - 1);
+  }
+
+  void TargetPool::release(int id, std::uint32_t now) {
+    Entry & e = entries_[id];
+    if (!e.used) return;
+    e.used = false;
+    e.released = now;
+    counts_.used_bytes -= bytes(e.size);
+    counts_.free_bytes += bytes(e.size);
+  }
+
+  bool TargetPool::in_use(int id) const {
+    return entries_[id].used;
+  }
+
+  Dimension TargetPool::size(int id) const {
+    return entries_[id].size;
+  }
+
+  void TargetPool::evict(int id, std::vector<int> & evicted) {
+    Entry & e = entries_[id];
+    e.live = false;
+    counts_.free_bytes -= bytes(e.size);
+    ++counts_.evictions;
+    evicted.push_back(id);
+  }
+
+  void TargetPool::trim(std::uint32_t now, std::vector<int> & evicted) {
+    evicted.clear();
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      const Entry & e = entries_[i];
+      // unsigned subtraction copes with the clock wrapping
+      if (e.live && !e.used && (now - e.released >= idle_time_)) evict(static_cast<int>(i), evicted);
+    }
+    while (counts_.free_bytes > max_free_bytes_) {
+      int oldest = -1;
+      for (size_t i = 0; i < entries_.size(); ++i) {
+        const Entry & e = entries_[i];
+        if (!e.live || e.used) continue;
+        if ((oldest < 0) || (now - e.released > now - entries_[oldest].released)) oldest = static_cast<int>(i);
+      }
+      evict(oldest, evicted);
+    }
+  }
+
+  void TargetPool::clear(void) {
+    entries_.clear();
+    counts_.used_bytes = 0;
+    counts_.free_bytes = 0;
+  }
+
+  TargetPoolCounts TargetPool::counts(void) const {
+    return counts_;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Decides which render targets to reuse when console windows are resized.
+//   Targets are allocated a bucket larger than asked for and a request is
+//   served by any free target it fits in, drawn to through a sub-rectangle,
+//   so dragging a window's edge or changing the font doesn't allocate and
+//   free video memory at every step. Free targets are evicted once they
+//   have been idle for a while or take up too much memory. Only ids and
+//   sizes are tracked here; the caller owns the targets themselves.
+
+#ifndef CONREP_TARGET_POOL_H
+#define CONREP_TARGET_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dimension.h"
+
+namespace console {
+  // Rounds dim up to the size a target for it is allocated with: each side
+  //   to a multiple of a quarter of its highest power of two, and at least
+  //   of 64.
+  Dimension target_bucket(Dimension dim);
+
+  struct TargetPoolCounts {
+    std::uint64_t hits;      // requests served by a free target
+    std::uint64_t misses;    // requests that needed a new target
+    std::uint64_t evictions;
+    std::uint64_t used_bytes;
+    std::uint64_t free_bytes;
+  };
+
+  class TargetPool {
+    public:
+      // Time is in milliseconds from any clock that wraps at 2^32.
+      //   bytes_per_pixel is only used to count memory.
+      TargetPool(unsigned idle_time, std::uint64_t max_free_bytes, unsigned bytes_per_pixel);
+
+      // Returns the id of the smallest free target with the same key that
+      //   dim fits in, now in use, or -1 if there is none. Targets more than
+      //   twice the area of target_bucket(dim) aren't used, so that a small
+      //   window doesn't hold on to a large one. The key ties targets to
+      //   something they can only be used with, such as a window.
+      int acquire(Dimension dim, std::uintptr_t key, std::uint32_t now);
+      // Records a target allocated at size, in use, and returns its id.
+      int add(Dimension size, std::uintptr_t key, std::uint32_t now);
+      void release(int id, std::uint32_t now);
+      bool in_use(int id) const;
+      Dimension size(int id) const;
+
+      // Stores in evicted the ids of free targets that have been idle for
+      //   longer than the idle time, and then of the least recently used
+      //   ones until the free targets fit in the limit, and forgets them.
+      void trim(std::uint32_t now, std::vector<int> & evicted);
+      // forgets every target, such as when the device is reset
+      void clear(void);
+
+      TargetPoolCounts counts(void) const;
+    private:
+      struct Entry {
+        bool live;
+        bool used;
+        Dimension size;
+        std::uintptr_t key;
+        std::uint32_t released; // when it was last freed
+      };
+
+      unsigned idle_time_;
+      std::uint64_t max_free_bytes_;
+      unsigned bytes_per_pixel_;
+      std::vector<Entry> entries_; // indexed by id; dead entries are reused
+      TargetPoolCounts counts_;
+
+      std::uint64_t bytes(Dimension size) const;
+      void evict(int id, std::vector<int> & evicted);
+  };
+}
+
+#endif
\ No newline at end of file
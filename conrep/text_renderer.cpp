@@ -18,11 +18,14 @@
 
 #include "text_renderer.h"
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 #include "assert.h"
 #include "char_info_buffer.h"
 #include "color_table.h"
+#include "console_capture.h"
 #include "console_util.h"
 #include "context_menu.h"
 #include "d3root.h"
@@ -34,6 +37,12 @@
 #include "windows.h"
 
 namespace console {
+  namespace {
+    // what text_texture_ is cleared to when it holds transmittance: nothing
+    //   drawn on it yet, so everything behind shows through
+    const D3DCOLOR TRANSMITTANCE_CLEAR = D3DCOLOR_ARGB(0xff, 0, 0, 0);
+  }
+
   TextRenderer::TextRenderer(RootPtr & root, const Settings & settings)
     : white_texture_(root->white_texture()),
       font_(create_font(root->device(), settings.font_name, settings.font_size * POINT_SIZE_SCALE)),
@@ -42,12 +51,21 @@ namespace console {
       gutter_size_(settings.gutter_size),
       extended_chars_(settings.extended_chars),
       intensify_(settings.intensify),
+      fused_supported_(false),
+      fused_alpha_(false),
+      text_pending_(false),
+      texture_lost_(false),
+      damage_(0),
+      clear_color_(0),
+      shadow_valid_(false),
+      drawn_since_poll_(false),
       active_pre_alpha_(static_cast<unsigned char>(settings.active_pre_alpha)),
       inactive_pre_alpha_(static_cast<unsigned char>(settings.inactive_pre_alpha)),
       font_size_(settings.font_size * POINT_SIZE_SCALE),
       color_table_(root->get_color_table())
   {
     get_logfont(font_, &lf_);
+    glyphs_.set_font(root->device(), lf_, char_dim_);
     ASSERT(settings.active_pre_alpha <= std::numeric_limits<unsigned char>::max());
     ASSERT(settings.inactive_pre_alpha <= std::numeric_limits<unsigned char>::max());
   }
@@ -65,6 +83,7 @@ namespace console {
       }
       get_logfont(font_, &lf_);
       char_dim_ = console::get_char_dim(font_);
+      glyphs_.set_font(device, lf_, char_dim_);
     }
 
     if (settings.scl_gutter_size) gutter_size_ = settings.gutter_size;
@@ -82,7 +101,8 @@ namespace console {
 
   void TextRenderer::toggle_extended_chars(void) {
     extended_chars_ = !extended_chars_;
-    char_info_buffer_.invalidate();
+    glyphs_.clear();
+    invalidate();
   }
 
   Dimension TextRenderer::console_dim_from_window_size(Dimension window_dim, INT scrollbar_width, DWORD style) {
@@ -107,6 +127,8 @@ namespace console {
       lf_ = lf;
       char_dim_ = console::get_char_dim(font_);
       font_size_ = cf.iPointSize;
+      glyphs_.set_font(device, lf_, char_dim_);
+      invalidate();
       return true;
     }
     return false;
@@ -116,32 +138,91 @@ namespace console {
     return calc_client_size(char_dim_, console_dim_, gutter_size_);
   }
 
+  // If the device can fuse the alphas, the text texture holds transmittance
+  //   rather than alpha and both alphas are applied in render(). Then the
+  //   focus changing only needs the frame composed again, not the text
+  //   redrawn, and the text doesn't need the pre alpha baked in. That is only
+  //   exact while no cell has a background: transmittance can't tell how much
+  //   of a filled cell a glyph edge drawn over it left see through, so while
+  //   the console shows any backgrounds prepare_text() bakes the pre alpha
+  //   in instead.
   void TextRenderer::create_texture(RootPtr & root, Dimension client_dim) {
+    // After a device reset the texture is uploaded from its shadow copy if
+    //   nothing has been drawn since the copy was made. The console contents
+    //   are then compared as usual, so only what changed while the device
+    //   was lost gets redrawn.
+    bool restore = texture_lost_ && shadow_valid_ &&
+                   (shadow_.dim == client_dim) &&
+                   (root->supports_fused_alpha() || !fused_alpha_);
+    texture_lost_ = false;
+    fused_supported_ = root->supports_fused_alpha();
+    if (!restore) fused_alpha_ = fused_supported_;
     white_texture_ = root->white_texture();
-    text_texture_ = root->create_texture(client_dim, D3DCOLOR_ARGB(0x80, 0, 0, 0));
+    // released first so that the pool can hand the old textures back
+    text_texture_ = 0;
+    scroll_texture_ = 0;
+    text_texture_ = root->acquire_target(client_dim, fused_alpha_ ? TRANSMITTANCE_CLEAR
+                                                                  : D3DCOLOR_ARGB(0x80, 0, 0, 0));
+    texture_dim_ = client_dim;
+    scroll_texture_ = root->acquire_target(client_dim);
+    if (restore) {
+      root->upload_target(text_texture_, shadow_);
+      return;
+    }
+    // the new texture has none of the old text on it
+    invalidate();
   }
 
   void TextRenderer::recreate_font(DevicePtr & device) {
     font_ = create_font(device, lf_);
+    glyphs_.set_font(device, lf_, char_dim_);
   }
 
   void TextRenderer::dispose(void) {
     font_ = 0;
     white_texture_ = 0;
     text_texture_ = 0; 
+    scroll_texture_ = 0;
+    texture_lost_ = true;
+    glyphs_.dispose();
   }
 
   void TextRenderer::set_menu_options(MenuPtr & menu) {
     menu->set_extended_chars(extended_chars_);
   }
 
-  void TextRenderer::render(SpritePtr & sprite, D3DCOLOR color) {
-    HRESULT hr = sprite->Draw(text_texture_, 0, 0, 0, color);
+  bool TextRenderer::activation_changed(void) {
+    if (fused_alpha_) return false;
+    invalidate();
+    return true;
+  }
+
+  unsigned char TextRenderer::pre_alpha(bool active) const {
+    return active ? active_pre_alpha_ : inactive_pre_alpha_;
+  }
+
+  // The text texture is pooled and may be larger than the window.
+  void TextRenderer::render(RootPtr & root, SpritePtr & sprite, bool active, D3DCOLOR color) {
+    RECT all = { 0, 0, texture_dim_.width, texture_dim_.height };
+    if (!fused_alpha_) {
+      HRESULT hr = sprite->Draw(text_texture_, &all, 0, 0, color);
+      if (FAILED(hr)) DX_EXCEPT("Failed call to ID3DXSprite::Draw(). ", hr);
+      return;
+    }
+
+    // the stage states only apply to what the sprite submits while they
+    //   are set
+    HRESULT hr = sprite->Flush();
+    if (FAILED(hr)) DX_EXCEPT("Failed call to ID3DXSprite::Flush(). ", hr);
+    root->begin_fused_alpha(text_texture_, pre_alpha(active));
+    hr = sprite->Draw(text_texture_, &all, 0, 0, color);
+    if (SUCCEEDED(hr)) hr = sprite->Flush();
+    root->end_fused_alpha();
     if (FAILED(hr)) DX_EXCEPT("Failed call to ID3DXSprite::Draw(). ", hr);
   }
 
-  bool TextRenderer::poll_console_size(ProcessLock & pl) {
-    Dimension d = pl.get_console_size();
+  bool TextRenderer::poll_console_size(const ConsoleSnapshot & snapshot) {
+    Dimension d = snapshot.dim;
     if (d == console_dim_) return false;
 
     resize_buffers(d);
@@ -150,13 +231,10 @@ namespace console {
 
   void TextRenderer::resize_buffers(Dimension new_console_dim) {
     console_dim_ = new_console_dim;
-    size_t new_size = new_console_dim.width * ColorTable::CONSOLE_COLORS;
-    if (new_size > plane_buffer_.size()) {
-      plane_buffer_.reserve(new_size);
-      plane_buffer_.resize(plane_buffer_.capacity());
-    }
-
     char_info_buffer_.resize(new_console_dim);
+    planes_.resize(new_console_dim);
+    damage_ = 0;
+    shadow_valid_ = false;
   }
 
   void TextRenderer::draw_block(SpritePtr & sprite, int x, int y, D3DCOLOR color) {
@@ -182,84 +260,231 @@ namespace console {
 
   void TextRenderer::invalidate(void) {
     char_info_buffer_.invalidate();
+    text_pending_ = true;
+    damage_ = 0;
+    shadow_valid_ = false;
+  }
+
+  // The texture is only read back once it has gone a whole poll without
+  //   being drawn to, so that a busy console isn't stalled on every frame.
+  void TextRenderer::update_shadow(RootPtr & root) {
+    if (shadow_valid_ || !text_texture_ || text_pending_ || damage_) return;
+    if (drawn_since_poll_) {
+      drawn_since_poll_ = false;
+      return;
+    }
+    shadow_valid_ = root->read_target(text_texture_, texture_dim_, shadow_);
   }
         
-  void TextRenderer::update_text_buffer(ProcessLock & pl, RootPtr & root, SpritePtr & sprite, bool active) {
-    ASSERT(text_texture_ != nullptr);
+  RECT TextRenderer::cell_rect(int column, int row) const {
+    RECT r = {
+      gutter_size_ + char_dim_.width * column,
+      gutter_size_ + char_dim_.height * row,
+      gutter_size_ + char_dim_.width * (column + 1),
+      gutter_size_ + char_dim_.height * (row + 1)
+    };
+    return r;
+  }
+
+  COORD TextRenderer::get_cursor_pos(void) const {
+    return cursor_pos_;
+  }
+
+  RECT TextRenderer::row_rect(int row) const {
+    RECT r = {
+      gutter_size_,
+      gutter_size_ + char_dim_.height * row,
+      gutter_size_ + char_dim_.width * console_dim_.width,
+      gutter_size_ + char_dim_.height * (row + 1)
+    };
+    return r;
+  }
+
+  // Moves the rows of text_texture_ up by rows (down if negative). Surfaces
+  //   can't be copied onto themselves, so the shifted rows are copied into
+  //   scroll_texture_ and the two textures exchanged. Rows that are scrolled
+  //   in are left for the caller to redraw.
+  void TextRenderer::scroll_text_texture(RootPtr & root, int rows, D3DCOLOR clear_color) {
+    root->set_render_target(scroll_texture_);
+    root->clear(clear_color);
+
+    int first = std::max(0, -rows);
+    int last  = std::min(console_dim_.height, console_dim_.height - rows);
+    if (first < last) {
+      RECT dest = row_rect(first);
+      dest.bottom = row_rect(last - 1).bottom;
+      RECT source = row_rect(first + rows);
+      source.bottom = row_rect(last - 1 + rows).bottom;
+      root->copy_rect(text_texture_, source, scroll_texture_, dest);
+    }
+
+    TexturePtr temp = text_texture_;
+    text_texture_ = scroll_texture_;
+    scroll_texture_ = temp;
+  }
+
+  // Draws the backgrounds of a block of consecutive rows. Each merged
+  //   rectangle is a single texel of the white texture scaled up to size, so
+  //   a run of cells costs one quad rather than one per cell.
+  void TextRenderer::draw_background(SpritePtr & sprite, int first_row, int last_row) {
+    const std::vector<BackgroundRect> & rects = background_.merge(planes_.attributes(first_row),
+                                                                  console_dim_.width,
+                                                                  first_row,
+                                                                  last_row,
+                                                                  true);
+    if (rects.empty()) return;
+
+    D3DXMATRIX old_matrix;
+    HRESULT hr = sprite->GetTransform(&old_matrix);
+    if (FAILED(hr)) DX_EXCEPT("Failure in ID3DXSprite::GetTransform(). ", hr);
+
+    const RECT texel = { 0, 0, 1, 1 };
+    for (std::vector<BackgroundRect>::const_iterator itr = rects.begin(); itr != rects.end(); ++itr) {
+      D3DXMATRIX scale, translate;
+      D3DXMatrixScaling(&scale,
+                        static_cast<float>((itr->right - itr->left) * char_dim_.width),
+                        static_cast<float>((itr->bottom - itr->top) * char_dim_.height),
+                        1.0f);
+      D3DXMatrixTranslation(&translate,
+                            static_cast<float>(gutter_size_ + itr->left * char_dim_.width),
+                            static_cast<float>(gutter_size_ + itr->top * char_dim_.height),
+                            0.0f);
+      D3DXMATRIX matrix = scale * translate * old_matrix;
+      hr = sprite->SetTransform(&matrix);
+      if (FAILED(hr)) DX_EXCEPT("Failure in ID3DXSprite::SetTransform(). ", hr);
+      hr = sprite->Draw(white_texture_, &texel, 0, 0, color_table_[itr->color]);
+      if (FAILED(hr)) DX_EXCEPT("Failed call to ID3DXSprite::Draw(). ", hr);
+    }
+
+    hr = sprite->SetTransform(&old_matrix);
+    if (FAILED(hr)) DX_EXCEPT("Failure in ID3DXSprite::SetTransform(). ", hr);
+  }
+
+  // Every visible cell is a quad from the glyph atlas, so the cost of a row
+  //   doesn't depend on how many colors it uses, and all the rows are
+  //   submitted together when the sprite is flushed.
+  void TextRenderer::draw_row_text(SpritePtr & sprite, int row) {
+    const CellChar * chars = planes_.chars(row);
+    glyphs_.prepare_row(sprite, chars, console_dim_.width, extended_chars_);
+    build_glyph_quads(glyphs_.atlas(), chars, planes_.attributes(row), console_dim_.width, intensify_, quads_);
+
+    TexturePtr texture = glyphs_.texture();
+    int overhang = glyphs_.overhang();
+    for (std::vector<GlyphQuad>::const_iterator itr = quads_.begin(); itr != quads_.end(); ++itr) {
+      RECT r = glyphs_.slot_rect(itr->slot);
+      int x = gutter_size_ + itr->column * char_dim_.width - overhang;
+      // Glyphs may reach into the neighbouring cells of the row, but not
+      //   into the gutter, which isn't cleared with the row.
+      if (itr->column == 0) {
+        r.left += overhang;
+        x += overhang;
+      }
+      if (itr->column == console_dim_.width - 1) r.right -= overhang;
+      D3DXVECTOR3 vec(static_cast<float>(x),
+                      static_cast<float>(gutter_size_ + row * char_dim_.height),
+                      0);
+      HRESULT hr = sprite->Draw(texture, &r, 0, &vec, color_table_[itr->color]);
+      if (FAILED(hr)) DX_EXCEPT("Failed call to ID3DXSprite::Draw(). ", hr);
+    }
+  }
+        
+  void TextRenderer::take_console_info(ProcessLock & pl) {
     pl.get_console_info(console_dim_, char_info_buffer_, cursor_pos_);
+    text_pending_ = true;
+  }
 
-    if (!char_info_buffer_.match()) {
-      root->set_render_target(text_texture_);
-            
-      {
-        SceneLock scene(*root);
-              
-        if (active) {
-          root->clear(D3DCOLOR_ARGB(active_pre_alpha_, 0, 0, 0));
-        } else {
-          root->clear(D3DCOLOR_ARGB(inactive_pre_alpha_, 0, 0, 0));
-        }
-
-        for (int i = 0; i < console_dim_.height; ++i) {
-          for (int j = 0; j < console_dim_.width; ++j) {
-            int offset = i * console_dim_.width + j;
-            int bg_index = (char_info_buffer_[offset].Attributes >> 4) & 0xf;
-            if (bg_index) draw_block(sprite, j, i, color_table_[bg_index]);
-          }
-        }
-
-        int plane_usage[ColorTable::CONSOLE_COLORS];
-        int first_plane[ColorTable::CONSOLE_COLORS];
-
-        ASSERT(((plane_buffer_.end() - plane_buffer_.begin()) % ColorTable::CONSOLE_COLORS) == 0);
-        std::fill(plane_buffer_.begin(), plane_buffer_.end(), _T(' '));
-        for (int i = 0; i < console_dim_.height; ++i) {
-          std::fill_n(plane_usage, ColorTable::CONSOLE_COLORS, 0);
-          std::fill_n(first_plane, ColorTable::CONSOLE_COLORS, -1);
-          for (int j = 0; j < console_dim_.width; ++j) {
-            int offset = i * console_dim_.width + j;
-            #ifdef UNICODE
-              TCHAR c = char_info_buffer_[offset].Char.UnicodeChar;
-            #else
-              TCHAR c = char_info_buffer_[offset].Char.AsciiChar;
-            #endif
-            WORD attr = char_info_buffer_[offset].Attributes;
-            int fg_index = attr & 0xf;
-
-            if (intensify_ && fg_index) fg_index |= 0x8;
-                  
-            if ( (c != 0) && 
-                 (extended_chars_ || (_istprint(c) && !_istspace(c))) ) {
-              plane_buffer_[fg_index * console_dim_.width + j] = c;
-              plane_usage[fg_index] = j + 1;
-              if (first_plane[fg_index] == -1) first_plane[fg_index] = j;
-            }
-          }
-          for (int j = 0; j < ColorTable::CONSOLE_COLORS; ++j) {
-            if (plane_usage[j]) {
-              int f = first_plane[j];
-              RECT r = {
-                gutter_size_ + char_dim_.width * f,
-                gutter_size_ + char_dim_.height * i,
-                char_dim_.width * console_dim_.width + gutter_size_,
-                char_dim_.height * console_dim_.height + gutter_size_
-              };
-              int line_start = j * console_dim_.width + f;
-              int length = plane_usage[j] - f;
-              HRESULT hr = font_->DrawText(sprite,
-                                            &plane_buffer_[line_start],
-                                            length,
-                                            &r,
-                                            DT_LEFT | DT_TOP | DT_NOCLIP | DT_SINGLELINE,
-                                            color_table_[j]);
-              if (FAILED(hr)) DX_EXCEPT("Failed call to ID3DXFont::DrawText(). ", hr);
-              std::fill_n(plane_buffer_.begin() + line_start, length, _T(' '));
-            }
-          }
-        }
+  void TextRenderer::take_snapshot(const ConsoleSnapshot & snapshot) {
+    ASSERT(!snapshot.exited);
+    if (snapshot.dim != console_dim_) char_info_buffer_.resize(snapshot.dim);
+    if (!snapshot.cells.empty()) {
+      std::memcpy(&char_info_buffer_[0], &snapshot.cells[0], snapshot.cells.size() * sizeof(CHAR_INFO));
+    }
+    cursor_pos_ = snapshot.cursor_pos;
+    text_pending_ = true;
+  }
+
+  bool TextRenderer::prepare_text(RootPtr & root, bool active, DirtyRegion & dirty) {
+    ASSERT(text_texture_ != nullptr);
+    if (!text_pending_) return damage_ != 0;
+    // Contents taken in before the last damage was drawn replace what it
+    //   was computed from. The texture may have been scrolled for it already,
+    //   so everything is redrawn.
+    if (damage_) char_info_buffer_.invalidate();
+    text_pending_ = false;
+    damage_ = 0;
+    const DamageSet * compared = &char_info_buffer_.compare();
+    if (compared->empty()) return false;
+    shadow_valid_ = false;
+
+    // see create_texture(); the texture is redrawn whole in the other mode
+    bool fused = fused_supported_ &&
+                 !has_backgrounds(char_info_buffer_.cells(), console_dim_.width * console_dim_.height);
+    if (fused != fused_alpha_) {
+      fused_alpha_ = fused;
+      char_info_buffer_.invalidate();
+      compared = &char_info_buffer_.compare();
+    }
+    const DamageSet & damage = *compared;
+
+    if (damage.full() || damage.scroll()) {
+      // both clear the gutter as well as the rows
+      PixelRect all = { 0, 0, texture_dim_.width, texture_dim_.height };
+      dirty.add(all);
+    } else {
+      for (DamageSet::const_iterator itr = damage.begin(); itr != damage.end(); ++itr) {
+        RECT r = row_rect(itr->row);
+        PixelRect row = { r.left, r.top, r.right, r.bottom };
+        dirty.add(row);
+      }
+    }
+
+    clear_color_ = fused_alpha_ ? TRANSMITTANCE_CLEAR : D3DCOLOR_ARGB(pre_alpha(active), 0, 0, 0);
+    // copying between render targets can't happen in a scene
+    if (damage.scroll()) scroll_text_texture(root, damage.scroll(), clear_color_);
+    damage_ = &damage;
+    return true;
+  }
+
+  void TextRenderer::draw_text(RootPtr & root, SpritePtr & sprite) {
+    ASSERT(damage_ != nullptr);
+    const DamageSet & damage = *damage_;
+    root->set_render_target(text_texture_);
+    if (fused_alpha_) root->set_transmittance_blend(true);
+
+    // Only whole rows are redrawn, even though the damage set records the
+    //   changed columns, as glyphs can extend past their cell horizontally
+    //   by up to GlyphCache::overhang().
+    if (damage.full()) {
+      root->clear(clear_color_);
+    } else {
+      for (DamageSet::const_iterator itr = damage.begin(); itr != damage.end(); ++itr) {
+        root->clear(clear_color_, row_rect(itr->row));
       }
-      char_info_buffer_.swap();
     }
+
+    // damaged rows are in order, so runs of consecutive rows can be split
+    //   and have their backgrounds merged together
+    DamageSet::const_iterator itr = damage.begin();
+    while (itr != damage.end()) {
+      int first_row = itr->row;
+      int last_row = first_row + 1;
+      for (++itr; (itr != damage.end()) && (itr->row == last_row); ++itr) ++last_row;
+      planes_.assign_rows(char_info_buffer_.cells(), first_row, last_row);
+      draw_background(sprite, first_row, last_row);
+    }
+
+    for (DamageSet::const_iterator itr = damage.begin(); itr != damage.end(); ++itr) {
+      draw_row_text(sprite, itr->row);
+    }
+
+    if (fused_alpha_) {
+      HRESULT hr = sprite->Flush();
+      if (FAILED(hr)) DX_EXCEPT("Failed call to ID3DXSprite::Flush(). ", hr);
+      root->set_transmittance_blend(false);
+    }
+    damage_ = 0;
+    char_info_buffer_.swap();
+    drawn_since_poll_ = true;
   }
 
 }
\ No newline at end of file
@@ -21,51 +21,96 @@
 
 #include <vector>
 
+#include "background_rects.h"
+#include "cell_planes.h"
 #include "char_info_buffer.h"
 #include "color_table.h"
 #include "context_menu.h"
 #include "d3root.h"
 #include "dimension.h"
+#include "dirty_region.h"
+#include "glyph_cache.h"
+#include "shadow_store.h"
 #include "shell_process.h"
 #include "windows.h"
 
 namespace console {
+  struct ConsoleSnapshot;
+
   class TextRenderer {
     public:
       TextRenderer(RootPtr & root, const Settings & settings);
 
+      // Called when the window gains or loses the focus. Returns whether the
+      //   text has to be redrawn from a new snapshot for the other pre alpha,
+      //   which it doesn't when the pre alpha is applied while composing.
+      bool activation_changed(void);
+
       void adjust(const DevicePtr & device, const Settings & settings);
+      RECT cell_rect(int column, int row) const;
       bool choose_font(DevicePtr & device, HWND hWnd);
       Dimension console_dim_from_window_size(Dimension window_dim, INT scrollbar_width, DWORD style);
       void create_texture(RootPtr & root, Dimension client_dim);
       void dispose(void);
       void draw_cursor(SpritePtr & sprite);
       Dimension get_client_size(void);
+      COORD get_cursor_pos(void) const;
       void invalidate(void);
-      bool poll_console_size(ProcessLock & pl);
+      bool poll_console_size(const ConsoleSnapshot & snapshot);
       void recreate_font(DevicePtr & device);
-      void render(SpritePtr & sprite, D3DCOLOR color);
+      // color holds the post alpha
+      void render(RootPtr & root, SpritePtr & sprite, bool active, D3DCOLOR color);
       void resize_buffers(Dimension new_console_dim);
       void set_menu_options(MenuPtr & menu);
       void toggle_extended_chars(void);
-      void update_text_buffer(ProcessLock & pl, RootPtr & root, SpritePtr & sprite, bool active);
+      // Called on the root window's poll timer. Keeps a system memory copy of
+      //   the text texture, so that after a device reset the texture is
+      //   uploaded again rather than redrawn.
+      void update_shadow(RootPtr & root);
+
+      // Redrawing the text is split in two so that the drawing of every
+      //   window can share a scene. The console contents are taken in,
+      //   then prepare_text() compares them to what was last drawn outside
+      //   of any scene, and if it returns true draw_text() is called in one.
+      void take_console_info(ProcessLock & pl);
+      void take_snapshot(const ConsoleSnapshot & snapshot);
+      // Returns whether any part of the text texture needs to be redrawn,
+      //   adding the parts that do to dirty. Scrolls the texture if the
+      //   contents scrolled.
+      bool prepare_text(RootPtr & root, bool active, DirtyRegion & dirty);
+      void draw_text(RootPtr & root, SpritePtr & sprite);
     private:
       TexturePtr white_texture_;
       TexturePtr text_texture_;
+      TexturePtr scroll_texture_; // target when text_texture_ contents are shifted
       FontPtr font_;
       LOGFONT lf_;
 
       Dimension char_dim_;
       Dimension console_dim_;
+      Dimension texture_dim_;
       COORD cursor_pos_;
 
       int gutter_size_;   // manually enforced inside border width
       bool extended_chars_;
       bool intensify_;
+      bool fused_supported_; // by the device; see create_texture()
+      bool fused_alpha_;  // text_texture_ holds transmittance
+      bool text_pending_; // contents taken in but not yet compared
+      bool texture_lost_; // disposed of; see create_texture()
+      const DamageSet * damage_; // between prepare_text() and draw_text()
+      D3DCOLOR clear_color_;     //   of the rows to redraw
         
-      std::vector<TCHAR> plane_buffer_; // work buffers for painting console
-      CharInfoBuffer char_info_buffer_; //   window. Member variables to avoid
-      // the cost of creation/deletion in every text repaint call.
+      GlyphCache glyphs_;
+
+      ShadowImage shadow_;    // of text_texture_, and only valid if it holds
+      bool shadow_valid_;     //   what char_info_buffer_ last compared with
+      bool drawn_since_poll_; // see update_shadow()
+
+      CharInfoBuffer char_info_buffer_; // work buffers for painting console
+      CellPlanes planes_;               //   window. Member variables to avoid
+      BackgroundMerger background_;     //   the cost of creation/deletion in
+      std::vector<GlyphQuad> quads_;    //   every text repaint call.
 
       unsigned char active_pre_alpha_;
       unsigned char inactive_pre_alpha_;
@@ -78,6 +123,11 @@ namespace console {
       TextRenderer & operator=(const TextRenderer &);
 
       void draw_block(SpritePtr & sprite, int x, int y, D3DCOLOR color);
+      void draw_background(SpritePtr & sprite, int first_row, int last_row);
+      void draw_row_text(SpritePtr & sprite, int row);
+      unsigned char pre_alpha(bool active) const;
+      RECT row_rect(int row) const;
+      void scroll_text_texture(RootPtr & root, int rows, D3DCOLOR clear_color);
     };
 
 }
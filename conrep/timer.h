@@ -26,7 +26,19 @@ namespace console {
     TIMER_REPAINT       = 0x101,
     TIMER_POLL_REGISTRY = 0x102,
     REPAINT_TIME        = 250,
-    POLL_TIME           = 250
+    POLL_TIME           = 250,
+    // console capture: fastest and slowest polling, and how long the console
+    //   must be idle before polling starts to slow down
+    CAPTURE_MIN_TIME    = 33,
+    CAPTURE_MAX_TIME    = 1000,
+    CAPTURE_IDLE_TIME   = 500,
+    // rows that changed within this long are read at every poll
+    CAPTURE_RECENT_TIME = 1000,
+    // how long no window must be over a monitor before its background
+    //   texture is released
+    BACKGROUND_IDLE_TIME = 60000,
+    // how long a pooled render target may go unused before it is freed
+    TARGET_IDLE_TIME     = 10000
   };
 }
 
@@ -0,0 +1,71 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Lock free hand off of the latest value from one producer thread to one
+//   consumer thread. The producer always has a slot to write to and the
+//   consumer always has a stable slot to read from; the third slot holds the
+//   most recently published value. Intermediate values the consumer never
+//   picks up are simply overwritten.
+
+#ifndef CONREP_TRIPLE_BUFFER_H
+#define CONREP_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+namespace console {
+  template <typename T>
+  class TripleBuffer {
+    public:
+      TripleBuffer() : middle_(1), back_(0), front_(2) {}
+
+      // producer side: fill in back() then publish() it
+      T & back(void) { return slots_[back_]; }
+      void publish(void) {
+        // release so the consumer sees the writes to the slot; acquire so
+        //   the slot handed back is no longer being read
+        unsigned old = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel);
+        back_ = old & INDEX_MASK;
+      }
+
+      // Consumer side: if a value was published since the last call, makes
+      //   it front() and returns true. Otherwise front() is unchanged.
+      bool acquire(void) {
+        if (!(middle_.load(std::memory_order_relaxed) & FRESH)) return false;
+        unsigned old = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = old & INDEX_MASK;
+        return true;
+      }
+      const T & front(void) const { return slots_[front_]; }
+            T & front(void)       { return slots_[front_]; }
+    private:
+      enum {
+        INDEX_MASK = 0x3,
+        FRESH      = 0x4 // set when the middle slot hasn't been acquired yet
+      };
+
+      T slots_[3];
+      std::atomic<unsigned> middle_; // index of the middle slot and FRESH
+      unsigned back_;                // only used by the producer
+      unsigned front_;               // only used by the consumer
+
+      TripleBuffer(const TripleBuffer &);
+      TripleBuffer & operator=(const TripleBuffer &);
+  };
+}
+
+#endif
\ No newline at end of file
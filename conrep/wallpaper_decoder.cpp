@@ -0,0 +1,196 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// wallpaper_decoder.cpp
+// implementation of the WallpaperDecoder worker thread
+
+#include "wallpaper_decoder.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "downsampler.h"
+
+namespace console {
+  namespace {
+    // rows read from the source at a time
+    const int STRIP_ROWS = 256;
+
+    void swap_results(DecodedWallpaper & lhs, DecodedWallpaper & rhs) {
+      std::swap(lhs.generation, rhs.generation);
+      std::swap(lhs.loaded, rhs.loaded);
+      std::swap(lhs.dim, rhs.dim);
+      lhs.pixels.swap(rhs.pixels);
+      std::swap(lhs.decode_ms, rhs.decode_ms);
+    }
+  }
+
+  Dimension wallpaper_load_size(Dimension image, WallpaperScale scale,
+                                const std::vector<Dimension> & monitors, Dimension max_size) {
+    double factor = 1.0;
+    if (scale != SCALE_NONE) {
+      double needed = 0.0;
+      for (std::vector<Dimension>::const_iterator itr = monitors.begin(); itr != monitors.end(); ++itr) {
+        double x_scale = static_cast<double>(itr->width) / image.width;
+        double y_scale = static_cast<double>(itr->height) / image.height;
+        needed = std::max(needed, (scale == SCALE_FIT) ? std::min(x_scale, y_scale)
+                                                       : std::max(x_scale, y_scale));
+      }
+      if (needed > 0.0) factor = std::min(factor, needed);
+    }
+    factor = std::min(factor, static_cast<double>(max_size.width) / image.width);
+    factor = std::min(factor, static_cast<double>(max_size.height) / image.height);
+
+    if (factor >= 1.0) return image;
+    return Dimension(std::max(1, std::min(image.width,  static_cast<int>(image.width  * factor + 0.5))),
+                     std::max(1, std::min(image.height, static_cast<int>(image.height * factor + 0.5))));
+  }
+
+  DecodedWallpaper::DecodedWallpaper()
+    : generation(0),
+      loaded(false),
+      dim(0, 0),
+      decode_ms(0)
+  {}
+
+  WallpaperDecoder::WallpaperDecoder(IWallpaperSource & source, const std::function<void ()> & notify)
+    : source_(source),
+      notify_(notify),
+      has_pending_(false),
+      has_ready_(false),
+      generation_(0),
+      stopping_(false)
+  {
+    thread_ = std::thread([this]() { run(); });
+  }
+
+  WallpaperDecoder::~WallpaperDecoder() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_.store(true);
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+
+  unsigned WallpaperDecoder::request(const WallpaperRequest & request) {
+    unsigned generation;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_ = request;
+      has_pending_ = true;
+      // bumped under the lock so the worker never pairs a request with the
+      //   wrong generation
+      generation = ++generation_;
+    }
+    wake_.notify_one();
+    return generation;
+  }
+
+  void WallpaperDecoder::cancel(void) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    has_pending_ = false;
+    ++generation_;
+  }
+
+  bool WallpaperDecoder::take(DecodedWallpaper & result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_) {
+      std::exception_ptr error = error_;
+      error_ = std::exception_ptr();
+      std::rethrow_exception(error);
+    }
+    if (!has_ready_) return false;
+    has_ready_ = false;
+    // a request made after this result was finished outdates it
+    if (ready_.generation != generation_.load()) return false;
+    swap_results(ready_, result);
+    // don't hold on to the previous pixels until the next result
+    std::vector<Pixel>().swap(ready_.pixels);
+    return true;
+  }
+
+  bool WallpaperDecoder::superseded(unsigned generation) const {
+    return stopping_.load() || (generation_.load() != generation);
+  }
+
+  void WallpaperDecoder::run(void) {
+    try {
+      WallpaperRequest request;
+      DecodedWallpaper result;
+      for (;;) {
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          while (!has_pending_ && !stopping_.load()) wake_.wait(lock);
+          if (stopping_.load()) return;
+          request = pending_;
+          has_pending_ = false;
+          result.generation = generation_.load();
+        }
+        if (!decode(request, result)) continue;
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (result.generation != generation_.load()) continue;
+          swap_results(ready_, result);
+          has_ready_ = true;
+        }
+        std::vector<Pixel>().swap(result.pixels);
+        notify_();
+      }
+    } catch (...) {
+      source_.close();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+      }
+      notify_();
+    }
+  }
+
+  bool WallpaperDecoder::decode(const WallpaperRequest & request, DecodedWallpaper & result) {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    result.loaded = false;
+    result.dim = Dimension(0, 0);
+    result.pixels.clear();
+
+    Dimension image(0, 0);
+    if (source_.open(request.name, image) && (image.width > 0) && (image.height > 0)) {
+      Downsampler downsampler(image, wallpaper_load_size(image, request.scale, request.monitors, request.max_size));
+      std::vector<Pixel> strip(image.width * std::min(STRIP_ROWS, image.height));
+      bool ok = true;
+      for (int y = 0; ok && (y < image.height); y += STRIP_ROWS) {
+        if (superseded(result.generation)) {
+          source_.close();
+          return false;
+        }
+        int count = std::min(STRIP_ROWS, image.height - y);
+        ok = source_.read_rows(y, count, &strip[0]);
+        if (ok) downsampler.add_rows(&strip[0], count, image.width);
+      }
+      if (ok) {
+        result.loaded = true;
+        result.dim = downsampler.dest_dim();
+        result.pixels.assign(downsampler.image(), downsampler.image() + result.dim.width * result.dim.height);
+      }
+    }
+    source_.close();
+    result.decode_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    return !superseded(result.generation);
+  }
+}
\ No newline at end of file
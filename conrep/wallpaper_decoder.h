@@ -0,0 +1,121 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Decodes and shrinks the wallpaper on a worker thread, so that a change to
+//   a large wallpaper doesn't stall every window while it is read. Windows
+//   keep drawing the old background until the new one is handed over.
+
+#ifndef CONREP_WALLPAPER_DECODER_H
+#define CONREP_WALLPAPER_DECODER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dimension.h"
+#include "framebuffer.h"
+
+namespace console {
+  // Where the wallpaper's pixels come from. Only used on the worker thread.
+  class IWallpaperSource {
+    public:
+      virtual ~IWallpaperSource() {}
+
+      // Opens the image, returning false if it can't be read. Any image
+      //   still open is closed first.
+      virtual bool open(const std::wstring & name, Dimension & dim) = 0;
+      // Reads count rows starting at first into rows, tightly packed ARGB.
+      virtual bool read_rows(int first, int count, Pixel * rows) = 0;
+      virtual void close(void) = 0;
+  };
+
+  // how the wallpaper will be scaled to each monitor
+  enum WallpaperScale {
+    SCALE_NONE, // drawn at its own size, as for tiled and centered wallpapers
+    SCALE_FIT,  // fit inside the monitor
+    SCALE_FILL  // cover the monitor, stretched or cropped
+  };
+
+  // Size a dim sized image is worth loading at: no larger than the biggest
+  //   of monitors needs with scale, and no larger than max_size.
+  Dimension wallpaper_load_size(Dimension image, WallpaperScale scale,
+                                const std::vector<Dimension> & monitors, Dimension max_size);
+
+  struct WallpaperRequest {
+    std::wstring name;
+    WallpaperScale scale;
+    std::vector<Dimension> monitors;
+    Dimension max_size;
+  };
+
+  struct DecodedWallpaper {
+    DecodedWallpaper();
+
+    unsigned generation;       // returned by the request() it answers
+    bool loaded;               // false if the wallpaper couldn't be read
+    Dimension dim;
+    std::vector<Pixel> pixels; // dim.width * dim.height
+    double decode_ms;          // opening, reading and shrinking
+  };
+
+  class WallpaperDecoder {
+    public:
+      // notify is called on the worker thread whenever a result is ready.
+      WallpaperDecoder(IWallpaperSource & source, const std::function<void ()> & notify);
+      ~WallpaperDecoder();
+
+      // Starts decoding request and returns its generation. A request still
+      //   being decoded is abandoned; only the newest is ever handed over.
+      unsigned request(const WallpaperRequest & request);
+      // abandons any request still being decoded
+      void cancel(void);
+      // If the newest request has finished since the last call, swaps its
+      //   result into result and returns true. Exceptions thrown on the
+      //   worker thread are rethrown here.
+      bool take(DecodedWallpaper & result);
+    private:
+      IWallpaperSource & source_;
+      std::function<void ()> notify_;
+
+      std::mutex mutex_;
+      std::condition_variable wake_;
+      WallpaperRequest pending_; // guarded by mutex_
+      bool has_pending_;         // guarded by mutex_
+      DecodedWallpaper ready_;   // guarded by mutex_
+      bool has_ready_;           // guarded by mutex_
+      std::exception_ptr error_; // guarded by mutex_
+      std::atomic<unsigned> generation_;
+      std::atomic<bool> stopping_;
+      std::thread thread_;
+
+      void run(void);
+      bool superseded(unsigned generation) const;
+      // returns false if the request was abandoned part way
+      bool decode(const WallpaperRequest & request, DecodedWallpaper & result);
+
+      WallpaperDecoder(const WallpaperDecoder &);
+      WallpaperDecoder & operator=(const WallpaperDecoder &);
+  };
+}
+
+#endif
\ No newline at end of file
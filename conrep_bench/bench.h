@@ -0,0 +1,82 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Microbenchmark harness for the cell kernels. Benchmarks register
+//   themselves like the test cases in conrep_tests and bench_main.cpp runs
+//   them. Only meaningful in Release builds.
+
+#ifndef CONREP_BENCH_H
+#define CONREP_BENCH_H
+
+#include <cstddef>
+
+#include "../conrep/cpu_features.h"
+
+namespace bench {
+  typedef void (*BenchFunction)(void);
+
+  struct BenchRegistrar {
+    BenchRegistrar(const char * name, BenchFunction function);
+  };
+
+  // where time_us() puts the work counts
+  extern volatile size_t sink;
+
+  // monotonic clock with sub-microsecond resolution where available
+  double now_us(void);
+
+  // Calls body(), which returns how much work it did, until a batch takes
+  //   long enough to time and returns the best microseconds per call over a
+  //   few batches. The work counts are summed into a sink so the calls
+  //   can't be optimized away.
+  template <typename Body>
+  double time_us(Body body) {
+    const double MIN_BATCH_US = 20000;
+    const int BATCHES = 5;
+    size_t iterations = 1;
+    for (;;) {
+      double start = now_us();
+      for (size_t i = 0; i < iterations; ++i) sink += body();
+      if (now_us() - start >= MIN_BATCH_US) break;
+      iterations *= 2;
+    }
+    double best = 0;
+    for (int b = 0; b < BATCHES; ++b) {
+      double start = now_us();
+      for (size_t i = 0; i < iterations; ++i) sink += body();
+      double per_call = (now_us() - start) / iterations;
+      if ((b == 0) || (per_call < best)) best = per_call;
+    }
+    return best;
+  }
+
+  const char * simd_level_name(console::SimdLevel level);
+
+  // one line of results: what was measured, the variant and the time
+  void report(const char * name, const char * variant, double us);
+  // Reports a kernel variant that gave a different answer than the
+  //   reference, and makes the run fail.
+  void mismatch(const char * name, const char * variant);
+}
+
+#define BENCHMARK(name) \
+  static void name(void); \
+  static ::bench::BenchRegistrar name##_registrar(#name, &name); \
+  static void name(void)
+
+#endif
\ No newline at end of file
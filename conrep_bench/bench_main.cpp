@@ -0,0 +1,102 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// bench_main.cpp
+// runs every registered benchmark; with an argument, only the benchmarks
+//   whose names contain it
+
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <chrono>
+#endif
+
+namespace bench {
+  namespace {
+    struct Benchmark {
+      const char * name;
+      BenchFunction function;
+    };
+
+    std::vector<Benchmark> & benchmarks(void) {
+      static std::vector<Benchmark> list;
+      return list;
+    }
+
+    int mismatches = 0;
+  }
+
+  volatile size_t sink = 0;
+
+  BenchRegistrar::BenchRegistrar(const char * name, BenchFunction function) {
+    Benchmark benchmark = { name, function };
+    benchmarks().push_back(benchmark);
+  }
+
+  #ifdef _WIN32
+    // VS2012's high_resolution_clock only ticks with the system clock
+    double now_us(void) {
+      LARGE_INTEGER frequency, counter;
+      QueryPerformanceFrequency(&frequency);
+      QueryPerformanceCounter(&counter);
+      return counter.QuadPart * 1e6 / frequency.QuadPart;
+    }
+  #else
+    double now_us(void) {
+      using namespace std::chrono;
+      return duration_cast<duration<double, std::micro> >(steady_clock::now().time_since_epoch()).count();
+    }
+  #endif
+
+  const char * simd_level_name(console::SimdLevel level) {
+    switch (level) {
+      case console::SIMD_SCALAR: return "scalar";
+      case console::SIMD_SSE2:   return "sse2";
+      case console::SIMD_AVX2:   return "avx2";
+    }
+    return "?";
+  }
+
+  void report(const char * name, const char * variant, double us) {
+    std::printf("%-36s %-12s %12.3f us\n", name, variant, us);
+  }
+
+  void mismatch(const char * name, const char * variant) {
+    std::printf("%-36s %-12s gave a different result\n", name, variant);
+    ++mismatches;
+  }
+}
+
+int main(int argc, char * argv[]) {
+  const char * filter = (argc > 1) ? argv[1] : 0;
+  std::printf("best SIMD level: %s\n", bench::simd_level_name(console::get_simd_level()));
+  const std::vector<bench::Benchmark> & list = bench::benchmarks();
+  for (size_t i = 0; i < list.size(); ++i) {
+    if (filter && !std::strstr(list[i].name, filter)) continue;
+    list[i].function();
+  }
+  return bench::mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// cell_compare_bench.cpp
+// find_cell_differences() with each kernel the processor supports, over
+//   console sized rows and whole buffers
+
+#include "bench.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "../conrep/cell_compare.h"
+
+namespace console {
+  namespace {
+    struct Case {
+      const char * name;
+      int width;
+      int height;
+      // cells changed in the second buffer, as offsets into a row; -1 means none
+      int first_change;
+      int last_change;
+    };
+
+    // Whole buffer compares as compute_damage() would do them, a row at a
+    //   time.
+    size_t compare_rows(const std::vector<Cell> & a, const std::vector<Cell> & b, int width, int height, SimdLevel level) {
+      size_t total = 0;
+      for (int i = 0; i < height; ++i) {
+        DiffRange r = find_cell_differences(&a[i * width], &b[i * width], width, 0xffffffff, level);
+        total += r.first + r.last;
+      }
+      return total;
+    }
+
+    void run_case(const Case & c) {
+      std::vector<Cell> a(c.width * c.height);
+      for (size_t i = 0; i < a.size(); ++i) {
+        a[i] = static_cast<Cell>(L'a' + i % 26) | (0x07 << 16);
+      }
+      std::vector<Cell> b = a;
+      if (c.first_change >= 0) {
+        for (int i = 0; i < c.height; ++i) {
+          b[i * c.width + c.first_change] ^= 1;
+          b[i * c.width + c.last_change] ^= 1;
+        }
+      }
+
+      char name[64];
+      std::sprintf(name, "%s %dx%d", c.name, c.width, c.height);
+      size_t reference = compare_rows(a, b, c.width, c.height, SIMD_SCALAR);
+      for (int l = SIMD_SCALAR; l <= get_simd_level(); ++l) {
+        SimdLevel level = static_cast<SimdLevel>(l);
+        if (compare_rows(a, b, c.width, c.height, level) != reference) {
+          bench::mismatch(name, bench::simd_level_name(level));
+          continue;
+        }
+        double us = bench::time_us([&]() { return compare_rows(a, b, c.width, c.height, level); });
+        bench::report(name, bench::simd_level_name(level), us);
+      }
+    }
+  }
+
+  BENCHMARK(cell_compare) {
+    const Case cases[] = {
+      { "compare identical",     80,  25, -1, -1 },
+      { "compare identical",    200,  60, -1, -1 },
+      { "compare identical",    400, 200, -1, -1 },
+      { "compare changed ends",  80,  25,  0, 79 },
+      { "compare changed ends", 400, 200,  0, 399 },
+      { "compare changed mid",  400, 200, 150, 250 }
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+      run_case(cases[i]);
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// cell_planes_bench.cpp
+// the render passes' reads over packed CHAR_INFO style cells against the
+//   same reads over CellPlanes, and the cost of splitting into planes
+
+#include "bench.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "../conrep/cell_planes.h"
+
+namespace console {
+  namespace {
+    // Text with a background colored status line and some highlighted
+    //   words, roughly what a shell or an editor shows.
+    std::vector<Cell> sample_cells(Dimension dim) {
+      std::vector<Cell> cells(dim.width * dim.height);
+      unsigned seed = 12345;
+      for (int i = 0; i < dim.height; ++i) {
+        for (int j = 0; j < dim.width; ++j) {
+          seed = seed * 1103515245 + 12345;
+          Cell c = ((seed >> 16) % 6) ? static_cast<Cell>(L'a' + (seed >> 8) % 26) : static_cast<Cell>(L' ');
+          Cell attribute = 0x07;
+          if (i == dim.height - 1) attribute = 0x70;
+          else if ((j / 8) % 5 == 3) attribute = 0x1f;
+          cells[i * dim.width + j] = c | (attribute << 16);
+        }
+      }
+      return cells;
+    }
+
+    // The background pass: the number of same colored runs with a non-zero
+    //   background. Templated on how a cell's attribute is fetched, so both
+    //   layouts run the same loop.
+    template <typename Fetch>
+    size_t count_runs(int count, Fetch fetch) {
+      size_t runs = 0;
+      int previous = 0;
+      for (int i = 0; i < count; ++i) {
+        int color = fetch(i) >> 4;
+        if (color && (color != previous)) ++runs;
+        previous = color;
+      }
+      return runs;
+    }
+
+    // The text pass: the number of cells that need a glyph drawn.
+    template <typename Fetch>
+    size_t count_glyphs(int count, Fetch fetch) {
+      size_t glyphs = 0;
+      for (int i = 0; i < count; ++i) {
+        if (fetch(i) != L' ') ++glyphs;
+      }
+      return glyphs;
+    }
+
+    void run_size(Dimension dim) {
+      std::vector<Cell> cells = sample_cells(dim);
+      const Cell * packed = &cells[0];
+      int count = dim.width * dim.height;
+      CellPlanes planes;
+      planes.resize(dim);
+      planes.assign(packed);
+      const CellChar * chars = planes.chars(0);
+      const CellAttribute * attributes = planes.attributes(0);
+
+      char name[64];
+      std::sprintf(name, "split into planes %dx%d", dim.width, dim.height);
+      std::vector<CellChar> split_chars(count);
+      std::vector<CellAttribute> split_attributes(count);
+      // split_cells() has no AVX2 kernel of its own
+      int top_level = (get_simd_level() < SIMD_SSE2) ? get_simd_level() : SIMD_SSE2;
+      for (int l = SIMD_SCALAR; l <= top_level; ++l) {
+        SimdLevel level = static_cast<SimdLevel>(l);
+        split_cells(packed, count, &split_chars[0], &split_attributes[0], level);
+        if ((split_chars != std::vector<CellChar>(chars, chars + count)) ||
+            (split_attributes != std::vector<CellAttribute>(attributes, attributes + count))) {
+          bench::mismatch(name, bench::simd_level_name(level));
+          continue;
+        }
+        double us = bench::time_us([&]() -> size_t {
+          split_cells(packed, count, &split_chars[0], &split_attributes[0], level);
+          return split_chars[count - 1];
+        });
+        bench::report(name, bench::simd_level_name(level), us);
+      }
+
+      auto packed_attribute = [=](int i) { return cell_attribute(packed[i]); };
+      auto plane_attribute  = [=](int i) { return attributes[i]; };
+      auto packed_char      = [=](int i) { return cell_char(packed[i]); };
+      auto plane_char       = [=](int i) { return chars[i]; };
+
+      std::sprintf(name, "background pass %dx%d", dim.width, dim.height);
+      if (count_runs(count, packed_attribute) != count_runs(count, plane_attribute)) bench::mismatch(name, "planes");
+      bench::report(name, "packed", bench::time_us([&]() { return count_runs(count, packed_attribute); }));
+      bench::report(name, "planes", bench::time_us([&]() { return count_runs(count, plane_attribute); }));
+
+      std::sprintf(name, "text pass %dx%d", dim.width, dim.height);
+      if (count_glyphs(count, packed_char) != count_glyphs(count, plane_char)) bench::mismatch(name, "planes");
+      bench::report(name, "packed", bench::time_us([&]() { return count_glyphs(count, packed_char); }));
+      bench::report(name, "planes", bench::time_us([&]() { return count_glyphs(count, plane_char); }));
+
+      // What a frame pays: both passes, plus the split for the planes.
+      std::sprintf(name, "frame %dx%d", dim.width, dim.height);
+      bench::report(name, "packed", bench::time_us([&]() {
+        return count_runs(count, packed_attribute) + count_glyphs(count, packed_char);
+      }));
+      bench::report(name, "split+planes", bench::time_us([&]() -> size_t {
+        planes.assign(packed);
+        return count_runs(count, plane_attribute) + count_glyphs(count, plane_char);
+      }));
+    }
+  }
+
+  BENCHMARK(cell_planes) {
+    run_size(Dimension(80, 25));
+    run_size(Dimension(200, 60));
+    run_size(Dimension(400, 200));
+  }
+}
\ No newline at end of file
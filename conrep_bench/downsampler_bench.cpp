@@ -0,0 +1,115 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// downsampler_bench.cpp
+// Downsampler shrinking synthetic wallpapers of up to 16384x16384 to
+//   monitor sizes, fed a strip at a time as the wallpaper decoder does
+
+#include "bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../conrep/downsampler.h"
+
+namespace console {
+  namespace {
+    // same as the wallpaper decoder's strips
+    const int STRIP_ROWS = 256;
+
+    // Noisy enough that every tap matters; rows repeat every strip so one
+    //   strip can stand in for an image too large to keep around.
+    Pixel source_pixel(int x, int y) {
+      unsigned n = static_cast<unsigned>(x) * 2654435761u ^ static_cast<unsigned>(y) * 40503u;
+      return 0xff000000 | (n & 0x00ffffff);
+    }
+
+    std::vector<Pixel> make_strip(int width) {
+      std::vector<Pixel> strip(width * STRIP_ROWS);
+      for (int y = 0; y < STRIP_ROWS; ++y) {
+        for (int x = 0; x < width; ++x) strip[y * width + x] = source_pixel(x, y);
+      }
+      return strip;
+    }
+
+    // returns a pixel of the result, so the work isn't optimized away
+    size_t shrink(const std::vector<Pixel> & strip, Dimension source, Dimension dest) {
+      Downsampler downsampler(source, dest);
+      for (int y = 0; y < source.height; y += STRIP_ROWS) {
+        downsampler.add_rows(&strip[0], std::min(STRIP_ROWS, source.height - y), source.width);
+      }
+      return downsampler.image()[dest.width * dest.height / 2];
+    }
+
+    // Exact area average in double precision, one destination pixel at a
+    //   time. Slow, so only for checking small cases.
+    unsigned reference_channel(Dimension source, Dimension dest, int dx, int dy, int shift) {
+      double x0 = static_cast<double>(dx) * source.width / dest.width;
+      double x1 = static_cast<double>(dx + 1) * source.width / dest.width;
+      double y0 = static_cast<double>(dy) * source.height / dest.height;
+      double y1 = static_cast<double>(dy + 1) * source.height / dest.height;
+      double sum = 0;
+      for (int y = static_cast<int>(y0); (y < y1) && (y < source.height); ++y) {
+        double wy = std::min<double>(y + 1, y1) - std::max<double>(y, y0);
+        for (int x = static_cast<int>(x0); (x < x1) && (x < source.width); ++x) {
+          double wx = std::min<double>(x + 1, x1) - std::max<double>(x, x0);
+          sum += ((source_pixel(x, y % STRIP_ROWS) >> shift) & 0xff) * wx * wy;
+        }
+      }
+      return static_cast<unsigned>(sum / ((x1 - x0) * (y1 - y0)) + 0.5);
+    }
+
+    bool matches_reference(Dimension source, Dimension dest) {
+      std::vector<Pixel> strip = make_strip(source.width);
+      Downsampler downsampler(source, dest);
+      for (int y = 0; y < source.height; y += STRIP_ROWS) {
+        downsampler.add_rows(&strip[0], std::min(STRIP_ROWS, source.height - y), source.width);
+      }
+      for (int dy = 0; dy < dest.height; ++dy) {
+        for (int dx = 0; dx < dest.width; ++dx) {
+          Pixel p = downsampler.image()[dy * dest.width + dx];
+          for (int shift = 0; shift < 32; shift += 8) {
+            int diff = static_cast<int>((p >> shift) & 0xff) - static_cast<int>(reference_channel(source, dest, dx, dy, shift));
+            if (std::abs(diff) > 1) return false;
+          }
+        }
+      }
+      return true;
+    }
+
+    void run_case(Dimension source, Dimension dest) {
+      char name[64];
+      std::sprintf(name, "shrink %dx%d to %dx%d", source.width, source.height, dest.width, dest.height);
+      std::vector<Pixel> strip = make_strip(source.width);
+      bench::report(name, "box", bench::time_us([&]() { return shrink(strip, source, dest); }));
+    }
+  }
+
+  BENCHMARK(downsampler) {
+    // odd ratios, so destination pixels straddle source pixels both ways
+    if (!matches_reference(Dimension(1000, 700), Dimension(333, 217))) {
+      bench::mismatch("shrink 1000x700 to 333x217", "box");
+    }
+    run_case(Dimension(4096, 4096), Dimension(1920, 1080));
+    run_case(Dimension(16384, 16384), Dimension(1920, 1080));
+    run_case(Dimension(16384, 16384), Dimension(3840, 2160));
+    run_case(Dimension(16384, 8192), Dimension(2560, 1440));
+  }
+}
\ No newline at end of file
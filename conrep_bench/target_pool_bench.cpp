@@ -0,0 +1,362 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// target_pool_bench.cpp
+// TargetPool replaying resize sequences of console windows: how many
+//   targets get allocated compared to one set per resize, and what the
+//   pool's bookkeeping costs per resize
+
+#include "bench.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "../conrep/target_pool.h"
+
+namespace console {
+  namespace {
+    // the client size of a window at a point in time, in milliseconds
+    struct ResizeStep {
+      unsigned time;
+      int window;
+      int width;
+      int height;
+    };
+
+    // one window dragged by its corner from 640x400 to 1280x800 and back
+    const ResizeStep DRAG_CORNER[] = {
+      {     0, 1,  640,  400 }, {    16, 1,  647,  403 }, {    32, 1,  657,  409 }, {    47, 1,  664,  416 },
+      {    62, 1,  669,  419 }, {    78, 1,  680,  427 }, {    95, 1,  688,  429 }, {   111, 1,  695,  435 },
+      {   127, 1,  704,  438 }, {   158, 1,  715,  446 }, {   175, 1,  717,  449 }, {   206, 1,  726,  453 },
+      {   222, 1,  733,  458 }, {   238, 1,  743,  465 }, {   254, 1,  754,  470 }, {   270, 1,  761,  473 },
+      {   285, 1,  767,  479 }, {   301, 1,  777,  484 }, {   316, 1,  781,  492 }, {   332, 1,  791,  494 },
+      {   348, 1,  801,  501 }, {   364, 1,  810,  505 }, {   395, 1,  819,  511 }, {   411, 1,  822,  516 },
+      {   426, 1,  834,  519 }, {   457, 1,  840,  525 }, {   473, 1,  845,  532 }, {   488, 1,  857,  534 },
+      {   505, 1,  862,  539 }, {   520, 1,  869,  545 }, {   535, 1,  883,  550 }, {   552, 1,  888,  557 },
+      {   567, 1,  899,  559 }, {   582, 1,  904,  567 }, {   598, 1,  909,  568 }, {   629, 1,  922,  573 },
+      {   644, 1,  927,  580 }, {   659, 1,  938,  585 }, {   674, 1,  947,  588 }, {   690, 1,  950,  597 },
+      {   721, 1,  962,  598 }, {   737, 1,  965,  607 }, {   753, 1,  975,  609 }, {   770, 1,  983,  613 },
+      {   787, 1,  989,  619 }, {   803, 1,  998,  624 }, {   818, 1, 1007,  629 }, {   849, 1, 1016,  634 },
+      {   864, 1, 1024,  641 }, {   879, 1, 1030,  644 }, {   895, 1, 1040,  648 }, {   911, 1, 1046,  655 },
+      {   942, 1, 1055,  659 }, {   957, 1, 1061,  665 }, {   972, 1, 1072,  670 }, {   988, 1, 1080,  676 },
+      {  1003, 1, 1085,  682 }, {  1020, 1, 1094,  683 }, {  1051, 1, 1101,  692 }, {  1082, 1, 1111,  693 },
+      {  1098, 1, 1119,  700 }, {  1129, 1, 1131,  703 }, {  1144, 1, 1133,  709 }, {  1160, 1, 1145,  716 },
+      {  1191, 1, 1149,  722 }, {  1207, 1, 1163,  725 }, {  1224, 1, 1165,  729 }, {  1255, 1, 1176,  737 },
+      {  1272, 1, 1184,  740 }, {  1287, 1, 1195,  746 }, {  1302, 1, 1201,  751 }, {  1318, 1, 1206,  754 },
+      {  1334, 1, 1216,  760 }, {  1351, 1, 1222,  767 }, {  1366, 1, 1231,  769 }, {  1381, 1, 1242,  775 },
+      {  1396, 1, 1251,  778 }, {  1413, 1, 1254,  787 }, {  1429, 1, 1263,  788 }, {  1445, 1, 1274,  795 },
+      {  1461, 1, 1280,  800 }, {  1861, 1, 1280,  800 }, {  1876, 1, 1270,  796 }, {  1907, 1, 1264,  789 },
+      {  1924, 1, 1256,  787 }, {  1940, 1, 1249,  782 }, {  1956, 1, 1241,  773 }, {  1973, 1, 1231,  770 },
+      {  1989, 1, 1224,  764 }, {  2006, 1, 1214,  760 }, {  2022, 1, 1210,  757 }, {  2038, 1, 1202,  752 },
+      {  2053, 1, 1194,  745 }, {  2068, 1, 1185,  739 }, {  2084, 1, 1176,  734 }, {  2115, 1, 1169,  730 },
+      {  2132, 1, 1162,  724 }, {  2148, 1, 1150,  720 }, {  2163, 1, 1145,  713 }, {  2179, 1, 1135,  710 },
+      {  2195, 1, 1131,  705 }, {  2210, 1, 1118,  700 }, {  2226, 1, 1109,  694 }, {  2242, 1, 1101,  691 },
+      {  2257, 1, 1097,  683 }, {  2274, 1, 1088,  681 }, {  2305, 1, 1082,  673 }, {  2321, 1, 1075,  670 },
+      {  2352, 1, 1065,  666 }, {  2368, 1, 1056,  661 }, {  2399, 1, 1048,  654 }, {  2415, 1, 1038,  649 },
+      {  2431, 1, 1029,  644 }, {  2448, 1, 1024,  641 }, {  2463, 1, 1019,  635 }, {  2494, 1, 1005,  629 },
+      {  2510, 1, 1002,  625 }, {  2526, 1,  993,  620 }, {  2543, 1,  987,  616 }, {  2558, 1,  975,  612 },
+      {  2574, 1,  970,  604 }, {  2605, 1,  961,  600 }, {  2621, 1,  950,  593 }, {  2637, 1,  947,  591 },
+      {  2653, 1,  935,  587 }, {  2669, 1,  929,  578 }, {  2685, 1,  921,  577 }, {  2716, 1,  909,  568 },
+      {  2732, 1,  904,  567 }, {  2747, 1,  897,  559 }, {  2778, 1,  891,  556 }, {  2795, 1,  880,  548 },
+      {  2811, 1,  875,  544 }, {  2826, 1,  864,  542 }, {  2857, 1,  858,  535 }, {  2873, 1,  846,  530 },
+      {  2889, 1,  837,  523 }, {  2920, 1,  834,  522 }, {  2951, 1,  824,  516 }, {  2967, 1,  819,  509 },
+      {  2998, 1,  810,  504 }, {  3029, 1,  797,  501 }, {  3044, 1,  793,  493 }, {  3060, 1,  781,  490 },
+      {  3076, 1,  775,  485 }, {  3107, 1,  768,  478 }, {  3123, 1,  757,  473 }, {  3154, 1,  754,  469 },
+      {  3170, 1,  742,  463 }, {  3187, 1,  736,  458 }, {  3202, 1,  729,  454 }, {  3219, 1,  721,  452 },
+      {  3236, 1,  709,  445 }, {  3253, 1,  706,  442 }, {  3269, 1,  695,  433 }, {  3286, 1,  686,  429 },
+      {  3317, 1,  682,  423 }, {  3332, 1,  675,  420 }, {  3348, 1,  666,  414 }, {  3364, 1,  654,  410 },
+      {  3379, 1,  645,  403 }, {  3395, 1,  640,  400 }
+    };
+
+    // two windows taking turns: one dragged wider and back, the other shorter
+    //   and back
+    const ResizeStep TWO_WINDOWS[] = {
+      {     0, 1,  648,  404 }, {    31, 1,  666,  404 }, {    62, 1,  684,  406 }, {    93, 1,  702,  404 },
+      {   108, 1,  720,  402 }, {   139, 1,  743,  406 }, {   156, 1,  758,  403 }, {   172, 1,  780,  404 },
+      {   188, 1,  796,  404 }, {   203, 1,  815,  406 }, {   219, 1,  839,  405 }, {   235, 1,  857,  402 },
+      {   250, 1,  871,  402 }, {   281, 1,  890,  406 }, {   297, 1,  910,  404 }, {   312, 1,  929,  402 },
+      {   329, 1,  945,  404 }, {   345, 1,  969,  405 }, {   362, 1,  989,  404 }, {   377, 1, 1002,  402 },
+      {   392, 1, 1021,  406 }, {   408, 1, 1042,  404 }, {   425, 1, 1062,  404 }, {   440, 1, 1083,  405 },
+      {   455, 1, 1096,  405 }, {   470, 1, 1117,  402 }, {   501, 1, 1137,  402 }, {   516, 1, 1158,  404 },
+      {   531, 1, 1174,  405 }, {   546, 1, 1192,  406 }, {   561, 1, 1214,  402 }, {   576, 1, 1231,  402 },
+      {   607, 1, 1247,  405 }, {   623, 1, 1267,  404 }, {   654, 1, 1284,  406 }, {   669, 1, 1308,  402 },
+      {   685, 1, 1327,  404 }, {   716, 1, 1343,  405 }, {   733, 1, 1359,  402 }, {   750, 1, 1378,  403 },
+      {   766, 1, 1400,  404 }, {   966, 2,  808,  604 }, {   997, 2,  806,  595 }, {  1028, 2,  811,  585 },
+      {  1059, 2,  806,  572 }, {  1075, 2,  807,  561 }, {  1091, 2,  807,  555 }, {  1122, 2,  808,  543 },
+      {  1139, 2,  808,  531 }, {  1155, 2,  809,  520 }, {  1171, 2,  810,  511 }, {  1187, 2,  811,  501 },
+      {  1218, 2,  809,  494 }, {  1249, 2,  806,  480 }, {  1265, 2,  807,  471 }, {  1296, 2,  805,  464 },
+      {  1311, 2,  810,  450 }, {  1327, 2,  805,  442 }, {  1344, 2,  809,  431 }, {  1360, 2,  805,  422 },
+      {  1376, 2,  807,  411 }, {  1392, 2,  806,  401 }, {  1409, 2,  808,  389 }, {  1425, 2,  806,  380 },
+      {  1442, 2,  808,  370 }, {  1458, 2,  808,  362 }, {  1475, 2,  805,  348 }, {  1491, 2,  808,  339 },
+      {  1522, 2,  809,  332 }, {  1537, 2,  808,  320 }, {  1552, 2,  805,  312 }, {  1569, 2,  808,  300 },
+      {  1769, 1, 1400,  404 }, {  1784, 1, 1383,  402 }, {  1800, 1, 1359,  403 }, {  1817, 1, 1344,  402 },
+      {  1848, 1, 1323,  403 }, {  1864, 1, 1308,  406 }, {  1880, 1, 1286,  403 }, {  1896, 1, 1268,  402 },
+      {  1912, 1, 1251,  406 }, {  1943, 1, 1232,  402 }, {  1974, 1, 1210,  405 }, {  1990, 1, 1193,  404 },
+      {  2006, 1, 1171,  402 }, {  2037, 1, 1155,  405 }, {  2053, 1, 1135,  403 }, {  2068, 1, 1120,  403 },
+      {  2083, 1, 1097,  403 }, {  2098, 1, 1081,  402 }, {  2114, 1, 1058,  404 }, {  2130, 1, 1039,  405 },
+      {  2146, 1, 1022,  405 }, {  2161, 1, 1005,  404 }, {  2192, 1,  984,  402 }, {  2208, 1,  967,  402 },
+      {  2225, 1,  948,  405 }, {  2242, 1,  931,  402 }, {  2258, 1,  912,  406 }, {  2289, 1,  894,  403 },
+      {  2305, 1,  870,  406 }, {  2320, 1,  852,  402 }, {  2351, 1,  839,  402 }, {  2367, 1,  815,  405 },
+      {  2383, 1,  795,  403 }, {  2399, 1,  778,  404 }, {  2416, 1,  762,  406 }, {  2432, 1,  739,  404 },
+      {  2447, 1,  721,  406 }, {  2464, 1,  705,  406 }, {  2480, 1,  684,  402 }, {  2496, 1,  666,  406 },
+      {  2511, 1,  648,  404 }, {  2711, 2,  808,  300 }, {  2728, 2,  808,  311 }, {  2759, 2,  809,  321 },
+      {  2775, 2,  806,  328 }, {  2806, 2,  806,  341 }, {  2823, 2,  810,  352 }, {  2854, 2,  809,  362 },
+      {  2885, 2,  805,  372 }, {  2902, 2,  806,  379 }, {  2919, 2,  807,  389 }, {  2934, 2,  809,  401 },
+      {  2950, 2,  806,  409 }, {  2965, 2,  806,  420 }, {  2980, 2,  805,  430 }, {  2996, 2,  808,  442 },
+      {  3027, 2,  809,  452 }, {  3043, 2,  811,  463 }, {  3059, 2,  806,  470 }, {  3075, 2,  805,  484 },
+      {  3091, 2,  808,  493 }, {  3107, 2,  811,  500 }, {  3123, 2,  807,  513 }, {  3138, 2,  811,  520 },
+      {  3155, 2,  806,  531 }, {  3186, 2,  811,  544 }, {  3217, 2,  806,  552 }, {  3233, 2,  809,  564 },
+      {  3264, 2,  806,  572 }, {  3280, 2,  805,  585 }, {  3311, 2,  806,  593 }, {  3327, 2,  808,  604 },
+      {  4327, 1,  648,  404 }, {  4343, 1,  669,  402 }, {  4374, 1,  683,  405 }, {  4391, 1,  701,  406 },
+      {  4406, 1,  720,  405 }, {  4437, 1,  744,  406 }, {  4468, 1,  759,  406 }, {  4484, 1,  779,  402 },
+      {  4515, 1,  798,  404 }, {  4546, 1,  815,  406 }, {  4563, 1,  838,  402 }, {  4580, 1,  851,  406 },
+      {  4595, 1,  876,  406 }, {  4626, 1,  895,  403 }, {  4643, 1,  911,  403 }, {  4659, 1,  928,  406 },
+      {  4690, 1,  950,  404 }, {  4706, 1,  970,  404 }, {  4737, 1,  988,  403 }, {  4754, 1, 1004,  404 },
+      {  4770, 1, 1027,  403 }, {  4786, 1, 1041,  402 }, {  4801, 1, 1064,  404 }, {  4818, 1, 1078,  404 },
+      {  4835, 1, 1097,  406 }, {  4866, 1, 1117,  406 }, {  4882, 1, 1134,  406 }, {  4898, 1, 1154,  405 },
+      {  4929, 1, 1176,  402 }, {  4945, 1, 1192,  402 }, {  4961, 1, 1210,  405 }, {  4976, 1, 1232,  404 },
+      {  4993, 1, 1247,  405 }, {  5008, 1, 1265,  402 }, {  5039, 1, 1286,  404 }, {  5055, 1, 1303,  406 },
+      {  5071, 1, 1323,  402 }, {  5087, 1, 1345,  402 }, {  5103, 1, 1362,  405 }, {  5118, 1, 1383,  402 },
+      {  5134, 1, 1400,  404 }, {  5334, 2,  808,  604 }, {  5365, 2,  806,  592 }, {  5380, 2,  808,  583 },
+      {  5395, 2,  806,  571 }, {  5411, 2,  805,  561 }, {  5427, 2,  807,  552 }, {  5458, 2,  805,  543 },
+      {  5489, 2,  809,  535 }, {  5506, 2,  805,  521 }, {  5521, 2,  805,  511 }, {  5536, 2,  808,  503 },
+      {  5551, 2,  810,  490 }, {  5568, 2,  807,  483 }, {  5584, 2,  809,  471 }, {  5599, 2,  811,  462 },
+      {  5615, 2,  805,  452 }, {  5632, 2,  810,  442 }, {  5648, 2,  809,  433 }, {  5664, 2,  809,  420 },
+      {  5679, 2,  810,  409 }, {  5695, 2,  807,  399 }, {  5711, 2,  807,  392 }, {  5727, 2,  810,  381 },
+      {  5743, 2,  805,  370 }, {  5758, 2,  807,  358 }, {  5774, 2,  809,  349 }, {  5805, 2,  808,  340 },
+      {  5822, 2,  805,  328 }, {  5838, 2,  811,  321 }, {  5854, 2,  805,  309 }, {  5871, 2,  808,  300 },
+      {  6071, 1, 1400,  404 }, {  6087, 1, 1383,  402 }, {  6103, 1, 1362,  403 }, {  6120, 1, 1343,  404 },
+      {  6136, 1, 1324,  402 }, {  6152, 1, 1307,  405 }, {  6168, 1, 1289,  404 }, {  6199, 1, 1265,  405 },
+      {  6216, 1, 1250,  405 }, {  6247, 1, 1231,  405 }, {  6264, 1, 1212,  404 }, {  6280, 1, 1195,  404 },
+      {  6311, 1, 1171,  402 }, {  6342, 1, 1154,  402 }, {  6357, 1, 1136,  406 }, {  6373, 1, 1116,  406 },
+      {  6390, 1, 1097,  403 }, {  6406, 1, 1081,  402 }, {  6421, 1, 1061,  404 }, {  6437, 1, 1041,  404 },
+      {  6453, 1, 1022,  403 }, {  6484, 1, 1005,  404 }, {  6515, 1,  984,  406 }, {  6530, 1,  970,  405 },
+      {  6547, 1,  948,  403 }, {  6564, 1,  927,  406 }, {  6579, 1,  910,  405 }, {  6610, 1,  894,  406 },
+      {  6626, 1,  870,  402 }, {  6643, 1,  852,  402 }, {  6660, 1,  835,  404 }, {  6676, 1,  815,  402 },
+      {  6707, 1,  799,  402 }, {  6723, 1,  782,  404 }, {  6738, 1,  757,  405 }, {  6754, 1,  740,  402 },
+      {  6785, 1,  721,  405 }, {  6802, 1,  704,  402 }, {  6817, 1,  684,  405 }, {  6834, 1,  667,  402 },
+      {  6865, 1,  648,  404 }, {  7065, 2,  808,  300 }, {  7081, 2,  806,  311 }, {  7096, 2,  807,  320 },
+      {  7112, 2,  808,  330 }, {  7129, 2,  809,  341 }, {  7160, 2,  811,  350 }, {  7175, 2,  807,  358 },
+      {  7190, 2,  808,  371 }, {  7221, 2,  809,  381 }, {  7237, 2,  810,  393 }, {  7253, 2,  808,  401 },
+      {  7269, 2,  808,  412 }, {  7286, 2,  809,  420 }, {  7301, 2,  805,  432 }, {  7316, 2,  809,  441 },
+      {  7347, 2,  805,  454 }, {  7378, 2,  811,  461 }, {  7393, 2,  809,  471 }, {  7409, 2,  805,  483 },
+      {  7424, 2,  805,  491 }, {  7440, 2,  811,  504 }, {  7456, 2,  809,  511 }, {  7471, 2,  811,  524 },
+      {  7487, 2,  808,  533 }, {  7502, 2,  808,  541 }, {  7519, 2,  809,  552 }, {  7536, 2,  811,  563 },
+      {  7567, 2,  811,  572 }, {  7582, 2,  811,  583 }, {  7598, 2,  809,  593 }, {  7614, 2,  808,  604 },
+      {  8614, 1,  648,  404 }, {  8630, 1,  669,  405 }, {  8646, 1,  685,  405 }, {  8663, 1,  703,  402 },
+      {  8678, 1,  720,  403 }, {  8709, 1,  739,  404 }, {  8726, 1,  763,  406 }, {  8742, 1,  776,  402 },
+      {  8758, 1,  800,  405 }, {  8774, 1,  817,  402 }, {  8790, 1,  839,  403 }, {  8806, 1,  853,  402 },
+      {  8822, 1,  875,  404 }, {  8853, 1,  895,  403 }, {  8884, 1,  913,  403 }, {  8915, 1,  930,  405 },
+      {  8946, 1,  949,  405 }, {  8963, 1,  967,  402 }, {  8979, 1,  986,  402 }, {  8994, 1, 1008,  403 },
+      {  9010, 1, 1022,  406 }, {  9027, 1, 1044,  403 }, {  9043, 1, 1062,  406 }, {  9059, 1, 1078,  405 },
+      {  9074, 1, 1100,  403 }, {  9090, 1, 1115,  403 }, {  9105, 1, 1135,  405 }, {  9121, 1, 1154,  403 },
+      {  9138, 1, 1172,  402 }, {  9169, 1, 1195,  402 }, {  9185, 1, 1215,  406 }, {  9202, 1, 1229,  403 },
+      {  9219, 1, 1251,  402 }, {  9236, 1, 1270,  404 }, {  9251, 1, 1290,  402 }, {  9282, 1, 1303,  404 },
+      {  9313, 1, 1325,  406 }, {  9328, 1, 1342,  403 }, {  9344, 1, 1361,  402 }, {  9359, 1, 1379,  403 },
+      {  9375, 1, 1400,  404 }, {  9575, 2,  808,  604 }, {  9591, 2,  810,  594 }, {  9607, 2,  809,  584 },
+      {  9623, 2,  808,  572 }, {  9639, 2,  807,  561 }, {  9654, 2,  811,  555 }, {  9685, 2,  811,  543 },
+      {  9700, 2,  805,  531 }, {  9717, 2,  808,  522 }, {  9732, 2,  805,  514 }, {  9763, 2,  808,  504 },
+      {  9779, 2,  808,  494 }, {  9795, 2,  806,  481 }, {  9811, 2,  811,  471 }, {  9828, 2,  808,  462 },
+      {  9845, 2,  811,  453 }, {  9860, 2,  808,  439 }, {  9877, 2,  805,  429 }, {  9908, 2,  809,  419 },
+      {  9924, 2,  811,  410 }, {  9940, 2,  808,  401 }, {  9955, 2,  808,  389 }, {  9971, 2,  809,  382 },
+      {  9987, 2,  806,  370 }, { 10002, 2,  807,  359 }, { 10018, 2,  807,  349 }, { 10033, 2,  808,  340 },
+      { 10050, 2,  811,  331 }, { 10081, 2,  811,  320 }, { 10097, 2,  809,  311 }, { 10113, 2,  808,  300 },
+      { 10313, 1, 1400,  404 }, { 10330, 1, 1380,  402 }, { 10346, 1, 1365,  406 }, { 10362, 1, 1345,  404 },
+      { 10378, 1, 1324,  403 }, { 10393, 1, 1307,  406 }, { 10424, 1, 1288,  406 }, { 10440, 1, 1270,  403 },
+      { 10471, 1, 1248,  404 }, { 10487, 1, 1229,  402 }, { 10518, 1, 1213,  403 }, { 10535, 1, 1193,  403 },
+      { 10550, 1, 1175,  403 }, { 10566, 1, 1155,  406 }, { 10583, 1, 1135,  406 }, { 10614, 1, 1117,  402 },
+      { 10645, 1, 1096,  403 }, { 10661, 1, 1079,  406 }, { 10677, 1, 1059,  403 }, { 10694, 1, 1044,  403 },
+      { 10725, 1, 1025,  403 }, { 10741, 1, 1002,  406 }, { 10757, 1,  989,  405 }, { 10772, 1,  964,  402 },
+      { 10789, 1,  948,  404 }, { 10820, 1,  928,  404 }, { 10837, 1,  914,  402 }, { 10854, 1,  895,  403 },
+      { 10871, 1,  873,  405 }, { 10887, 1,  853,  402 }, { 10903, 1,  839,  403 }, { 10919, 1,  817,  402 },
+      { 10950, 1,  801,  406 }, { 10966, 1,  782,  404 }, { 10982, 1,  757,  402 }, { 10998, 1,  744,  402 },
+      { 11014, 1,  722,  402 }, { 11045, 1,  707,  405 }, { 11061, 1,  684,  403 }, { 11078, 1,  666,  403 },
+      { 11094, 1,  648,  404 }, { 11294, 2,  808,  300 }, { 11309, 2,  809,  312 }, { 11324, 2,  807,  318 },
+      { 11340, 2,  805,  330 }, { 11355, 2,  807,  338 }, { 11371, 2,  805,  352 }, { 11387, 2,  808,  362 },
+      { 11403, 2,  809,  371 }, { 11420, 2,  811,  379 }, { 11437, 2,  809,  389 }, { 11468, 2,  805,  400 },
+      { 11484, 2,  806,  410 }, { 11499, 2,  809,  423 }, { 11516, 2,  805,  432 }, { 11532, 2,  809,  440 },
+      { 11549, 2,  808,  453 }, { 11564, 2,  807,  463 }, { 11580, 2,  810,  470 }, { 11611, 2,  810,  484 },
+      { 11628, 2,  811,  492 }, { 11644, 2,  810,  502 }, { 11675, 2,  806,  513 }, { 11691, 2,  808,  521 },
+      { 11706, 2,  810,  535 }, { 11737, 2,  807,  542 }, { 11752, 2,  807,  551 }, { 11783, 2,  810,  565 },
+      { 11798, 2,  811,  573 }, { 11829, 2,  811,  581 }, { 11860, 2,  808,  591 }, { 11876, 2,  808,  604 },
+      { 12876, 1,  648,  404 }, { 12893, 1,  665,  406 }, { 12924, 1,  687,  404 }, { 12941, 1,  703,  406 },
+      { 12957, 1,  726,  405 }, { 12988, 1,  740,  406 }, { 13004, 1,  757,  402 }, { 13020, 1,  781,  405 },
+      { 13037, 1,  799,  405 }, { 13053, 1,  815,  406 }, { 13068, 1,  837,  404 }, { 13083, 1,  856,  402 },
+      { 13098, 1,  874,  404 }, { 13114, 1,  892,  404 }, { 13130, 1,  914,  403 }, { 13145, 1,  933,  405 },
+      { 13176, 1,  946,  403 }, { 13192, 1,  970,  405 }, { 13209, 1,  986,  404 }, { 13224, 1, 1004,  403 },
+      { 13255, 1, 1021,  403 }, { 13271, 1, 1045,  403 }, { 13288, 1, 1058,  406 }, { 13304, 1, 1080,  402 },
+      { 13319, 1, 1098,  402 }, { 13350, 1, 1115,  403 }, { 13366, 1, 1137,  403 }, { 13397, 1, 1155,  405 },
+      { 13414, 1, 1172,  405 }, { 13431, 1, 1193,  403 }, { 13446, 1, 1214,  402 }, { 13463, 1, 1233,  405 },
+      { 13494, 1, 1251,  403 }, { 13511, 1, 1269,  405 }, { 13528, 1, 1284,  406 }, { 13544, 1, 1309,  403 },
+      { 13560, 1, 1324,  403 }, { 13591, 1, 1343,  402 }, { 13607, 1, 1362,  403 }, { 13623, 1, 1383,  402 },
+      { 13639, 1, 1400,  404 }, { 13839, 2,  808,  604 }, { 13870, 2,  809,  594 }, { 13886, 2,  805,  581 },
+      { 13902, 2,  811,  572 }, { 13917, 2,  808,  562 }, { 13948, 2,  806,  555 }, { 13964, 2,  805,  541 },
+      { 13995, 2,  806,  531 }, { 14011, 2,  806,  522 }, { 14026, 2,  805,  514 }, { 14041, 2,  807,  501 },
+      { 14057, 2,  811,  493 }, { 14072, 2,  811,  483 }, { 14089, 2,  806,  471 }, { 14104, 2,  805,  464 },
+      { 14120, 2,  810,  454 }, { 14137, 2,  806,  440 }, { 14168, 2,  807,  431 }, { 14199, 2,  809,  419 },
+      { 14214, 2,  810,  409 }, { 14230, 2,  811,  403 }, { 14246, 2,  807,  393 }, { 14262, 2,  807,  380 },
+      { 14278, 2,  810,  369 }, { 14294, 2,  810,  359 }, { 14325, 2,  808,  349 }, { 14342, 2,  810,  342 },
+      { 14358, 2,  805,  328 }, { 14389, 2,  809,  321 }, { 14405, 2,  811,  310 }, { 14421, 2,  808,  300 },
+      { 14621, 1, 1400,  404 }, { 14637, 1, 1379,  406 }, { 14652, 1, 1360,  404 }, { 14668, 1, 1346,  403 },
+      { 14684, 1, 1324,  406 }, { 14700, 1, 1305,  405 }, { 14716, 1, 1284,  404 }, { 14733, 1, 1265,  402 },
+      { 14749, 1, 1247,  404 }, { 14780, 1, 1232,  403 }, { 14811, 1, 1214,  405 }, { 14827, 1, 1192,  402 },
+      { 14842, 1, 1174,  402 }, { 14859, 1, 1155,  405 }, { 14874, 1, 1138,  405 }, { 14890, 1, 1118,  406 },
+      { 14906, 1, 1101,  402 }, { 14937, 1, 1080,  402 }, { 14953, 1, 1063,  405 }, { 14969, 1, 1042,  406 },
+      { 15000, 1, 1023,  406 }, { 15017, 1, 1002,  404 }, { 15033, 1,  988,  402 }, { 15049, 1,  970,  405 },
+      { 15065, 1,  945,  406 }, { 15082, 1,  929,  403 }, { 15099, 1,  911,  402 }, { 15115, 1,  894,  405 },
+      { 15132, 1,  870,  406 }, { 15147, 1,  851,  402 }, { 15178, 1,  839,  405 }, { 15193, 1,  820,  404 },
+      { 15209, 1,  796,  405 }, { 15224, 1,  782,  404 }, { 15239, 1,  761,  406 }, { 15256, 1,  742,  405 },
+      { 15273, 1,  722,  403 }, { 15289, 1,  704,  403 }, { 15305, 1,  682,  406 }, { 15321, 1,  669,  404 },
+      { 15338, 1,  648,  404 }, { 15538, 2,  808,  300 }, { 15554, 2,  810,  312 }, { 15571, 2,  805,  321 },
+      { 15586, 2,  806,  328 }, { 15602, 2,  805,  342 }, { 15618, 2,  809,  352 }, { 15633, 2,  810,  358 },
+      { 15664, 2,  809,  369 }, { 15680, 2,  811,  380 }, { 15697, 2,  809,  389 }, { 15713, 2,  806,  399 },
+      { 15744, 2,  806,  410 }, { 15759, 2,  808,  420 }, { 15776, 2,  806,  431 }, { 15791, 2,  808,  439 },
+      { 15808, 2,  806,  452 }, { 15824, 2,  806,  461 }, { 15840, 2,  808,  474 }, { 15855, 2,  810,  480 },
+      { 15870, 2,  805,  491 }, { 15886, 2,  808,  503 }, { 15902, 2,  805,  513 }, { 15919, 2,  807,  524 },
+      { 15950, 2,  811,  533 }, { 15967, 2,  805,  542 }, { 15983, 2,  810,  551 }, { 16014, 2,  807,  562 },
+      { 16031, 2,  811,  571 }, { 16047, 2,  805,  583 }, { 16063, 2,  810,  595 }, { 16079, 2,  808,  604 }
+    };
+
+    // an 80x25 window stepped through font sizes 8 to 20 with --adjust and
+    //   back
+    const ResizeStep FONT_SIZES[] = {
+      {     0, 1,  484,  304 }, {   250, 1,  564,  354 }, {   500, 1,  644,  404 }, {   800, 1,  724,  429 },
+      {  1050, 1,  804,  454 }, {  1350, 1,  884,  529 }, {  1750, 1, 1044,  604 }, {  2000, 1, 1124,  679 },
+      {  2300, 1, 1284,  754 }, {  2550, 1, 1284,  754 }, {  2800, 1, 1124,  679 }, {  3100, 1, 1044,  604 },
+      {  3350, 1,  884,  529 }, {  3750, 1,  804,  454 }, {  4150, 1,  724,  429 }, {  4400, 1,  644,  404 },
+      {  4650, 1,  564,  354 }, {  4950, 1,  484,  304 }, {  5200, 1,  484,  304 }, {  5500, 1,  564,  354 },
+      {  5750, 1,  644,  404 }, {  6000, 1,  724,  429 }, {  6300, 1,  804,  454 }, {  6600, 1,  884,  529 },
+      {  6900, 1, 1044,  604 }, {  7150, 1, 1124,  679 }, {  7550, 1, 1284,  754 }, {  7800, 1, 1284,  754 },
+      {  8200, 1, 1124,  679 }, {  8600, 1, 1044,  604 }, {  8850, 1,  884,  529 }, {  9250, 1,  804,  454 },
+      {  9650, 1,  724,  429 }, {  9950, 1,  644,  404 }, { 10200, 1,  564,  354 }, { 10500, 1,  484,  304 },
+      { 10900, 1,  484,  304 }, { 11150, 1,  564,  354 }, { 11450, 1,  644,  404 }, { 11750, 1,  724,  429 },
+      { 12000, 1,  804,  454 }, { 12400, 1,  884,  529 }, { 12650, 1, 1044,  604 }, { 12900, 1, 1124,  679 },
+      { 13300, 1, 1284,  754 }, { 13700, 1, 1284,  754 }, { 14000, 1, 1124,  679 }, { 14250, 1, 1044,  604 },
+      { 14650, 1,  884,  529 }, { 15050, 1,  804,  454 }, { 15450, 1,  724,  429 }, { 15750, 1,  644,  404 },
+      { 16150, 1,  564,  354 }, { 16450, 1,  484,  304 }, { 16850, 1,  484,  304 }, { 17100, 1,  564,  354 },
+      { 17400, 1,  644,  404 }, { 17800, 1,  724,  429 }, { 18050, 1,  804,  454 }, { 18350, 1,  884,  529 },
+      { 18600, 1, 1044,  604 }, { 18850, 1, 1124,  679 }, { 19100, 1, 1284,  754 }, { 19350, 1, 1284,  754 },
+      { 19650, 1, 1124,  679 }, { 19900, 1, 1044,  604 }, { 20300, 1,  884,  529 }, { 20550, 1,  804,  454 },
+      { 20800, 1,  724,  429 }, { 21100, 1,  644,  404 }, { 21400, 1,  564,  354 }, { 21800, 1,  484,  304 },
+      { 22100, 1,  484,  304 }, { 22400, 1,  564,  354 }, { 22800, 1,  644,  404 }, { 23100, 1,  724,  429 },
+      { 23350, 1,  804,  454 }, { 23750, 1,  884,  529 }, { 24000, 1, 1044,  604 }, { 24400, 1, 1124,  679 },
+      { 24800, 1, 1284,  754 }, { 25050, 1, 1284,  754 }, { 25350, 1, 1124,  679 }, { 25600, 1, 1044,  604 },
+      { 25850, 1,  884,  529 }, { 26150, 1,  804,  454 }, { 26400, 1,  724,  429 }, { 26700, 1,  644,  404 },
+      { 27100, 1,  564,  354 }, { 27350, 1,  484,  304 }, { 27750, 1,  484,  304 }, { 28050, 1,  564,  354 },
+      { 28300, 1,  644,  404 }, { 28700, 1,  724,  429 }, { 28950, 1,  804,  454 }, { 29350, 1,  884,  529 },
+      { 29650, 1, 1044,  604 }, { 29900, 1, 1124,  679 }, { 30300, 1, 1284,  754 }, { 30600, 1, 1284,  754 },
+      { 30850, 1, 1124,  679 }, { 31250, 1, 1044,  604 }, { 31500, 1,  884,  529 }, { 31900, 1,  804,  454 },
+      { 32300, 1,  724,  429 }, { 32600, 1,  644,  404 }, { 32900, 1,  564,  354 }, { 33200, 1,  484,  304 }
+    };
+
+    // maximized and restored, sometimes left long enough for idle targets to
+    //   be evicted
+    const ResizeStep MAXIMIZE[] = {
+      {     0, 1,  648,  404 }, {  3000, 1, 1920, 1040 }, {  5000, 1,  648,  404 }, {  6500, 1, 1920, 1040 },
+      { 18500, 1,  648,  404 }, { 20000, 1, 1920, 1040 }, { 22000, 1,  648,  404 }, { 25000, 1, 1920, 1040 },
+      { 37000, 1,  648,  404 }, { 37800, 1, 1920, 1040 }, { 49800, 1,  648,  404 }, { 52800, 1, 1920, 1040 },
+      { 53600, 1,  648,  404 }, { 56600, 1, 1920, 1040 }, { 57400, 1,  648,  404 }, { 58900, 1, 1920, 1040 },
+      { 60900, 1,  648,  404 }, { 61700, 1, 1920, 1040 }, { 73700, 1,  648,  404 }, { 74500, 1, 1920, 1040 },
+      { 75300, 1,  648,  404 }, { 76100, 1, 1920, 1040 }, { 76900, 1,  648,  404 }, { 78400, 1, 1920, 1040 },
+      { 79200, 1,  648,  404 }, { 82200, 1, 1920, 1040 }, { 83000, 1,  648,  404 }, { 86000, 1, 1920, 1040 },
+      { 88000, 1,  648,  404 }, { 91000, 1, 1920, 1040 }, { 91800, 1,  648,  404 }, { 92600, 1, 1920, 1040 },
+      { 93400, 1,  648,  404 }, { 94900, 1, 1920, 1040 }, { 95700, 1,  648,  404 }, { 96500, 1, 1920, 1040 },
+      { 98500, 1,  648,  404 }, { 100000, 1, 1920, 1040 }, { 102000, 1,  648,  404 }, { 102800, 1, 1920, 1040 },
+      { 104800, 1,  648,  404 }, { 106300, 1, 1920, 1040 }, { 118300, 1,  648,  404 }, { 119100, 1, 1920, 1040 },
+      { 121100, 1,  648,  404 }, { 122600, 1, 1920, 1040 }, { 124600, 1,  648,  404 }, { 126100, 1, 1920, 1040 },
+      { 128100, 1,  648,  404 }, { 128900, 1, 1920, 1040 }, { 130900, 1,  648,  404 }, { 131700, 1, 1920, 1040 },
+      { 133700, 1,  648,  404 }, { 134500, 1, 1920, 1040 }, { 135300, 1,  648,  404 }, { 138300, 1, 1920, 1040 },
+      { 139100, 1,  648,  404 }, { 139900, 1, 1920, 1040 }, { 140700, 1,  648,  404 }, { 141500, 1, 1920, 1040 },
+      { 142300, 1,  648,  404 }, { 143800, 1, 1920, 1040 }, { 144600, 1,  648,  404 }, { 147600, 1, 1920, 1040 },
+      { 159600, 1,  648,  404 }, { 162600, 1, 1920, 1040 }, { 164600, 1,  648,  404 }, { 165400, 1, 1920, 1040 },
+      { 166200, 1,  648,  404 }, { 167700, 1, 1920, 1040 }, { 168500, 1,  648,  404 }, { 169300, 1, 1920, 1040 },
+      { 170100, 1,  648,  404 }, { 173100, 1, 1920, 1040 }, { 173900, 1,  648,  404 }, { 175400, 1, 1920, 1040 },
+      { 187400, 1,  648,  404 }, { 188900, 1, 1920, 1040 }, { 189700, 1,  648,  404 }, { 190500, 1, 1920, 1040 },
+      { 191300, 1,  648,  404 }, { 194300, 1, 1920, 1040 }, { 196300, 1,  648,  404 }, { 199300, 1, 1920, 1040 },
+      { 211300, 1,  648,  404 }, { 212800, 1, 1920, 1040 }, { 213600, 1,  648,  404 }, { 214400, 1, 1920, 1040 },
+      { 226400, 1,  648,  404 }, { 227200, 1, 1920, 1040 }, { 239200, 1,  648,  404 }, { 240700, 1, 1920, 1040 },
+      { 242700, 1,  648,  404 }, { 245700, 1, 1920, 1040 }, { 246500, 1,  648,  404 }, { 249500, 1, 1920, 1040 },
+      { 261500, 1,  648,  404 }, { 263000, 1, 1920, 1040 }, { 275000, 1,  648,  404 }, { 276500, 1, 1920, 1040 }
+    };
+
+    // as in timer.h and d3root.cpp
+    const unsigned TARGET_IDLE_TIME = 10000;
+    const std::uint64_t TEXTURE_POOL_BYTES = 64 << 20;
+    const std::uint64_t SWAP_CHAIN_POOL_BYTES = 32 << 20;
+    const unsigned BYTES_PER_PIXEL = 4;
+    // a swap chain and the text, scroll, frame and background textures
+    const int TEXTURES_PER_WINDOW = 4;
+    const int TARGETS_PER_WINDOW = 1 + TEXTURES_PER_WINDOW;
+    const int MAX_WINDOWS = 3;
+
+    struct WindowTargets {
+      bool open;
+      int swap_chain;
+      int textures[TEXTURES_PER_WINDOW];
+    };
+
+    int acquire(TargetPool & pool, Dimension dim, std::uintptr_t key, std::uint32_t now) {
+      int id = pool.acquire(dim, key, now);
+      if (id < 0) id = pool.add(target_bucket(dim), key, now);
+      return id;
+    }
+
+    // Resizes the way ConsoleWindowImpl::acquire_targets() does: the old
+    //   targets go back first, then a swap chain keyed by the window and the
+    //   textures, which any window can use. Trimmed at every step, as often
+    //   as the pool could be. Returns the number of targets allocated.
+    size_t replay(const ResizeStep * steps, size_t count) {
+      TargetPool textures(TARGET_IDLE_TIME, TEXTURE_POOL_BYTES, BYTES_PER_PIXEL);
+      TargetPool swap_chains(TARGET_IDLE_TIME, SWAP_CHAIN_POOL_BYTES, BYTES_PER_PIXEL);
+      WindowTargets windows[MAX_WINDOWS] = {};
+      std::vector<int> evicted;
+      for (size_t i = 0; i < count; ++i) {
+        const ResizeStep & step = steps[i];
+        WindowTargets & window = windows[step.window];
+        if (window.open) {
+          swap_chains.release(window.swap_chain, step.time);
+          for (int t = 0; t < TEXTURES_PER_WINDOW; ++t) textures.release(window.textures[t], step.time);
+        }
+        Dimension dim(step.width, step.height);
+        window.swap_chain = acquire(swap_chains, dim, static_cast<std::uintptr_t>(step.window), step.time);
+        for (int t = 0; t < TEXTURES_PER_WINDOW; ++t) window.textures[t] = acquire(textures, dim, 0, step.time);
+        window.open = true;
+        textures.trim(step.time, evicted);
+        swap_chains.trim(step.time, evicted);
+      }
+      return static_cast<size_t>(textures.counts().misses + swap_chains.counts().misses);
+    }
+
+    void run_sequence(const char * sequence, const ResizeStep * steps, size_t count) {
+      char name[64];
+      std::sprintf(name, "replay %s", sequence);
+      std::printf("%-36s %-12s %12u of %u allocations\n", name, "pool",
+                  static_cast<unsigned>(replay(steps, count)),
+                  static_cast<unsigned>(count * TARGETS_PER_WINDOW));
+      double us = bench::time_us([&]() { return replay(steps, count); });
+      bench::report(name, "per resize", us / count);
+    }
+  }
+
+  BENCHMARK(target_pool) {
+    run_sequence("drag corner", DRAG_CORNER, sizeof(DRAG_CORNER) / sizeof(DRAG_CORNER[0]));
+    run_sequence("two windows", TWO_WINDOWS, sizeof(TWO_WINDOWS) / sizeof(TWO_WINDOWS[0]));
+    run_sequence("font sizes", FONT_SIZES, sizeof(FONT_SIZES) / sizeof(FONT_SIZES[0]));
+    run_sequence("maximize", MAXIMIZE, sizeof(MAXIMIZE) / sizeof(MAXIMIZE[0]));
+  }
+}
\ No newline at end of file
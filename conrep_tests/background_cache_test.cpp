@@ -0,0 +1,122 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// background_cache_test.cpp
+// tests for the background cache file layout
+
+#include "test.h"
+
+#include <string>
+#include <vector>
+
+#include "../conrep/background_cache.h"
+
+namespace console {
+  namespace {
+    BackgroundKey sample_key(void) {
+      BackgroundKey key;
+      key.wallpaper_name = L"C:\\Windows\\Web\\Wallpaper\\img0.jpg";
+      key.modify_time = 130000000000000000ull;
+      key.style = 2;
+      key.background_color = 0x003a6ea5;
+      PixelRect monitor = { -640, 0, 0, 480 };
+      key.monitor = monitor;
+      key.origin_x = -640;
+      key.origin_y = 0;
+      key.os_version = 0x0601;
+      return key;
+    }
+
+    // a 640x480 background in a buffer with a wider stride, and the file
+    //   written from it
+    struct CacheFile {
+      std::vector<Pixel> pixels;
+      std::vector<unsigned char> bytes;
+
+      explicit CacheFile(const BackgroundKey & key) {
+        const int stride = 700;
+        Dimension dim(640, 480);
+        pixels.resize(stride * dim.height);
+        for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = static_cast<Pixel>(i * 2654435761u);
+        // a vector of Pixel keeps the pixels as aligned as a mapped view would
+        std::vector<Pixel> storage((background_cache_size(key, dim) + sizeof(Pixel) - 1) / sizeof(Pixel));
+        write_background_cache(&storage[0], key, dim, &pixels[0], stride);
+        const unsigned char * begin = reinterpret_cast<const unsigned char *>(&storage[0]);
+        bytes.assign(begin, begin + background_cache_size(key, dim));
+      }
+
+      bool matches(const Pixel * read) const {
+        for (int y = 0; y < 480; ++y) {
+          for (int x = 0; x < 640; ++x) {
+            if (read[y * 640 + x] != pixels[y * 700 + x]) return false;
+          }
+        }
+        return true;
+      }
+    };
+  }
+
+  TEST(background_cache_reads_back_what_was_written) {
+    BackgroundKey key = sample_key();
+    CacheFile file(key);
+    Dimension dim(0, 0);
+    const Pixel * read = read_background_cache(&file.bytes[0], file.bytes.size(), key, dim);
+    CHECK(read != 0);
+    CHECK((dim.width == 640) && (dim.height == 480));
+    CHECK(read && file.matches(read));
+  }
+
+  TEST(background_cache_misses_on_any_key_change) {
+    BackgroundKey key = sample_key();
+    CacheFile file(key);
+    Dimension dim(0, 0);
+
+    BackgroundKey other = key;
+    other.wallpaper_name = L"C:\\Windows\\Web\\Wallpaper\\img1.jpg";
+    CHECK(!read_background_cache(&file.bytes[0], file.bytes.size(), other, dim));
+    other = key;
+    other.modify_time += 1;
+    CHECK(!read_background_cache(&file.bytes[0], file.bytes.size(), other, dim));
+    other = key;
+    other.background_color = 0;
+    CHECK(!read_background_cache(&file.bytes[0], file.bytes.size(), other, dim));
+    other = key;
+    other.origin_x = 0;
+    CHECK(!read_background_cache(&file.bytes[0], file.bytes.size(), other, dim));
+  }
+
+  TEST(background_cache_rejects_damaged_files) {
+    BackgroundKey key = sample_key();
+    CacheFile file(key);
+    Dimension dim(0, 0);
+    CHECK(!read_background_cache(&file.bytes[0], file.bytes.size() - 1, key, dim));
+    CHECK(!read_background_cache(&file.bytes[0], 8, key, dim));
+
+    std::vector<unsigned char> bad_magic = file.bytes;
+    bad_magic[0] ^= 0xff;
+    CHECK(!read_background_cache(&bad_magic[0], bad_magic.size(), key, dim));
+  }
+
+  TEST(background_cache_names_files_by_monitor) {
+    BackgroundKey key = sample_key();
+    CHECK(background_cache_name(key) == "monitor_-640_0_640x480.bgc");
+    BackgroundKey other = key;
+    other.wallpaper_name = L"other.png";
+    CHECK(background_cache_name(other) == background_cache_name(key));
+  }
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// background_layout_test.cpp
+// tests for BackgroundLayout
+
+#include "test.h"
+
+#include <vector>
+
+#include "../conrep/background_layout.h"
+
+namespace console {
+  namespace {
+    PixelRect make_rect(int left, int top, int right, int bottom) {
+      PixelRect r = { left, top, right, bottom };
+      return r;
+    }
+
+    bool same_rect(const PixelRect & a, int left, int top, int right, int bottom) {
+      return (a.left == left) && (a.top == top) && (a.right == right) && (a.bottom == bottom);
+    }
+
+    // a 1920x1080 primary with a 1280x1024 monitor to its left
+    std::vector<PixelRect> two_monitors(void) {
+      std::vector<PixelRect> monitors;
+      monitors.push_back(make_rect(0, 0, 1920, 1080));
+      monitors.push_back(make_rect(-1280, 0, 0, 1024));
+      return monitors;
+    }
+  }
+
+  TEST(background_layout_maps_a_window_on_one_monitor) {
+    BackgroundLayout layout;
+    CHECK(layout.update(make_rect(100, 50, 740, 450), two_monitors()));
+    const std::vector<BackgroundPiece> & pieces = layout.pieces();
+    CHECK(pieces.size() == 1);
+    CHECK(pieces[0].monitor == 0);
+    CHECK(same_rect(pieces[0].source, 100, 50, 740, 450));
+    CHECK(same_rect(pieces[0].dest, 0, 0, 640, 400));
+  }
+
+  TEST(background_layout_splits_a_window_across_monitors) {
+    BackgroundLayout layout;
+    layout.update(make_rect(-200, 900, 200, 1100), two_monitors());
+    const std::vector<BackgroundPiece> & pieces = layout.pieces();
+    CHECK(pieces.size() == 2);
+    CHECK(pieces[0].monitor == 0);
+    CHECK(same_rect(pieces[0].source, 0, 900, 200, 1080));
+    CHECK(same_rect(pieces[0].dest, 200, 0, 400, 180));
+    CHECK(pieces[1].monitor == 1);
+    CHECK(same_rect(pieces[1].source, 1080, 900, 1280, 1024));
+    CHECK(same_rect(pieces[1].dest, 0, 0, 200, 124));
+  }
+
+  TEST(background_layout_reports_only_real_changes) {
+    BackgroundLayout layout;
+    std::vector<PixelRect> monitors = two_monitors();
+    CHECK(layout.update(make_rect(100, 100, 500, 400), monitors));
+    CHECK(!layout.update(make_rect(100, 100, 500, 400), monitors));
+    CHECK(layout.update(make_rect(110, 100, 510, 400), monitors));
+    layout.invalidate();
+    CHECK(layout.update(make_rect(110, 100, 510, 400), monitors));
+
+    monitors[0] = make_rect(0, 0, 2560, 1440);
+    CHECK(!layout.update(make_rect(110, 100, 510, 400), monitors)); // same pixels under it
+    monitors[0] = make_rect(100, 0, 2660, 1440);
+    CHECK(layout.update(make_rect(110, 100, 510, 400), monitors));
+  }
+
+  TEST(background_layout_has_no_pieces_off_screen) {
+    BackgroundLayout layout;
+    layout.update(make_rect(5000, 5000, 5400, 5300), two_monitors());
+    CHECK(layout.pieces().empty());
+  }
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// background_rects_test.cpp
+// tests for BackgroundMerger
+
+#include "test.h"
+
+#include <vector>
+
+#include "../conrep/background_rects.h"
+
+namespace console {
+  namespace {
+    // one character per cell: '.' has background 0, digits have that
+    //   background color
+    std::vector<CellAttribute> parse_rows(const char * const * rows, int height, int width) {
+      std::vector<CellAttribute> attributes;
+      for (int i = 0; i < height; ++i) {
+        for (int j = 0; j < width; ++j) {
+          char c = rows[i][j];
+          int color = (c == '.') ? 0 : c - '0';
+          attributes.push_back(static_cast<CellAttribute>((color << 4) | 0x07));
+        }
+      }
+      return attributes;
+    }
+
+    bool has_rect(const std::vector<BackgroundRect> & rects, int left, int top, int right, int bottom, int color) {
+      for (size_t i = 0; i < rects.size(); ++i) {
+        const BackgroundRect & r = rects[i];
+        if ((r.left == left) && (r.top == top) && (r.right == right) && (r.bottom == bottom) && (r.color == color)) return true;
+      }
+      return false;
+    }
+  }
+
+  TEST(background_merger_skips_color_zero) {
+    const char * rows[] = { "........", "........" };
+    std::vector<CellAttribute> attributes = parse_rows(rows, 2, 8);
+    BackgroundMerger merger;
+    CHECK(merger.merge(&attributes[0], 8, 0, 2, true).empty());
+  }
+
+  TEST(background_merger_makes_one_rect_per_run) {
+    const char * rows[] = { "11.2233." };
+    std::vector<CellAttribute> attributes = parse_rows(rows, 1, 8);
+    BackgroundMerger merger;
+    const std::vector<BackgroundRect> & rects = merger.merge(&attributes[0], 8, 0, 1, false);
+    CHECK(rects.size() == 3);
+    CHECK(has_rect(rects, 0, 0, 2, 1, 1));
+    CHECK(has_rect(rects, 3, 0, 5, 1, 2));
+    CHECK(has_rect(rects, 5, 0, 7, 1, 3));
+  }
+
+  TEST(background_merger_merges_matching_rows) {
+    const char * rows[] = {
+      "..11..22",
+      "..11..22",
+      "..11.222",
+      "..11...."
+    };
+    std::vector<CellAttribute> attributes = parse_rows(rows, 4, 8);
+    BackgroundMerger merger;
+    const std::vector<BackgroundRect> & merged = merger.merge(&attributes[0], 8, 0, 4, true);
+    CHECK(merged.size() == 3);
+    CHECK(has_rect(merged, 2, 0, 4, 4, 1));
+    CHECK(has_rect(merged, 6, 0, 8, 2, 2));
+    CHECK(has_rect(merged, 5, 2, 8, 3, 2)); // different columns start a new rect
+
+    const std::vector<BackgroundRect> & unmerged = merger.merge(&attributes[0], 8, 0, 4, false);
+    CHECK(unmerged.size() == 7);
+  }
+
+  TEST(background_merger_does_not_merge_different_colors) {
+    const char * rows[] = { "1111", "2222" };
+    std::vector<CellAttribute> attributes = parse_rows(rows, 2, 4);
+    BackgroundMerger merger;
+    const std::vector<BackgroundRect> & rects = merger.merge(&attributes[0], 4, 0, 2, true);
+    CHECK(rects.size() == 2);
+    CHECK(has_rect(rects, 0, 0, 4, 1, 1));
+    CHECK(has_rect(rects, 0, 1, 4, 2, 2));
+  }
+
+  TEST(background_merger_numbers_rows_from_first_row) {
+    const char * rows[] = { ".33.", ".33." };
+    std::vector<CellAttribute> attributes = parse_rows(rows, 2, 4);
+    BackgroundMerger merger;
+    const std::vector<BackgroundRect> & rects = merger.merge(&attributes[0], 4, 10, 12, true);
+    CHECK(rects.size() == 1);
+    CHECK(has_rect(rects, 1, 10, 3, 12, 3));
+  }
+
+  TEST(has_backgrounds_only_looks_at_the_background_nibble) {
+    // foreground colors and the COMMON_LVB_* flags don't count
+    std::vector<Cell> cells(9, 0xff0f0041);
+    CHECK(!has_backgrounds(&cells[0], cells.size()));
+    cells[8] = 0x00100020;
+    CHECK(has_backgrounds(&cells[0], cells.size()));
+    CHECK(!has_backgrounds(&cells[0], 8));
+    CHECK(!has_backgrounds(&cells[0], 0));
+  }
+}
\ No newline at end of file
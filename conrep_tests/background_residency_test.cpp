@@ -0,0 +1,105 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// background_residency_test.cpp
+// tests for BackgroundResidency, driven by simulated window movements
+
+#include "test.h"
+
+#include <vector>
+
+#include "../conrep/background_residency.h"
+
+namespace console {
+  namespace {
+    const MonitorKey LEFT  = 0x1001;
+    const MonitorKey RIGHT = 0x1002;
+    const OwnerKey WINDOW  = 0x2001;
+    const OwnerKey OTHER   = 0x2002;
+
+    std::vector<MonitorKey> monitors(MonitorKey a) {
+      return std::vector<MonitorKey>(1, a);
+    }
+
+    std::vector<MonitorKey> monitors(MonitorKey a, MonitorKey b) {
+      std::vector<MonitorKey> keys;
+      keys.push_back(a);
+      keys.push_back(b);
+      return keys;
+    }
+  }
+
+  TEST(background_residency_keeps_covered_monitors) {
+    BackgroundResidency residency(1000);
+    std::vector<MonitorKey> evicted;
+    residency.cover(WINDOW, monitors(LEFT), 0);
+    residency.loaded(LEFT, 100, 0);
+    CHECK(!residency.evict(5000, evicted));
+    CHECK(residency.resident(LEFT));
+    CHECK(residency.resident_bytes() == 100);
+  }
+
+  TEST(background_residency_evicts_after_the_idle_time) {
+    BackgroundResidency residency(1000);
+    std::vector<MonitorKey> evicted;
+    residency.cover(WINDOW, monitors(LEFT, RIGHT), 0);
+    residency.loaded(LEFT, 100, 0);
+    residency.loaded(RIGHT, 200, 0);
+
+    // the window moves wholly onto the left monitor at 500
+    residency.cover(WINDOW, monitors(LEFT), 500);
+    CHECK(!residency.evict(1499, evicted));
+    CHECK(residency.evict(1500, evicted));
+    CHECK(evicted == monitors(RIGHT));
+    CHECK(!residency.resident(RIGHT));
+    CHECK(residency.resident_bytes() == 100);
+  }
+
+  TEST(background_residency_counts_every_owner) {
+    BackgroundResidency residency(1000);
+    std::vector<MonitorKey> evicted;
+    residency.cover(WINDOW, monitors(LEFT), 0);
+    residency.cover(OTHER, monitors(LEFT), 0);
+    residency.loaded(LEFT, 100, 0);
+
+    residency.cover(WINDOW, std::vector<MonitorKey>(), 100); // closed
+    CHECK(!residency.evict(5000, evicted));
+    residency.cover(OTHER, std::vector<MonitorKey>(), 5000);
+    CHECK(!residency.evict(5999, evicted));
+    CHECK(residency.evict(6000, evicted));
+    CHECK(evicted == monitors(LEFT));
+  }
+
+  TEST(background_residency_counts_a_replaced_texture_once) {
+    BackgroundResidency residency(1000);
+    residency.loaded(LEFT, 100, 0);
+    residency.loaded(LEFT, 300, 0);
+    CHECK(residency.resident_bytes() == 300);
+    residency.clear();
+    CHECK(residency.resident_bytes() == 0);
+    CHECK(!residency.resident(LEFT));
+  }
+
+  TEST(background_residency_survives_the_clock_wrapping) {
+    BackgroundResidency residency(1000);
+    std::vector<MonitorKey> evicted;
+    residency.loaded(LEFT, 100, 0xfffffe00u);
+    CHECK(!residency.evict(0x100, evicted));
+    CHECK(residency.evict(0x200, evicted));
+  }
+}
\ No newline at end of file
@@ -0,0 +1,158 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// capture_frame_test.cpp
+// tests for the capture frame record encoding
+
+#include "test.h"
+
+#include <cstring>
+#include <vector>
+
+#include "../conrep/capture_frame.h"
+
+namespace console {
+  namespace {
+    CaptureFrame sample_frame(Dimension dim) {
+      CaptureFrame frame;
+      frame.resize_generation = 3;
+      frame.dim = dim;
+      frame.cells.resize(dim.width * dim.height);
+      for (size_t i = 0; i < frame.cells.size(); ++i) frame.cells[i] = static_cast<Cell>(0x00070000 | (L'a' + i % 26));
+      frame.cursor_x = 2;
+      frame.cursor_y = 1;
+      frame.scroll_max = 300;
+      frame.scroll_page = dim.height;
+      const char title[] = "cmd.exe";
+      frame.title.assign(title, title + sizeof(title) - 1);
+      return frame;
+    }
+
+    bool same_frame(const CaptureFrame & lhs, const CaptureFrame & rhs) {
+      return (lhs.exited == rhs.exited) &&
+             (lhs.resize_generation == rhs.resize_generation) &&
+             (lhs.dim.width == rhs.dim.width) &&
+             (lhs.dim.height == rhs.dim.height) &&
+             (lhs.cells == rhs.cells) &&
+             (lhs.cursor_x == rhs.cursor_x) &&
+             (lhs.cursor_y == rhs.cursor_y) &&
+             (lhs.scroll_max == rhs.scroll_max) &&
+             (lhs.scroll_page == rhs.scroll_page) &&
+             (lhs.title == rhs.title);
+    }
+
+    bool apply(const std::vector<unsigned char> & record, CaptureFrame & frame) {
+      return apply_frame_record(&record[0], record.size(), frame);
+    }
+
+    // encodes and commits a copy of frame, as the agent does
+    bool send(FrameEncoder & encoder, const CaptureFrame & frame, std::vector<unsigned char> & record) {
+      if (!encoder.encode(frame, record)) return false;
+      CaptureFrame committed = frame;
+      encoder.commit(committed);
+      return true;
+    }
+  }
+
+  TEST(capture_frame_starts_with_a_key_frame) {
+    FrameEncoder encoder;
+    CaptureFrame frame = sample_frame(Dimension(10, 4));
+    std::vector<unsigned char> record;
+    CHECK(send(encoder, frame, record));
+    CaptureFrame received;
+    CHECK(apply(record, received));
+    CHECK(same_frame(received, frame));
+    CHECK(encoder.counts().key_frames == 1);
+    CHECK(encoder.counts().rows_sent == 4);
+  }
+
+  TEST(capture_frame_sends_only_changed_rows) {
+    FrameEncoder encoder;
+    CaptureFrame frame = sample_frame(Dimension(10, 4));
+    std::vector<unsigned char> key;
+    send(encoder, frame, key);
+    CaptureFrame received;
+    apply(key, received);
+
+    std::vector<unsigned char> record;
+    CHECK(!encoder.encode(frame, record)); // nothing changed
+    frame.cells[2 * 10 + 5] = L'X';
+    frame.cursor_x = 6;
+    CHECK(send(encoder, frame, record));
+    CHECK(record.size() < key.size());
+    CHECK(encoder.counts().delta_frames == 1);
+    CHECK(encoder.counts().rows_sent == 5);
+    CHECK(apply(record, received));
+    CHECK(same_frame(received, frame));
+
+    // the title alone is a change too
+    frame.title.pop_back();
+    CHECK(send(encoder, frame, record));
+    CHECK(apply(record, received));
+    CHECK(same_frame(received, frame));
+  }
+
+  TEST(capture_frame_resends_everything_after_a_resize) {
+    FrameEncoder encoder;
+    std::vector<unsigned char> record;
+    CaptureFrame received;
+    send(encoder, sample_frame(Dimension(10, 4)), record);
+    apply(record, received);
+    CaptureFrame resized = sample_frame(Dimension(12, 3));
+    CHECK(send(encoder, resized, record));
+    CHECK(encoder.counts().key_frames == 2);
+    CHECK(apply(record, received));
+    CHECK(same_frame(received, resized));
+  }
+
+  TEST(capture_frame_reports_the_shell_exiting_once) {
+    FrameEncoder encoder;
+    std::vector<unsigned char> record;
+    CaptureFrame received;
+    send(encoder, sample_frame(Dimension(10, 4)), record);
+    apply(record, received);
+    CaptureFrame exited;
+    exited.exited = true;
+    CHECK(send(encoder, exited, record));
+    CHECK(apply(record, received));
+    CHECK(received.exited);
+    CHECK(!encoder.encode(exited, record));
+  }
+
+  TEST(capture_frame_rejects_malformed_records) {
+    FrameEncoder encoder;
+    CaptureFrame frame = sample_frame(Dimension(10, 4));
+    std::vector<unsigned char> key;
+    send(encoder, frame, key);
+    frame.cells[0] = L'X';
+    std::vector<unsigned char> delta;
+    send(encoder, frame, delta);
+
+    CaptureFrame received;
+    CHECK(!apply(delta, received)); // no key frame before it
+    CHECK(!apply_frame_record(&key[0], key.size() - 1, received));
+    CHECK(!apply_frame_record(&key[0], 8, received));
+
+    // a row index past the bottom of the console
+    std::vector<unsigned char> bad_row = delta;
+    std::uint32_t index = 4;
+    std::memcpy(&bad_row[delta.size() - 10 * sizeof(Cell) - sizeof(index)], &index, sizeof(index));
+    CHECK(apply(key, received));
+    CHECK(!apply(bad_row, received));
+  }
+}
\ No newline at end of file
@@ -0,0 +1,167 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// capture_policy_test.cpp
+// tests for CapturePolicy, replaying polls against a simulated console
+
+#include "test.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../conrep/capture_policy.h"
+
+namespace console {
+  namespace {
+    const Dimension DIM(10, 20);
+
+    struct Screen {
+      std::vector<Cell> cells;
+
+      Screen() : cells(DIM.width * DIM.height, L' ') {}
+
+      void set_row(int row, Cell value) {
+        std::fill(cells.begin() + row * DIM.width, cells.begin() + (row + 1) * DIM.width, value);
+      }
+    };
+
+    std::vector<ReadBand> whole_viewport(void) {
+      ReadBand band = { 0, DIM.height };
+      return std::vector<ReadBand>(1, band);
+    }
+
+    // reads exactly the hinted rows
+    std::vector<ReadBand> hinted(const std::vector<RowRange> & hint) {
+      std::vector<ReadBand> bands;
+      for (size_t i = 0; i < hint.size(); ++i) {
+        ReadBand band = { hint[i].first, hint[i].last };
+        bands.push_back(band);
+      }
+      return bands;
+    }
+
+    // ranges as "first-last ", for comparing whole hints
+    std::string describe(const std::vector<RowRange> & hint) {
+      std::string text;
+      for (size_t i = 0; i < hint.size(); ++i) {
+        text += std::to_string(hint[i].first) + "-" + std::to_string(hint[i].last) + " ";
+      }
+      return text;
+    }
+
+    // runs one poll the way capture_console() does; returns if it was a sweep
+    bool poll(CapturePolicy & policy, std::uint32_t now, int cursor_row, const Screen & screen, std::vector<RowRange> & hint) {
+      bool sweep = policy.plan(now, DIM, 0, cursor_row, hint);
+      policy.observe(now, &screen.cells[0], sweep ? whole_viewport() : hinted(hint));
+      return sweep;
+    }
+  }
+
+  TEST(capture_policy_reads_around_the_cursor_between_sweeps) {
+    CapturePolicy policy(1, 500, 1000);
+    Screen screen;
+    std::vector<RowRange> hint;
+    CHECK(poll(policy, 0, 5, screen, hint)); // nothing to compare against yet
+    CHECK(!poll(policy, 10, 5, screen, hint));
+    CHECK(describe(hint) == "4-7 ");
+    // as well as every row the cursor moved across
+    CHECK(!poll(policy, 20, 9, screen, hint));
+    CHECK(describe(hint) == "4-11 ");
+    CHECK(!poll(policy, 30, 0, screen, hint));
+    CHECK(describe(hint) == "0-11 ");
+
+    CHECK(policy.counts().forced_sweeps == 1);
+    CHECK(policy.counts().fast_reads == 3);
+    CHECK(policy.counts().rows_read == 20 + 3 + 7 + 11);
+  }
+
+  TEST(capture_policy_follows_rows_a_sweep_found_changed) {
+    CapturePolicy policy(1, 500, 1000);
+    Screen screen;
+    std::vector<RowRange> hint;
+    poll(policy, 0, 5, screen, hint);
+    poll(policy, 10, 5, screen, hint);
+
+    screen.set_row(5, L'a'); // would have been read by a fast read
+    screen.set_row(15, L'b');
+    CHECK(poll(policy, 1000, 5, screen, hint));
+    CHECK(policy.counts().sweeps == 1);
+    CHECK(policy.counts().missed_sweeps == 1);
+    CHECK(policy.counts().missed_rows == 1);
+
+    CHECK(!poll(policy, 1010, 5, screen, hint));
+    CHECK(describe(hint) == "4-7 5-6 15-16 ");
+    // until they've been quiet for recent_time
+    CHECK(!poll(policy, 1500, 5, screen, hint));
+    CHECK(describe(hint) == "4-7 ");
+  }
+
+  TEST(capture_policy_sweeps_early_after_a_burst) {
+    CapturePolicy policy(1, 500, 1000);
+    Screen screen;
+    std::vector<RowRange> hint;
+    poll(policy, 0, 5, screen, hint);
+    screen.set_row(4, L'a');
+    screen.set_row(5, L'a');
+    CHECK(!poll(policy, 10, 5, screen, hint));
+    CHECK(poll(policy, 20, 5, screen, hint));
+    CHECK(policy.counts().forced_sweeps == 2);
+    CHECK(policy.counts().sweeps == 0);
+    CHECK(!poll(policy, 30, 5, screen, hint));
+
+    // a single changed row is ordinary output
+    screen.set_row(5, L'b');
+    CHECK(!poll(policy, 40, 5, screen, hint));
+    CHECK(!poll(policy, 50, 5, screen, hint));
+  }
+
+  TEST(capture_policy_starts_over_when_the_viewport_changes) {
+    CapturePolicy policy(1, 500, 1000);
+    Screen screen;
+    std::vector<RowRange> hint;
+    poll(policy, 0, 5, screen, hint);
+    CHECK(!policy.plan(10, DIM, 0, 5, hint));
+    policy.observe(10, &screen.cells[0], hinted(hint));
+
+    // scrolled by a row, so every row moved
+    screen.set_row(12, L'a');
+    CHECK(policy.plan(20, DIM, 1, 5, hint));
+    policy.observe(20, &screen.cells[0], whole_viewport());
+    // and rows read by a reset aren't taken as recently changed
+    CHECK(!policy.plan(30, DIM, 1, 5, hint));
+    CHECK(describe(hint) == "4-7 ");
+    policy.observe(30, &screen.cells[0], hinted(hint));
+
+    CHECK(policy.plan(40, Dimension(10, 21), 1, 5, hint));
+    CHECK(policy.counts().forced_sweeps == 2);
+  }
+
+  TEST(capture_policy_without_a_sweep_time_reads_everything) {
+    CapturePolicy policy(1, 500, 0);
+    Screen screen;
+    std::vector<RowRange> hint;
+    for (std::uint32_t now = 0; now < 50; now += 10) {
+      screen.set_row(15, static_cast<Cell>(L'a' + now));
+      CHECK(poll(policy, now, 5, screen, hint));
+    }
+    CHECK(policy.counts().sweeps == 4);
+    CHECK(policy.counts().missed_sweeps == 0);
+    CHECK(policy.counts().fast_reads == 0);
+  }
+}
\ No newline at end of file
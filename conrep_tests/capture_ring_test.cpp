@@ -0,0 +1,203 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// capture_ring_test.cpp
+// tests for the capture record ring, including rings whose lengths were
+//   scribbled over and a writer and reader on two threads
+
+#include "test.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../conrep/capture_ring.h"
+
+namespace console {
+  namespace {
+    const size_t CAPACITY = 256;
+
+    // ring memory, kept as 64 bit words so the header is aligned
+    struct Ring {
+      std::vector<std::uint64_t> words;
+
+      Ring() : words((ring_memory_size(CAPACITY) + 7) / 8) {
+        init_ring(memory(), CAPACITY);
+      }
+
+      void * memory(void) { return &words[0]; }
+      unsigned char * records(void) { return static_cast<unsigned char *>(memory()) + ring_memory_size(0); }
+
+      void set_length(size_t offset, std::uint32_t length) {
+        std::memcpy(records() + offset, &length, sizeof(length));
+      }
+    };
+
+    std::vector<unsigned char> bytes(size_t size, unsigned char first) {
+      std::vector<unsigned char> data(size);
+      for (size_t i = 0; i < size; ++i) data[i] = static_cast<unsigned char>(first + i);
+      return data;
+    }
+
+    bool write(RingWriter & writer, const std::vector<unsigned char> & data) {
+      return writer.write(data.empty() ? 0 : &data[0], data.size());
+    }
+  }
+
+  TEST(capture_ring_validates_its_memory) {
+    Ring ring;
+    CHECK(valid_ring(ring.memory(), ring_memory_size(CAPACITY)));
+    CHECK(!valid_ring(ring.memory(), ring_memory_size(CAPACITY) - 1));
+    std::memset(ring.memory(), 0, 4);
+    CHECK(!valid_ring(ring.memory(), ring_memory_size(CAPACITY)));
+  }
+
+  TEST(capture_ring_reads_records_in_order) {
+    Ring ring;
+    RingWriter writer(ring.memory());
+    RingReader reader(ring.memory());
+    std::vector<unsigned char> record;
+    CHECK(reader.read(record) == RING_EMPTY);
+
+    CHECK(write(writer, bytes(5, 1)));
+    CHECK(write(writer, bytes(0, 0)));
+    CHECK(write(writer, bytes(40, 9)));
+    CHECK((reader.read(record) == RING_RECORD) && (record == bytes(5, 1)));
+    CHECK((reader.read(record) == RING_RECORD) && record.empty());
+    CHECK((reader.read(record) == RING_RECORD) && (record == bytes(40, 9)));
+    CHECK(reader.read(record) == RING_EMPTY);
+  }
+
+  TEST(capture_ring_refuses_records_until_the_reader_makes_room) {
+    Ring ring;
+    RingWriter writer(ring.memory());
+    RingReader reader(ring.memory());
+    std::vector<unsigned char> record;
+    size_t max_record = ring_max_record(CAPACITY);
+    CHECK(write(writer, bytes(max_record, 1)));
+    CHECK(write(writer, bytes(max_record, 2)));
+    CHECK(!write(writer, bytes(1, 3)));
+    CHECK((reader.read(record) == RING_RECORD) && (record == bytes(max_record, 1)));
+    CHECK(write(writer, bytes(1, 3)));
+  }
+
+  TEST(capture_ring_wraps_records_to_the_start) {
+    Ring ring;
+    RingWriter writer(ring.memory());
+    RingReader reader(ring.memory());
+    std::vector<unsigned char> record;
+    // records of 100 bytes take 104, so the third doesn't fit before the end
+    for (unsigned char i = 0; i < 20; ++i) {
+      CHECK(write(writer, bytes(100, i)));
+      CHECK((reader.read(record) == RING_RECORD) && (record == bytes(100, i)));
+    }
+    CHECK(reader.read(record) == RING_EMPTY);
+  }
+
+  TEST(capture_ring_rejects_a_length_past_what_was_written) {
+    Ring ring;
+    RingWriter writer(ring.memory());
+    RingReader reader(ring.memory());
+    std::vector<unsigned char> record;
+    CHECK(write(writer, bytes(10, 1)));
+    CHECK(write(writer, bytes(10, 2)));
+    ring.set_length(0, 40); // within the area, but only 32 bytes were written
+    CHECK(reader.read(record) == RING_CORRUPT);
+    // everything was dropped, so the writer has the whole ring again
+    CHECK(reader.read(record) == RING_EMPTY);
+    CHECK(write(writer, bytes(ring_max_record(CAPACITY), 3)));
+    CHECK((reader.read(record) == RING_RECORD) && (record == bytes(ring_max_record(CAPACITY), 3)));
+  }
+
+  TEST(capture_ring_rejects_lengths_that_would_overflow) {
+    Ring ring;
+    RingWriter writer(ring.memory());
+    RingReader reader(ring.memory());
+    std::vector<unsigned char> record;
+    CHECK(write(writer, bytes(10, 1)));
+    ring.set_length(0, 0xfffffffc);
+    CHECK(reader.read(record) == RING_CORRUPT);
+    CHECK(write(writer, bytes(10, 1)));
+    ring.set_length(16, 0xfffffff9);
+    CHECK(reader.read(record) == RING_CORRUPT);
+  }
+
+  TEST(capture_ring_checks_the_record_after_a_wrap_marker) {
+    Ring ring;
+    RingWriter writer(ring.memory());
+    RingReader reader(ring.memory());
+    std::vector<unsigned char> record;
+    CHECK(write(writer, bytes(100, 1)));
+    CHECK(write(writer, bytes(100, 2)));
+    CHECK(reader.read(record) == RING_RECORD);
+    CHECK(reader.read(record) == RING_RECORD);
+    // written at the start after a wrap marker at 208
+    CHECK(write(writer, bytes(100, 3)));
+    ring.set_length(0, 200);
+    CHECK(reader.read(record) == RING_CORRUPT);
+
+    // a wrap marker with nothing written after it, in place of a record at
+    //   208 that is all there is
+    CHECK(write(writer, bytes(100, 4)));
+    CHECK(reader.read(record) == RING_RECORD);
+    CHECK(write(writer, bytes(10, 5)));
+    ring.set_length(208, 0xffffffff);
+    CHECK(reader.read(record) == RING_CORRUPT);
+    CHECK(reader.read(record) == RING_EMPTY);
+  }
+
+  // Every record must arrive whole and in order, with the writer retrying
+  //   whenever the ring is full.
+  TEST(capture_ring_hands_off_between_threads) {
+    const unsigned COUNT = 100000;
+    Ring ring;
+    RingWriter writer(ring.memory());
+    RingReader reader(ring.memory());
+
+    std::thread producer([&]() {
+      for (unsigned i = 0; i < COUNT; ++i) {
+        std::vector<unsigned char> data = bytes(i % 61, static_cast<unsigned char>(i));
+        while (!write(writer, data)) std::this_thread::yield();
+      }
+    });
+
+    unsigned received = 0;
+    bool mismatched = false;
+    bool corrupt = false;
+    std::vector<unsigned char> record;
+    while (received < COUNT) {
+      RingRead result = reader.read(record);
+      if (result == RING_EMPTY) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (result == RING_CORRUPT) {
+        corrupt = true;
+        break;
+      }
+      if (record != bytes(received % 61, static_cast<unsigned char>(received))) mismatched = true;
+      ++received;
+    }
+    producer.join();
+
+    CHECK(!corrupt);
+    CHECK(!mismatched);
+    CHECK(received == COUNT);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// cell_compare_test.cpp
+// tests for find_cell_differences() with every kernel the processor
+//   supports, checked against a straightforward search
+
+#include "test.h"
+
+#include <vector>
+
+#include "../conrep/cell_compare.h"
+
+namespace console {
+  namespace {
+    const Cell ALL = 0xffffffff;
+
+    DiffRange expected_range(const std::vector<Cell> & a, const std::vector<Cell> & b, Cell mask) {
+      DiffRange r = { a.size(), a.size() };
+      for (size_t i = 0; i < a.size(); ++i) {
+        if (!((a[i] ^ b[i]) & mask)) continue;
+        if (r.first == a.size()) r.first = i;
+        r.last = i;
+      }
+      return r;
+    }
+
+    // true if every supported kernel agrees with expected_range()
+    bool kernels_agree(const std::vector<Cell> & a, const std::vector<Cell> & b, Cell mask) {
+      DiffRange expected = expected_range(a, b, mask);
+      for (int l = SIMD_SCALAR; l <= get_simd_level(); ++l) {
+        DiffRange r = find_cell_differences(a.empty() ? 0 : &a[0], b.empty() ? 0 : &b[0], a.size(), mask, static_cast<SimdLevel>(l));
+        if ((r.first != expected.first) || (r.last != expected.last)) return false;
+      }
+      return true;
+    }
+
+    std::vector<Cell> row(size_t count) {
+      std::vector<Cell> cells(count);
+      for (size_t i = 0; i < count; ++i) cells[i] = static_cast<Cell>(0x00070000 | (L'a' + i % 26));
+      return cells;
+    }
+  }
+
+  TEST(cell_compare_finds_no_difference_in_equal_rows) {
+    for (size_t count = 0; count <= 40; ++count) {
+      std::vector<Cell> a = row(count);
+      CHECK(kernels_agree(a, a, ALL));
+    }
+  }
+
+  // every pair of changed cells for widths around the 4 and 8 cell blocks,
+  //   so changes land in whole blocks, across them and in the tail cells
+  TEST(cell_compare_finds_the_first_and_last_difference) {
+    bool agree = true;
+    for (size_t count = 1; count <= 35; ++count) {
+      std::vector<Cell> a = row(count);
+      for (size_t first = 0; first < count; ++first) {
+        for (size_t last = first; last < count; ++last) {
+          std::vector<Cell> b = a;
+          b[first] ^= 0x100;
+          b[last] ^= 0x00010000;
+          if (!kernels_agree(a, b, ALL)) agree = false;
+        }
+      }
+    }
+    CHECK(agree);
+  }
+
+  TEST(cell_compare_finds_differences_in_the_middle_of_long_rows) {
+    std::vector<Cell> a = row(203);
+    std::vector<Cell> b = a;
+    for (size_t i = 97; i < 150; i += 13) b[i] = L'X';
+    CHECK(kernels_agree(a, b, ALL));
+  }
+
+  TEST(cell_compare_ignores_bits_outside_the_mask) {
+    for (size_t count = 1; count <= 20; ++count) {
+      std::vector<Cell> a = row(count);
+      std::vector<Cell> b = a;
+      for (size_t i = 0; i < count; ++i) b[i] |= 0x80000000;
+      CHECK(kernels_agree(a, b, 0x00ffffff));
+      b[count / 2] ^= 1;
+      CHECK(kernels_agree(a, b, 0x00ffffff));
+    }
+  }
+}
\ No newline at end of file
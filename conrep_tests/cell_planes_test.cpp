@@ -0,0 +1,113 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// cell_planes_test.cpp
+// tests for split_cells() with every kernel the processor supports and
+//   for CellPlanes
+
+#include "test.h"
+
+#include <vector>
+
+#include "../conrep/cell_planes.h"
+
+namespace console {
+  namespace {
+    // characters above 0x7fff and attribute flags above the low byte, which
+    //   the SSE2 kernel has to handle specially
+    std::vector<Cell> cells(size_t count, unsigned seed) {
+      std::vector<Cell> result(count);
+      for (size_t i = 0; i < count; ++i) {
+        unsigned n = static_cast<unsigned>(i) * 2654435761u + seed;
+        result[i] = static_cast<Cell>((n & 0xffff) | ((n >> 8) & 0xffff) << 16);
+      }
+      return result;
+    }
+
+    const CellChar      CHAR_GUARD      = 0xdead;
+    const CellAttribute ATTRIBUTE_GUARD = 0xee;
+
+    // true if every supported kernel splits the cells and writes nothing
+    //   past count
+    bool kernels_split(const std::vector<Cell> & packed) {
+      size_t count = packed.size();
+      for (int l = SIMD_SCALAR; l <= get_simd_level(); ++l) {
+        std::vector<CellChar> chars(count + 16, CHAR_GUARD);
+        std::vector<CellAttribute> attributes(count + 16, ATTRIBUTE_GUARD);
+        split_cells(count ? &packed[0] : 0, count, &chars[0], &attributes[0], static_cast<SimdLevel>(l));
+        for (size_t i = 0; i < count; ++i) {
+          if (chars[i] != (packed[i] & 0xffff)) return false;
+          if (attributes[i] != ((packed[i] >> 16) & 0xff)) return false;
+        }
+        for (size_t i = count; i < chars.size(); ++i) {
+          if ((chars[i] != CHAR_GUARD) || (attributes[i] != ATTRIBUTE_GUARD)) return false;
+        }
+      }
+      return true;
+    }
+  }
+
+  // widths around the 16 cell block, so every length of tail is covered
+  TEST(split_cells_matches_for_every_kernel) {
+    for (size_t count = 0; count <= 50; ++count) {
+      CHECK(kernels_split(cells(count, 7)));
+    }
+    CHECK(kernels_split(cells(80 * 25, 11)));
+  }
+
+  TEST(split_cells_keeps_extreme_values) {
+    std::vector<Cell> packed(21);
+    for (size_t i = 0; i < packed.size(); ++i) {
+      packed[i] = (i % 3 == 0) ? 0xffffffff : (i % 3 == 1) ? 0x00ff8000 : 0xff007fff;
+    }
+    CHECK(kernels_split(packed));
+  }
+
+  TEST(cell_planes_assign_rows_only_touches_those_rows) {
+    const Dimension dim(19, 5);
+    std::vector<Cell> before = cells(dim.width * dim.height, 1);
+    std::vector<Cell> after  = cells(dim.width * dim.height, 2);
+    CellPlanes planes;
+    planes.resize(dim);
+    planes.assign(&before[0]);
+    planes.assign_rows(&after[0], 1, 3);
+    planes.assign_rows(&after[0], 4, 4);
+
+    bool matches = true;
+    for (int r = 0; r < dim.height; ++r) {
+      const std::vector<Cell> & source = ((r >= 1) && (r < 3)) ? after : before;
+      for (int c = 0; c < dim.width; ++c) {
+        Cell cell = source[r * dim.width + c];
+        if (planes.chars(r)[c] != cell_char(cell)) matches = false;
+        if (planes.attributes(r)[c] != cell_attribute(cell)) matches = false;
+      }
+    }
+    CHECK(matches);
+  }
+
+  TEST(cell_planes_rows_follow_the_current_width) {
+    CellPlanes planes;
+    planes.resize(Dimension(40, 10));
+    planes.resize(Dimension(13, 3));
+    CHECK((planes.dim().width == 13) && (planes.dim().height == 3));
+    std::vector<Cell> packed = cells(13 * 3, 5);
+    planes.assign(&packed[0]);
+    CHECK(planes.chars(2)[0] == cell_char(packed[26]));
+    CHECK(planes.attributes(1)[12] == cell_attribute(packed[25]));
+  }
+}
\ No newline at end of file
@@ -0,0 +1,170 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// console_attachment_test.cpp
+// tests for ConsoleAttachment against a fake console API
+
+#include "test.h"
+
+#include <string>
+
+#include "../conrep/console_attachment.h"
+
+namespace console {
+  namespace {
+    // Attaching answers with each status in turn, 'B' for ATTACH_BUSY and
+    //   'E' for ATTACH_ERROR, then ATTACH_OK. The process has exited once
+    //   exited is set. Every call is logged.
+    class FakeConsoleApi : public IConsoleApi {
+      public:
+        FakeConsoleApi(const char * statuses)
+          : exited(false), statuses_(statuses), clock_(0) {}
+
+        AttachStatus attach_console(std::uint32_t process_id, std::uint32_t & error) {
+          log += "a";
+          log += static_cast<char>('0' + process_id);
+          log += ' ';
+          clock_ += 100;
+          char status = *statuses_ ? *statuses_++ : 0;
+          if (status == 'B') return ATTACH_BUSY;
+          if (status == 'E') {
+            error = 6;
+            return ATTACH_ERROR;
+          }
+          return ATTACH_OK;
+        }
+
+        void free_console(void) {
+          log += "f ";
+          clock_ += 10;
+        }
+
+        bool process_exited(std::uintptr_t) {
+          return exited;
+        }
+
+        std::uint64_t now_us(void) {
+          return clock_;
+        }
+
+        std::string log;
+        bool exited;
+      private:
+        const char * statuses_;
+        std::uint64_t clock_;
+    };
+
+    const std::uint32_t SHELL = 1;
+    const std::uint32_t OTHER = 2;
+  }
+
+  TEST(console_attachment_keeps_the_console_between_acquires) {
+    FakeConsoleApi api("");
+    ConsoleAttachment attachment(api);
+    std::uint32_t error = 0;
+    for (int i = 0; i < 3; ++i) {
+      CHECK(attachment.acquire(SHELL, 0, error) == ACQUIRE_OK);
+      CHECK(attachment.acquire(SHELL, 0, error) == ACQUIRE_OK); // nested
+      CHECK(attachment.depth() == 2);
+      attachment.release();
+      attachment.release();
+    }
+    CHECK(attachment.attached_process() == SHELL);
+    CHECK(attachment.depth() == 0);
+    CHECK(api.log == "a1 ");
+    CHECK(attachment.counts().acquires == 6);
+    CHECK(attachment.counts().reuses == 5);
+    CHECK(attachment.counts().attaches == 1);
+    CHECK(attachment.counts().attach_us == 100);
+  }
+
+  TEST(console_attachment_moves_only_for_another_console) {
+    FakeConsoleApi api("");
+    ConsoleAttachment attachment(api);
+    std::uint32_t error = 0;
+    CHECK(attachment.acquire(SHELL, 0, error) == ACQUIRE_OK);
+    CHECK(attachment.acquire(OTHER, 0, error) == ACQUIRE_CONFLICT);
+    attachment.release();
+    CHECK(attachment.acquire(OTHER, 0, error) == ACQUIRE_OK);
+    attachment.release();
+    CHECK(attachment.attached_process() == OTHER);
+    CHECK(api.log == "a1 f a2 ");
+    CHECK(attachment.counts().detaches == 1);
+    CHECK(attachment.counts().detach_us == 10);
+  }
+
+  TEST(console_attachment_retries_busy_consoles) {
+    FakeConsoleApi api("BB");
+    ConsoleAttachment attachment(api);
+    std::uint32_t error = 0;
+    CHECK(attachment.acquire(SHELL, 0, error) == ACQUIRE_OK);
+    CHECK(api.log == "a1 a1 a1 ");
+    CHECK(attachment.counts().retries == 2);
+    CHECK(attachment.counts().attach_us == 300);
+  }
+
+  TEST(console_attachment_stops_retrying_once_the_process_exits) {
+    FakeConsoleApi api("BBBB");
+    api.exited = true;
+    ConsoleAttachment attachment(api);
+    std::uint32_t error = 0;
+    CHECK(attachment.acquire(SHELL, 0, error) == ACQUIRE_EXITED);
+    CHECK(api.log == "a1 ");
+    CHECK(attachment.attached_process() == 0);
+    CHECK(attachment.depth() == 0);
+  }
+
+  TEST(console_attachment_reports_attach_errors) {
+    FakeConsoleApi api("BE");
+    ConsoleAttachment attachment(api);
+    std::uint32_t error = 0;
+    CHECK(attachment.acquire(SHELL, 0, error) == ACQUIRE_ERROR);
+    CHECK(error == 6);
+    CHECK(attachment.attached_process() == 0);
+    CHECK(attachment.counts().attaches == 0);
+  }
+
+  TEST(console_attachment_drops_the_console_of_an_exited_shell) {
+    FakeConsoleApi api("");
+    ConsoleAttachment attachment(api);
+    attachment.adopt(SHELL);
+    std::uint32_t error = 0;
+    CHECK(attachment.acquire(SHELL, 0, error) == ACQUIRE_OK);
+    attachment.release();
+    CHECK(api.log.empty()); // adopted, so never attached
+
+    api.exited = true;
+    CHECK(attachment.acquire(SHELL, 0, error) == ACQUIRE_EXITED);
+    CHECK(attachment.attached_process() == 0);
+    CHECK(api.log == "f ");
+  }
+
+  TEST(console_attachment_detach_frees_only_a_held_console) {
+    FakeConsoleApi api("");
+    ConsoleAttachment attachment(api);
+    attachment.detach();
+    CHECK(api.log.empty());
+    std::uint32_t error = 0;
+    attachment.acquire(SHELL, 0, error);
+    attachment.release();
+    attachment.detach();
+    attachment.detach();
+    CHECK(api.log == "a1 f ");
+    CHECK(attachment.attached_process() == 0);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// damage_set_test.cpp
+// tests for DamageSet and compute_damage()
+
+#include "test.h"
+
+#include <vector>
+
+#include "../conrep/damage_set.h"
+
+namespace console {
+  namespace {
+    Cell make_cell(wchar_t c, unsigned attributes) {
+      return static_cast<Cell>(c) | (static_cast<Cell>(attributes) << 16);
+    }
+
+    std::vector<Cell> blank_cells(Dimension dim) {
+      return std::vector<Cell>(dim.width * dim.height, make_cell(L' ', 0x07));
+    }
+  }
+
+  TEST(damage_set_starts_empty) {
+    DamageSet damage;
+    damage.reset(Dimension(80, 25));
+    CHECK(damage.empty());
+    CHECK(!damage.full());
+    CHECK(damage.size() == 0);
+    CHECK(damage.dim().width == 80);
+    CHECK(damage.dim().height == 25);
+  }
+
+  TEST(damage_set_widens_the_last_row) {
+    DamageSet damage;
+    damage.reset(Dimension(80, 25));
+    damage.add(3, 10, 12);
+    damage.add(3, 5, 8);
+    damage.add(3, 40, 41);
+    damage.add(4, 0, 1);
+    CHECK(damage.size() == 2);
+    DamageSet::const_iterator itr = damage.begin();
+    CHECK((itr->row == 3) && (itr->begin == 5) && (itr->end == 41));
+    ++itr;
+    CHECK((itr->row == 4) && (itr->begin == 0) && (itr->end == 1));
+  }
+
+  TEST(damage_set_mark_all_covers_every_row) {
+    DamageSet damage;
+    damage.reset(Dimension(10, 4));
+    damage.add(1, 2, 3);
+    damage.set_scroll(2);
+    damage.mark_all();
+    CHECK(damage.full());
+    CHECK(damage.scroll() == 0);
+    CHECK(damage.size() == 4);
+    int row = 0;
+    for (DamageSet::const_iterator itr = damage.begin(); itr != damage.end(); ++itr, ++row) {
+      CHECK((itr->row == row) && (itr->begin == 0) && (itr->end == 10));
+    }
+  }
+
+  TEST(damage_set_scroll_alone_is_not_empty) {
+    DamageSet damage;
+    damage.reset(Dimension(10, 4));
+    damage.set_scroll(-1);
+    CHECK(!damage.empty());
+    CHECK(damage.size() == 0);
+  }
+
+  TEST(compute_damage_finds_changed_columns) {
+    Dimension dim(40, 5);
+    std::vector<Cell> previous = blank_cells(dim);
+    std::vector<Cell> current = previous;
+    current[1 * dim.width + 7]  = make_cell(L'a', 0x07);
+    current[1 * dim.width + 19] = make_cell(L'b', 0x07);
+    current[4 * dim.width + 39] = make_cell(L'c', 0x07);
+
+    DamageSet damage;
+    compute_damage(&current[0], &previous[0], dim, 0xffffffff, damage);
+    CHECK(damage.size() == 2);
+    DamageSet::const_iterator itr = damage.begin();
+    CHECK((itr->row == 1) && (itr->begin == 7) && (itr->end == 20));
+    ++itr;
+    CHECK((itr->row == 4) && (itr->begin == 39) && (itr->end == 40));
+  }
+
+  TEST(compute_damage_ignores_masked_bits) {
+    Dimension dim(16, 2);
+    std::vector<Cell> previous = blank_cells(dim);
+    std::vector<Cell> current = previous;
+    // only the COMMON_LVB_* flags differ, which the mask leaves out
+    current[3] = make_cell(L' ', 0x07 | 0x8000);
+
+    DamageSet damage;
+    compute_damage(&current[0], &previous[0], dim, 0x00ffffff, damage);
+    CHECK(damage.empty());
+    compute_damage(&current[0], &previous[0], dim, 0xffffffff, damage);
+    CHECK(damage.size() == 1);
+  }
+
+  TEST(compute_damage_compares_shifted_rows) {
+    Dimension dim(8, 4);
+    std::vector<Cell> previous(dim.width * dim.height);
+    for (int i = 0; i < dim.height; ++i) {
+      for (int j = 0; j < dim.width; ++j) {
+        previous[i * dim.width + j] = make_cell(static_cast<wchar_t>(L'a' + i), 0x07);
+      }
+    }
+    // everything moved up a row and a new row appeared at the bottom
+    std::vector<Cell> current(previous.begin() + dim.width, previous.end());
+    current.resize(previous.size(), make_cell(L'z', 0x07));
+
+    DamageSet damage;
+    compute_damage(&current[0], &previous[0], dim, 0xffffffff, 1, damage);
+    CHECK(damage.scroll() == 1);
+    CHECK(damage.size() == 1);
+    CHECK((damage.begin()->row == 3) && (damage.begin()->begin == 0) && (damage.begin()->end == 8));
+  }
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// device_recovery_test.cpp
+// tests for DeviceRecovery against a fake device
+
+#include "test.h"
+
+#include <string>
+
+#include "../conrep/device_recovery.h"
+
+namespace console {
+  namespace {
+    // Reports each status in turn, 'L' for DEVICE_LOST, then
+    //   DEVICE_NOT_RESET. The first failed_resets resets fail.
+    class FakeDevice : public IRecoverableDevice {
+      public:
+        FakeDevice(std::string & log, const char * statuses, int failed_resets)
+          : log_(log), statuses_(statuses), failed_resets_(failed_resets) {}
+
+        DeviceStatus test_device(void) {
+          log_ += "t ";
+          if (!*statuses_) return DEVICE_NOT_RESET;
+          return (*statuses_++ == 'L') ? DEVICE_LOST : DEVICE_NOT_RESET;
+        }
+
+        bool reset_device(void) {
+          log_ += "R ";
+          if (failed_resets_ <= 0) return true;
+          --failed_resets_;
+          return false;
+        }
+      private:
+        std::string & log_;
+        const char * statuses_;
+        int failed_resets_;
+
+        FakeDevice & operator=(const FakeDevice &);
+    };
+
+    class FakeResources : public IDeviceResources {
+      public:
+        FakeResources(std::string & log, char name) : log_(log), name_(name) {}
+        void dispose_resources(void) { record('d'); }
+        void restore_resources(void) { record('r'); }
+      private:
+        std::string & log_;
+        char name_;
+
+        void record(char step) {
+          log_ += step;
+          log_ += name_;
+          log_ += ' ';
+        }
+        FakeResources & operator=(const FakeResources &);
+    };
+  }
+
+  TEST(device_recovery_waits_while_the_device_is_lost) {
+    std::string log;
+    FakeDevice device(log, "LL", 0);
+    FakeResources a(log, 'a');
+    FakeResources b(log, 'b');
+    DeviceRecovery recovery;
+    recovery.add(&a);
+    recovery.add(&b);
+
+    CHECK(!recovery.poll(device));
+    CHECK(!recovery.poll(device));
+    CHECK(recovery.poll(device));
+    CHECK(log == "da db t da db t da db t R ra rb ");
+    CHECK(recovery.timings().recoveries == 1);
+  }
+
+  TEST(device_recovery_retries_a_failed_reset) {
+    std::string log;
+    FakeDevice device(log, "", 1);
+    FakeResources a(log, 'a');
+    DeviceRecovery recovery;
+    recovery.add(&a);
+
+    CHECK(!recovery.poll(device));
+    CHECK(recovery.poll(device));
+    CHECK(log == "da t R da t R ra ");
+    CHECK(recovery.timings().failed_resets == 1);
+    CHECK(recovery.timings().recoveries == 1);
+  }
+
+  TEST(device_recovery_skips_removed_resources) {
+    std::string log;
+    FakeDevice device(log, "L", 0);
+    FakeResources a(log, 'a');
+    FakeResources b(log, 'b');
+    DeviceRecovery recovery;
+    recovery.add(&a);
+    recovery.add(&b);
+
+    CHECK(!recovery.poll(device));
+    recovery.remove(&a);
+    CHECK(recovery.poll(device));
+    CHECK(log == "da db t db t R rb ");
+  }
+}
\ No newline at end of file
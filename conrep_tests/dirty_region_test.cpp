@@ -0,0 +1,111 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// dirty_region_test.cpp
+// tests for DirtyRegion
+
+#include "test.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "../conrep/dirty_region.h"
+
+namespace console {
+  namespace {
+    PixelRect make_rect(int left, int top, int right, int bottom) {
+      PixelRect r = { left, top, right, bottom };
+      return r;
+    }
+
+    bool same_rect(const PixelRect & a, int left, int top, int right, int bottom) {
+      return (a.left == left) && (a.top == top) && (a.right == right) && (a.bottom == bottom);
+    }
+
+    bool covered(const DirtyRegion & region, int x, int y) {
+      const std::vector<PixelRect> & rects = region.rects();
+      for (size_t i = 0; i < rects.size(); ++i) {
+        const PixelRect & r = rects[i];
+        if ((x >= r.left) && (x < r.right) && (y >= r.top) && (y < r.bottom)) return true;
+      }
+      return false;
+    }
+  }
+
+  TEST(dirty_region_ignores_empty_rects) {
+    DirtyRegion region;
+    region.add(make_rect(5, 5, 5, 10));
+    region.add(make_rect(5, 5, 10, 4));
+    CHECK(region.empty());
+    CHECK(same_rect(region.bounds(), 0, 0, 0, 0));
+  }
+
+  TEST(dirty_region_merges_neighbouring_rows) {
+    DirtyRegion region;
+    region.add(make_rect(0, 0, 640, 16));
+    region.add(make_rect(0, 32, 640, 48));
+    CHECK(region.rects().size() == 2);
+    // the row between them joins all three into one
+    region.add(make_rect(0, 16, 640, 32));
+    CHECK(region.rects().size() == 1);
+    CHECK(same_rect(region.rects()[0], 0, 0, 640, 48));
+  }
+
+  TEST(dirty_region_absorbs_a_cell_inside_a_row) {
+    DirtyRegion region;
+    region.add(make_rect(0, 16, 640, 32));
+    region.add(make_rect(80, 16, 88, 32));
+    CHECK(region.rects().size() == 1);
+    CHECK(region.area() == 640 * 16);
+  }
+
+  TEST(dirty_region_keeps_distant_cells_apart) {
+    DirtyRegion region;
+    region.add(make_rect(0, 0, 8, 16));
+    region.add(make_rect(600, 400, 608, 416));
+    CHECK(region.rects().size() == 2);
+    CHECK(region.area() == 2 * 8 * 16);
+    CHECK(same_rect(region.bounds(), 0, 0, 608, 416));
+    region.clear();
+    CHECK(region.empty());
+  }
+
+  // Random cells: the region never holds more than MAX_RECTS rectangles and
+  //   never loses a pixel that was added.
+  TEST(dirty_region_bounds_the_count_and_keeps_coverage) {
+    std::srand(1);
+    for (int round = 0; round < 50; ++round) {
+      DirtyRegion region;
+      std::vector<PixelRect> added;
+      for (int i = 0; i < 40; ++i) {
+        int x = (std::rand() % 80) * 8;
+        int y = (std::rand() % 25) * 16;
+        PixelRect r = make_rect(x, y, x + 8 * (1 + std::rand() % 4), y + 16);
+        added.push_back(r);
+        region.add(r);
+        CHECK(region.rects().size() <= DirtyRegion::MAX_RECTS);
+      }
+      bool all_covered = true;
+      for (size_t i = 0; i < added.size(); ++i) {
+        const PixelRect & r = added[i];
+        if (!covered(region, r.left, r.top) || !covered(region, r.right - 1, r.bottom - 1)) all_covered = false;
+      }
+      CHECK(all_covered);
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// downsampler_test.cpp
+// tests for Downsampler
+
+#include "test.h"
+
+#include <vector>
+
+#include "../conrep/downsampler.h"
+
+namespace console {
+  namespace {
+    // a gradient in every channel, so misplaced taps change the result
+    std::vector<Pixel> sample_image(Dimension dim) {
+      std::vector<Pixel> pixels(dim.width * dim.height);
+      for (int y = 0; y < dim.height; ++y) {
+        for (int x = 0; x < dim.width; ++x) {
+          Pixel a = 0xff;
+          Pixel r = (x * 255) / dim.width;
+          Pixel g = (y * 255) / dim.height;
+          Pixel b = ((x + y) * 7) & 0xff;
+          pixels[y * dim.width + x] = (a << 24) | (r << 16) | (g << 8) | b;
+        }
+      }
+      return pixels;
+    }
+
+    std::vector<Pixel> shrink(const std::vector<Pixel> & source, Dimension source_dim, Dimension dest_dim, int strip) {
+      Downsampler downsampler(source_dim, dest_dim);
+      for (int y = 0; y < source_dim.height; y += strip) {
+        int count = (source_dim.height - y < strip) ? source_dim.height - y : strip;
+        downsampler.add_rows(&source[y * source_dim.width], count, source_dim.width);
+      }
+      CHECK(downsampler.done());
+      const Pixel * image = downsampler.image();
+      return std::vector<Pixel>(image, image + dest_dim.width * dest_dim.height);
+    }
+  }
+
+  TEST(downsampler_copies_an_image_of_the_same_size) {
+    Dimension dim(7, 5);
+    std::vector<Pixel> source = sample_image(dim);
+    CHECK(shrink(source, dim, dim, 2) == source);
+  }
+
+  TEST(downsampler_averages_two_by_two_blocks) {
+    Pixel source[] = {
+      0xff000000, 0xff0000ff, 0xff101010, 0xff101010,
+      0xff00ff00, 0xffff0000, 0xff101010, 0xff101010
+    };
+    Downsampler downsampler(Dimension(4, 2), Dimension(2, 1));
+    downsampler.add_rows(source, 2, 4);
+    CHECK(downsampler.done());
+    const Pixel * image = downsampler.image();
+    CHECK(image[0] == 0xff404040); // 63.75 in each channel rounds up
+    CHECK(image[1] == 0xff101010);
+  }
+
+  TEST(downsampler_weights_straddling_pixels_by_overlap) {
+    // three source pixels into two: the middle one is split evenly, so the
+    //   outputs are (2 * 0 + 90) / 3 and (90 + 2 * 180) / 3
+    Pixel source[] = { 0x00000000, 0x5a5a5a5a, 0xb4b4b4b4 };
+    Downsampler downsampler(Dimension(3, 1), Dimension(2, 1));
+    downsampler.add_rows(source, 1, 3);
+    const Pixel * image = downsampler.image();
+    CHECK(image[0] == 0x1e1e1e1e);
+    CHECK(image[1] == 0x96969696);
+  }
+
+  TEST(downsampler_keeps_a_solid_color) {
+    Dimension source_dim(101, 67);
+    Dimension dest_dim(13, 9);
+    std::vector<Pixel> source(source_dim.width * source_dim.height, 0x80c0ff20);
+    std::vector<Pixel> dest = shrink(source, source_dim, dest_dim, 16);
+    CHECK(dest == std::vector<Pixel>(dest.size(), 0x80c0ff20));
+  }
+
+  TEST(downsampler_does_not_depend_on_the_strip_height) {
+    Dimension source_dim(120, 97);
+    Dimension dest_dim(37, 23);
+    std::vector<Pixel> source = sample_image(source_dim);
+    std::vector<Pixel> whole = shrink(source, source_dim, dest_dim, source_dim.height);
+    CHECK(shrink(source, source_dim, dest_dim, 1) == whole);
+    CHECK(shrink(source, source_dim, dest_dim, 10) == whole);
+  }
+}
\ No newline at end of file
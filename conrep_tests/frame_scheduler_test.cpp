@@ -0,0 +1,151 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// frame_scheduler_test.cpp
+// tests for FrameScheduler against a fake device and windows that record
+//   the calls made on them
+
+#include "test.h"
+
+#include <stdexcept>
+#include <string>
+
+#include "../conrep/frame_scheduler.h"
+
+namespace console {
+  namespace {
+    class FakeDevice : public ISceneDevice {
+      public:
+        explicit FakeDevice(std::string & log) : log_(log) {}
+        void begin_scene(void) { log_ += "[ "; }
+        void end_scene(void)   { log_ += "] "; }
+        void flush(void)       { log_ += "f "; }
+      private:
+        std::string & log_;
+        FakeDevice & operator=(const FakeDevice &);
+    };
+
+    // each call appends a step letter and the window's name
+    class FakeWindow : public IScheduledWindow {
+      public:
+        FakeWindow(std::string & log, char name, unsigned work)
+          : log_(log), name_(name), work_(work), throw_in_text_(false) {}
+
+        unsigned prepare(void) { record('p'); return work_; }
+        void draw_text(void) {
+          record('t');
+          if (throw_in_text_) throw std::runtime_error("draw_text");
+        }
+        void compose(void)      { record('c'); }
+        void copy_frame(void)   { record('y'); }
+        void draw_overlay(void) { record('o'); }
+        void present(void)      { record('P'); }
+
+        void set_work(unsigned work) { work_ = work; }
+        void throw_in_text(void) { throw_in_text_ = true; }
+      private:
+        std::string & log_;
+        char name_;
+        unsigned work_;
+        bool throw_in_text_;
+
+        void record(char step) {
+          log_ += step;
+          log_ += name_;
+          log_ += ' ';
+        }
+        FakeWindow & operator=(const FakeWindow &);
+    };
+
+    const unsigned ALL_WORK = WORK_TEXT | WORK_COMPOSE | WORK_PRESENT | WORK_OVERLAY;
+  }
+
+  TEST(frame_scheduler_groups_every_window_into_two_scenes) {
+    std::string log;
+    FakeDevice device(log);
+    FakeWindow a(log, 'a', ALL_WORK);
+    FakeWindow b(log, 'b', ALL_WORK);
+    FrameScheduler scheduler;
+    scheduler.add(&a);
+    scheduler.add(&b);
+    scheduler.tick(device);
+    CHECK(log == "pa pb [ ta f tb f ca f cb f ] ya yb [ oa f ob f ] Pa Pb ");
+    CHECK(scheduler.counts().scenes == 2);
+    CHECK(scheduler.counts().frames == 2);
+  }
+
+  TEST(frame_scheduler_steps_only_the_work_asked_for) {
+    std::string log;
+    FakeDevice device(log);
+    FakeWindow a(log, 'a', WORK_COMPOSE | WORK_PRESENT);
+    FakeWindow b(log, 'b', 0);
+    FrameScheduler scheduler;
+    scheduler.add(&a);
+    scheduler.add(&b);
+    scheduler.tick(device);
+    CHECK(log == "pa pb [ ca f ] ya Pa ");
+
+    log.clear();
+    a.set_work(0);
+    scheduler.tick(device);
+    CHECK(log == "pa pb ");
+    CHECK(scheduler.counts().ticks == 2);
+    CHECK(scheduler.counts().scenes == 1);
+    CHECK(scheduler.counts().frames == 1);
+  }
+
+  TEST(frame_scheduler_coalesces_requests_until_a_tick) {
+    std::string log;
+    FakeDevice device(log);
+    FrameScheduler scheduler;
+    CHECK(scheduler.request());
+    CHECK(!scheduler.request());
+    scheduler.tick(device);
+    CHECK(scheduler.request());
+  }
+
+  TEST(frame_scheduler_forgets_removed_windows) {
+    std::string log;
+    FakeDevice device(log);
+    FakeWindow a(log, 'a', WORK_PRESENT);
+    FakeWindow b(log, 'b', WORK_PRESENT);
+    FrameScheduler scheduler;
+    scheduler.add(&a);
+    scheduler.add(&b);
+    scheduler.remove(&a);
+    scheduler.tick(device);
+    CHECK(log == "pb yb Pb ");
+  }
+
+  TEST(frame_scheduler_ends_the_scene_when_a_step_throws) {
+    std::string log;
+    FakeDevice device(log);
+    FakeWindow a(log, 'a', ALL_WORK);
+    a.throw_in_text();
+    FrameScheduler scheduler;
+    scheduler.add(&a);
+    bool thrown = false;
+    try {
+      scheduler.tick(device);
+    } catch (std::runtime_error &) {
+      thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(log == "pa [ ta ] ");
+  }
+}
\ No newline at end of file
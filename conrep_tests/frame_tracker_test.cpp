@@ -0,0 +1,113 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// frame_tracker_test.cpp
+// tests for FrameTracker
+
+#include "test.h"
+
+#include "../conrep/frame_tracker.h"
+
+namespace console {
+  namespace {
+    CursorCell cursor_at(int column, int row, bool visible) {
+      CursorCell cursor = { column, row, visible };
+      return cursor;
+    }
+
+    bool same_cell(const CursorCell & cell, int column, int row) {
+      return (cell.column == column) && (cell.row == row);
+    }
+  }
+
+  TEST(frame_tracker_wants_a_first_frame) {
+    FrameTracker tracker;
+    CHECK(tracker.request());
+    CHECK(!tracker.partial());
+    tracker.presented();
+    CHECK(!tracker.request());
+    CHECK(tracker.counts().presented == 1);
+    CHECK(tracker.counts().skipped == 1);
+  }
+
+  TEST(frame_tracker_ignores_a_hidden_cursor_moving) {
+    FrameTracker tracker;
+    tracker.presented();
+    tracker.set_cursor(cursor_at(3, 4, false));
+    CHECK(!tracker.request());
+    tracker.set_cursor(cursor_at(3, 4, true));
+    CHECK(tracker.changes() == FRAME_CURSOR);
+    tracker.presented();
+    tracker.set_cursor(cursor_at(3, 4, true));
+    CHECK(!tracker.request());
+  }
+
+  TEST(frame_tracker_patches_only_text_and_cursor_changes) {
+    FrameTracker tracker;
+    tracker.presented();
+    tracker.mark(FRAME_TEXT);
+    tracker.set_cursor(cursor_at(1, 1, true));
+    CHECK(tracker.partial());
+    tracker.mark(FRAME_POSITION);
+    CHECK(!tracker.partial());
+    tracker.presented();
+    tracker.mark(FRAME_EXPOSE);
+    CHECK(!tracker.partial());
+  }
+
+  TEST(frame_tracker_restores_the_cell_the_cursor_left) {
+    FrameTracker tracker;
+    tracker.set_cursor(cursor_at(2, 5, true));
+    tracker.presented();
+    tracker.set_cursor(cursor_at(3, 5, true));
+
+    CursorCell cells[2];
+    CHECK(tracker.cursor_cells(cells) == 2);
+    CHECK(same_cell(cells[0], 2, 5));
+    CHECK(same_cell(cells[1], 3, 5));
+  }
+
+  TEST(frame_tracker_counts_a_blinking_cursor_once) {
+    FrameTracker tracker;
+    tracker.set_cursor(cursor_at(2, 5, true));
+    tracker.presented();
+
+    CursorCell cells[2];
+    tracker.set_cursor(cursor_at(2, 5, false));
+    CHECK(tracker.cursor_cells(cells) == 1);
+    CHECK(same_cell(cells[0], 2, 5));
+    tracker.presented();
+
+    tracker.set_cursor(cursor_at(2, 5, true));
+    CHECK(tracker.cursor_cells(cells) == 1);
+    CHECK(same_cell(cells[0], 2, 5));
+    tracker.presented();
+
+    tracker.mark(FRAME_TEXT);
+    CHECK(tracker.cursor_cells(cells) == 1); // unmoved, but still redrawn
+  }
+
+  TEST(frame_tracker_clears_the_region_when_presented) {
+    FrameTracker tracker;
+    PixelRect rect = { 0, 0, 10, 10 };
+    tracker.region().add(rect);
+    CHECK(!tracker.region().empty());
+    tracker.presented();
+    CHECK(tracker.region().empty());
+  }
+}
\ No newline at end of file
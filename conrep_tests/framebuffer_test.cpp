@@ -0,0 +1,166 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// framebuffer_test.cpp
+// tests for Framebuffer compositing, chiefly that the fused pre and post
+//   alpha pass matches the two-pass one
+
+#include "test.h"
+
+#include <vector>
+
+#include "../conrep/framebuffer.h"
+
+namespace console {
+  namespace {
+    const Dimension GLYPH_DIM(8, 16);
+    const Dimension TEXT_DIM(64, 32);
+
+    std::vector<std::uint8_t> sample_coverage(unsigned seed) {
+      std::vector<std::uint8_t> coverage(GLYPH_DIM.width * GLYPH_DIM.height);
+      for (size_t i = 0; i < coverage.size(); ++i) {
+        seed = seed * 1103515245 + 12345;
+        coverage[i] = static_cast<std::uint8_t>(seed >> 16);
+      }
+      return coverage;
+    }
+
+    void fill_backdrop(Framebuffer & backdrop) {
+      backdrop.resize(TEXT_DIM);
+      for (int y = 0; y < TEXT_DIM.height; ++y) {
+        for (int x = 0; x < TEXT_DIM.width; ++x) {
+          backdrop.row(y)[x] = 0xff000000 | (x * 4 << 16) | (y * 8 << 8) | ((x + y) & 0xff);
+        }
+      }
+    }
+
+    // glyphs in a few colors, one of them half transparent, with a gap
+    //   between them where only the clear shows
+    void draw_text(Framebuffer & text) {
+      const Pixel colors[] = { 0xffc0c0c0, 0xffff0000, 0x8000ff80, 0xff2040ff };
+      for (int i = 0; i < 4; ++i) {
+        std::vector<std::uint8_t> coverage = sample_coverage(i + 1);
+        text.draw_coverage(i * 16, 8, &coverage[0], GLYPH_DIM, colors[i]);
+      }
+    }
+
+    // draw_text() with opaque cell backgrounds in the gaps, and a glyph drawn
+    //   solidly over one of them
+    void draw_cells(Framebuffer & text) {
+      draw_text(text);
+      PixelRect gap = { 8, 0, 16, 32 };
+      text.fill(0xff123456, gap);
+      PixelRect under_glyph = { 40, 0, 48, 32 };
+      text.fill(0xff654321, under_glyph);
+      std::vector<std::uint8_t> solid(GLYPH_DIM.width * GLYPH_DIM.height, 0xff);
+      text.draw_coverage(40, 8, &solid[0], GLYPH_DIM, 0xffc0c0c0);
+    }
+
+    typedef void (*Drawing)(Framebuffer & text);
+
+    std::uint64_t two_pass(unsigned pre_alpha, unsigned post_alpha, Drawing drawing = draw_text) {
+      Framebuffer text;
+      text.resize(TEXT_DIM);
+      text.clear(pre_alpha << 24);
+      drawing(text);
+      Framebuffer target;
+      fill_backdrop(target);
+      target.draw(text, 0, 0, (post_alpha << 24) | 0x00ffffff);
+      return target.hash();
+    }
+
+    std::uint64_t fused(unsigned pre_alpha, unsigned post_alpha, Drawing drawing = draw_text) {
+      Framebuffer text;
+      text.resize(TEXT_DIM);
+      text.set_alpha_mode(ALPHA_TRANSMITTANCE);
+      text.clear(0xff000000);
+      drawing(text);
+      Framebuffer target;
+      fill_backdrop(target);
+      target.draw_fused(text, 0, 0, pre_alpha, post_alpha);
+      return target.hash();
+    }
+  }
+
+  TEST(framebuffer_fused_pass_matches_two_passes) {
+    const unsigned alphas[] = { 0, 1, 64, 128, 200, 254, 255 };
+    bool all_match = true;
+    for (int i = 0; i < 7; ++i) {
+      for (int j = 0; j < 7; ++j) {
+        if (two_pass(alphas[i], alphas[j]) != fused(alphas[i], alphas[j])) all_match = false;
+      }
+    }
+    CHECK(all_match);
+  }
+
+  // Only a partly covered glyph edge over a filled cell can't be matched, as
+  //   the transmittance left over it is zero either way; the renderers keep
+  //   out of the fused mode while the console has cell backgrounds, which
+  //   software_renderer_test.cpp checks.
+  TEST(framebuffer_fused_pass_matches_two_passes_with_filled_cells) {
+    const unsigned alphas[] = { 0, 1, 64, 128, 200, 254, 255 };
+    bool all_match = true;
+    for (int i = 0; i < 7; ++i) {
+      for (int j = 0; j < 7; ++j) {
+        if (two_pass(alphas[i], alphas[j], draw_cells) != fused(alphas[i], alphas[j], draw_cells)) all_match = false;
+      }
+    }
+    CHECK(all_match);
+  }
+
+  TEST(framebuffer_kernels_agree) {
+    std::vector<Pixel> source(67);
+    std::vector<Pixel> dest(67);
+    unsigned seed = 7;
+    for (size_t i = 0; i < source.size(); ++i) {
+      seed = seed * 1103515245 + 12345;
+      source[i] = seed;
+      seed = seed * 1103515245 + 12345;
+      dest[i] = seed;
+    }
+    // a run of fully transparent pixels, which the SSE2 kernel skips
+    for (size_t i = 8; i < 16; ++i) source[i] &= 0x00ffffff;
+
+    for (int l = SIMD_SCALAR; l <= get_simd_level(); ++l) {
+      SimdLevel level = static_cast<SimdLevel>(l);
+      std::vector<Pixel> expected = dest;
+      blend_span(&expected[0], &source[0], source.size(), SIMD_SCALAR);
+      std::vector<Pixel> actual = dest;
+      blend_span(&actual[0], &source[0], source.size(), level);
+      CHECK(actual == expected);
+
+      expected = dest;
+      blend_span_transmittance(&expected[0], &source[0], source.size(), SIMD_SCALAR);
+      actual = dest;
+      blend_span_transmittance(&actual[0], &source[0], source.size(), level);
+      CHECK(actual == expected);
+    }
+  }
+
+  TEST(framebuffer_moves_rows_within_a_range) {
+    Framebuffer fb;
+    fb.resize(Dimension(2, 6));
+    for (int y = 0; y < 6; ++y) fb.row(y)[0] = fb.row(y)[1] = y;
+    fb.move_rows(1, 5, -2);
+    CHECK(fb.row(0)[0] == 0);
+    CHECK(fb.row(1)[0] == 3);
+    CHECK(fb.row(2)[1] == 4);
+    CHECK(fb.row(3)[0] == 3); // uncovered, left unchanged
+    CHECK(fb.row(5)[0] == 5);
+  }
+}
\ No newline at end of file
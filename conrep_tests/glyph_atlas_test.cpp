@@ -0,0 +1,144 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// glyph_atlas_test.cpp
+// tests for GlyphAtlas and build_glyph_quads()
+
+#include "test.h"
+
+#include <vector>
+
+#include "../conrep/glyph_atlas.h"
+
+namespace console {
+  namespace {
+    // with a pixel between slots, 8x16 glyphs fit 4 across and 2 down
+    void reset_small(GlyphAtlas & atlas) {
+      atlas.reset(Dimension(37, 35), Dimension(8, 16));
+    }
+
+    std::vector<CellChar> chars_of(const wchar_t * text) {
+      std::vector<CellChar> chars;
+      for (; *text; ++text) chars.push_back(static_cast<CellChar>(*text));
+      return chars;
+    }
+  }
+
+  TEST(glyph_atlas_lays_slots_out_in_a_grid) {
+    GlyphAtlas atlas;
+    reset_small(atlas);
+    CHECK(atlas.capacity() == 8);
+    CHECK(atlas.free_slots() == 8);
+    CHECK((atlas.glyph_dim().width == 8) && (atlas.glyph_dim().height == 16));
+    CHECK((atlas.slot_x(0) == 0) && (atlas.slot_y(0) == 0));
+    CHECK((atlas.slot_x(3) == 27) && (atlas.slot_y(3) == 0));
+    CHECK((atlas.slot_x(5) == 9) && (atlas.slot_y(5) == 17));
+  }
+
+  TEST(glyph_atlas_adds_each_character_once) {
+    GlyphAtlas atlas;
+    reset_small(atlas);
+    CHECK(atlas.find(L'a') == GlyphAtlas::MISSING);
+    CHECK(atlas.add(L'a') == 0);
+    CHECK(atlas.add(L'b') == 1);
+    CHECK(atlas.add(L'a') == 0);
+    CHECK(atlas.find(L'b') == 1);
+    CHECK(atlas.free_slots() == 6);
+
+    // blanks take no slot, and don't replace a glyph
+    atlas.add_blank(L' ');
+    atlas.add_blank(L'a');
+    CHECK(atlas.find(L' ') == GlyphAtlas::BLANK);
+    CHECK(atlas.find(L'a') == 0);
+    CHECK(atlas.free_slots() == 6);
+  }
+
+  TEST(glyph_atlas_refuses_characters_once_full) {
+    GlyphAtlas atlas;
+    reset_small(atlas);
+    for (CellChar c = 0x4e00; c < 0x4e08; ++c) CHECK(atlas.add(c) >= 0);
+    CHECK(atlas.free_slots() == 0);
+    CHECK(atlas.add(0xffff) == GlyphAtlas::MISSING);
+    CHECK(atlas.find(0xffff) == GlyphAtlas::MISSING);
+    CHECK(atlas.add(0x4e07) == 7); // already there
+  }
+
+  TEST(glyph_atlas_clear_forgets_every_glyph) {
+    GlyphAtlas atlas;
+    reset_small(atlas);
+    atlas.add(L'a');
+    atlas.add_blank(L' ');
+    atlas.clear();
+    CHECK(atlas.find(L'a') == GlyphAtlas::MISSING);
+    CHECK(atlas.find(L' ') == GlyphAtlas::MISSING);
+    CHECK(atlas.free_slots() == 8);
+    CHECK(atlas.add(L'z') == 0);
+
+    // and so does a new layout
+    atlas.reset(Dimension(100, 100), Dimension(9, 9));
+    CHECK(atlas.find(L'z') == GlyphAtlas::MISSING);
+    CHECK(atlas.capacity() == 100);
+  }
+
+  TEST(glyph_atlas_finds_distinct_missing_characters) {
+    GlyphAtlas atlas;
+    reset_small(atlas);
+    atlas.add(L'l');
+    atlas.add_blank(L' ');
+    std::vector<CellChar> row = chars_of(L"hello world");
+    std::vector<CellChar> missing;
+    atlas.find_missing(&row[0], static_cast<int>(row.size()), missing);
+    CHECK(missing == chars_of(L"dehorw"));
+
+    // appends to what earlier rows found
+    std::vector<CellChar> next = chars_of(L"zz");
+    atlas.find_missing(&next[0], static_cast<int>(next.size()), missing);
+    CHECK(missing == chars_of(L"dehorwz"));
+  }
+
+  TEST(build_glyph_quads_skips_blank_and_missing_glyphs) {
+    GlyphAtlas atlas;
+    reset_small(atlas);
+    atlas.add(L'a');
+    atlas.add(L'b');
+    atlas.add_blank(L' ');
+    std::vector<CellChar> chars = chars_of(L"a b?a");
+    CellAttribute attributes[] = { 0x17, 0x17, 0x2c, 0x17, 0x70 };
+    std::vector<GlyphQuad> quads(3); // replaced, not appended to
+    build_glyph_quads(atlas, &chars[0], attributes, 5, false, quads);
+    CHECK(quads.size() == 3);
+    CHECK((quads[0].column == 0) && (quads[0].slot == 0) && (quads[0].color == 0x7));
+    CHECK((quads[1].column == 2) && (quads[1].slot == 1) && (quads[1].color == 0xc));
+    CHECK((quads[2].column == 4) && (quads[2].slot == 0) && (quads[2].color == 0x0));
+  }
+
+  TEST(build_glyph_quads_intensifies_all_but_black) {
+    GlyphAtlas atlas;
+    reset_small(atlas);
+    atlas.add(L'a');
+    std::vector<CellChar> chars = chars_of(L"aaaa");
+    CellAttribute attributes[] = { 0x07, 0x70, 0x0c, 0x01 };
+    std::vector<GlyphQuad> quads;
+    build_glyph_quads(atlas, &chars[0], attributes, 4, true, quads);
+    CHECK(quads.size() == 4);
+    CHECK(quads[0].color == 0xf);
+    CHECK(quads[1].color == 0x0);
+    CHECK(quads[2].color == 0xc);
+    CHECK(quads[3].color == 0x9);
+  }
+}
\ No newline at end of file
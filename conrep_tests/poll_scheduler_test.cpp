@@ -0,0 +1,82 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// poll_scheduler_test.cpp
+// tests for PollScheduler
+
+#include "test.h"
+
+#include "../conrep/poll_scheduler.h"
+
+namespace console {
+  TEST(poll_scheduler_starts_at_the_minimum) {
+    PollScheduler scheduler(10, 1000, 100);
+    CHECK(scheduler.interval() == 10);
+  }
+
+  TEST(poll_scheduler_waits_out_the_grace_period) {
+    PollScheduler scheduler(10, 1000, 100);
+    CHECK(scheduler.polled(0, true) == 10);
+    CHECK(scheduler.polled(50, false) == 10);
+    CHECK(scheduler.polled(99, false) == 10);
+    CHECK(scheduler.polled(100, false) == 20);
+  }
+
+  TEST(poll_scheduler_backs_off_to_the_maximum) {
+    PollScheduler scheduler(10, 100, 0);
+    CHECK(scheduler.polled(1, false) == 20);
+    CHECK(scheduler.polled(2, false) == 40);
+    CHECK(scheduler.polled(3, false) == 80);
+    CHECK(scheduler.polled(4, false) == 100);
+    CHECK(scheduler.polled(5, false) == 100);
+  }
+
+  TEST(poll_scheduler_resets_on_change_and_input) {
+    PollScheduler scheduler(10, 1000, 0);
+    scheduler.polled(1, false);
+    scheduler.polled(2, false);
+    CHECK(scheduler.interval() == 40);
+    CHECK(scheduler.polled(3, true) == 10);
+
+    scheduler.polled(4, false);
+    CHECK(scheduler.interval() == 20);
+    scheduler.input(5);
+    CHECK(scheduler.interval() == 10);
+  }
+
+  TEST(poll_scheduler_input_restarts_the_grace_period) {
+    PollScheduler scheduler(10, 1000, 100);
+    scheduler.polled(0, true);
+    scheduler.input(80);
+    CHECK(scheduler.polled(150, false) == 10);
+    CHECK(scheduler.polled(180, false) == 20);
+  }
+
+  TEST(poll_scheduler_survives_the_clock_wrapping) {
+    PollScheduler scheduler(10, 1000, 100);
+    scheduler.polled(0xffffffc0u, true);
+    // 0x40 is 128 ms after the change, past the grace period
+    CHECK(scheduler.polled(0x20, false) == 10);
+    CHECK(scheduler.polled(0x40, false) == 20);
+  }
+
+  TEST(poll_scheduler_raises_a_maximum_below_the_minimum) {
+    PollScheduler scheduler(50, 10, 0);
+    CHECK(scheduler.polled(1, false) == 50);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// read_planner_test.cpp
+// tests for rows_per_read() and plan_reads()
+
+#include "test.h"
+
+#include <string>
+#include <vector>
+
+#include "../conrep/read_planner.h"
+
+namespace console {
+  namespace {
+    const size_t CELL = 4; // sizeof(CHAR_INFO)
+
+    std::vector<RowRange> & add(std::vector<RowRange> & hint, int first, int last) {
+      RowRange r = { first, last };
+      hint.push_back(r);
+      return hint;
+    }
+
+    // bands as "top-bottom ", for comparing whole plans
+    std::string describe(const std::vector<ReadBand> & plan) {
+      std::string text;
+      for (size_t i = 0; i < plan.size(); ++i) {
+        text += std::to_string(plan[i].top) + "-" + std::to_string(plan[i].bottom) + " ";
+      }
+      return text;
+    }
+  }
+
+  TEST(rows_per_read_stays_under_the_limit) {
+    CHECK(rows_per_read(80, CELL, CONSOLE_READ_LIMIT) == 204);
+    // exactly the limit is too much
+    CHECK(rows_per_read(1024, CELL, CONSOLE_READ_LIMIT) == 15);
+    CHECK(rows_per_read(1000, CELL, CONSOLE_READ_LIMIT) == 16);
+    // always at least a row, however wide
+    CHECK(rows_per_read(20000, CELL, CONSOLE_READ_LIMIT) == 1);
+    CHECK(rows_per_read(0, CELL, CONSOLE_READ_LIMIT) > 0);
+  }
+
+  TEST(plan_reads_covers_the_whole_viewport) {
+    std::vector<ReadBand> plan;
+    plan_reads(Dimension(80, 50), CELL, CONSOLE_READ_LIMIT, plan);
+    CHECK(describe(plan) == "0-50 ");
+    plan_reads(Dimension(1000, 40), CELL, CONSOLE_READ_LIMIT, plan);
+    CHECK(describe(plan) == "0-16 16-32 32-40 ");
+    plan_reads(Dimension(0, 40), CELL, CONSOLE_READ_LIMIT, plan);
+    CHECK(plan.empty());
+  }
+
+  TEST(plan_reads_joins_nearby_hints) {
+    std::vector<RowRange> hint;
+    add(add(add(hint, 50, 52), 10, 12), 5, 6);
+    std::vector<ReadBand> plan;
+    plan_reads(Dimension(1000, 100), CELL, CONSOLE_READ_LIMIT, hint, plan);
+    // rows 6 to 10 cost nothing to read along with the rest
+    CHECK(describe(plan) == "5-12 50-52 ");
+  }
+
+  TEST(plan_reads_clips_and_merges_overlapping_hints) {
+    std::vector<RowRange> hint;
+    add(add(add(add(hint, 95, 120), 2, 8), -5, 3), 7, 7);
+    std::vector<ReadBand> plan;
+    plan_reads(Dimension(1000, 100), CELL, CONSOLE_READ_LIMIT, hint, plan);
+    CHECK(describe(plan) == "0-8 95-100 ");
+  }
+
+  TEST(plan_reads_splits_a_long_hint) {
+    std::vector<RowRange> hint;
+    add(add(hint, 0, 40), 41, 42);
+    std::vector<ReadBand> plan;
+    plan_reads(Dimension(1000, 100), CELL, CONSOLE_READ_LIMIT, hint, plan);
+    CHECK(describe(plan) == "0-16 16-32 32-42 ");
+
+    hint.clear();
+    plan_reads(Dimension(1000, 100), CELL, CONSOLE_READ_LIMIT, hint, plan);
+    CHECK(plan.empty());
+  }
+}
\ No newline at end of file
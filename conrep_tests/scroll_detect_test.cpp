@@ -0,0 +1,102 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// scroll_detect_test.cpp
+// tests for row hashing and ScrollDetector
+
+#include "test.h"
+
+#include <vector>
+
+#include "../conrep/scroll_detect.h"
+
+namespace console {
+  namespace {
+    // rows of distinct text, so every row hash is unique
+    std::vector<Cell> numbered_rows(Dimension dim, int first_number) {
+      std::vector<Cell> cells(dim.width * dim.height, static_cast<Cell>(L' ') | (0x07 << 16));
+      for (int i = 0; i < dim.height; ++i) {
+        int n = first_number + i;
+        cells[i * dim.width + 0] = static_cast<Cell>(L'0' + (n / 100) % 10) | (0x07 << 16);
+        cells[i * dim.width + 1] = static_cast<Cell>(L'0' + (n / 10) % 10) | (0x07 << 16);
+        cells[i * dim.width + 2] = static_cast<Cell>(L'0' + n % 10) | (0x07 << 16);
+      }
+      return cells;
+    }
+
+    std::vector<RowHash> hashes_of(const std::vector<Cell> & cells, Dimension dim) {
+      std::vector<RowHash> hashes;
+      hash_rows(&cells[0], dim, 0xffffffff, hashes);
+      return hashes;
+    }
+  }
+
+  TEST(hash_row_sees_the_last_cell) {
+    Cell a[4] = { 1, 2, 3, 4 };
+    Cell b[4] = { 1, 2, 3, 5 };
+    CHECK(hash_row(a, 4, 0xffffffff) != hash_row(b, 4, 0xffffffff));
+    CHECK(hash_row(a, 4, 0xffffffff) == hash_row(a, 4, 0xffffffff));
+  }
+
+  TEST(hash_row_applies_the_mask) {
+    Cell a[2] = { 0x00070041, 0x00070042 };
+    Cell b[2] = { 0x80070041, 0x00070042 };
+    CHECK(hash_row(a, 2, 0x00ffffff) == hash_row(b, 2, 0x00ffffff));
+    CHECK(hash_row(a, 2, 0xffffffff) != hash_row(b, 2, 0xffffffff));
+  }
+
+  TEST(scroll_detector_finds_no_shift_in_identical_rows) {
+    Dimension dim(20, 10);
+    std::vector<RowHash> hashes = hashes_of(numbered_rows(dim, 0), dim);
+    ScrollDetector detector;
+    CHECK(detector.detect(hashes, hashes) == 0);
+  }
+
+  TEST(scroll_detector_finds_upward_and_downward_shifts) {
+    Dimension dim(20, 10);
+    std::vector<RowHash> previous = hashes_of(numbered_rows(dim, 0), dim);
+    ScrollDetector detector;
+    // rows 3 to 12 are showing: the text moved up three rows
+    CHECK(detector.detect(previous, hashes_of(numbered_rows(dim, 3), dim)) == 3);
+    // rows -2 to 7, numbered modulo 1000: the text moved down two rows
+    CHECK(detector.detect(previous, hashes_of(numbered_rows(dim, 998), dim)) == -2);
+  }
+
+  TEST(scroll_detector_ignores_repeated_rows) {
+    Dimension dim(20, 12);
+    std::vector<Cell> before = numbered_rows(dim, 0);
+    // Half the screen is blank, which would otherwise vote for every
+    //   shift; the unique rows moved up one.
+    for (int i = 6; i < dim.height; ++i) {
+      for (int j = 0; j < dim.width; ++j) before[i * dim.width + j] = static_cast<Cell>(L' ') | (0x07 << 16);
+    }
+    std::vector<Cell> after(before.begin() + dim.width, before.end());
+    after.resize(before.size(), static_cast<Cell>(L' ') | (0x07 << 16));
+
+    ScrollDetector detector;
+    CHECK(detector.detect(hashes_of(before, dim), hashes_of(after, dim)) == 1);
+  }
+
+  TEST(scroll_detector_needs_two_rows) {
+    std::vector<RowHash> one(1, 42);
+    std::vector<RowHash> none;
+    ScrollDetector detector;
+    CHECK(detector.detect(one, one) == 0);
+    CHECK(detector.detect(none, none) == 0);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// shadow_store_test.cpp
+// tests for copy_shadow() and ShadowStore
+
+#include "test.h"
+
+#include <vector>
+
+#include "../conrep/shadow_store.h"
+
+namespace console {
+  namespace {
+    ShadowImage solid_image(Dimension dim, Pixel color) {
+      ShadowImage image;
+      image.dim = dim;
+      image.pixels.assign(dim.width * dim.height, color);
+      return image;
+    }
+  }
+
+  TEST(copy_shadow_drops_the_stride_padding) {
+    // a 3x2 image in a surface 4 pixels wide
+    Pixel surface[] = { 1, 2, 3, 0xdead, 4, 5, 6, 0xdead };
+    ShadowImage image;
+    copy_shadow(surface, 4, Dimension(3, 2), image);
+    CHECK((image.dim.width == 3) && (image.dim.height == 2));
+    Pixel expected[] = { 1, 2, 3, 4, 5, 6 };
+    CHECK(image.pixels == std::vector<Pixel>(expected, expected + 6));
+  }
+
+  TEST(shadow_store_takes_and_replaces_copies) {
+    ShadowStore store(1 << 20);
+    ShadowImage image = solid_image(Dimension(16, 16), 0xff0000ff);
+    store.store(1, image);
+    CHECK(image.pixels.empty()); // taken, not copied
+    const ShadowImage * found = store.find(1);
+    CHECK(found && (found->pixels.size() == 256) && (found->pixels[0] == 0xff0000ff));
+    CHECK(!store.find(2));
+    CHECK(store.bytes() == 256 * sizeof(Pixel));
+
+    ShadowImage smaller = solid_image(Dimension(8, 8), 0xff00ff00);
+    store.store(1, smaller);
+    CHECK(store.bytes() == 64 * sizeof(Pixel));
+    store.erase(1);
+    CHECK(!store.find(1));
+    CHECK(store.bytes() == 0);
+  }
+
+  TEST(shadow_store_drops_the_oldest_past_the_limit) {
+    ShadowStore store(2 * 256 * sizeof(Pixel));
+    for (std::uintptr_t key = 1; key <= 3; ++key) {
+      ShadowImage image = solid_image(Dimension(16, 16), 0);
+      store.store(key, image);
+    }
+    CHECK(!store.find(1));
+    CHECK(store.find(2) && store.find(3));
+
+    // replacing a copy makes it the newest
+    ShadowImage image = solid_image(Dimension(16, 16), 0);
+    store.store(2, image);
+    image = solid_image(Dimension(16, 16), 0);
+    store.store(4, image);
+    CHECK(!store.find(3));
+    CHECK(store.find(2) && store.find(4));
+  }
+
+  TEST(shadow_store_keeps_one_copy_over_the_limit) {
+    ShadowStore store(100);
+    ShadowImage image = solid_image(Dimension(64, 64), 0);
+    store.store(1, image);
+    CHECK(store.find(1));
+    store.clear();
+    CHECK(!store.find(1));
+    CHECK(store.bytes() == 0);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,269 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// software_renderer_test.cpp
+// tests for SoftwareRenderer, the reference for what TextRenderer draws
+
+#include "test.h"
+
+#include <vector>
+
+#include "../conrep/software_renderer.h"
+
+namespace console {
+  namespace {
+    const Dimension CONSOLE_DIM(12, 5);
+    const Dimension GLYPH_DIM(6, 10);
+    const int GUTTER_SIZE = 3;
+
+    // Unlike PatternGlyphSource, every coverage value turns up, as at the
+    //   anti-aliased edges of real glyphs.
+    class RampGlyphSource : public GlyphSource {
+      public:
+        RampGlyphSource() : coverage_(GLYPH_DIM.width * GLYPH_DIM.height) {}
+
+        Dimension glyph_dim(void) const {
+          return GLYPH_DIM;
+        }
+
+        const std::uint8_t * glyph(CellChar c) {
+          if (c <= ' ') return 0;
+          for (size_t i = 0; i < coverage_.size(); ++i) {
+            coverage_[i] = static_cast<std::uint8_t>(c * 37 + i * 23);
+          }
+          return &coverage_[0];
+        }
+      private:
+        std::vector<std::uint8_t> coverage_;
+    };
+
+    struct Palette {
+      Pixel colors[SoftwareRenderer::CONSOLE_COLORS];
+
+      Palette() {
+        for (int i = 0; i < SoftwareRenderer::CONSOLE_COLORS; ++i) {
+          colors[i] = 0xff000000 | (i * 0x100f07);
+        }
+      }
+    };
+
+    // letters and spaces in every foreground color; with backgrounds, some
+    //   runs of cells in row 2 are filled as well
+    std::vector<Cell> sample_cells(bool backgrounds) {
+      std::vector<Cell> cells(CONSOLE_DIM.width * CONSOLE_DIM.height);
+      for (size_t i = 0; i < cells.size(); ++i) {
+        Cell c = (i % 5 == 4) ? ' ' : static_cast<Cell>('A' + i % 26);
+        Cell attribute = 1 + i % 15;
+        int row = static_cast<int>(i) / CONSOLE_DIM.width;
+        if (backgrounds && (row == 2) && (i % 4 != 0)) attribute |= (1 + i % 3) << 4;
+        cells[i] = c | (attribute << 16);
+      }
+      return cells;
+    }
+
+    // the contents moved up by rows, or down if negative, with new rows of
+    //   '#' in the uncovered space
+    std::vector<Cell> scroll_cells(const std::vector<Cell> & cells, int rows) {
+      std::vector<Cell> scrolled(cells.size());
+      for (int i = 0; i < CONSOLE_DIM.height; ++i) {
+        int j = i + rows;
+        for (int k = 0; k < CONSOLE_DIM.width; ++k) {
+          bool kept = (j >= 0) && (j < CONSOLE_DIM.height);
+          scrolled[i * CONSOLE_DIM.width + k] = kept ? cells[j * CONSOLE_DIM.width + k] : (0x00240000 | '#');
+        }
+      }
+      return scrolled;
+    }
+
+    DamageSet all_rows(void) {
+      DamageSet damage;
+      damage.reset(CONSOLE_DIM);
+      damage.mark_all();
+      return damage;
+    }
+
+    std::uint64_t compose(const SoftwareRenderer & renderer, unsigned pre_alpha, unsigned post_alpha) {
+      Framebuffer target;
+      Dimension dim = renderer.get_client_size();
+      target.resize(dim);
+      for (int y = 0; y < dim.height; ++y) {
+        for (int x = 0; x < dim.width; ++x) {
+          target.row(y)[x] = 0xff000000 | (x * 3 << 16) | (y * 5 << 8) | ((x ^ y) & 0xff);
+        }
+      }
+      renderer.render(target, pre_alpha, post_alpha);
+      return target.hash();
+    }
+
+    // What a new window shows for cells, to compare incremental updates with.
+    struct Redraw {
+      std::uint64_t text;
+      std::uint64_t composed;
+    };
+
+    Redraw full_redraw(GlyphSource & glyphs, const std::vector<Cell> & cells, bool fused) {
+      Palette palette;
+      SoftwareRenderer renderer(glyphs, palette.colors, GUTTER_SIZE);
+      renderer.set_fused_alpha(fused);
+      renderer.resize(CONSOLE_DIM);
+      renderer.update_text(&cells[0], all_rows(), 100, false);
+      Redraw r = { renderer.text().hash(), compose(renderer, 100, 200) };
+      return r;
+    }
+
+    // Updates a renderer showing previous to current through the damage
+    //   found with the given scroll, then checks it against a full redraw.
+    bool update_matches_redraw(const std::vector<Cell> & previous, const std::vector<Cell> & current, int scroll, bool fused) {
+      PatternGlyphSource glyphs(GLYPH_DIM);
+      Palette palette;
+      SoftwareRenderer renderer(glyphs, palette.colors, GUTTER_SIZE);
+      renderer.set_fused_alpha(fused);
+      renderer.resize(CONSOLE_DIM);
+      renderer.update_text(&previous[0], all_rows(), 100, false);
+
+      DamageSet damage;
+      compute_damage(&current[0], &previous[0], CONSOLE_DIM, 0xffffffff, scroll, damage);
+      renderer.update_text(&current[0], damage, 100, false);
+
+      Redraw expected = full_redraw(glyphs, current, fused);
+      return (renderer.text().hash() == expected.text) &&
+             (compose(renderer, 100, 200) == expected.composed);
+    }
+  }
+
+  TEST(software_renderer_draws_cells_and_gutter) {
+    PatternGlyphSource glyphs(GLYPH_DIM);
+    Palette palette;
+    SoftwareRenderer renderer(glyphs, palette.colors, GUTTER_SIZE);
+    renderer.resize(CONSOLE_DIM);
+    CHECK(renderer.get_client_size().width == 12 * 6 + 2 * GUTTER_SIZE);
+    CHECK(renderer.get_client_size().height == 5 * 10 + 2 * GUTTER_SIZE);
+
+    std::vector<Cell> cells(CONSOLE_DIM.width * CONSOLE_DIM.height, 0x00070000 | ' ');
+    cells[0] = 0x00520000 | ' ';                   // blank on background 5
+    cells[CONSOLE_DIM.width + 1] = 0x00030000 | 'W'; // row 1, column 1
+    renderer.update_text(&cells[0], all_rows(), 0x40, false);
+
+    const Framebuffer & text = renderer.text();
+    CHECK(text.row(0)[0] == 0x40000000);
+    CHECK(text.row(GUTTER_SIZE)[GUTTER_SIZE] == palette.colors[5]);
+    CHECK(text.row(GUTTER_SIZE + 9)[GUTTER_SIZE + 5] == palette.colors[5]);
+    CHECK(text.row(GUTTER_SIZE)[GUTTER_SIZE + 6] == 0x40000000);
+
+    // PatternGlyphSource leaves a one pixel border and otherwise covers
+    //   pixels fully or not at all
+    const std::uint8_t * w = glyphs.glyph('W');
+    bool glyph_drawn = (text.row(GUTTER_SIZE + 10)[GUTTER_SIZE + 6] == 0x40000000);
+    for (int y = 1; y < GLYPH_DIM.height - 1; ++y) {
+      for (int x = 1; x < GLYPH_DIM.width - 1; ++x) {
+        Pixel p = text.row(GUTTER_SIZE + 10 + y)[GUTTER_SIZE + 6 + x];
+        if (p != (w[y * GLYPH_DIM.width + x] ? palette.colors[3] : 0x40000000)) glyph_drawn = false;
+      }
+    }
+    CHECK(glyph_drawn);
+  }
+
+  // The reference hashes of a full redraw; any change to them is a change
+  //   to what the console looks like and should be made on purpose.
+  TEST(software_renderer_full_redraw_hashes) {
+    PatternGlyphSource glyphs(GLYPH_DIM);
+    Redraw fused = full_redraw(glyphs, sample_cells(false), true);
+    Redraw two_pass = full_redraw(glyphs, sample_cells(false), false);
+    Redraw filled = full_redraw(glyphs, sample_cells(true), false);
+    CHECK(fused.text == 0x456170d20c583c6bull);
+    CHECK(fused.composed == 0x21c57ae16af3f075ull);
+    CHECK(two_pass.text == 0x39b9a38a66583c6bull);
+    CHECK(two_pass.composed == 0x21c57ae16af3f075ull);
+    CHECK(filled.text == 0xf36f57bb95808c8bull);
+    CHECK(filled.composed == 0x532ab30839142943ull);
+    // the same picture either way
+    CHECK(fused.composed == two_pass.composed);
+  }
+
+  TEST(software_renderer_partial_update_matches_full_redraw) {
+    std::vector<Cell> previous = sample_cells(false);
+    std::vector<Cell> current = previous;
+    current[CONSOLE_DIM.width + 3] = 0x000e0000 | 'x';
+    current[3 * CONSOLE_DIM.width + 11] = 0x00010000 | ' ';
+    current[3 * CONSOLE_DIM.width] = 0x00010000 | 'y';
+    CHECK(update_matches_redraw(previous, current, 0, true));
+    CHECK(update_matches_redraw(previous, current, 0, false));
+
+    std::vector<Cell> filled = sample_cells(true);
+    std::vector<Cell> refilled = filled;
+    refilled[2 * CONSOLE_DIM.width + 5] = 0x00700000 | 'z';
+    CHECK(update_matches_redraw(filled, refilled, 0, false));
+    CHECK(update_matches_redraw(previous, filled, 0, false));
+    CHECK(update_matches_redraw(filled, previous, 0, false));
+  }
+
+  TEST(software_renderer_scrolled_update_matches_full_redraw) {
+    const int scrolls[] = { 1, 2, -1, 4, -4 };
+    std::vector<Cell> plain = sample_cells(false);
+    std::vector<Cell> filled = sample_cells(true);
+    for (int i = 0; i < 5; ++i) {
+      CHECK(update_matches_redraw(plain, scroll_cells(plain, scrolls[i]), scrolls[i], true));
+      CHECK(update_matches_redraw(plain, scroll_cells(plain, scrolls[i]), scrolls[i], false));
+      CHECK(update_matches_redraw(filled, scroll_cells(filled, scrolls[i]), scrolls[i], false));
+    }
+
+    // the damage only holds the new rows
+    DamageSet damage;
+    std::vector<Cell> scrolled = scroll_cells(plain, 2);
+    compute_damage(&scrolled[0], &plain[0], CONSOLE_DIM, 0xffffffff, 2, damage);
+    CHECK(damage.scroll() == 2);
+    CHECK(damage.size() == 2);
+  }
+
+  // Glyph edges over a filled cell are where draw_fused() and draw() part
+  //   ways, so the fused mode has to be left for as long as there are any,
+  //   including when only a few rows were damaged.
+  TEST(software_renderer_matches_two_pass_with_cell_backgrounds) {
+    const unsigned PRE_ALPHA = 100;
+    const unsigned POST_ALPHA = 200;
+    RampGlyphSource glyphs;
+    Palette palette;
+    SoftwareRenderer fused(glyphs, palette.colors, GUTTER_SIZE);
+    fused.set_fused_alpha(true);
+    fused.resize(CONSOLE_DIM);
+    SoftwareRenderer two_pass(glyphs, palette.colors, GUTTER_SIZE);
+    two_pass.resize(CONSOLE_DIM);
+
+    std::vector<Cell> plain = sample_cells(false);
+    std::vector<Cell> filled = sample_cells(true);
+    DamageSet damage = all_rows();
+    fused.update_text(&plain[0], damage, PRE_ALPHA, false);
+    two_pass.update_text(&plain[0], damage, PRE_ALPHA, false);
+    CHECK(fused.fused_alpha());
+    CHECK(!two_pass.fused_alpha());
+    CHECK(compose(fused, PRE_ALPHA, POST_ALPHA) == compose(two_pass, PRE_ALPHA, POST_ALPHA));
+
+    compute_damage(&filled[0], &plain[0], CONSOLE_DIM, 0xffffffff, damage);
+    CHECK(damage.size() == 1);
+    fused.update_text(&filled[0], damage, PRE_ALPHA, false);
+    two_pass.update_text(&filled[0], damage, PRE_ALPHA, false);
+    CHECK(!fused.fused_alpha());
+    CHECK(compose(fused, PRE_ALPHA, POST_ALPHA) == compose(two_pass, PRE_ALPHA, POST_ALPHA));
+
+    compute_damage(&plain[0], &filled[0], CONSOLE_DIM, 0xffffffff, damage);
+    fused.update_text(&plain[0], damage, PRE_ALPHA, false);
+    two_pass.update_text(&plain[0], damage, PRE_ALPHA, false);
+    CHECK(fused.fused_alpha());
+    CHECK(compose(fused, PRE_ALPHA, POST_ALPHA) == compose(two_pass, PRE_ALPHA, POST_ALPHA));
+  }
+}
\ No newline at end of file
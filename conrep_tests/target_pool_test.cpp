@@ -0,0 +1,116 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// target_pool_test.cpp
+// tests for target_bucket() and TargetPool, driven by simulated resizes
+
+#include "test.h"
+
+#include <vector>
+
+#include "../conrep/target_pool.h"
+
+namespace console {
+  namespace {
+    const std::uintptr_t WINDOW = 1;
+    const std::uintptr_t OTHER  = 2;
+
+    bool same_dim(Dimension dim, int width, int height) {
+      return (dim.width == width) && (dim.height == height);
+    }
+  }
+
+  TEST(target_bucket_rounds_up_by_a_quarter_power_of_two) {
+    CHECK(same_dim(target_bucket(Dimension(1, 64)), 64, 64));
+    CHECK(same_dim(target_bucket(Dimension(100, 640)), 128, 640));
+    CHECK(same_dim(target_bucket(Dimension(700, 1000)), 768, 1024));
+    CHECK(same_dim(target_bucket(Dimension(1300, 2049)), 1536, 2560));
+  }
+
+  // dragging a window edge a few pixels at a time reuses one target
+  TEST(target_pool_reuses_a_target_while_resizing) {
+    TargetPool pool(1000, 1 << 30, 4);
+    Dimension bucket = target_bucket(Dimension(650, 410));
+    CHECK(pool.acquire(Dimension(650, 410), WINDOW, 0) < 0);
+    int id = pool.add(bucket, WINDOW, 0);
+    for (int width = 652; width <= bucket.width; width += 2) {
+      pool.release(id, width);
+      CHECK(pool.acquire(Dimension(width, 410), WINDOW, width) == id);
+    }
+    CHECK(pool.counts().misses == 1);
+    CHECK(pool.counts().hits == static_cast<std::uint64_t>((bucket.width - 650) / 2));
+  }
+
+  TEST(target_pool_matches_keys_and_sizes) {
+    TargetPool pool(1000, 1 << 30, 4);
+    int small = pool.add(Dimension(256, 256), WINDOW, 0);
+    int large = pool.add(Dimension(1024, 1024), WINDOW, 0);
+    pool.release(small, 0);
+    pool.release(large, 0);
+
+    CHECK(pool.acquire(Dimension(200, 200), OTHER, 0) < 0);
+    CHECK(pool.acquire(Dimension(200, 200), WINDOW, 0) == small);
+    CHECK(pool.in_use(small));
+    // the large one is more than twice the area a 300x300 target needs
+    CHECK(pool.acquire(Dimension(300, 300), WINDOW, 0) < 0);
+    CHECK(pool.acquire(Dimension(900, 900), WINDOW, 0) == large);
+  }
+
+  TEST(target_pool_evicts_idle_targets) {
+    TargetPool pool(1000, 1 << 30, 4);
+    std::vector<int> evicted;
+    int a = pool.add(Dimension(64, 64), WINDOW, 0);
+    int b = pool.add(Dimension(64, 64), WINDOW, 0);
+    pool.release(a, 100);
+    pool.trim(1099, evicted);
+    CHECK(evicted.empty());
+    pool.trim(1100, evicted);
+    CHECK((evicted.size() == 1) && (evicted[0] == a));
+    CHECK(pool.counts().free_bytes == 0);
+    CHECK(pool.counts().used_bytes == 64 * 64 * 4);
+
+    // an evicted id is handed out again
+    CHECK(pool.add(Dimension(128, 128), WINDOW, 2000) == a);
+    CHECK(pool.in_use(b));
+  }
+
+  TEST(target_pool_evicts_the_oldest_past_the_limit) {
+    TargetPool pool(100000, 2 * 64 * 64 * 4, 4);
+    std::vector<int> evicted;
+    int a = pool.add(Dimension(64, 64), WINDOW, 0);
+    int b = pool.add(Dimension(64, 64), WINDOW, 0);
+    int c = pool.add(Dimension(64, 64), WINDOW, 0);
+    pool.release(b, 10);
+    pool.release(a, 20);
+    pool.release(c, 30);
+    pool.trim(40, evicted);
+    CHECK((evicted.size() == 1) && (evicted[0] == b));
+    CHECK(pool.counts().evictions == 1);
+  }
+
+  TEST(target_pool_survives_the_clock_wrapping) {
+    TargetPool pool(1000, 1 << 30, 4);
+    std::vector<int> evicted;
+    int id = pool.add(Dimension(64, 64), WINDOW, 0);
+    pool.release(id, 0xffffff00u);
+    pool.trim(0x100, evicted);
+    CHECK(evicted.empty());
+    pool.trim(0x300, evicted);
+    CHECK(evicted.size() == 1);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Just enough of a unit test framework for the parts of conrep that don't
+//   depend on Windows. Test cases register themselves during static
+//   initialization and test_main.cpp runs them all; a failed CHECK is
+//   reported and the test case carries on.
+
+#ifndef CONREP_TEST_H
+#define CONREP_TEST_H
+
+namespace test {
+  typedef void (*TestFunction)(void);
+
+  struct TestRegistrar {
+    TestRegistrar(const char * name, TestFunction function);
+  };
+
+  void check_failed(const char * file, int line, const char * expression);
+}
+
+#define TEST(name) \
+  static void name(void); \
+  static ::test::TestRegistrar name##_registrar(#name, &name); \
+  static void name(void)
+
+#define CHECK(expression) \
+  do { \
+    if (!(expression)) ::test::check_failed(__FILE__, __LINE__, #expression); \
+  } while (0)
+
+#endif
\ No newline at end of file
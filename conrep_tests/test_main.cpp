@@ -0,0 +1,75 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// test_main.cpp
+// runs every registered test case; with an argument, only the test cases
+//   whose names contain it
+
+#include "test.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace test {
+  namespace {
+    struct TestCase {
+      const char * name;
+      TestFunction function;
+    };
+
+    // function local so registration doesn't depend on the order the
+    //   translation units are initialized in
+    std::vector<TestCase> & test_cases(void) {
+      static std::vector<TestCase> cases;
+      return cases;
+    }
+
+    int failures = 0;
+  }
+
+  TestRegistrar::TestRegistrar(const char * name, TestFunction function) {
+    TestCase test_case = { name, function };
+    test_cases().push_back(test_case);
+  }
+
+  void check_failed(const char * file, int line, const char * expression) {
+    std::printf("%s(%d): CHECK(%s) failed\n", file, line, expression);
+    ++failures;
+  }
+}
+
+int main(int argc, char * argv[]) {
+  const char * filter = (argc > 1) ? argv[1] : 0;
+  const std::vector<test::TestCase> & cases = test::test_cases();
+  int run = 0;
+  int failed = 0;
+  for (size_t i = 0; i < cases.size(); ++i) {
+    if (filter && !std::strstr(cases[i].name, filter)) continue;
+    int before = test::failures;
+    cases[i].function();
+    ++run;
+    if (test::failures != before) {
+      std::printf("FAILED %s\n", cases[i].name);
+      ++failed;
+    }
+  }
+  std::printf("%d of %d test cases passed\n", run - failed, run);
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
\ No newline at end of file
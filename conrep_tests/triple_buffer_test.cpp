@@ -0,0 +1,120 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// triple_buffer_test.cpp
+// tests for TripleBuffer, including one that hands values between two
+//   threads as fast as they can go
+
+#include "test.h"
+
+#include <atomic>
+#include <thread>
+
+#include "../conrep/triple_buffer.h"
+
+namespace console {
+  namespace {
+    const int PAYLOAD_SIZE = 64;
+
+    // every word of the payload is derived from the sequence number, so a
+    //   slot written while it was being read shows up as a mismatch
+    struct Value {
+      unsigned sequence;
+      unsigned payload[PAYLOAD_SIZE];
+    };
+
+    void fill(Value & value, unsigned sequence) {
+      value.sequence = sequence;
+      for (int i = 0; i < PAYLOAD_SIZE; ++i) value.payload[i] = sequence * 2654435761u + i;
+    }
+
+    bool consistent(const Value & value) {
+      for (int i = 0; i < PAYLOAD_SIZE; ++i) {
+        if (value.payload[i] != value.sequence * 2654435761u + i) return false;
+      }
+      return true;
+    }
+  }
+
+  TEST(triple_buffer_acquires_nothing_before_a_publish) {
+    TripleBuffer<int> buffer;
+    CHECK(!buffer.acquire());
+    buffer.back() = 1;
+    buffer.publish();
+    CHECK(buffer.acquire());
+    CHECK(buffer.front() == 1);
+    CHECK(!buffer.acquire());
+    CHECK(buffer.front() == 1);
+  }
+
+  TEST(triple_buffer_acquires_the_latest_value) {
+    TripleBuffer<int> buffer;
+    for (int i = 1; i <= 5; ++i) {
+      buffer.back() = i;
+      buffer.publish();
+    }
+    CHECK(buffer.acquire());
+    CHECK(buffer.front() == 5);
+    buffer.back() = 6;
+    buffer.publish();
+    CHECK(buffer.front() == 5); // unchanged until acquired
+    CHECK(buffer.acquire());
+    CHECK(buffer.front() == 6);
+  }
+
+  // The consumer must only ever see whole values, in the order they were
+  //   published, and must end up with the last one.
+  TEST(triple_buffer_hands_off_between_threads) {
+    const unsigned LAST = 200000;
+    TripleBuffer<Value> buffer;
+    fill(buffer.front(), 0);
+    std::atomic<bool> done(false);
+
+    std::thread producer([&]() {
+      for (unsigned sequence = 1; sequence <= LAST; ++sequence) {
+        fill(buffer.back(), sequence);
+        buffer.publish();
+      }
+      done.store(true);
+    });
+
+    unsigned previous = 0;
+    unsigned acquired = 0;
+    bool torn = false;
+    bool out_of_order = false;
+    for (;;) {
+      // Read before acquiring: once the producer is seen to be done, its
+      //   last publish is visible to the acquire that follows.
+      bool finished = done.load();
+      if (buffer.acquire()) {
+        ++acquired;
+        const Value & value = buffer.front();
+        if (!consistent(value)) torn = true;
+        if (value.sequence <= previous) out_of_order = true;
+        previous = value.sequence;
+      }
+      if (finished) break;
+    }
+    producer.join();
+
+    CHECK(!torn);
+    CHECK(!out_of_order);
+    CHECK(previous == LAST);
+    CHECK(acquired > 0);
+  }
+}
\ No newline at end of file
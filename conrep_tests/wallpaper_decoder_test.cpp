@@ -0,0 +1,188 @@
+/* 
+ * Copyright 2007-2013 Howard Jeng <hjeng@cowfriendly.org>
+ * 
+ * This file is part of Conrep.
+ * 
+ * Conrep is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ * 
+ * Eraser is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License can be found at
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// wallpaper_decoder_test.cpp
+// tests for wallpaper_load_size() and WallpaperDecoder, the latter against
+//   an in memory wallpaper source
+
+#include "test.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../conrep/wallpaper_decoder.h"
+
+namespace console {
+  namespace {
+    // "solid" is a 400x300 image of one color, "slow" is the same but
+    //   blocks in read_rows() until released, "broken" throws and anything
+    //   else fails to open
+    class FakeSource : public IWallpaperSource {
+      public:
+        FakeSource() : reading_slow_(false), released_(false) {}
+
+        bool open(const std::wstring & name, Dimension & dim) {
+          if ((name != L"solid") && (name != L"slow") && (name != L"broken")) return false;
+          name_ = name;
+          dim = Dimension(400, 300);
+          return true;
+        }
+
+        bool read_rows(int, int count, Pixel * rows) {
+          if (name_ == L"broken") throw std::runtime_error("broken wallpaper");
+          if (name_ == L"slow") {
+            std::unique_lock<std::mutex> lock(mutex_);
+            reading_slow_ = true;
+            changed_.notify_all();
+            while (!released_) changed_.wait(lock);
+          }
+          std::fill(rows, rows + count * 400, 0xff336699);
+          return true;
+        }
+
+        void close(void) { name_.clear(); }
+
+        void wait_for_slow_read(void) {
+          std::unique_lock<std::mutex> lock(mutex_);
+          while (!reading_slow_) changed_.wait(lock);
+        }
+
+        void release(void) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          released_ = true;
+          changed_.notify_all();
+        }
+      private:
+        std::wstring name_; // only touched on the worker thread
+        std::mutex mutex_;
+        std::condition_variable changed_;
+        bool reading_slow_;
+        bool released_;
+    };
+
+    WallpaperRequest make_request(const wchar_t * name) {
+      WallpaperRequest request;
+      request.name = name;
+      request.scale = SCALE_FILL;
+      request.monitors.push_back(Dimension(200, 150));
+      request.max_size = Dimension(4096, 4096);
+      return request;
+    }
+
+    // take() until a result or an exception arrives, giving up after a few
+    //   seconds
+    bool wait_for_result(WallpaperDecoder & decoder, DecodedWallpaper & result) {
+      for (int i = 0; i < 5000; ++i) {
+        if (decoder.take(result)) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      return false;
+    }
+  }
+
+  TEST(wallpaper_load_size_scales_to_fit_or_fill) {
+    std::vector<Dimension> monitors(1, Dimension(1280, 1024));
+    Dimension max_size(8192, 8192);
+    Dimension image(7680, 4320);
+
+    Dimension fit = wallpaper_load_size(image, SCALE_FIT, monitors, max_size);
+    CHECK((fit.width == 1280) && (fit.height == 720));
+    Dimension fill = wallpaper_load_size(image, SCALE_FILL, monitors, max_size);
+    CHECK((fill.width == 1820) && (fill.height == 1024));
+    Dimension none = wallpaper_load_size(image, SCALE_NONE, monitors, max_size);
+    CHECK((none.width == 7680) && (none.height == 4320));
+  }
+
+  TEST(wallpaper_load_size_shrinks_to_the_largest_monitor) {
+    std::vector<Dimension> monitors;
+    monitors.push_back(Dimension(1280, 1024));
+    monitors.push_back(Dimension(1920, 1080));
+    Dimension fit = wallpaper_load_size(Dimension(7680, 4320), SCALE_FIT, monitors, Dimension(8192, 8192));
+    CHECK((fit.width == 1920) && (fit.height == 1080));
+  }
+
+  TEST(wallpaper_load_size_never_enlarges_and_respects_the_maximum) {
+    std::vector<Dimension> monitors(1, Dimension(2560, 1440));
+    Dimension small = wallpaper_load_size(Dimension(800, 600), SCALE_FILL, monitors, Dimension(4096, 4096));
+    CHECK((small.width == 800) && (small.height == 600));
+    Dimension capped = wallpaper_load_size(Dimension(8000, 2000), SCALE_NONE, monitors, Dimension(4000, 4000));
+    CHECK((capped.width == 4000) && (capped.height == 1000));
+  }
+
+  TEST(wallpaper_decoder_hands_over_a_shrunk_wallpaper) {
+    FakeSource source;
+    std::atomic<int> notified(0);
+    WallpaperDecoder decoder(source, [&]() { ++notified; });
+    unsigned generation = decoder.request(make_request(L"solid"));
+
+    DecodedWallpaper result;
+    CHECK(wait_for_result(decoder, result));
+    CHECK(result.generation == generation);
+    CHECK(result.loaded);
+    CHECK((result.dim.width == 200) && (result.dim.height == 150));
+    CHECK(result.pixels == std::vector<Pixel>(200 * 150, 0xff336699));
+    CHECK(notified.load() == 1);
+    CHECK(!decoder.take(result));
+  }
+
+  TEST(wallpaper_decoder_reports_an_unreadable_wallpaper) {
+    FakeSource source;
+    WallpaperDecoder decoder(source, []() {});
+    decoder.request(make_request(L"missing"));
+    DecodedWallpaper result;
+    CHECK(wait_for_result(decoder, result));
+    CHECK(!result.loaded);
+    CHECK(result.pixels.empty());
+  }
+
+  TEST(wallpaper_decoder_hands_over_only_the_newest_request) {
+    FakeSource source;
+    WallpaperDecoder decoder(source, []() {});
+    decoder.request(make_request(L"slow"));
+    source.wait_for_slow_read();
+    WallpaperRequest newer = make_request(L"solid");
+    newer.monitors[0] = Dimension(100, 75);
+    unsigned generation = decoder.request(newer);
+    source.release();
+
+    DecodedWallpaper result;
+    CHECK(wait_for_result(decoder, result));
+    CHECK(result.generation == generation);
+    CHECK((result.dim.width == 100) && (result.dim.height == 75));
+  }
+
+  TEST(wallpaper_decoder_rethrows_worker_exceptions) {
+    FakeSource source;
+    WallpaperDecoder decoder(source, []() {});
+    decoder.request(make_request(L"broken"));
+    bool thrown = false;
+    try {
+      DecodedWallpaper result;
+      wait_for_result(decoder, result);
+    } catch (std::runtime_error &) {
+      thrown = true;
+    }
+    CHECK(thrown);
+  }
+}
\ No newline at end of file